@@ -0,0 +1,252 @@
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+#include <glm/glm.hpp>
+
+#include "profiler.hpp"
+#include "benchmark.hpp"
+
+static glm::vec3 catmullRom(const glm::vec3 & p0, const glm::vec3 & p1, const glm::vec3 & p2, const glm::vec3 & p3, float t){
+	float t2 = t * t;
+	float t3 = t2 * t;
+	return 0.5f * ((2.0f * p1) + (p2 - p0) * t + (2.0f*p0 - 5.0f*p1 + 4.0f*p2 - p3) * t2 + (3.0f*p1 - p0 - 3.0f*p2 + p3) * t3);
+}
+
+void sampleCameraPath(const CameraKey * keys, int keyCount, float time, glm::vec3 & position, glm::vec3 & target){
+	if (time <= keys[0].time || keyCount == 1){
+		position = keys[0].position;
+		target = keys[0].target;
+		return;
+	}
+	if (time >= keys[keyCount-1].time){
+		position = keys[keyCount-1].position;
+		target = keys[keyCount-1].target;
+		return;
+	}
+
+	int i = 0;
+	while (keys[i+1].time <= time)
+		i++;
+	const CameraKey & k0 = keys[std::max(i-1, 0)];
+	const CameraKey & k1 = keys[i];
+	const CameraKey & k2 = keys[i+1];
+	const CameraKey & k3 = keys[std::min(i+2, keyCount-1)];
+	float t = (time - k1.time) / (k2.time - k1.time);
+	position = catmullRom(k0.position, k1.position, k2.position, k3.position, t);
+	target = catmullRom(k0.target, k1.target, k2.target, k3.target, t);
+}
+
+long getPeakMemoryKB(){
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return (long)(counters.PeakWorkingSetSize / 1024);
+	return -1;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return -1;
+#ifdef __APPLE__
+	return usage.ru_maxrss / 1024; // Bytes on OS X
+#else
+	return usage.ru_maxrss;        // Kilobytes on Linux
+#endif
+#endif
+}
+
+unsigned int hashBytes(const unsigned char * data, size_t size){
+	unsigned int hash = 2166136261u;
+	for (size_t i=0; i<size; i++){
+		hash ^= data[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static double milliseconds(std::chrono::steady_clock::duration d){
+	return std::chrono::duration<double, std::milli>(d).count();
+}
+
+// Nearest rank, on sorted values
+static float percentile(const std::vector<float> & sorted, float p){
+	if (sorted.empty())
+		return 0.0f;
+	int rank = (int)(p / 100.0f * sorted.size() + 0.5f);
+	rank = std::min(std::max(rank, 1), (int)sorted.size());
+	return sorted[rank - 1];
+}
+
+Benchmark::Benchmark(){
+	phaseStart = Clock::now();
+#ifdef ENABLE_PROFILER
+	phaseTimestamp = profilerTimestamp();
+#endif
+	startupMs = 0.0;
+	inFrame = false;
+	currentDrawCalls = 0;
+	imageChecksum = 0;
+	peakMemoryKB = -1;
+	meanMs = p50Ms = p95Ms = p99Ms = maxMs = 0.0f;
+	meanDrawCalls = 0.0f;
+	maxDrawCalls = 0;
+}
+
+void Benchmark::endPhase(const char * name){
+	Clock::time_point now = Clock::now();
+	Phase phase = { name, milliseconds(now - phaseStart) };
+	phases.push_back(phase);
+	startupMs += phase.ms;
+	phaseStart = now;
+#ifdef ENABLE_PROFILER
+	uint64_t timestamp = profilerTimestamp();
+	if (profilerRecording)
+		profilerRecord(name, phaseTimestamp, timestamp);
+	phaseTimestamp = timestamp;
+#endif
+}
+
+void Benchmark::beginFrame(){
+	Clock::time_point now = Clock::now();
+	if (inFrame){
+		frameMs.push_back((float)milliseconds(now - frameStart));
+		drawCalls.push_back(currentDrawCalls);
+	}
+	frameStart = now;
+	inFrame = true;
+	currentDrawCalls = 0;
+}
+
+void Benchmark::finish(unsigned int imageChecksum){
+	beginFrame(); // Closes the last frame
+	inFrame = false;
+	this->imageChecksum = imageChecksum;
+	peakMemoryKB = getPeakMemoryKB();
+
+	std::vector<float> sorted = frameMs;
+	std::sort(sorted.begin(), sorted.end());
+	double sum = 0.0;
+	for (size_t i=0; i<sorted.size(); i++)
+		sum += sorted[i];
+	meanMs = sorted.empty() ? 0.0f : (float)(sum / sorted.size());
+	p50Ms = percentile(sorted, 50.0f);
+	p95Ms = percentile(sorted, 95.0f);
+	p99Ms = percentile(sorted, 99.0f);
+	maxMs = sorted.empty() ? 0.0f : sorted.back();
+
+	long drawSum = 0;
+	maxDrawCalls = 0;
+	for (size_t i=0; i<drawCalls.size(); i++){
+		drawSum += drawCalls[i];
+		maxDrawCalls = std::max(maxDrawCalls, drawCalls[i]);
+	}
+	meanDrawCalls = drawCalls.empty() ? 0.0f : (float)drawSum / drawCalls.size();
+}
+
+void Benchmark::printSummary() const {
+	printf("Benchmark : %d frames\n", (int)frameMs.size());
+	for (size_t i=0; i<phases.size(); i++)
+		printf("  startup %-10s %8.2f ms\n", phases[i].name, phases[i].ms);
+	printf("  startup total      %8.2f ms\n", startupMs);
+	printf("  frame mean %.3f ms, p50 %.3f ms, p95 %.3f ms, p99 %.3f ms, max %.3f ms\n", meanMs, p50Ms, p95Ms, p99Ms, maxMs);
+	printf("  draw calls mean %.1f, max %d\n", meanDrawCalls, maxDrawCalls);
+	printf("  peak memory %ld KB\n", peakMemoryKB);
+	if (imageChecksum)
+		printf("  last frame checksum 0x%08x\n", imageChecksum);
+}
+
+bool Benchmark::writeJSON(const char * path) const {
+	FILE * file = fopen(path, "w");
+	if (file == NULL){
+		printf("Impossible to open %s\n", path);
+		return false;
+	}
+	fprintf(file, "{\n");
+	fprintf(file, "\t\"frames\": %d,\n", (int)frameMs.size());
+	fprintf(file, "\t\"startup_ms\": {");
+	for (size_t i=0; i<phases.size(); i++)
+		fprintf(file, " \"%s\": %.3f,", phases[i].name, phases[i].ms);
+	fprintf(file, " \"total\": %.3f },\n", startupMs);
+	fprintf(file, "\t\"frame_ms\": { \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f },\n", meanMs, p50Ms, p95Ms, p99Ms, maxMs);
+	fprintf(file, "\t\"draw_calls\": { \"mean\": %.2f, \"max\": %d },\n", meanDrawCalls, maxDrawCalls);
+	fprintf(file, "\t\"peak_memory_kb\": %ld,\n", peakMemoryKB);
+	fprintf(file, "\t\"image_checksum\": %u\n", imageChecksum);
+	fprintf(file, "}\n");
+	fclose(file);
+	return true;
+}
+
+// Reads "key": number, inside the object "section" if there is one.
+// Enough for the files written above, not a general JSON parser.
+static bool readNumber(const std::string & json, const char * section, const char * key, double & value){
+	size_t start = 0;
+	if (section){
+		start = json.find(std::string("\"") + section + "\"");
+		if (start == std::string::npos)
+			return false;
+	}
+	size_t position = json.find(std::string("\"") + key + "\"", start);
+	if (position == std::string::npos)
+		return false;
+	position = json.find(':', position);
+	if (position == std::string::npos)
+		return false;
+	value = strtod(json.c_str() + position + 1, NULL);
+	return true;
+}
+
+// Lower is better for every measure
+static bool checkMeasure(const std::string & baseline, const char * section, const char * key, const char * label, double current, float threshold){
+	double reference;
+	if (!readNumber(baseline, section, key, reference) || reference <= 0.0){
+		printf("  %-18s %10.3f    (not in the baseline)\n", label, current);
+		return true;
+	}
+	double change = (current - reference) / reference;
+	bool ok = change <= threshold;
+	printf("  %-18s %10.3f vs %10.3f  %+6.1f%%  %s\n", label, current, reference, 100.0 * change, ok ? "ok" : "REGRESSION");
+	return ok;
+}
+
+bool Benchmark::compareWithBaseline(const char * path, float threshold) const {
+	FILE * file = fopen(path, "rb");
+	if (file == NULL){
+		printf("Impossible to open the baseline %s\n", path);
+		return false;
+	}
+	std::string baseline;
+	char buffer[1024];
+	size_t read;
+	while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		baseline.append(buffer, read);
+	fclose(file);
+
+	printf("Comparison with %s, %.0f%% allowed :\n", path, 100.0f * threshold);
+	bool ok = true;
+	ok &= checkMeasure(baseline, "startup_ms", "total", "startup ms", startupMs, threshold);
+	ok &= checkMeasure(baseline, "frame_ms", "p50", "frame p50 ms", p50Ms, threshold);
+	ok &= checkMeasure(baseline, "frame_ms", "p95", "frame p95 ms", p95Ms, threshold);
+	ok &= checkMeasure(baseline, "frame_ms", "p99", "frame p99 ms", p99Ms, threshold);
+	ok &= checkMeasure(baseline, "draw_calls", "mean", "draw calls", meanDrawCalls, threshold);
+	ok &= checkMeasure(baseline, NULL, "peak_memory_kb", "peak memory KB", (double)peakMemoryKB, threshold);
+
+	// The run is deterministic : any difference in the last frame is a rendering change
+	double referenceChecksum;
+	if (imageChecksum && readNumber(baseline, NULL, "image_checksum", referenceChecksum) && referenceChecksum != 0.0){
+		bool same = (unsigned int)referenceChecksum == imageChecksum;
+		printf("  %-18s 0x%08x vs 0x%08x  %s\n", "last frame", imageChecksum, (unsigned int)referenceChecksum, same ? "ok" : "DIFFERENT");
+		ok &= same;
+	}
+	return ok;
+}
@@ -0,0 +1,78 @@
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+#include <chrono>
+
+// Benchmark mode.
+// The game runs a fixed number of frames at a fixed simulated time step, with
+// the camera on a scripted path, so that two runs do exactly the same work.
+// Startup phases, CPU frame times, draw calls and memory are recorded and
+// written as JSON, and can be checked against the JSON of an earlier run.
+
+// A point of a scripted camera path
+struct CameraKey {
+	float time;       // Seconds of simulated time
+	glm::vec3 position;
+	glm::vec3 target; // Where the camera looks
+};
+
+// Camera at a given time along a path, smoothly interpolated (Catmull-Rom) between the keys.
+// The path is clamped to its first and last keys.
+void sampleCameraPath(const CameraKey * keys, int keyCount, float time, glm::vec3 & position, glm::vec3 & target);
+
+class Benchmark {
+public:
+	// Starts the clock of the first startup phase
+	Benchmark();
+
+	// Ends the current startup phase, and starts the next one
+	void endPhase(const char * name);
+
+	// Frame times are measured from one beginFrame() to the next
+	void beginFrame();
+	void setDrawCalls(int drawCalls) { currentDrawCalls = drawCalls; }
+
+	// Stops the measures. imageChecksum identifies the last frame, 0 if unknown.
+	void finish(unsigned int imageChecksum = 0);
+
+	void printSummary() const;
+	bool writeJSON(const char * path) const;
+
+	// Compares with the JSON of an earlier run. Returns false if a measure is worse by more
+	// than threshold (0.1 = 10%), or if the last frame differs.
+	bool compareWithBaseline(const char * path, float threshold) const;
+
+private:
+	struct Phase {
+		const char * name;
+		double ms;
+	};
+	typedef std::chrono::steady_clock Clock;
+
+	Clock::time_point phaseStart;
+#ifdef ENABLE_PROFILER
+	uint64_t phaseTimestamp; // Startup phases show up in the trace too
+#endif
+	std::vector<Phase> phases;
+	double startupMs;
+	Clock::time_point frameStart;
+	bool inFrame;
+	int currentDrawCalls;
+	std::vector<float> frameMs;
+	std::vector<int> drawCalls;
+	unsigned int imageChecksum;
+	long peakMemoryKB;
+
+	// Computed by finish()
+	float meanMs, p50Ms, p95Ms, p99Ms, maxMs;
+	float meanDrawCalls;
+	int maxDrawCalls;
+};
+
+// Peak resident memory of the process in kilobytes, -1 if unknown
+long getPeakMemoryKB();
+
+// FNV-1a hash, to tell whether two frames are identical
+unsigned int hashBytes(const unsigned char * data, size_t size);
+
+#endif
@@ -0,0 +1,993 @@
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BVH_USE_SSE
+#endif
+
+#include "objloader.hpp"
+#include "occlusion.hpp"
+#include "jobsystem.hpp"
+#include "profiler.hpp"
+#include "bvh.hpp"
+
+static const size_t CACHE_LINE = 64;
+static const int BIN_COUNT = 16;      // Candidate splits per axis of the surface area heuristic
+static const int MAX_BUILD_DEPTH = 40; // Past it, nodes are split in the middle, so that they halve
+// Deepest the tree gets : MAX_BUILD_DEPTH levels, then halving down to 4 triangles, 29 levels at
+// most for an int count. A level of the traversal pops one node and pushes at most 4.
+static const int MAX_TREE_DEPTH = MAX_BUILD_DEPTH + 30;
+static const int STACK_SIZE = 3 * MAX_TREE_DEPTH + 8;
+
+// Two cache lines : the boxes of 4 children, one per lane
+struct TriangleBVH::Node {
+	float minX[4], minY[4], minZ[4];
+	float maxX[4], maxY[4], maxZ[4];
+	int children[4]; // Node index, or ~leaf index when negative
+	int padding[4];
+};
+
+// Three cache lines : 4 triangles, one per lane, as a corner and two edges
+struct TriangleBVH::Leaf {
+	float v0x[4], v0y[4], v0z[4];
+	float e1x[4], e1y[4], e1z[4]; // v1 - v0
+	float e2x[4], e2y[4], e2z[4]; // v2 - v0
+	int triangles[4];             // -1 for an empty lane
+	int padding[8];
+};
+
+static void * allocateAligned(size_t size){
+	unsigned char * block = (unsigned char *)malloc(size + CACHE_LINE + sizeof(void *));
+	if (block == NULL)
+		return NULL;
+	uintptr_t aligned = ((uintptr_t)block + sizeof(void *) + CACHE_LINE - 1) & ~(uintptr_t)(CACHE_LINE - 1);
+	((void **)aligned)[-1] = block;
+	return (void *)aligned;
+}
+
+static void freeAligned(void * pointer){
+	if (pointer)
+		free(((void **)pointer)[-1]);
+}
+
+// Building
+
+struct BuildRef {
+	glm::vec3 aabbMin, aabbMax, centroid;
+	int triangle;
+};
+
+struct BuildNode {
+	glm::vec3 aabbMin, aabbMax;
+	int left, right; // -1 for a leaf
+	int first, count; // Refs of a leaf
+};
+
+static float surfaceArea(const glm::vec3 & aabbMin, const glm::vec3 & aabbMax){
+	glm::vec3 d = glm::max(aabbMax - aabbMin, glm::vec3(0.0f));
+	return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+static int buildBinary(std::vector<BuildNode> & nodes, std::vector<BuildRef> & refs, int first, int count, int depth){
+	BuildNode node;
+	node.aabbMin = glm::vec3(FLT_MAX);
+	node.aabbMax = glm::vec3(-FLT_MAX);
+	glm::vec3 centroidMin(FLT_MAX), centroidMax(-FLT_MAX);
+	for (int i=first; i<first+count; i++){
+		node.aabbMin = glm::min(node.aabbMin, refs[i].aabbMin);
+		node.aabbMax = glm::max(node.aabbMax, refs[i].aabbMax);
+		centroidMin = glm::min(centroidMin, refs[i].centroid);
+		centroidMax = glm::max(centroidMax, refs[i].centroid);
+	}
+	node.left = node.right = -1;
+	node.first = first;
+	node.count = count;
+	int index = (int)nodes.size();
+	nodes.push_back(node);
+	if (count <= 4)
+		return index; // One leaf lane per triangle
+
+	// Binned surface area heuristic : the cheapest of BIN_COUNT-1 planes on each axis
+	int bestAxis = -1, bestSplit = 0;
+	float bestCost = FLT_MAX;
+	if (depth < MAX_BUILD_DEPTH){
+		for (int axis=0; axis<3; axis++){
+			float extent = centroidMax[axis] - centroidMin[axis];
+			if (extent <= 0.0f)
+				continue;
+			glm::vec3 binMin[BIN_COUNT], binMax[BIN_COUNT];
+			int binCount[BIN_COUNT];
+			for (int b=0; b<BIN_COUNT; b++){
+				binMin[b] = glm::vec3(FLT_MAX);
+				binMax[b] = glm::vec3(-FLT_MAX);
+				binCount[b] = 0;
+			}
+			float scale = BIN_COUNT / extent;
+			for (int i=first; i<first+count; i++){
+				int b = std::min(BIN_COUNT - 1, (int)((refs[i].centroid[axis] - centroidMin[axis]) * scale));
+				binMin[b] = glm::min(binMin[b], refs[i].aabbMin);
+				binMax[b] = glm::max(binMax[b], refs[i].aabbMax);
+				binCount[b]++;
+			}
+			// Areas and counts left of each plane, then right of it
+			float leftArea[BIN_COUNT];
+			int leftCount[BIN_COUNT];
+			glm::vec3 sweepMin(FLT_MAX), sweepMax(-FLT_MAX);
+			int sweepCount = 0;
+			for (int b=0; b<BIN_COUNT-1; b++){
+				sweepMin = glm::min(sweepMin, binMin[b]);
+				sweepMax = glm::max(sweepMax, binMax[b]);
+				sweepCount += binCount[b];
+				leftArea[b] = surfaceArea(sweepMin, sweepMax);
+				leftCount[b] = sweepCount;
+			}
+			sweepMin = glm::vec3(FLT_MAX);
+			sweepMax = glm::vec3(-FLT_MAX);
+			sweepCount = 0;
+			for (int b=BIN_COUNT-1; b>0; b--){
+				sweepMin = glm::min(sweepMin, binMin[b]);
+				sweepMax = glm::max(sweepMax, binMax[b]);
+				sweepCount += binCount[b];
+				if (leftCount[b-1] == 0 || sweepCount == 0)
+					continue;
+				float cost = leftArea[b-1] * leftCount[b-1] + surfaceArea(sweepMin, sweepMax) * sweepCount;
+				if (cost < bestCost){
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = b;
+				}
+			}
+		}
+	}
+
+	int middle;
+	if (bestAxis >= 0){
+		float scale = BIN_COUNT / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+		BuildRef * split = std::partition(&refs[first], &refs[first] + count, [&](const BuildRef & ref){
+			return std::min(BIN_COUNT - 1, (int)((ref.centroid[bestAxis] - centroidMin[bestAxis]) * scale)) < bestSplit;
+		});
+		middle = (int)(split - &refs[0]);
+	}else{
+		// Every centroid in the same place, or too deep : halves along the longest axis
+		glm::vec3 extent = centroidMax - centroidMin;
+		int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+		middle = first + count / 2;
+		std::nth_element(&refs[first], &refs[middle], &refs[first] + count, [axis](const BuildRef & a, const BuildRef & b){
+			return a.centroid[axis] < b.centroid[axis];
+		});
+	}
+
+	int left = buildBinary(nodes, refs, first, middle - first, depth + 1);
+	int right = buildBinary(nodes, refs, middle, first + count - middle, depth + 1);
+	nodes[index].left = left;
+	nodes[index].right = right;
+	return index;
+}
+
+struct Collapser {
+	const std::vector<BuildNode> & binary;
+	const std::vector<BuildRef> & refs;
+	const std::vector<glm::vec3> & triangles;
+	std::vector<TriangleBVH::Node> & nodes;
+	std::vector<TriangleBVH::Leaf> & leaves;
+
+	int makeLeaf(const BuildNode & source){
+		TriangleBVH::Leaf leaf;
+		memset(&leaf, 0, sizeof(leaf));
+		for (int lane=0; lane<4; lane++){
+			leaf.triangles[lane] = -1;
+			if (lane >= source.count)
+				continue; // Zero edges : never hit
+			int triangle = refs[source.first + lane].triangle;
+			glm::vec3 v0 = triangles[3*triangle];
+			glm::vec3 e1 = triangles[3*triangle + 1] - v0;
+			glm::vec3 e2 = triangles[3*triangle + 2] - v0;
+			leaf.v0x[lane] = v0.x; leaf.v0y[lane] = v0.y; leaf.v0z[lane] = v0.z;
+			leaf.e1x[lane] = e1.x; leaf.e1y[lane] = e1.y; leaf.e1z[lane] = e1.z;
+			leaf.e2x[lane] = e2.x; leaf.e2y[lane] = e2.y; leaf.e2z[lane] = e2.z;
+			leaf.triangles[lane] = triangle;
+		}
+		leaves.push_back(leaf);
+		return (int)leaves.size() - 1;
+	}
+
+	// Pulls the grandchildren of the biggest inner children up, until there are 4 of them
+	int collapse(int index){
+		int children[4] = { binary[index].left, binary[index].right, -1, -1 };
+		int count = 2;
+		while (count < 4){
+			int biggest = -1;
+			float biggestArea = -1.0f;
+			for (int c=0; c<count; c++){
+				const BuildNode & child = binary[children[c]];
+				float area = surfaceArea(child.aabbMin, child.aabbMax);
+				if (child.left >= 0 && area > biggestArea){
+					biggest = c;
+					biggestArea = area;
+				}
+			}
+			if (biggest < 0)
+				break;
+			int opened = children[biggest];
+			children[biggest] = binary[opened].left;
+			children[count++] = binary[opened].right;
+		}
+
+		int nodeIndex = (int)nodes.size();
+		nodes.push_back(TriangleBVH::Node());
+		for (int c=0; c<4; c++){
+			// Empty lanes have inverted bounds : no ray enters them
+			glm::vec3 aabbMin(FLT_MAX), aabbMax(-FLT_MAX);
+			int code = 0;
+			if (c < count){
+				const BuildNode & child = binary[children[c]];
+				aabbMin = child.aabbMin;
+				aabbMax = child.aabbMax;
+				code = child.left < 0 ? ~makeLeaf(child) : collapse(children[c]);
+			}
+			TriangleBVH::Node & node = nodes[nodeIndex]; // After the recursion, which may move the array
+			node.minX[c] = aabbMin.x; node.minY[c] = aabbMin.y; node.minZ[c] = aabbMin.z;
+			node.maxX[c] = aabbMax.x; node.maxY[c] = aabbMax.y; node.maxZ[c] = aabbMax.z;
+			node.children[c] = code;
+			node.padding[c] = 0;
+		}
+		return nodeIndex;
+	}
+};
+
+TriangleBVH::TriangleBVH(){
+	nodes = NULL;
+	leaves = NULL;
+	nodeCount = leafCount = triangleCount = 0;
+}
+
+TriangleBVH::~TriangleBVH(){
+	release();
+}
+
+void TriangleBVH::release(){
+	freeAligned(nodes);
+	freeAligned(leaves);
+	nodes = NULL;
+	leaves = NULL;
+	nodeCount = leafCount = triangleCount = 0;
+}
+
+void TriangleBVH::build(const std::vector<glm::vec3> & triangles){
+	PROFILE_FUNCTION();
+	release();
+	triangleCount = (int)triangles.size() / 3;
+	if (triangleCount == 0)
+		return;
+
+	std::vector<BuildRef> refs(triangleCount);
+	for (int t=0; t<triangleCount; t++){
+		const glm::vec3 & a = triangles[3*t], & b = triangles[3*t + 1], & c = triangles[3*t + 2];
+		refs[t].aabbMin = glm::min(a, glm::min(b, c));
+		refs[t].aabbMax = glm::max(a, glm::max(b, c));
+		refs[t].centroid = 0.5f * (refs[t].aabbMin + refs[t].aabbMax);
+		refs[t].triangle = t;
+	}
+	std::vector<BuildNode> binary;
+	binary.reserve(2 * triangleCount / 4 + 1);
+	buildBinary(binary, refs, 0, triangleCount, 0);
+
+	std::vector<Node> flatNodes;
+	std::vector<Leaf> flatLeaves;
+	Collapser collapser = { binary, refs, triangles, flatNodes, flatLeaves };
+	if (binary[0].left < 0){
+		// A few triangles : a root with a single leaf
+		const BuildNode & root = binary[0];
+		Node node;
+		for (int c=0; c<4; c++){
+			node.minX[c] = node.minY[c] = node.minZ[c] = FLT_MAX;
+			node.maxX[c] = node.maxY[c] = node.maxZ[c] = -FLT_MAX;
+			node.children[c] = 0;
+			node.padding[c] = 0;
+		}
+		node.minX[0] = root.aabbMin.x; node.minY[0] = root.aabbMin.y; node.minZ[0] = root.aabbMin.z;
+		node.maxX[0] = root.aabbMax.x; node.maxY[0] = root.aabbMax.y; node.maxZ[0] = root.aabbMax.z;
+		node.children[0] = ~collapser.makeLeaf(root);
+		flatNodes.push_back(node);
+	}else{
+		collapser.collapse(0);
+	}
+
+	// Copied into blocks aligned on cache lines
+	nodeCount = (int)flatNodes.size();
+	leafCount = (int)flatLeaves.size();
+	nodes = (Node *)allocateAligned(nodeCount * sizeof(Node));
+	leaves = (Leaf *)allocateAligned(leafCount * sizeof(Leaf));
+	memcpy(nodes, &flatNodes[0], nodeCount * sizeof(Node));
+	memcpy(leaves, &flatLeaves[0], leafCount * sizeof(Leaf));
+}
+
+size_t TriangleBVH::getMemoryBytes() const {
+	return nodeCount * sizeof(Node) + leafCount * sizeof(Leaf);
+}
+
+// Queries
+
+// A ray, or the motion of a sphere, ready for the box tests
+struct RaySetup {
+	float origin[3], direction[3], inverse[3];
+	bool negative[3]; // The far side of a box is its min on this axis
+};
+
+static void setupRay(RaySetup & ray, const glm::vec3 & origin, const glm::vec3 & direction){
+	for (int axis=0; axis<3; axis++){
+		ray.origin[axis] = origin[axis];
+		ray.direction[axis] = direction[axis];
+		// No division by 0 : no infinity, so no NaN where the ray starts on a slab
+		float d = fabsf(direction[axis]) > 1e-20f ? direction[axis] : (direction[axis] < 0.0f ? -1e-20f : 1e-20f);
+		ray.inverse[axis] = 1.0f / d;
+		ray.negative[axis] = d < 0.0f;
+	}
+}
+
+// Mask of the children the ray enters between 0 and maxDistance, and where. The boxes grow by radius, for sweeps.
+static int intersectBoxes(const TriangleBVH::Node & node, const RaySetup & ray, float radius, float maxDistance, float entry[4]){
+	const float * nearX = ray.negative[0] ? node.maxX : node.minX, * farX = ray.negative[0] ? node.minX : node.maxX;
+	const float * nearY = ray.negative[1] ? node.maxY : node.minY, * farY = ray.negative[1] ? node.minY : node.maxY;
+	const float * nearZ = ray.negative[2] ? node.maxZ : node.minZ, * farZ = ray.negative[2] ? node.minZ : node.maxZ;
+	float growX = ray.negative[0] ? radius : -radius, growY = ray.negative[1] ? radius : -radius, growZ = ray.negative[2] ? radius : -radius;
+#ifdef BVH_USE_SSE
+	__m128 ox = _mm_set1_ps(ray.origin[0] - growX), oy = _mm_set1_ps(ray.origin[1] - growY), oz = _mm_set1_ps(ray.origin[2] - growZ);
+	__m128 fx = _mm_set1_ps(ray.origin[0] + growX), fy = _mm_set1_ps(ray.origin[1] + growY), fz = _mm_set1_ps(ray.origin[2] + growZ);
+	__m128 ix = _mm_set1_ps(ray.inverse[0]), iy = _mm_set1_ps(ray.inverse[1]), iz = _mm_set1_ps(ray.inverse[2]);
+	__m128 tNear = _mm_max_ps(
+		_mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(nearX), ox), ix), _mm_mul_ps(_mm_sub_ps(_mm_load_ps(nearY), oy), iy)),
+		_mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(nearZ), oz), iz), _mm_setzero_ps()));
+	__m128 tFar = _mm_min_ps(
+		_mm_min_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(farX), fx), ix), _mm_mul_ps(_mm_sub_ps(_mm_load_ps(farY), fy), iy)),
+		_mm_min_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(farZ), fz), iz), _mm_set1_ps(maxDistance)));
+	_mm_storeu_ps(entry, tNear);
+	return _mm_movemask_ps(_mm_cmple_ps(tNear, tFar));
+#else
+	int mask = 0;
+	for (int c=0; c<4; c++){
+		float tNear = std::max(std::max((nearX[c] + growX - ray.origin[0]) * ray.inverse[0], (nearY[c] + growY - ray.origin[1]) * ray.inverse[1]),
+		                       std::max((nearZ[c] + growZ - ray.origin[2]) * ray.inverse[2], 0.0f));
+		float tFar = std::min(std::min((farX[c] - growX - ray.origin[0]) * ray.inverse[0], (farY[c] - growY - ray.origin[1]) * ray.inverse[1]),
+		                      std::min((farZ[c] - growZ - ray.origin[2]) * ray.inverse[2], maxDistance));
+		entry[c] = tNear;
+		mask |= tNear <= tFar ? 1 << c : 0;
+	}
+	return mask;
+#endif
+}
+
+// Mask of the triangles of the leaf the ray hits between 0 and maxDistance (Moller-Trumbore), and where
+static int intersectTriangles(const TriangleBVH::Leaf & leaf, const RaySetup & ray, float maxDistance, float t[4], float u[4], float v[4]){
+#ifdef BVH_USE_SSE
+	__m128 dx = _mm_set1_ps(ray.direction[0]), dy = _mm_set1_ps(ray.direction[1]), dz = _mm_set1_ps(ray.direction[2]);
+	__m128 e1x = _mm_load_ps(leaf.e1x), e1y = _mm_load_ps(leaf.e1y), e1z = _mm_load_ps(leaf.e1z);
+	__m128 e2x = _mm_load_ps(leaf.e2x), e2y = _mm_load_ps(leaf.e2y), e2z = _mm_load_ps(leaf.e2z);
+	__m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+	__m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+	__m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+	__m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+	__m128 inverse = _mm_div_ps(_mm_set1_ps(1.0f), det);
+	__m128 sx = _mm_sub_ps(_mm_set1_ps(ray.origin[0]), _mm_load_ps(leaf.v0x));
+	__m128 sy = _mm_sub_ps(_mm_set1_ps(ray.origin[1]), _mm_load_ps(leaf.v0y));
+	__m128 sz = _mm_sub_ps(_mm_set1_ps(ray.origin[2]), _mm_load_ps(leaf.v0z));
+	__m128 bu = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inverse);
+	__m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+	__m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+	__m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+	__m128 bv = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inverse);
+	__m128 distance = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inverse);
+	// Empty lanes and edge-on triangles have det = 0 : their NaNs fail every comparison
+	__m128 zero = _mm_setzero_ps();
+	__m128 hit = _mm_and_ps(_mm_cmpge_ps(bu, zero), _mm_cmpge_ps(bv, zero));
+	hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_add_ps(bu, bv), _mm_set1_ps(1.0f)));
+	hit = _mm_and_ps(hit, _mm_and_ps(_mm_cmpge_ps(distance, zero), _mm_cmplt_ps(distance, _mm_set1_ps(maxDistance))));
+	hit = _mm_and_ps(hit, _mm_cmpneq_ps(det, zero));
+	_mm_storeu_ps(t, distance);
+	_mm_storeu_ps(u, bu);
+	_mm_storeu_ps(v, bv);
+	return _mm_movemask_ps(hit);
+#else
+	int mask = 0;
+	glm::vec3 d(ray.direction[0], ray.direction[1], ray.direction[2]);
+	glm::vec3 o(ray.origin[0], ray.origin[1], ray.origin[2]);
+	for (int lane=0; lane<4; lane++){
+		glm::vec3 e1(leaf.e1x[lane], leaf.e1y[lane], leaf.e1z[lane]);
+		glm::vec3 e2(leaf.e2x[lane], leaf.e2y[lane], leaf.e2z[lane]);
+		glm::vec3 p = glm::cross(d, e2);
+		float det = glm::dot(e1, p);
+		if (det == 0.0f)
+			continue;
+		float inverse = 1.0f / det;
+		glm::vec3 s = o - glm::vec3(leaf.v0x[lane], leaf.v0y[lane], leaf.v0z[lane]);
+		glm::vec3 q = glm::cross(s, e1);
+		u[lane] = glm::dot(s, p) * inverse;
+		v[lane] = glm::dot(d, q) * inverse;
+		t[lane] = glm::dot(e2, q) * inverse;
+		if (u[lane] >= 0.0f && v[lane] >= 0.0f && u[lane] + v[lane] <= 1.0f && t[lane] >= 0.0f && t[lane] < maxDistance)
+			mask |= 1 << lane;
+	}
+	return mask;
+#endif
+}
+
+struct StackEntry {
+	int code;       // Node, or ~leaf
+	float distance; // Where the ray enters it : skipped once something nearer was hit
+};
+
+// Pushes the children in mask, the nearest last so that it is visited first
+static void pushChildren(StackEntry * stack, int & top, const TriangleBVH::Node & node, int mask, const float distance[4]){
+	StackEntry children[4];
+	int count = 0;
+	for (int c=0; c<4; c++){
+		if (!(mask & (1 << c)))
+			continue;
+		StackEntry child = { node.children[c], distance[c] };
+		int i = count++;
+		while (i > 0 && children[i-1].distance < child.distance){
+			children[i] = children[i-1];
+			i--;
+		}
+		children[i] = child;
+	}
+	for (int c=0; c<count; c++)
+		stack[top++] = children[c];
+}
+
+static glm::vec3 getTriangleNormal(const TriangleBVH::Leaf & leaf, int lane){
+	glm::vec3 e1(leaf.e1x[lane], leaf.e1y[lane], leaf.e1z[lane]);
+	glm::vec3 e2(leaf.e2x[lane], leaf.e2y[lane], leaf.e2z[lane]);
+	return glm::normalize(glm::cross(e1, e2));
+}
+
+bool TriangleBVH::raycast(const BvhRay & ray, BvhHit & hit) const {
+	hit.distance = ray.maxDistance;
+	hit.triangle = -1;
+	if (nodeCount == 0)
+		return false;
+	RaySetup setup;
+	setupRay(setup, ray.origin, ray.direction);
+
+	StackEntry stack[STACK_SIZE];
+	int top = 0;
+	StackEntry root = { 0, 0.0f };
+	stack[top++] = root;
+	int hitLeaf = -1, hitLane = 0;
+	while (top > 0){
+		StackEntry entry = stack[--top];
+		if (entry.distance > hit.distance)
+			continue; // Behind what was hit since it was pushed
+		if (entry.code < 0){
+			const Leaf & leaf = leaves[~entry.code];
+			float t[4], u[4], v[4];
+			int mask = intersectTriangles(leaf, setup, hit.distance, t, u, v);
+			for (int lane=0; lane<4; lane++){
+				if ((mask & (1 << lane)) && t[lane] < hit.distance){
+					hit.distance = t[lane];
+					hit.u = u[lane];
+					hit.v = v[lane];
+					hit.triangle = leaf.triangles[lane];
+					hitLeaf = ~entry.code;
+					hitLane = lane;
+				}
+			}
+			continue;
+		}
+		const Node & node = nodes[entry.code];
+		float entryDistance[4];
+		int mask = intersectBoxes(node, setup, 0.0f, hit.distance, entryDistance);
+		pushChildren(stack, top, node, mask, entryDistance);
+	}
+	if (hitLeaf < 0)
+		return false;
+	hit.normal = getTriangleNormal(leaves[hitLeaf], hitLane);
+	if (glm::dot(hit.normal, ray.direction) > 0.0f)
+		hit.normal = -hit.normal;
+	return true;
+}
+
+bool TriangleBVH::intersectsSegment(const glm::vec3 & a, const glm::vec3 & b) const {
+	if (nodeCount == 0)
+		return false;
+	RaySetup setup;
+	setupRay(setup, a, b - a);
+	int stack[STACK_SIZE];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0){
+		int code = stack[--top];
+		if (code < 0){
+			float t[4], u[4], v[4];
+			if (intersectTriangles(leaves[~code], setup, 1.0f, t, u, v))
+				return true;
+			continue;
+		}
+		const Node & node = nodes[code];
+		float entryDistance[4];
+		int mask = intersectBoxes(node, setup, 0.0f, 1.0f, entryDistance);
+		for (int c=0; c<4; c++)
+			if (mask & (1 << c))
+				stack[top++] = node.children[c];
+	}
+	return false;
+}
+
+// Smallest t in [0, maxT] where a sphere moving from center to center + t * motion touches the point
+static bool sweepSpherePoint(const glm::vec3 & center, float radius, const glm::vec3 & motion, const glm::vec3 & point, float maxT, float & t){
+	glm::vec3 m = center - point;
+	float c = glm::dot(m, m) - radius * radius;
+	if (c <= 0.0f){
+		t = 0.0f; // Already touching
+		return true;
+	}
+	float b = glm::dot(m, motion);
+	float a = glm::dot(motion, motion);
+	if (b >= 0.0f || a == 0.0f)
+		return false; // Moving away
+	float discriminant = b * b - a * c;
+	if (discriminant < 0.0f)
+		return false;
+	float root = (-b - sqrtf(discriminant)) / a;
+	if (root > maxT)
+		return false;
+	t = root;
+	return true;
+}
+
+// Same with the edge from p to p + edge : the sphere reaches the cylinder around it, between its ends
+static bool sweepSphereEdge(const glm::vec3 & center, float radius, const glm::vec3 & motion, const glm::vec3 & p, const glm::vec3 & edge,
+                            float maxT, float & t, glm::vec3 & contact){
+	float lengthSquared = glm::dot(edge, edge);
+	if (lengthSquared == 0.0f)
+		return false;
+	glm::vec3 m = center - p;
+	// Components across the edge
+	glm::vec3 mAcross = m - edge * (glm::dot(m, edge) / lengthSquared);
+	glm::vec3 motionAcross = motion - edge * (glm::dot(motion, edge) / lengthSquared);
+	float a = glm::dot(motionAcross, motionAcross);
+	float b = glm::dot(mAcross, motionAcross);
+	float c = glm::dot(mAcross, mAcross) - radius * radius;
+	float root;
+	if (c <= 0.0f){
+		root = 0.0f; // Already inside the cylinder
+	}else{
+		if (a == 0.0f || b >= 0.0f)
+			return false; // Along the edge, or away from it : its ends are the vertices
+		float discriminant = b * b - a * c;
+		if (discriminant < 0.0f)
+			return false;
+		root = (-b - sqrtf(discriminant)) / a;
+	}
+	if (root > maxT)
+		return false;
+	float f = glm::dot(m + root * motion, edge) / lengthSquared;
+	if (f < 0.0f || f > 1.0f)
+		return false;
+	t = root;
+	contact = p + f * edge;
+	return true;
+}
+
+// First contact of a moving sphere with a triangle : its face, else its edges and corners
+static bool sweepSphereTriangle(const glm::vec3 & center, float radius, const glm::vec3 & motion,
+                                const glm::vec3 & v0, const glm::vec3 & e1, const glm::vec3 & e2, float maxT, float & t, glm::vec3 & normal){
+	glm::vec3 faceNormal = glm::cross(e1, e2);
+	float area = glm::length(faceNormal);
+	if (area == 0.0f)
+		return false;
+	faceNormal /= area;
+	float distance = glm::dot(center - v0, faceNormal);
+	if (distance < 0.0f){
+		faceNormal = -faceNormal;
+		distance = -distance;
+	}
+	float approach = glm::dot(motion, faceNormal);
+	if (distance > radius && approach >= 0.0f)
+		return false; // Away from the plane, or along it
+	float faceT = distance <= radius ? 0.0f : (distance - radius) / -approach;
+	if (faceT > maxT)
+		return false;
+
+	// Where the sphere touches the plane : nothing of the triangle can be touched earlier
+	glm::vec3 w = center + faceT * motion - v0;
+	w -= faceNormal * glm::dot(w, faceNormal);
+	float d00 = glm::dot(e1, e1), d01 = glm::dot(e1, e2), d11 = glm::dot(e2, e2);
+	float d20 = glm::dot(w, e1), d21 = glm::dot(w, e2);
+	float denominator = d00 * d11 - d01 * d01;
+	float b1 = (d11 * d20 - d01 * d21) / denominator;
+	float b2 = (d00 * d21 - d01 * d20) / denominator;
+	if (b1 >= 0.0f && b2 >= 0.0f && b1 + b2 <= 1.0f){
+		t = faceT;
+		normal = faceNormal;
+		return true;
+	}
+
+	bool found = false;
+	glm::vec3 contact;
+	const glm::vec3 corners[3] = { v0, v0 + e1, v0 + e2 };
+	for (int i=0; i<3; i++){
+		float cornerT;
+		if (sweepSpherePoint(center, radius, motion, corners[i], maxT, cornerT)){
+			maxT = t = cornerT;
+			contact = corners[i];
+			found = true;
+		}
+		float edgeT;
+		glm::vec3 edgeContact;
+		const glm::vec3 & next = corners[(i + 1) % 3];
+		if (sweepSphereEdge(center, radius, motion, corners[i], next - corners[i], maxT, edgeT, edgeContact)){
+			maxT = t = edgeT;
+			contact = edgeContact;
+			found = true;
+		}
+	}
+	if (found){
+		glm::vec3 away = center + t * motion - contact;
+		float length = glm::length(away);
+		normal = length > 0.0f ? away / length : faceNormal;
+	}
+	return found;
+}
+
+bool TriangleBVH::sweepSphere(const glm::vec3 & center, float radius, const glm::vec3 & motion, BvhHit & hit) const {
+	hit.distance = 1.0f;
+	hit.triangle = -1;
+	hit.u = hit.v = 0.0f;
+	if (nodeCount == 0)
+		return false;
+	RaySetup setup;
+	setupRay(setup, center, motion);
+	StackEntry stack[STACK_SIZE];
+	int top = 0;
+	StackEntry root = { 0, 0.0f };
+	stack[top++] = root;
+	while (top > 0){
+		StackEntry entry = stack[--top];
+		if (entry.distance > hit.distance)
+			continue;
+		if (entry.code < 0){
+			// Boxes were tested 4 at a time ; the exact test is one triangle at a time
+			const Leaf & leaf = leaves[~entry.code];
+			for (int lane=0; lane<4 && leaf.triangles[lane] >= 0; lane++){
+				float t;
+				glm::vec3 normal;
+				glm::vec3 v0(leaf.v0x[lane], leaf.v0y[lane], leaf.v0z[lane]);
+				glm::vec3 e1(leaf.e1x[lane], leaf.e1y[lane], leaf.e1z[lane]);
+				glm::vec3 e2(leaf.e2x[lane], leaf.e2y[lane], leaf.e2z[lane]);
+				if (sweepSphereTriangle(center, radius, motion, v0, e1, e2, hit.distance, t, normal) &&
+					(t < hit.distance || hit.triangle < 0)){
+					hit.distance = t;
+					hit.normal = normal;
+					hit.triangle = leaf.triangles[lane];
+				}
+			}
+			continue;
+		}
+		const Node & node = nodes[entry.code];
+		float entryDistance[4];
+		int mask = intersectBoxes(node, setup, radius, hit.distance, entryDistance);
+		pushChildren(stack, top, node, mask, entryDistance);
+	}
+	return hit.triangle >= 0;
+}
+
+void TriangleBVH::raycastPacket(const BvhRay rays[4], BvhHit hits[4]) const {
+#ifdef BVH_USE_SSE
+	for (int r=0; r<4; r++){
+		hits[r].distance = rays[r].maxDistance;
+		hits[r].triangle = -1;
+	}
+	if (nodeCount == 0)
+		return;
+
+	// One ray per lane
+	RaySetup setups[4];
+	for (int r=0; r<4; r++)
+		setupRay(setups[r], rays[r].origin, rays[r].direction);
+	__m128 ox = _mm_setr_ps(setups[0].origin[0], setups[1].origin[0], setups[2].origin[0], setups[3].origin[0]);
+	__m128 oy = _mm_setr_ps(setups[0].origin[1], setups[1].origin[1], setups[2].origin[1], setups[3].origin[1]);
+	__m128 oz = _mm_setr_ps(setups[0].origin[2], setups[1].origin[2], setups[2].origin[2], setups[3].origin[2]);
+	__m128 dx = _mm_setr_ps(setups[0].direction[0], setups[1].direction[0], setups[2].direction[0], setups[3].direction[0]);
+	__m128 dy = _mm_setr_ps(setups[0].direction[1], setups[1].direction[1], setups[2].direction[1], setups[3].direction[1]);
+	__m128 dz = _mm_setr_ps(setups[0].direction[2], setups[1].direction[2], setups[2].direction[2], setups[3].direction[2]);
+	__m128 ix = _mm_setr_ps(setups[0].inverse[0], setups[1].inverse[0], setups[2].inverse[0], setups[3].inverse[0]);
+	__m128 iy = _mm_setr_ps(setups[0].inverse[1], setups[1].inverse[1], setups[2].inverse[1], setups[3].inverse[1]);
+	__m128 iz = _mm_setr_ps(setups[0].inverse[2], setups[1].inverse[2], setups[2].inverse[2], setups[3].inverse[2]);
+	__m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+	__m128 negativeX = _mm_cmplt_ps(ix, zero), negativeY = _mm_cmplt_ps(iy, zero), negativeZ = _mm_cmplt_ps(iz, zero);
+	__m128 best = _mm_setr_ps(rays[0].maxDistance, rays[1].maxDistance, rays[2].maxDistance, rays[3].maxDistance);
+	__m128 bestU = zero, bestV = zero;
+	__m128i bestHit = _mm_set1_epi32(-1); // 4 * leaf + lane
+
+	StackEntry stack[STACK_SIZE];
+	int top = 0;
+	StackEntry root = { 0, 0.0f };
+	stack[top++] = root;
+	while (top > 0){
+		StackEntry entry = stack[--top];
+		float farthest[4];
+		_mm_storeu_ps(farthest, best);
+		if (entry.distance > std::max(std::max(farthest[0], farthest[1]), std::max(farthest[2], farthest[3])))
+			continue;
+
+		if (entry.code < 0){
+			// Each triangle of the leaf against the 4 rays
+			const Leaf & leaf = leaves[~entry.code];
+			for (int lane=0; lane<4 && leaf.triangles[lane] >= 0; lane++){
+				__m128 e1x = _mm_set1_ps(leaf.e1x[lane]), e1y = _mm_set1_ps(leaf.e1y[lane]), e1z = _mm_set1_ps(leaf.e1z[lane]);
+				__m128 e2x = _mm_set1_ps(leaf.e2x[lane]), e2y = _mm_set1_ps(leaf.e2y[lane]), e2z = _mm_set1_ps(leaf.e2z[lane]);
+				__m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+				__m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+				__m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+				__m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+				__m128 inverse = _mm_div_ps(one, det);
+				__m128 sx = _mm_sub_ps(ox, _mm_set1_ps(leaf.v0x[lane]));
+				__m128 sy = _mm_sub_ps(oy, _mm_set1_ps(leaf.v0y[lane]));
+				__m128 sz = _mm_sub_ps(oz, _mm_set1_ps(leaf.v0z[lane]));
+				__m128 bu = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inverse);
+				__m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+				__m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+				__m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+				__m128 bv = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inverse);
+				__m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inverse);
+				__m128 hit = _mm_and_ps(_mm_cmpge_ps(bu, zero), _mm_cmpge_ps(bv, zero));
+				hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_add_ps(bu, bv), one));
+				hit = _mm_and_ps(hit, _mm_and_ps(_mm_cmpge_ps(t, zero), _mm_cmplt_ps(t, best)));
+				hit = _mm_and_ps(hit, _mm_cmpneq_ps(det, zero));
+				if (_mm_movemask_ps(hit) == 0)
+					continue;
+				best = _mm_or_ps(_mm_and_ps(hit, t), _mm_andnot_ps(hit, best));
+				bestU = _mm_or_ps(_mm_and_ps(hit, bu), _mm_andnot_ps(hit, bestU));
+				bestV = _mm_or_ps(_mm_and_ps(hit, bv), _mm_andnot_ps(hit, bestV));
+				__m128i code = _mm_set1_epi32(4 * ~entry.code + lane);
+				__m128i hitMask = _mm_castps_si128(hit);
+				bestHit = _mm_or_si128(_mm_and_si128(hitMask, code), _mm_andnot_si128(hitMask, bestHit));
+			}
+			continue;
+		}
+
+		// Each child box against the 4 rays
+		const Node & node = nodes[entry.code];
+		int mask = 0;
+		float entryDistance[4];
+		for (int c=0; c<4; c++){
+			__m128 minX = _mm_set1_ps(node.minX[c]), minY = _mm_set1_ps(node.minY[c]), minZ = _mm_set1_ps(node.minZ[c]);
+			__m128 maxX = _mm_set1_ps(node.maxX[c]), maxY = _mm_set1_ps(node.maxY[c]), maxZ = _mm_set1_ps(node.maxZ[c]);
+			__m128 nearX = _mm_or_ps(_mm_and_ps(negativeX, maxX), _mm_andnot_ps(negativeX, minX));
+			__m128 nearY = _mm_or_ps(_mm_and_ps(negativeY, maxY), _mm_andnot_ps(negativeY, minY));
+			__m128 nearZ = _mm_or_ps(_mm_and_ps(negativeZ, maxZ), _mm_andnot_ps(negativeZ, minZ));
+			__m128 farX = _mm_or_ps(_mm_and_ps(negativeX, minX), _mm_andnot_ps(negativeX, maxX));
+			__m128 farY = _mm_or_ps(_mm_and_ps(negativeY, minY), _mm_andnot_ps(negativeY, maxY));
+			__m128 farZ = _mm_or_ps(_mm_and_ps(negativeZ, minZ), _mm_andnot_ps(negativeZ, maxZ));
+			__m128 tNear = _mm_max_ps(
+				_mm_max_ps(_mm_mul_ps(_mm_sub_ps(nearX, ox), ix), _mm_mul_ps(_mm_sub_ps(nearY, oy), iy)),
+				_mm_max_ps(_mm_mul_ps(_mm_sub_ps(nearZ, oz), iz), zero));
+			__m128 tFar = _mm_min_ps(
+				_mm_min_ps(_mm_mul_ps(_mm_sub_ps(farX, ox), ix), _mm_mul_ps(_mm_sub_ps(farY, oy), iy)),
+				_mm_min_ps(_mm_mul_ps(_mm_sub_ps(farZ, oz), iz), best));
+			__m128 enters = _mm_cmple_ps(tNear, tFar);
+			if (_mm_movemask_ps(enters) == 0)
+				continue;
+			// Ordered by the nearest entry of the rays that enter it
+			float entries[4];
+			_mm_storeu_ps(entries, _mm_or_ps(_mm_and_ps(enters, tNear), _mm_andnot_ps(enters, _mm_set1_ps(FLT_MAX))));
+			entryDistance[c] = std::min(std::min(entries[0], entries[1]), std::min(entries[2], entries[3]));
+			mask |= 1 << c;
+		}
+		pushChildren(stack, top, node, mask, entryDistance);
+	}
+
+	float distances[4], us[4], vs[4];
+	int codes[4];
+	_mm_storeu_ps(distances, best);
+	_mm_storeu_ps(us, bestU);
+	_mm_storeu_ps(vs, bestV);
+	_mm_storeu_si128((__m128i *)codes, bestHit);
+	for (int r=0; r<4; r++){
+		if (codes[r] < 0)
+			continue;
+		const Leaf & leaf = leaves[codes[r] / 4];
+		int lane = codes[r] % 4;
+		hits[r].distance = distances[r];
+		hits[r].u = us[r];
+		hits[r].v = vs[r];
+		hits[r].triangle = leaf.triangles[lane];
+		hits[r].normal = getTriangleNormal(leaf, lane);
+		if (glm::dot(hits[r].normal, rays[r].direction) > 0.0f)
+			hits[r].normal = -hits[r].normal;
+	}
+#else
+	for (int r=0; r<4; r++)
+		raycast(rays[r], hits[r]);
+#endif
+}
+
+void TriangleBVH::raycastBatch(const BvhRay * rays, int count, BvhHit * hits, JobSystem * jobs) const {
+	auto trace = [this, rays, count, hits](int begin, int end){
+		for (int packet=begin; packet<end; packet++){
+			int first = 4 * packet;
+			if (first + 4 <= count){
+				raycastPacket(rays + first, hits + first);
+			}else{
+				for (int r=first; r<count; r++)
+					raycast(rays[r], hits[r]);
+			}
+		}
+	};
+	int packetCount = (count + 3) / 4;
+	if (jobs)
+		jobs->parallelFor(0, packetCount, 64, trace);
+	else
+		trace(0, packetCount);
+}
+
+// Benchmark
+
+static float randomFloat(float min, float max){
+	return min + (max - min) * (rand() / (float)RAND_MAX);
+}
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static double secondsSince(Clock::time_point start){
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Nearest hit by testing every triangle : the reference
+static bool raycastBruteForce(const std::vector<glm::vec3> & triangles, const BvhRay & ray, BvhHit & hit){
+	hit.distance = ray.maxDistance;
+	hit.triangle = -1;
+	for (size_t t=0; t+2<triangles.size(); t+=3){
+		glm::vec3 e1 = triangles[t+1] - triangles[t], e2 = triangles[t+2] - triangles[t];
+		glm::vec3 p = glm::cross(ray.direction, e2);
+		float det = glm::dot(e1, p);
+		if (det == 0.0f)
+			continue;
+		glm::vec3 s = ray.origin - triangles[t];
+		glm::vec3 q = glm::cross(s, e1);
+		float u = glm::dot(s, p) / det, v = glm::dot(ray.direction, q) / det, distance = glm::dot(e2, q) / det;
+		if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && distance >= 0.0f && distance < hit.distance){
+			hit.distance = distance;
+			hit.triangle = (int)t / 3;
+		}
+	}
+	return hit.triangle >= 0;
+}
+
+void runBvhBenchmark(){
+	std::vector<glm::vec3> floor;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec3> normals;
+	if (!loadOBJ("GameFloor.obj", floor, uvs, normals))
+		return;
+	glm::vec3 floorMin, floorMax;
+	computeAABB(floor, floorMin, floorMax);
+	const float ballRadius = 0.087f;
+	const int rayCount = 200000;
+	printf("BVH benchmark : GameFloor, then a track of copies of it side by side, %d queries of each kind\n", rayCount);
+
+	const int copyCounts[] = { 1, 64 };
+	for (int k=0; k<2; k++){
+		int copies = copyCounts[k];
+		srand(42); // The same rays for both tracks, on their first floor
+		std::vector<glm::vec3> track;
+		track.reserve(floor.size() * copies);
+		float step = floorMax.x - floorMin.x;
+		for (int c=0; c<copies; c++)
+			for (size_t v=0; v<floor.size(); v++)
+				track.push_back(floor[v] + glm::vec3(c * step, 0.0f, 0.0f));
+
+		Clock::time_point start = Clock::now();
+		TriangleBVH bvh;
+		bvh.build(track);
+		double buildMs = secondsSince(start) * 1000.0;
+		printf("  %d floor(s) : %d triangles, %d nodes, %d leaves, %.1f KB, built in %.2f ms\n",
+			copies, bvh.getTriangleCount(), bvh.getNodeCount(), bvh.getLeafCount(), bvh.getMemoryBytes() / 1024.0, buildMs);
+
+		// Ground probes : straight down from above the floor, anywhere on it
+		std::vector<BvhRay> probes(rayCount);
+		for (int i=0; i<rayCount; i++){
+			BvhRay ray = { glm::vec3(randomFloat(floorMin.x, floorMax.x), 1.0f, randomFloat(floorMin.z, floorMax.z)), glm::vec3(0.0f, -1.0f, 0.0f), 2.0f };
+			probes[i] = ray;
+		}
+		std::vector<BvhHit> grounds(rayCount), hits(rayCount);
+		int hitCount = 0;
+		start = Clock::now();
+		for (int i=0; i<rayCount; i++)
+			hitCount += bvh.raycast(probes[i], grounds[i]) ? 1 : 0;
+		double seconds = secondsSince(start);
+		printf("    probes   : %6.2f Mrays/s, %d%% hit\n", rayCount / seconds * 1e-6, 100 * hitCount / rayCount);
+
+		// Camera rays, over the first floor, in 2x2 pixel quads : packets of rays going the same way
+		const int width = 400, height = rayCount / width;
+		glm::vec3 eye(0.0f, 5.0f, 4.0f);
+		glm::mat3 camera = glm::mat3(glm::inverse(glm::lookAt(eye, glm::vec3(0.0f, 0.7f, 1.0f), glm::vec3(0, 1, 0))));
+		std::vector<BvhRay> cameraRays(width * height);
+		int r = 0;
+		for (int y=0; y<height; y+=2)
+			for (int x=0; x<width; x+=2)
+				for (int q=0; q<4; q++){
+					float px = ((x + (q & 1) + 0.5f) / width * 2.0f - 1.0f) * 0.4f * 4.0f / 3.0f;
+					float py = (1.0f - (y + (q >> 1) + 0.5f) / height * 2.0f) * 0.4f;
+					BvhRay ray = { eye, camera * glm::vec3(px, py, -1.0f), 100.0f };
+					cameraRays[r++] = ray;
+				}
+		start = Clock::now();
+		hitCount = 0;
+		for (int i=0; i<r; i++)
+			hitCount += bvh.raycast(cameraRays[i], hits[i]) ? 1 : 0;
+		double singleSeconds = secondsSince(start);
+		start = Clock::now();
+		for (int i=0; i+3<r; i+=4)
+			bvh.raycastPacket(&cameraRays[i], &hits[i]);
+		double packetSeconds = secondsSince(start);
+		int packetHits = 0;
+		for (int i=0; i<r; i++)
+			packetHits += hits[i].triangle >= 0 ? 1 : 0;
+		printf("    camera   : %6.2f Mrays/s one by one, %6.2f Mrays/s in packets of 4, %d%% hit%s\n",
+			r / singleSeconds * 1e-6, r / packetSeconds * 1e-6, 100 * hitCount / r, packetHits == hitCount ? "" : ", PACKETS DIFFER");
+
+		// Shadow segments, from the floor towards a low sun : the walls cast long shadows
+		glm::vec3 sun(-1.0f, 0.25f, 0.3f);
+		start = Clock::now();
+		int shadowed = 0;
+		for (int i=0; i<rayCount; i++){
+			glm::vec3 ground = probes[i].origin + probes[i].direction * (grounds[i].triangle >= 0 ? grounds[i].distance : 1.0f);
+			ground.y += 0.001f;
+			shadowed += bvh.intersectsSegment(ground, ground + sun) ? 1 : 0;
+		}
+		seconds = secondsSince(start);
+		printf("    shadows  : %6.2f Msegments/s, %d%% in shadow\n", rayCount / seconds * 1e-6, 100 * shadowed / rayCount);
+
+		// The ball falling and rolling : sphere sweeps
+		std::vector<glm::vec3> motions(rayCount);
+		for (int i=0; i<rayCount; i++)
+			motions[i] = glm::vec3(randomFloat(-0.3f, 0.3f), -1.0f, randomFloat(-0.3f, 0.3f));
+		start = Clock::now();
+		int touching = 0;
+		for (int i=0; i<rayCount; i++){
+			BvhHit hit;
+			touching += bvh.sweepSphere(probes[i].origin, ballRadius, motions[i], hit) ? 1 : 0;
+		}
+		seconds = secondsSince(start);
+		printf("    sweeps   : %6.2f Msweeps/s, %d%% touch the floor\n", rayCount / seconds * 1e-6, 100 * touching / rayCount);
+
+		// Batches spread over the cores
+		int maxThreads = std::max(1, (int)std::thread::hardware_concurrency());
+		for (int threads=1; ; threads = std::min(threads*2, maxThreads)){
+			JobSystem jobs(threads);
+			start = Clock::now();
+			bvh.raycastBatch(&cameraRays[0], r, &hits[0], &jobs);
+			seconds = secondsSince(start);
+			printf("    batch    : %2d thread(s), %6.2f Mrays/s, %6.2f Mrays/s per core\n", threads, r / seconds * 1e-6, r / seconds * 1e-6 / threads);
+			if (threads == maxThreads)
+				break;
+		}
+
+		// Testing every triangle, on a few of the probes
+		int bruteCount = std::max(1, 20000 / copies);
+		int mismatches = 0;
+		start = Clock::now();
+		for (int i=0; i<bruteCount; i++){
+			BvhHit reference;
+			raycastBruteForce(track, probes[i], reference);
+			if (reference.triangle != grounds[i].triangle && fabsf(reference.distance - grounds[i].distance) > 1e-5f)
+				mismatches++;
+		}
+		seconds = secondsSince(start);
+		printf("    brute    : %6.3f Mrays/s, %d mismatch(es) with the tree on %d rays\n", bruteCount / seconds * 1e-6, mismatches, bruteCount);
+	}
+}
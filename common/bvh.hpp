@@ -0,0 +1,70 @@
+#ifndef BVH_HPP
+#define BVH_HPP
+
+// Bounding volume hierarchy over a triangle soup, for ray casts and sphere sweeps.
+// Built once from the vertices loadOBJ returns, three per triangle : a binary
+// tree split with the surface area heuristic, then collapsed into a tree of
+// 4-wide nodes, stored flat in one array aligned on cache lines. A node holds
+// the boxes of its 4 children side by side, and a leaf holds up to 4 triangles
+// the same way, so that each step of a query tests 4 boxes, or 4 triangles,
+// at once (SSE). Packets of 4 rays are traced together, one ray per lane.
+// Distances are in units of the length of the ray direction, or of the motion.
+
+class JobSystem;
+
+struct BvhRay {
+	glm::vec3 origin;
+	glm::vec3 direction;
+	float maxDistance;
+};
+
+struct BvhHit {
+	float distance;   // Along the ray, or fraction of the motion of a sweep
+	int triangle;     // Vertices 3*triangle to 3*triangle+2 of the soup, -1 for no hit
+	float u, v;       // Barycentric coordinates of the point hit, for rays
+	glm::vec3 normal; // Facing the ray, or pushing the sphere away
+};
+
+class TriangleBVH {
+public:
+	TriangleBVH();
+	~TriangleBVH();
+
+	// Replaces the tree. Three vertices per triangle, as loaded.
+	void build(const std::vector<glm::vec3> & triangles);
+
+	// Nearest hit within ray.maxDistance
+	bool raycast(const BvhRay & ray, BvhHit & hit) const;
+	// True if a triangle lies between a and b : shadow and visibility tests, that stop at the first hit
+	bool intersectsSegment(const glm::vec3 & a, const glm::vec3 & b) const;
+	// First contact of a sphere moving from center to center + motion
+	bool sweepSphere(const glm::vec3 & center, float radius, const glm::vec3 & motion, BvhHit & hit) const;
+
+	// Nearest hits of 4 rays traced together : faster than one by one when they go the same way
+	void raycastPacket(const BvhRay rays[4], BvhHit hits[4]) const;
+	// hits[i] for rays[i], in packets of 4 consecutive rays, spread over the jobs if not NULL
+	void raycastBatch(const BvhRay * rays, int count, BvhHit * hits, JobSystem * jobs = NULL) const;
+
+	int getTriangleCount() const { return triangleCount; }
+	int getNodeCount() const { return nodeCount; }
+	int getLeafCount() const { return leafCount; }
+	size_t getMemoryBytes() const;
+
+	// Layouts, in bvh.cpp
+	struct Node;
+	struct Leaf;
+
+private:
+	void release();
+
+	Node * nodes; // nodes[0] is the root
+	Leaf * leaves;
+	int nodeCount, leafCount;
+	int triangleCount;
+};
+
+// Rays per second per core, on the floor and on a longer track made of copies of it :
+// single rays, packets, segments, sphere sweeps, and brute force for reference
+void runBvhBenchmark();
+
+#endif
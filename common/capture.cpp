@@ -0,0 +1,329 @@
+#include <vector>
+#include <deque>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+#include <GL/glew.h>
+
+#include "glextensions.hpp"
+#include "capture.hpp"
+#include "profiler.hpp"
+#include "glstats.hpp"
+
+// Frames waiting for the encoder, on top of the ring. Beyond that, frames are dropped.
+static const int ENCODER_BACKLOG = 4;
+
+FrameCapture::FrameCapture(){
+	width = height = 0;
+	format = CAPTURE_BMP;
+	stream = NULL;
+	persistent = false;
+	ringSize = 0;
+	nextSlot = 0;
+	frameCount = 0;
+	captured = dropped = stalls = 0;
+	totalMs = maxMs = 0.0;
+	quit = false;
+}
+
+FrameCapture::~FrameCapture(){
+	if (encoder.joinable())
+		finish();
+}
+
+bool FrameCapture::init(const char * path, CaptureFormat format, int framesPerSecond, int ringSize){
+	this->path = path;
+	this->format = format;
+	this->ringSize = ringSize;
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	width = viewport[2];
+	height = viewport[3];
+
+	if (format == CAPTURE_Y4M){
+		stream = fopen(path, "wb");
+		if (stream == NULL){
+			printf("Impossible to open %s\n", path);
+			return false;
+		}
+		// 4:2:0 in JPEG (full) range, so that the conversion stays a few multiply-adds
+		fprintf(stream, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, framesPerSecond);
+	}
+
+	// Persistent buffers stay busy while they are encoded : have enough for the backlog too
+	persistent = GLEW_VERSION_4_4 || isExtensionSupported("GL_ARB_buffer_storage");
+	int slotCount = persistent ? ringSize + ENCODER_BACKLOG : ringSize;
+	GLsizeiptr size = width * height * 4;
+	slots.resize(slotCount);
+	for (int i=0; i<slotCount; i++){
+		Slot & slot = slots[i];
+		slot.fence = 0;
+		slot.frameNumber = -1;
+		slot.mapped = NULL;
+		slot.encoding = false;
+		glGenBuffers(1, &slot.pbo);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+		if (persistent){
+			GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glBufferStorage(GL_PIXEL_PACK_BUFFER, size, NULL, flags);
+			slot.mapped = (unsigned char *)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, flags);
+		}else{
+			glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+		}
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	// Every buffer is allocated now : capturing never allocates
+	for (int i=0; i<ENCODER_BACKLOG; i++){
+		Frame * frame = new Frame;
+		if (!persistent)
+			frame->copy.resize(size);
+		allFrames.push_back(frame);
+		freeFrames.push_back(frame);
+	}
+
+	quit = false;
+	encoder = std::thread(&FrameCapture::encoderLoop, this);
+	printf("Capturing %dx%d to %s, %s mapping\n", width, height, path, persistent ? "persistent" : "per-frame");
+	return true;
+}
+
+void FrameCapture::capture(){
+	PROFILE_SCOPE("FrameCapture::capture");
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	// Hand over the frame of ringSize frames ago : the GPU is surely done with it
+	while ((int)pending.size() >= ringSize){
+		readBack(pending.front());
+		pending.pop_front();
+	}
+
+	int slot = nextSlot;
+	bool encoding;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		encoding = slots[slot].encoding;
+	}
+	if (encoding){
+		dropped++; // The encoder is behind, and still reads this buffer
+	}else{
+		// BGRA is what most drivers store, so the copy needs no conversion
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slots[slot].pbo);
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+		glReadPixels(0, 0, width, height, GL_BGRA, GL_UNSIGNED_BYTE, (void*)0);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		slots[slot].fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		slots[slot].frameNumber = frameCount;
+		pending.push_back(slot);
+		nextSlot = (nextSlot + 1) % (int)slots.size();
+	}
+	frameCount++;
+
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	totalMs += ms;
+	maxMs = std::max(maxMs, ms);
+}
+
+void FrameCapture::readBack(int index){
+	Slot & slot = slots[index];
+
+	// Normally long done. If not, the GPU is more than ringSize frames behind.
+	if (glClientWaitSync(slot.fence, 0, 0) == GL_TIMEOUT_EXPIRED){
+		stalls++;
+		while (glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+			;
+	}
+	glDeleteSync(slot.fence);
+	slot.fence = 0;
+
+	Frame * frame = NULL;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!freeFrames.empty()){
+			frame = freeFrames.back();
+			freeFrames.pop_back();
+		}
+	}
+
+	if (frame == NULL){
+		dropped++; // The encoder is behind
+	}else if (persistent){
+		// Read in place : the slot stays busy until it is written
+		frame->pixels = slot.mapped;
+		frame->slot = index;
+	}else{
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+		const void * pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frame->copy.size(), GL_MAP_READ_BIT);
+		if (pixels){
+			memcpy(&frame->copy[0], pixels, frame->copy.size());
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		frame->pixels = &frame->copy[0];
+		frame->slot = -1;
+	}
+
+	if (frame){
+		frame->number = slot.frameNumber;
+		std::lock_guard<std::mutex> lock(mutex);
+		if (frame->slot >= 0)
+			slot.encoding = true;
+		queue.push_back(frame);
+		captured++;
+		wakeUp.notify_one();
+	}
+	slot.frameNumber = -1;
+}
+
+void FrameCapture::finish(){
+	// Oldest first, so that the stream stays in order
+	while (!pending.empty()){
+		readBack(pending.front());
+		pending.pop_front();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+		wakeUp.notify_one();
+	}
+	encoder.join();
+
+	if (stream){
+		fclose(stream);
+		stream = NULL;
+	}
+	for (size_t i=0; i<slots.size(); i++){
+		if (slots[i].mapped){
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, slots[i].pbo);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		glDeleteBuffers(1, &slots[i].pbo);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	slots.clear();
+	for (size_t i=0; i<allFrames.size(); i++)
+		delete allFrames[i];
+	allFrames.clear();
+	freeFrames.clear();
+
+	printf("Captured %d frames, %d dropped, %d stalls. Render thread cost : %.3f ms/frame, %.3f ms max\n",
+		captured, dropped, stalls, frameCount ? totalMs / frameCount : 0.0, maxMs);
+}
+
+void FrameCapture::encoderLoop(){
+	PROFILE_THREAD_NAME("capture encoder");
+	while (true){
+		Frame * frame;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			while (queue.empty() && !quit)
+				wakeUp.wait(lock);
+			if (queue.empty())
+				return; // Quit, and everything is written
+			frame = queue.front();
+			queue.pop_front();
+		}
+
+		{
+			PROFILE_SCOPE("FrameCapture encode");
+			if (format == CAPTURE_BMP)
+				writeBMP(*frame);
+			else
+				writeY4M(*frame);
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (frame->slot >= 0)
+			slots[frame->slot].encoding = false;
+		freeFrames.push_back(frame);
+	}
+}
+
+static void writeLittleEndian(unsigned char * p, unsigned int value, int bytes){
+	for (int i=0; i<bytes; i++)
+		p[i] = (unsigned char)(value >> (8*i));
+}
+
+void FrameCapture::writeBMP(const Frame & frame){
+	// BMP rows are bottom-up like OpenGL's, BGR, and padded to 4 bytes
+	int rowSize = (width * 3 + 3) & ~3;
+	unsigned int imageSize = rowSize * height;
+	unsigned char header[54] = { 'B', 'M' };
+	writeLittleEndian(header + 2, 54 + imageSize, 4); // File size
+	writeLittleEndian(header + 10, 54, 4);            // Offset of the pixels
+	writeLittleEndian(header + 14, 40, 4);            // BITMAPINFOHEADER
+	writeLittleEndian(header + 18, width, 4);
+	writeLittleEndian(header + 22, height, 4);
+	writeLittleEndian(header + 26, 1, 2);             // Planes
+	writeLittleEndian(header + 28, 24, 2);            // Bits per pixel
+	writeLittleEndian(header + 34, imageSize, 4);
+	writeLittleEndian(header + 38, 2835, 4);          // 72 DPI
+	writeLittleEndian(header + 42, 2835, 4);
+
+	scratch.assign(imageSize, 0);
+	for (int y=0; y<height; y++){
+		const unsigned char * src = &frame.pixels[y * width * 4];
+		unsigned char * dst = &scratch[y * rowSize];
+		for (int x=0; x<width; x++){
+			dst[3*x+0] = src[4*x+0];
+			dst[3*x+1] = src[4*x+1];
+			dst[3*x+2] = src[4*x+2];
+		}
+	}
+
+	char filename[1024];
+	snprintf(filename, sizeof(filename), path.c_str(), frame.number);
+	FILE * file = fopen(filename, "wb");
+	if (file == NULL){
+		printf("Impossible to open %s\n", filename);
+		return;
+	}
+	fwrite(header, 1, sizeof(header), file);
+	fwrite(&scratch[0], 1, scratch.size(), file);
+	fclose(file);
+}
+
+void FrameCapture::writeY4M(const Frame & frame){
+	// BT.601 full range. Chroma is averaged over 2x2 pixels.
+	int chromaWidth = (width + 1) / 2;
+	int chromaHeight = (height + 1) / 2;
+	scratch.resize(width * height + 2 * chromaWidth * chromaHeight);
+	unsigned char * yPlane = &scratch[0];
+	unsigned char * uPlane = yPlane + width * height;
+	unsigned char * vPlane = uPlane + chromaWidth * chromaHeight;
+
+	// Y4M is top-down
+	for (int y=0; y<height; y++){
+		const unsigned char * src = &frame.pixels[(height - 1 - y) * width * 4];
+		unsigned char * dst = yPlane + y * width;
+		for (int x=0; x<width; x++){
+			int b = src[4*x+0], g = src[4*x+1], r = src[4*x+2];
+			dst[x] = (unsigned char)((77*r + 150*g + 29*b + 128) >> 8);
+		}
+	}
+	for (int cy=0; cy<chromaHeight; cy++){
+		for (int cx=0; cx<chromaWidth; cx++){
+			int r = 0, g = 0, b = 0, n = 0;
+			for (int dy=0; dy<2; dy++){
+				int y = std::min(2*cy + dy, height - 1);
+				const unsigned char * src = &frame.pixels[(height - 1 - y) * width * 4];
+				for (int dx=0; dx<2; dx++){
+					int x = std::min(2*cx + dx, width - 1);
+					b += src[4*x+0]; g += src[4*x+1]; r += src[4*x+2];
+					n++;
+				}
+			}
+			r /= n; g /= n; b /= n;
+			uPlane[cy * chromaWidth + cx] = (unsigned char)std::min(255, std::max(0, ((-43*r - 85*g + 128*b + 128) >> 8) + 128));
+			vPlane[cy * chromaWidth + cx] = (unsigned char)std::min(255, std::max(0, ((128*r - 107*g - 21*b + 128) >> 8) + 128));
+		}
+	}
+
+	fputs("FRAME\n", stream);
+	fwrite(&scratch[0], 1, scratch.size(), stream);
+}
@@ -0,0 +1,90 @@
+#ifndef CAPTURE_HPP
+#define CAPTURE_HPP
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Asynchronous frame capture.
+// Each frame is read into one of a ring of pixel buffer objects : glReadPixels
+// then only queues a copy on the GPU and returns. The buffer is read a few
+// frames later, once the copy is surely done, and its pixels go to a
+// background thread that converts and writes them. The render thread never
+// waits for the GPU nor for the disk. If the encoder can't keep up, frames
+// are dropped rather than slowing the game down.
+// With GL_ARB_buffer_storage the buffers stay mapped and the encoder reads
+// them in place. Otherwise they are mapped and copied for the encoder.
+
+enum CaptureFormat {
+	CAPTURE_BMP, // One 24 bits BMP file per frame : path is a printf pattern like "frame%05d.bmp"
+	CAPTURE_Y4M  // A single raw YUV 4:2:0 stream, that ffmpeg and most players read directly
+};
+
+class FrameCapture {
+public:
+	FrameCapture();
+	~FrameCapture();
+
+	// Captures the current viewport. Needs a current context.
+	bool init(const char * path, CaptureFormat format, int framesPerSecond = 60, int ringSize = 3);
+
+	// Queues the read back of the frame just drawn, and hands over the one of ringSize frames ago.
+	// Call it on the thread that draws, before swapping buffers.
+	void capture();
+
+	// Hands over the frames still in the ring, waits until everything is written, and frees the buffers
+	void finish();
+
+	int getCapturedCount() const { return captured; }
+	int getDroppedCount() const { return dropped; }
+
+private:
+	struct Slot {
+		GLuint pbo;
+		GLsync fence;
+		int frameNumber;        // -1 if free
+		unsigned char * mapped; // Persistent mapping, NULL otherwise
+		bool encoding;          // The encoder still reads the mapping. Guarded by mutex.
+	};
+	struct Frame {
+		std::vector<unsigned char> copy; // Unused with persistent mappings
+		const unsigned char * pixels;    // BGRA, bottom row first
+		int slot;                        // Slot to release once written, -1 for a copy
+		int number;
+	};
+
+	void readBack(int slot);
+	void encoderLoop();
+	void writeBMP(const Frame & frame);
+	void writeY4M(const Frame & frame);
+
+	int width, height;
+	std::string path;
+	CaptureFormat format;
+	FILE * stream;          // Y4M output
+	bool persistent;
+	int ringSize;
+	std::vector<Slot> slots;
+	std::deque<int> pending; // Slots the GPU copies into, oldest first
+	int nextSlot;
+	int frameCount;
+	int captured, dropped, stalls;
+	double totalMs, maxMs;  // Cost of capture() on the render thread
+
+	// Shared with the encoder thread
+	std::mutex mutex;
+	std::condition_variable wakeUp;
+	std::vector<Frame *> freeFrames;
+	std::deque<Frame *> queue;
+	std::vector<Frame *> allFrames;
+	bool quit;
+	std::thread encoder;
+
+	// Encoder thread only
+	std::vector<unsigned char> scratch;
+};
+
+#endif
@@ -0,0 +1,236 @@
+#include <vector>
+#include <string>
+#include <map>
+#include <stdio.h>
+#include <string.h>
+
+#include <glm/glm.hpp>
+
+#include <btBulletDynamicsCommon.h>
+#include <LinearMath/btConvexHull.h>
+#include <BulletCollision/CollisionShapes/btConvexPointCloudShape.h>
+
+#include "benchmark.hpp"
+#include "profiler.hpp"
+#include "collision.hpp"
+
+// What Bullet reads in place must start on 16 bytes
+static const size_t ALIGNMENT = 16;
+
+struct CollisionFileHeader {
+	char magic[4];              // "COL1"
+	unsigned int type;          // CollisionType
+	unsigned int sourceHash;    // hashVertices() of what it was cooked from
+	unsigned int layout;        // sizeof(btQuantizedBvh) of the build that wrote it
+	unsigned int vertexCount;
+	unsigned int triangleCount; // 0 for a hull
+	unsigned int bvhOffset;     // From the start of the file
+	unsigned int bvhSize;
+};
+// Then, for a mesh : vertexCount float[3], triangleCount int[3], padding, the tree.
+// For a hull : vertexCount btVector3.
+
+static size_t alignUp(size_t offset){
+	return (offset + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+
+std::string getCollisionPath(const char * meshPath){
+	std::string path(meshPath);
+	size_t dot = path.find_last_of('.');
+	if (dot != std::string::npos && path.find_first_of("/\\", dot) == std::string::npos)
+		path.resize(dot);
+	return path + ".collision";
+}
+
+unsigned int hashVertices(const std::vector<glm::vec3> & vertices){
+	if (vertices.empty())
+		return 0;
+	return hashBytes((const unsigned char *)&vertices[0], vertices.size() * sizeof(glm::vec3));
+}
+
+static void initHeader(CollisionFileHeader & header, CollisionType type, const std::vector<glm::vec3> & source){
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "COL1", 4);
+	header.type = type;
+	header.sourceHash = hashVertices(source);
+	header.layout = sizeof(btQuantizedBvh);
+}
+
+static bool writeFile(const char * path, const std::vector<unsigned char> & bytes){
+	FILE * file = fopen(path, "wb");
+	if (file == NULL){
+		printf("Impossible to open %s\n", path);
+		return false;
+	}
+	bool written = fwrite(&bytes[0], 1, bytes.size(), file) == bytes.size();
+	fclose(file);
+	return written;
+}
+
+// Positions are shared by several triangles : the tree only needs them once
+struct WeldKey {
+	float x, y, z;
+	bool operator<(const WeldKey & other) const {
+		if (x != other.x) return x < other.x;
+		if (y != other.y) return y < other.y;
+		return z < other.z;
+	}
+};
+
+bool cookCollisionMesh(const std::vector<glm::vec3> & triangles, const char * path){
+	PROFILE_FUNCTION();
+	std::vector<float> positions;
+	std::vector<int> indices;
+	std::map<WeldKey, int> welded;
+	for (size_t i=0; i+2<triangles.size(); i+=3){
+		for (int corner=0; corner<3; corner++){
+			const glm::vec3 & v = triangles[i + corner];
+			WeldKey key = { v.x, v.y, v.z };
+			std::map<WeldKey, int>::iterator found = welded.find(key);
+			if (found == welded.end()){
+				found = welded.insert(std::make_pair(key, (int)positions.size() / 3)).first;
+				positions.push_back(v.x);
+				positions.push_back(v.y);
+				positions.push_back(v.z);
+			}
+			indices.push_back(found->second);
+		}
+	}
+	int vertexCount = (int)positions.size() / 3;
+	int triangleCount = (int)indices.size() / 3;
+	if (triangleCount == 0)
+		return false;
+
+	// The same tree as at runtime, built over the welded arrays
+	btTriangleIndexVertexArray mesh(triangleCount, &indices[0], 3 * sizeof(int), vertexCount, &positions[0], 3 * sizeof(float));
+	btBvhTriangleMeshShape shape(&mesh, true, true);
+	btOptimizedBvh * bvh = shape.getOptimizedBvh();
+
+	CollisionFileHeader header;
+	initHeader(header, COLLISION_MESH, triangles);
+	header.vertexCount = vertexCount;
+	header.triangleCount = triangleCount;
+	size_t positionsOffset = alignUp(sizeof(header));
+	size_t indicesOffset = positionsOffset + positions.size() * sizeof(float);
+	header.bvhOffset = (unsigned int)alignUp(indicesOffset + indices.size() * sizeof(int));
+	header.bvhSize = bvh->calculateSerializeBufferSize();
+
+	// The tree is serialized into an aligned block, then copied to the file image
+	std::vector<unsigned char> bytes(header.bvhOffset + header.bvhSize, 0);
+	void * tree = btAlignedAlloc(header.bvhSize, ALIGNMENT);
+	bool serialized = bvh->serializeInPlace(tree, header.bvhSize, false);
+	memcpy(&bytes[header.bvhOffset], tree, header.bvhSize);
+	btAlignedFree(tree);
+	if (!serialized)
+		return false;
+	memcpy(&bytes[0], &header, sizeof(header));
+	memcpy(&bytes[positionsOffset], &positions[0], positions.size() * sizeof(float));
+	memcpy(&bytes[indicesOffset], &indices[0], indices.size() * sizeof(int));
+
+	printf("Cooked %s : %d vertices, %d triangles, %u bytes of tree\n", path, vertexCount, triangleCount, header.bvhSize);
+	return writeFile(path, bytes);
+}
+
+bool simplifyHull(const std::vector<glm::vec3> & vertices, std::vector<glm::vec3> & hull, int maxVertices){
+	hull.clear();
+	if (vertices.empty())
+		return false;
+	HullDesc description(QF_TRIANGLES, (unsigned int)vertices.size(), (const btVector3 *)&vertices[0], sizeof(glm::vec3));
+	description.mMaxVertices = maxVertices;
+	HullLibrary library;
+	HullResult result;
+	if (library.CreateConvexHull(description, result) != QE_OK)
+		return false;
+	for (unsigned int i=0; i<result.mNumOutputVertices; i++){
+		const btVector3 & v = result.m_OutputVertices[i];
+		hull.push_back(glm::vec3(v.x(), v.y(), v.z()));
+	}
+	library.ReleaseResult(result);
+	return true;
+}
+
+bool cookCollisionHull(const std::vector<glm::vec3> & vertices, const char * path, int maxVertices){
+	PROFILE_FUNCTION();
+	std::vector<glm::vec3> hull;
+	if (!simplifyHull(vertices, hull, maxVertices))
+		return false;
+
+	CollisionFileHeader header;
+	initHeader(header, COLLISION_HULL, vertices);
+	header.vertexCount = (unsigned int)hull.size();
+	size_t pointsOffset = alignUp(sizeof(header));
+	std::vector<unsigned char> bytes(pointsOffset + hull.size() * sizeof(btVector3), 0);
+	memcpy(&bytes[0], &header, sizeof(header));
+	for (size_t i=0; i<hull.size(); i++){
+		btVector3 point(hull[i].x, hull[i].y, hull[i].z); // Padded to 16 bytes, as Bullet reads them
+		memcpy(&bytes[pointsOffset + i * sizeof(btVector3)], &point, sizeof(btVector3));
+	}
+
+	printf("Cooked %s : %d vertices, %u in the hull\n", path, (int)vertices.size(), header.vertexCount);
+	return writeFile(path, bytes);
+}
+
+CollisionData::CollisionData(){
+	data = NULL;
+	size = 0;
+	meshInterface = NULL;
+}
+
+CollisionData::~CollisionData(){
+	delete meshInterface;
+	btAlignedFree(data);
+}
+
+bool CollisionData::load(const char * path, CollisionType type, unsigned int sourceHash){
+	PROFILE_FUNCTION();
+	FILE * file = fopen(path, "rb");
+	if (file == NULL)
+		return false;
+	fseek(file, 0, SEEK_END);
+	long length = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	CollisionFileHeader header;
+	if (length < (long)sizeof(header) || fread(&header, sizeof(header), 1, file) != 1 ||
+		memcmp(header.magic, "COL1", 4) != 0 || header.type != (unsigned int)type ||
+		header.sourceHash != sourceHash || header.layout != sizeof(btQuantizedBvh) ||
+		(size_t)length < (size_t)header.bvhOffset + header.bvhSize ||
+		(size_t)length < alignUp(sizeof(header)) + header.vertexCount * (type == COLLISION_HULL ? sizeof(btVector3) : 3 * sizeof(float)) + header.triangleCount * 3 * sizeof(int)){
+		fclose(file);
+		return false;
+	}
+
+	// One block for the whole file, the shapes point into it
+	btAlignedFree(data);
+	size = (size_t)length;
+	data = (unsigned char *)btAlignedAlloc(size, ALIGNMENT);
+	fseek(file, 0, SEEK_SET);
+	bool read = fread(data, 1, size, file) == size;
+	fclose(file);
+	return read;
+}
+
+btCollisionShape * CollisionData::createShape(){
+	const CollisionFileHeader & header = *(const CollisionFileHeader *)data;
+	unsigned char * payload = data + alignUp(sizeof(header));
+
+	if (header.type == COLLISION_HULL){
+		btConvexPointCloudShape * shape = new btConvexPointCloudShape((btVector3 *)payload, header.vertexCount, btVector3(1.0f, 1.0f, 1.0f));
+		shape->setMargin(COLLISION_MARGIN);
+		return shape;
+	}
+
+	float * positions = (float *)payload;
+	int * indices = (int *)(payload + header.vertexCount * 3 * sizeof(float));
+	delete meshInterface;
+	meshInterface = new btTriangleIndexVertexArray(header.triangleCount, indices, 3 * sizeof(int), header.vertexCount, positions, 3 * sizeof(float));
+
+	// The tree was cooked over the same arrays : it is only pointed to
+	btOptimizedBvh * bvh = btOptimizedBvh::deSerializeInPlace(data + header.bvhOffset, header.bvhSize, false);
+	if (bvh == NULL)
+		return NULL;
+	btBvhTriangleMeshShape * shape = new btBvhTriangleMeshShape(meshInterface, true, false);
+	shape->setOptimizedBvh(bvh);
+	shape->setMargin(COLLISION_MARGIN);
+	return shape;
+}
@@ -0,0 +1,61 @@
+#ifndef COLLISION_HPP
+#define COLLISION_HPP
+
+// Baked collision data.
+// The tree of a static triangle mesh, and the hull of a prop, are built once
+// by a cooking step and written next to the .obj, as Bullet lays them out in
+// memory. Loading reads the file into one aligned block and points the shapes
+// into it : nothing is built, and nothing but the block is allocated.
+// A file records a hash of the vertices it was cooked from, and the layout of
+// the build that wrote it : a changed mesh, or another build, makes it stale.
+//
+//	"GameFloor.obj" -> "GameFloor.collision"
+
+class btCollisionShape;
+class btTriangleIndexVertexArray;
+
+enum CollisionType {
+	COLLISION_MESH = 1, // Welded triangles and their quantized tree
+	COLLISION_HULL = 2  // Vertices of a simplified convex hull
+};
+
+// The scene is a few units wide : Bullet's default margin, 4 cm, would be as big as the ball
+static const float COLLISION_MARGIN = 0.002f;
+
+// Hull vertices kept by default : enough for the props, cheap for the collision tests
+static const int DEFAULT_HULL_VERTICES = 32;
+
+// Path of the cooked data of a mesh file
+std::string getCollisionPath(const char * meshPath);
+
+// Hash of the source vertices, recorded by the cooked files
+unsigned int hashVertices(const std::vector<glm::vec3> & vertices);
+
+// Corners of the convex hull of the vertices, at most maxVertices of them. False if they are all flat.
+bool simplifyHull(const std::vector<glm::vec3> & vertices, std::vector<glm::vec3> & hull, int maxVertices = DEFAULT_HULL_VERTICES);
+
+// Cook from vertices in world space, three per triangle as loaded. False if the file can't be written.
+bool cookCollisionMesh(const std::vector<glm::vec3> & triangles, const char * path);
+bool cookCollisionHull(const std::vector<glm::vec3> & vertices, const char * path, int maxVertices = DEFAULT_HULL_VERTICES);
+
+// Cooked data, loaded in place. Its shape points into it : delete the shape first.
+class CollisionData {
+public:
+	CollisionData();
+	~CollisionData();
+
+	// False if the file is missing, of another type, or stale
+	bool load(const char * path, CollisionType type, unsigned int sourceHash);
+
+	// New shape over the data
+	btCollisionShape * createShape();
+
+	size_t getSize() const { return size; }
+
+private:
+	unsigned char * data; // Aligned for Bullet
+	size_t size;
+	btTriangleIndexVertexArray * meshInterface;
+};
+
+#endif
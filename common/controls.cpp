@@ -43,6 +43,14 @@ void computeMatricesFromInputs(){
 	double currentTime = glfwGetTime();
 	float deltaTime = float(currentTime - lastTime);
 
+	computeMatricesFromInputs(deltaTime);
+
+	// For the next frame, the "last time" will be "now"
+	lastTime = currentTime;
+}
+
+void computeMatricesFromInputs(float deltaTime){
+
 	// Get mouse position
 	double xpos, ypos;
 	glfwGetCursorPos(window, &xpos, &ypos);
@@ -94,7 +102,4 @@ void computeMatricesFromInputs(){
 								position+direction, // and looks here : at the same position, plus "direction"
 								up                  // Head is up (set to 0,-1,0 to look upside-down)
 						   );
-
-	// For the next frame, the "last time" will be "now"
-	lastTime = currentTime;
 }
\ No newline at end of file
@@ -2,6 +2,8 @@
 #define CONTROLS_HPP
 
 void computeMatricesFromInputs();
+// Same, for a simulation tick of fixed duration, so that moving doesn't depend on the frame rate
+void computeMatricesFromInputs(float deltaTime);
 glm::mat4 getViewMatrix();
 glm::mat4 getProjectionMatrix();
 
@@ -0,0 +1,600 @@
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "jobsystem.hpp"
+#include "profiler.hpp"
+#include "ecs.hpp"
+
+static const int CACHE_LINE = 64;
+// Arrays of a chunk start on this, for SSE
+static const int COLUMN_ALIGNMENT = 16;
+
+static void * allocateAligned(size_t size){
+	unsigned char * block = (unsigned char *)malloc(size + CACHE_LINE + sizeof(void *));
+	if (block == NULL)
+		return NULL;
+	uintptr_t aligned = ((uintptr_t)block + sizeof(void *) + CACHE_LINE - 1) & ~(uintptr_t)(CACHE_LINE - 1);
+	((void **)aligned)[-1] = block;
+	return (void *)aligned;
+}
+
+static void freeAligned(void * pointer){
+	if (pointer)
+		free(((void **)pointer)[-1]);
+}
+
+static int alignColumn(int offset){
+	return (offset + COLUMN_ALIGNMENT - 1) & ~(COLUMN_ALIGNMENT - 1);
+}
+
+// Command buffers
+
+void EcsCommandBuffer::push(int type, Entity entity, int component, ComponentMask mask, const void * value, int size){
+	Command command = { type, component, value ? size : 0, entity, mask };
+	size_t start = bytes.size();
+	int padded = (command.size + 7) & ~7;
+	bytes.resize(start + sizeof(Command) + padded);
+	memcpy(&bytes[start], &command, sizeof(Command));
+	if (command.size > 0)
+		memcpy(&bytes[start + sizeof(Command)], value, command.size);
+	count++;
+}
+
+void EcsCommandBuffer::create(ComponentMask mask){
+	push(CREATE, NULL_ENTITY, 0, mask, NULL, 0);
+}
+
+void EcsCommandBuffer::setCreated(int component, const void * value, int size){
+	push(SET_CREATED, NULL_ENTITY, component, 0, value, size);
+}
+
+void EcsCommandBuffer::destroy(Entity entity){
+	push(DESTROY, entity, 0, 0, NULL, 0);
+}
+
+void EcsCommandBuffer::add(Entity entity, int component, const void * value, int size){
+	push(ADD, entity, component, 0, value, size);
+}
+
+void EcsCommandBuffer::remove(Entity entity, int component){
+	push(REMOVE, entity, component, 0, NULL, 0);
+}
+
+// World
+
+EcsWorld::EcsWorld(){
+	componentCount = 0;
+	liveCount = 0;
+	allocatedChunks = 0;
+	iterating = 0;
+}
+
+EcsWorld::~EcsWorld(){
+	for (size_t a=0; a<archetypes.size(); a++)
+		for (size_t c=0; c<archetypes[a].chunks.size(); c++)
+			freeAligned(archetypes[a].chunks[c].data);
+	for (size_t c=0; c<freeChunks.size(); c++)
+		freeAligned(freeChunks[c]);
+}
+
+int EcsWorld::registerComponent(const char * name, int size){
+	if (componentCount >= ECS_MAX_COMPONENTS){
+		printf("Can't register the component %s : there are already %d\n", name, ECS_MAX_COMPONENTS);
+		return -1;
+	}
+	if (size < 0 || alignColumn((int)sizeof(Entity)) + size > ECS_CHUNK_BYTES){
+		printf("Can't register the component %s : %d bytes don't fit in a chunk of %d\n", name, size, ECS_CHUNK_BYTES);
+		return -1;
+	}
+	sizes[componentCount] = size;
+	names[componentCount] = name;
+	return componentCount++;
+}
+
+bool EcsWorld::checkStructural(const char * operation) const {
+	if (iterating == 0)
+		return true;
+	printf("EcsWorld::%s while a query runs : record it in an EcsCommandBuffer instead\n", operation);
+	return false;
+}
+
+int EcsWorld::findArchetype(ComponentMask mask){
+	std::vector<std::pair<ComponentMask, int> >::iterator found =
+		std::lower_bound(archetypeMasks.begin(), archetypeMasks.end(), std::make_pair(mask, -1));
+	if (found != archetypeMasks.end() && found->first == mask)
+		return found->second;
+
+	// The ids first, then every array, as many entities as fit
+	Archetype archetype;
+	archetype.mask = mask;
+	int rowBytes = sizeof(Entity);
+	for (int c=0; c<componentCount; c++){
+		archetype.offsets[c] = -1;
+		archetype.next[c] = -1;
+		if (mask & componentBit(c)){
+			archetype.components.push_back(c);
+			rowBytes += sizes[c];
+		}
+	}
+	for (int c=componentCount; c<ECS_MAX_COMPONENTS; c++)
+		archetype.offsets[c] = archetype.next[c] = -1;
+	int padding = COLUMN_ALIGNMENT * (int)archetype.components.size();
+	archetype.capacity = (ECS_CHUNK_BYTES - padding) / rowBytes;
+	if (archetype.capacity < 1){
+		printf("EcsWorld : an entity with %d components of %d bytes doesn't fit in a chunk of %d\n",
+			(int)archetype.components.size(), rowBytes, ECS_CHUNK_BYTES);
+		return -1;
+	}
+	int offset = alignColumn(archetype.capacity * (int)sizeof(Entity));
+	for (size_t i=0; i<archetype.components.size(); i++){
+		int c = archetype.components[i];
+		archetype.offsets[c] = offset;
+		offset = alignColumn(offset + archetype.capacity * sizes[c]);
+	}
+	int index = (int)archetypes.size();
+	archetypes.push_back(archetype);
+	archetypeMasks.insert(found, std::make_pair(mask, index));
+	return index;
+}
+
+// Archetype with the component flipped, cached : adding or removing a component is a lookup
+int EcsWorld::getNeighbour(int archetype, int component){
+	int next = archetypes[archetype].next[component];
+	if (next < 0){
+		next = findArchetype(archetypes[archetype].mask ^ componentBit(component));
+		if (next >= 0)
+			archetypes[archetype].next[component] = next;
+	}
+	return next;
+}
+
+unsigned char * EcsWorld::allocateChunk(){
+	if (!freeChunks.empty()){
+		unsigned char * data = freeChunks.back();
+		freeChunks.pop_back();
+		return data;
+	}
+	allocatedChunks++;
+	return (unsigned char *)allocateAligned(ECS_CHUNK_BYTES);
+}
+
+void EcsWorld::allocateRow(int archetype, int & chunk, int & row){
+	Archetype & a = archetypes[archetype];
+	if (a.chunks.empty() || a.chunks.back().count == a.capacity){
+		Chunk fresh = { allocateChunk(), 0 };
+		a.chunks.push_back(fresh);
+	}
+	chunk = (int)a.chunks.size() - 1;
+	row = a.chunks[chunk].count++;
+}
+
+// The last entity of the archetype fills the hole, so chunks stay full
+void EcsWorld::removeRow(int archetype, int chunk, int row){
+	Archetype & a = archetypes[archetype];
+	int lastChunk = (int)a.chunks.size() - 1;
+	Chunk & last = a.chunks[lastChunk];
+	int lastRow = last.count - 1;
+	if (chunk != lastChunk || row != lastRow){
+		unsigned char * to = a.chunks[chunk].data;
+		unsigned char * from = last.data;
+		Entity moved = ((Entity *)from)[lastRow];
+		((Entity *)to)[row] = moved;
+		for (size_t i=0; i<a.components.size(); i++){
+			int c = a.components[i];
+			memcpy(to + a.offsets[c] + row * sizes[c], from + a.offsets[c] + lastRow * sizes[c], sizes[c]);
+		}
+		records[moved.index].chunk = chunk;
+		records[moved.index].row = row;
+	}
+	if (--last.count == 0){
+		freeChunks.push_back(last.data);
+		a.chunks.pop_back();
+	}
+}
+
+Entity EcsWorld::create(ComponentMask mask){
+	if (!checkStructural("create"))
+		return NULL_ENTITY;
+	int archetype = findArchetype(mask);
+	if (archetype < 0)
+		return NULL_ENTITY;
+	Entity entity;
+	if (!freeIndices.empty()){
+		entity.index = freeIndices.back();
+		freeIndices.pop_back();
+	}else{
+		entity.index = (uint32_t)records.size();
+		Record record = { -1, 0, 0, 1 };
+		records.push_back(record);
+	}
+	Record & record = records[entity.index];
+	entity.generation = record.generation;
+	record.archetype = archetype;
+	allocateRow(record.archetype, record.chunk, record.row);
+
+	const Archetype & a = archetypes[record.archetype];
+	unsigned char * data = a.chunks[record.chunk].data;
+	((Entity *)data)[record.row] = entity;
+	for (size_t i=0; i<a.components.size(); i++){
+		int c = a.components[i];
+		memset(data + a.offsets[c] + record.row * sizes[c], 0, sizes[c]);
+	}
+	liveCount++;
+	return entity;
+}
+
+void EcsWorld::destroy(Entity entity){
+	if (!checkStructural("destroy") || !isAlive(entity))
+		return;
+	Record & record = records[entity.index];
+	removeRow(record.archetype, record.chunk, record.row);
+	record.archetype = -1;
+	// 0 is never a live generation
+	if (++record.generation == 0)
+		record.generation = 1;
+	freeIndices.push_back(entity.index);
+	liveCount--;
+}
+
+void EcsWorld::moveEntity(Entity entity, int archetype){
+	Record & record = records[entity.index];
+	int from = record.archetype, fromChunk = record.chunk, fromRow = record.row;
+	int chunk, row;
+	allocateRow(archetype, chunk, row);
+
+	// What both have is copied, what's new is zeroed
+	const Archetype & source = archetypes[from];
+	const Archetype & destination = archetypes[archetype];
+	const unsigned char * in = source.chunks[fromChunk].data;
+	unsigned char * out = destination.chunks[chunk].data;
+	((Entity *)out)[row] = entity;
+	for (size_t i=0; i<destination.components.size(); i++){
+		int c = destination.components[i];
+		if (source.offsets[c] >= 0)
+			memcpy(out + destination.offsets[c] + row * sizes[c], in + source.offsets[c] + fromRow * sizes[c], sizes[c]);
+		else
+			memset(out + destination.offsets[c] + row * sizes[c], 0, sizes[c]);
+	}
+	removeRow(from, fromChunk, fromRow);
+	record.archetype = archetype;
+	record.chunk = chunk;
+	record.row = row;
+}
+
+void EcsWorld::add(Entity entity, int component, const void * value){
+	if (!checkStructural("add") || !isAlive(entity))
+		return;
+	Record & record = records[entity.index];
+	if (archetypes[record.archetype].offsets[component] < 0){
+		int next = getNeighbour(record.archetype, component);
+		if (next < 0)
+			return;
+		moveEntity(entity, next);
+	}
+	void * data = getComponent(entity, component);
+	if (value)
+		memcpy(data, value, sizes[component]);
+	else
+		memset(data, 0, sizes[component]);
+}
+
+void EcsWorld::remove(Entity entity, int component){
+	if (!checkStructural("remove") || !isAlive(entity))
+		return;
+	Record & record = records[entity.index];
+	if (archetypes[record.archetype].offsets[component] >= 0)
+		moveEntity(entity, getNeighbour(record.archetype, component));
+}
+
+void EcsWorld::reserve(ComponentMask mask, int count){
+	// Creating the archetype would move the ones queries are reading
+	if (!checkStructural("reserve"))
+		return;
+	int archetype = findArchetype(mask);
+	if (archetype < 0)
+		return;
+	Archetype & a = archetypes[archetype];
+	int free = a.chunks.empty() ? 0 : a.capacity - a.chunks.back().count;
+	int needed = (count - free + a.capacity - 1) / a.capacity;
+	for (int i=(int)freeChunks.size(); i<needed; i++){
+		freeChunks.push_back((unsigned char *)allocateAligned(ECS_CHUNK_BYTES));
+		allocatedChunks++;
+	}
+	a.chunks.reserve(a.chunks.size() + std::max(needed, 0));
+	records.reserve(records.size() + count);
+}
+
+void EcsWorld::flush(EcsCommandBuffer & commands){
+	PROFILE_FUNCTION();
+	if (!checkStructural("flush"))
+		return;
+	Entity created = NULL_ENTITY;
+	size_t cursor = 0;
+	while (cursor < commands.bytes.size()){
+		EcsCommandBuffer::Command command;
+		memcpy(&command, &commands.bytes[cursor], sizeof(command));
+		const void * value = command.size > 0 ? &commands.bytes[cursor + sizeof(command)] : NULL;
+		cursor += sizeof(command) + ((command.size + 7) & ~7);
+		switch (command.type){
+		case EcsCommandBuffer::CREATE:
+			created = create(command.mask);
+			break;
+		case EcsCommandBuffer::SET_CREATED:
+			if (value && isAlive(created) && archetypes[records[created.index].archetype].offsets[command.component] >= 0)
+				memcpy(getComponent(created, command.component), value, std::min(command.size, sizes[command.component]));
+			break;
+		case EcsCommandBuffer::DESTROY:
+			destroy(command.entity);
+			break;
+		case EcsCommandBuffer::ADD:
+			if (value && command.size != sizes[command.component])
+				printf("EcsWorld::flush : %d bytes for the component %s of %d\n", command.size, names[command.component], sizes[command.component]);
+			else
+				add(command.entity, command.component, value);
+			break;
+		case EcsCommandBuffer::REMOVE:
+			remove(command.entity, command.component);
+			break;
+		}
+	}
+	commands.clear();
+}
+
+ComponentMask EcsWorld::getMask(Entity entity) const {
+	return isAlive(entity) ? archetypes[records[entity.index].archetype].mask : 0;
+}
+
+void * EcsWorld::getComponent(Entity entity, int component){
+	if (!isAlive(entity))
+		return NULL;
+	const Record & record = records[entity.index];
+	const Archetype & a = archetypes[record.archetype];
+	if (a.offsets[component] < 0)
+		return NULL;
+	return a.chunks[record.chunk].data + a.offsets[component] + record.row * sizes[component];
+}
+
+void EcsWorld::matchArchetypes(EcsQuery & query) const {
+	// Only the archetypes created since the last time
+	for (; query.checked<(int)archetypes.size(); query.checked++){
+		ComponentMask mask = archetypes[query.checked].mask;
+		if ((mask & query.all) == query.all && (mask & query.none) == 0)
+			query.archetypes.push_back(query.checked);
+	}
+}
+
+void EcsWorld::beginQuery(EcsQuery & query, std::vector<EcsChunkView> & chunks){
+	matchArchetypes(query);
+	for (size_t i=0; i<query.archetypes.size(); i++){
+		const Archetype & a = archetypes[query.archetypes[i]];
+		for (size_t c=0; c<a.chunks.size(); c++){
+			EcsChunkView view = { a.chunks[c].data, a.offsets, a.chunks[c].count };
+			chunks.push_back(view);
+		}
+	}
+	iterating++;
+}
+
+int EcsWorld::count(EcsQuery & query){
+	matchArchetypes(query);
+	int total = 0;
+	for (size_t i=0; i<query.archetypes.size(); i++){
+		const Archetype & a = archetypes[query.archetypes[i]];
+		if (!a.chunks.empty())
+			total += (int)(a.chunks.size() - 1) * a.capacity + a.chunks.back().count;
+	}
+	return total;
+}
+
+int EcsWorld::getChunkCount() const {
+	int count = 0;
+	for (size_t a=0; a<archetypes.size(); a++)
+		count += (int)archetypes[a].chunks.size();
+	return count;
+}
+
+size_t EcsWorld::getMemoryBytes() const {
+	size_t bytes = (size_t)allocatedChunks * ECS_CHUNK_BYTES + records.capacity() * sizeof(Record)
+	             + freeIndices.capacity() * sizeof(uint32_t) + archetypes.capacity() * sizeof(Archetype);
+	for (size_t a=0; a<archetypes.size(); a++)
+		bytes += archetypes[a].chunks.capacity() * sizeof(Chunk) + archetypes[a].components.capacity() * sizeof(int);
+	return bytes;
+}
+
+// Benchmark
+
+// How game objects are stored without the ECS : everything an object may need, in one structure
+struct BenchObject {
+	glm::vec3 position;
+	glm::vec3 velocity;
+	glm::quat rotation;
+	glm::mat4 world;
+	float lifetime;
+	float spin;
+	int flags;
+};
+
+static double nanosecondsSince(std::chrono::steady_clock::time_point start, double count){
+	return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / count;
+}
+
+static float random01(unsigned int & seed){
+	seed = seed * 1664525u + 1013904223u;
+	return (seed >> 8) * (1.0f / 16777216.0f);
+}
+
+void runEcsBenchmark(int entityCount){
+	const float dt = 1.0f / 60.0f;
+	const int frames = 20;
+	JobSystem jobs;
+	printf("ECS benchmark : %d entities, %d thread(s)\n", entityCount, jobs.getThreadCount());
+
+	EcsWorld world;
+	int position = world.registerComponent<glm::vec3>("position");
+	int velocity = world.registerComponent<glm::vec3>("velocity");
+	int lifetime = world.registerComponent<float>("lifetime");
+	int spin = world.registerComponent<float>("spin");
+	ComponentMask moving = componentBit(position) | componentBit(velocity) | componentBit(lifetime);
+
+	// A quarter of them spin too : two archetypes
+	std::vector<glm::vec3> positions(entityCount), velocities(entityCount);
+	std::vector<float> lifetimes(entityCount);
+	unsigned int seed = 12345;
+	for (int i=0; i<entityCount; i++){
+		positions[i] = glm::vec3(random01(seed) * 100.0f, random01(seed) * 10.0f, random01(seed) * 100.0f);
+		velocities[i] = glm::vec3(random01(seed) - 0.5f, random01(seed) - 0.5f, random01(seed) - 0.5f);
+		lifetimes[i] = (2.0f * frames + random01(seed) * 100.0f) * dt; // Past the movement below, then about 1% expire every frame
+	}
+	std::vector<Entity> entities(entityCount);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	world.reserve(moving, entityCount);
+	for (int i=0; i<entityCount; i++){
+		Entity entity = world.create(i % 4 == 3 ? moving | componentBit(spin) : moving);
+		*world.get<glm::vec3>(entity, position) = positions[i];
+		*world.get<glm::vec3>(entity, velocity) = velocities[i];
+		*world.get<float>(entity, lifetime) = lifetimes[i];
+		entities[i] = entity;
+	}
+	printf("  spawn     : %.1f ns/entity, %d archetypes, %d chunks, %.1f MB\n", nanosecondsSince(start, entityCount),
+		world.getArchetypeCount(), world.getChunkCount(), world.getMemoryBytes() / (1024.0 * 1024.0));
+
+	std::vector<BenchObject> objects(entityCount);
+	for (int i=0; i<entityCount; i++){
+		BenchObject object = { positions[i], velocities[i], glm::quat(), glm::mat4(1.0f), lifetimes[i], 0.0f, i % 4 == 3 ? 1 : 0 };
+		objects[i] = object;
+	}
+
+	// Movement : the same arithmetic over the structures, then over the chunks
+	start = std::chrono::steady_clock::now();
+	for (int f=0; f<frames; f++){
+		for (int i=0; i<entityCount; i++){
+			objects[i].position += objects[i].velocity * dt;
+			objects[i].lifetime -= dt;
+		}
+	}
+	double aosNs = nanosecondsSince(start, (double)entityCount * frames);
+
+	EcsQuery movers(moving);
+	auto move = [position, velocity, lifetime, dt](const EcsChunkView & chunk){
+		glm::vec3 * p = chunk.get<glm::vec3>(position);
+		const glm::vec3 * v = chunk.get<glm::vec3>(velocity);
+		float * life = chunk.get<float>(lifetime);
+		for (int i=0; i<chunk.count; i++){
+			p[i] += v[i] * dt;
+			life[i] -= dt;
+		}
+	};
+	start = std::chrono::steady_clock::now();
+	for (int f=0; f<frames; f++)
+		world.forEach(movers, move);
+	double ecsNs = nanosecondsSince(start, (double)entityCount * frames);
+	start = std::chrono::steady_clock::now();
+	for (int f=0; f<frames; f++)
+		world.parallelForEach(movers, jobs, move);
+	double parallelNs = nanosecondsSince(start, (double)entityCount * frames);
+	// Once more on the structures, then both must be where the other is
+	for (int f=0; f<frames; f++)
+		for (int i=0; i<entityCount; i++)
+			objects[i].position += objects[i].velocity * dt;
+	int mismatches = 0;
+	for (int i=0; i<entityCount; i++)
+		mismatches += *world.get<glm::vec3>(entities[i], position) != objects[i].position ? 1 : 0;
+	printf("  move      : %.2f ns/entity in structures, %.2f in chunks, %.2f in chunks on every thread, %s\n",
+		aosNs, ecsNs, parallelNs, mismatches == 0 ? "same positions" : "POSITIONS DIFFER");
+
+	// Only the spinning quarter : the query skips the other archetype altogether
+	EcsQuery spinners(componentBit(spin));
+	int spinnerCount = world.count(spinners);
+	start = std::chrono::steady_clock::now();
+	for (int f=0; f<frames; f++){
+		for (int i=0; i<entityCount; i++)
+			if (objects[i].flags & 1)
+				objects[i].spin += dt;
+	}
+	aosNs = nanosecondsSince(start, (double)spinnerCount * frames);
+	start = std::chrono::steady_clock::now();
+	for (int f=0; f<frames; f++){
+		world.forEach(spinners, [spin, dt](const EcsChunkView & chunk){
+			float * angle = chunk.get<float>(spin);
+			for (int i=0; i<chunk.count; i++)
+				angle[i] += dt;
+		});
+	}
+	ecsNs = nanosecondsSince(start, (double)spinnerCount * frames);
+	printf("  spin      : %.2f ns/spinner in structures, %.2f in chunks (%d spinners)\n", aosNs, ecsNs, spinnerCount);
+
+	// Expired entities despawn and respawn elsewhere, through the command buffer of their thread
+	std::vector<EcsCommandBuffer> buffers(jobs.getThreadCount());
+	double systemNs = 0.0, flushNs = 0.0;
+	long long changes = 0;
+	for (int f=0; f<frames; f++){
+		start = std::chrono::steady_clock::now();
+		world.parallelForEach(movers, jobs, [&](const EcsChunkView & chunk){
+			EcsCommandBuffer & commands = buffers[jobs.getThreadIndex()];
+			const Entity * ids = chunk.getEntities();
+			glm::vec3 * p = chunk.get<glm::vec3>(position);
+			float * life = chunk.get<float>(lifetime);
+			for (int i=0; i<chunk.count; i++){
+				life[i] -= dt;
+				if (life[i] > 0.0f)
+					continue;
+				commands.destroy(ids[i]);
+				commands.create(chunk.has(spin) ? moving | componentBit(spin) : moving);
+				commands.setCreated(position, p[i] * 0.5f);
+				commands.setCreated(lifetime, 100.0f * dt);
+			}
+		});
+		systemNs += nanosecondsSince(start, 1.0);
+		start = std::chrono::steady_clock::now();
+		for (size_t b=0; b<buffers.size(); b++){
+			changes += buffers[b].getCount();
+			world.flush(buffers[b]);
+		}
+		flushNs += nanosecondsSince(start, 1.0);
+	}
+	changes /= 4; // A despawn, a spawn and its two components each
+	int stale = 0;
+	for (int i=0; i<entityCount; i++)
+		stale += world.isAlive(entities[i]) ? 0 : 1;
+	printf("  churn     : %lld respawns, system %.2f ms/frame, %.1f ns per respawn to apply, %d entities, %d stale handles detected\n",
+		changes, systemNs / frames * 1e-6, flushNs / std::max(changes, 1LL), world.getCount(), stale);
+
+	// Tagging and untagging : every entity moves to the other archetype and back
+	int toggled = std::min(entityCount, 100000);
+	std::vector<Entity> alive;
+	alive.reserve(toggled);
+	EcsQuery all(moving, componentBit(spin));
+	world.forEach(all, [&alive, toggled](const EcsChunkView & chunk){
+		for (int i=0; i<chunk.count && (int)alive.size() < toggled; i++)
+			alive.push_back(chunk.getEntities()[i]);
+	});
+	start = std::chrono::steady_clock::now();
+	for (size_t i=0; i<alive.size(); i++)
+		world.add(alive[i], spin);
+	for (size_t i=0; i<alive.size(); i++)
+		world.remove(alive[i], spin);
+	printf("  add/remove: %.1f ns per move between archetypes, %d spinners after, %.1f MB\n",
+		nanosecondsSince(start, 2.0 * std::max((int)alive.size(), 1)), world.count(spinners), world.getMemoryBytes() / (1024.0 * 1024.0));
+
+	// Despawn everything
+	std::vector<Entity> everything;
+	everything.reserve(world.getCount());
+	EcsQuery any;
+	world.forEach(any, [&everything](const EcsChunkView & chunk){
+		everything.insert(everything.end(), chunk.getEntities(), chunk.getEntities() + chunk.count);
+	});
+	start = std::chrono::steady_clock::now();
+	for (size_t i=0; i<everything.size(); i++)
+		world.destroy(everything[i]);
+	printf("  despawn   : %.1f ns/entity, %d left, %d chunks\n", nanosecondsSince(start, (double)std::max((int)everything.size(), 1)),
+		world.getCount(), world.getChunkCount());
+}
@@ -0,0 +1,213 @@
+#ifndef ECS_HPP
+#define ECS_HPP
+
+// Entity-component system.
+// An entity is only an id : an index, and the generation of that index, bumped
+// every time the index is freed, so that a handle kept after its entity was
+// destroyed is detected instead of pointing at whatever reused the index.
+// Components are plain data, registered with their size and copied bytewise.
+// Entities with the same set of components share an archetype, which stores
+// them in chunks of ECS_CHUNK_BYTES : the ids, then one array per component
+// (SoA), each aligned for SSE. Every chunk but the last of an archetype is
+// full : destroying an entity moves the last entity of its archetype into the
+// hole. A query visits the archetypes with the components it asks for, chunk
+// by chunk, over dense arrays. It remembers the archetypes it matched, and
+// only looks at the ones created since.
+// Adding or removing a component moves the entity to another archetype.
+// Structural changes (create, destroy, add, remove) can't happen while a query
+// runs : systems record them in an EcsCommandBuffer, one per thread, and the
+// buffers are applied in order by EcsWorld::flush() at the sync points between
+// systems. Freed chunks are pooled, so a steady game doesn't allocate.
+// Queries may run inside the callback of another query, each with its own
+// list of chunks. An EcsQuery is only used by one thread at a time.
+// Needs jobsystem.hpp, for parallelForEach().
+
+#define ECS_MAX_COMPONENTS 64
+#define ECS_CHUNK_BYTES 16384
+
+typedef uint64_t ComponentMask;
+
+inline ComponentMask componentBit(int component){ return (ComponentMask)1 << component; }
+
+struct Entity {
+	uint32_t index;
+	uint32_t generation; // 0 for none : no live entity has it
+
+	bool operator==(const Entity & other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const Entity & other) const { return !(*this == other); }
+};
+
+static const Entity NULL_ENTITY = { 0, 0 };
+
+// One chunk, as a query sees it
+struct EcsChunkView {
+	unsigned char * data;
+	const int * offsets; // Of every component's array in data, -1 when the archetype doesn't have it
+	int count;
+
+	const Entity * getEntities() const { return (const Entity *)data; }
+	bool has(int component) const { return offsets[component] >= 0; }
+	template <typename T>
+	T * get(int component) const { return offsets[component] < 0 ? NULL : (T *)(data + offsets[component]); }
+};
+
+// Entities with every component of all, and none of none
+struct EcsQuery {
+	ComponentMask all;
+	ComponentMask none;
+	std::vector<int> archetypes; // Matched so far
+	int checked;                 // Archetypes looked at so far
+
+	EcsQuery(ComponentMask all = 0, ComponentMask none = 0) : all(all), none(none), checked(0) {}
+};
+
+// Structural changes recorded while systems run, applied by EcsWorld::flush()
+class EcsCommandBuffer {
+public:
+	// New entity with these components, zeroed. setCreated() then sets them.
+	void create(ComponentMask mask);
+	void setCreated(int component, const void * value, int size);
+	template <typename T>
+	void setCreated(int component, const T & value){ setCreated(component, &value, sizeof(T)); }
+
+	// Entities destroyed in the meantime are skipped
+	void destroy(Entity entity);
+	// Adds the component, or only sets it if the entity already has it. value NULL zeroes it.
+	void add(Entity entity, int component, const void * value, int size);
+	template <typename T>
+	void add(Entity entity, int component, const T & value){ add(entity, component, &value, sizeof(T)); }
+	void remove(Entity entity, int component);
+
+	bool isEmpty() const { return bytes.empty(); }
+	int getCount() const { return count; }
+	void clear(){ bytes.clear(); count = 0; }
+
+	EcsCommandBuffer() : count(0) {}
+
+private:
+	friend class EcsWorld;
+	enum Type { CREATE, SET_CREATED, DESTROY, ADD, REMOVE };
+	struct Command {
+		int type;
+		int component;
+		int size;     // Of the value after it, 0 for none
+		Entity entity;
+		ComponentMask mask;
+	};
+	void push(int type, Entity entity, int component, ComponentMask mask, const void * value, int size);
+
+	std::vector<unsigned char> bytes; // Commands, each followed by its value padded to 8 bytes
+	int count;
+};
+
+class EcsWorld {
+public:
+	EcsWorld();
+	~EcsWorld();
+
+	// Returns the id of the component, -1 once there are ECS_MAX_COMPONENTS, or if one
+	// doesn't fit in a chunk
+	int registerComponent(const char * name, int size);
+	template <typename T>
+	int registerComponent(const char * name){ return registerComponent(name, sizeof(T)); }
+	const char * getComponentName(int component) const { return names[component]; }
+
+	// Structural changes, at once : not while a query runs. Sets of components too big for
+	// one entity per chunk are refused.
+	Entity create(ComponentMask mask); // Components zeroed, NULL_ENTITY if refused
+	void destroy(Entity entity);
+	void add(Entity entity, int component, const void * value = NULL);
+	void remove(Entity entity, int component);
+	// Chunks for count more entities with these components, ahead of a burst of create()
+	void reserve(ComponentMask mask, int count);
+
+	// Applies the commands in the order they were recorded, then clears them
+	void flush(EcsCommandBuffer & commands);
+
+	bool isAlive(Entity entity) const { return entity.index < records.size() && entity.generation != 0 && records[entity.index].generation == entity.generation; }
+	ComponentMask getMask(Entity entity) const;
+	// NULL if the entity is dead or doesn't have the component. Valid until the next structural change.
+	void * getComponent(Entity entity, int component);
+	template <typename T>
+	T * get(Entity entity, int component){ return (T *)getComponent(entity, component); }
+
+	// Calls f(const EcsChunkView &) on every chunk the query matches
+	template <typename F>
+	void forEach(EcsQuery & query, const F & f){
+		std::vector<EcsChunkView> chunks;
+		beginQuery(query, chunks);
+		for (size_t i=0; i<chunks.size(); i++)
+			f(chunks[i]);
+		iterating--;
+	}
+	// Same on the job system, a chunk per job : f must only write to its own chunk
+	template <typename F>
+	void parallelForEach(EcsQuery & query, JobSystem & jobs, const F & f){
+		std::vector<EcsChunkView> chunks;
+		beginQuery(query, chunks);
+		jobs.parallelFor(0, (int)chunks.size(), 1, [&chunks, &f](int begin, int end){
+			for (int i=begin; i<end; i++)
+				f(chunks[i]);
+		});
+		iterating--;
+	}
+	// Entities the query matches
+	int count(EcsQuery & query);
+
+	int getCount() const { return liveCount; }
+	int getArchetypeCount() const { return (int)archetypes.size(); }
+	int getChunkCount() const;
+	size_t getMemoryBytes() const;
+
+private:
+	struct Chunk {
+		unsigned char * data;
+		int count;
+	};
+	struct Archetype {
+		ComponentMask mask;
+		int offsets[ECS_MAX_COMPONENTS]; // -1 for the components it doesn't have
+		std::vector<int> components;
+		int capacity;                    // Entities per chunk
+		std::vector<Chunk> chunks;       // Full but the last
+		int next[ECS_MAX_COMPONENTS];    // Archetype with a component more or less, -1 until looked up
+	};
+	struct Record {
+		int archetype; // -1 while the index is free
+		int chunk;
+		int row;
+		uint32_t generation;
+	};
+
+	EcsWorld(const EcsWorld &);
+	EcsWorld & operator=(const EcsWorld &);
+
+	int findArchetype(ComponentMask mask); // Created if needed, -1 if an entity doesn't fit in a chunk
+	int getNeighbour(int archetype, int component);
+	void allocateRow(int archetype, int & chunk, int & row);
+	void removeRow(int archetype, int chunk, int row);
+	void moveEntity(Entity entity, int archetype);
+	unsigned char * allocateChunk();
+	void matchArchetypes(EcsQuery & query) const;
+	void beginQuery(EcsQuery & query, std::vector<EcsChunkView> & chunks);
+	bool checkStructural(const char * operation) const;
+
+	int componentCount;
+	int sizes[ECS_MAX_COMPONENTS];
+	const char * names[ECS_MAX_COMPONENTS];
+	std::vector<Archetype> archetypes;
+	std::vector<std::pair<ComponentMask, int> > archetypeMasks; // Sorted, to find them
+	std::vector<Record> records;
+	std::vector<uint32_t> freeIndices;
+	int liveCount;
+	std::vector<unsigned char *> freeChunks;
+	int allocatedChunks;
+	std::atomic<int> iterating; // Queries running, on any thread
+};
+
+// entityCount entities moving around : spawning them, updating them with queries on one
+// thread and on every core against an array of structures, then spawning and despawning
+// through command buffers, and moving them between archetypes
+void runEcsBenchmark(int entityCount);
+
+#endif
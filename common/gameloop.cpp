@@ -0,0 +1,134 @@
+#include <thread>
+#include <algorithm>
+
+#include "gameloop.hpp"
+#include "profiler.hpp"
+
+// Beyond this, the simulation gives up catching up instead of making the next frame even slower
+static const int MAX_TICKS_PER_FRAME = 5;
+
+// Bounds of the time spun at the end of a frame, in seconds
+static const double MIN_SPIN_MARGIN = 0.0002;
+static const double MAX_SPIN_MARGIN = 0.004;
+
+static double seconds(std::chrono::steady_clock::duration d){
+	return std::chrono::duration<double>(d).count();
+}
+
+GameLoop::GameLoop(double tickRate, double targetFrameRate){
+	tickDuration = 1.0 / tickRate;
+	this->targetFrameRate = targetFrameRate;
+	accumulator = 0.0;
+	fixedFrameTime = 0.0;
+	ticksThisFrame = 0;
+	inTick = false;
+	tickCount = 0;
+	frames = 0;
+	spinMargin = 0.001;
+	started = false;
+	frameSum = tickSum = sleepSum = 0.0;
+	frameCount = tickSumCount = droppedCount = 0;
+	newStats = false;
+	GameLoopStats empty = {};
+	stats = empty;
+}
+
+void GameLoop::setTargetFrameRate(double framesPerSecond){
+	targetFrameRate = framesPerSecond;
+}
+
+void GameLoop::beginFrame(){
+	Clock::time_point now = Clock::now();
+	newStats = false;
+	if (!started){
+		// The first frame simulates one tick, so that there is something to show
+		started = true;
+		statsStart = now;
+		accumulator = tickDuration;
+	}else{
+		double elapsed = seconds(now - frameStart);
+		accumulator += fixedFrameTime > 0.0 ? fixedFrameTime : elapsed;
+		frameSum += elapsed;
+		frameCount++;
+	}
+	frameStart = now;
+
+	// Too far behind (breakpoint, window dragged...) : drop the ticks we can't afford
+	if (accumulator > MAX_TICKS_PER_FRAME * tickDuration){
+		int dropped = (int)(accumulator / tickDuration) - MAX_TICKS_PER_FRAME;
+		droppedCount += dropped;
+		accumulator -= dropped * tickDuration;
+	}
+	ticksThisFrame = 0;
+	frames++;
+
+	double statsElapsed = seconds(now - statsStart);
+	if (statsElapsed >= 1.0 && frameCount > 0){
+		stats.frameMs = (float)(1000.0 * frameSum / frameCount);
+		stats.sleepMs = (float)(1000.0 * sleepSum / frameCount);
+		stats.workMs = stats.frameMs - stats.sleepMs;
+		stats.tickMs = tickSumCount > 0 ? (float)(1000.0 * tickSum / tickSumCount) : 0.0f;
+		stats.framesPerSecond = (float)(frameCount / statsElapsed);
+		stats.ticksPerSecond = (float)(tickSumCount / statsElapsed);
+		stats.droppedTicks = droppedCount;
+		frameSum = tickSum = sleepSum = 0.0;
+		frameCount = tickSumCount = droppedCount = 0;
+		statsStart = now;
+		newStats = true;
+	}
+}
+
+bool GameLoop::tick(){
+	Clock::time_point now = Clock::now();
+	if (inTick){
+		tickSum += seconds(now - tickStart);
+		tickSumCount++;
+		inTick = false;
+	}
+	if (accumulator < tickDuration || ticksThisFrame >= MAX_TICKS_PER_FRAME)
+		return false;
+
+	accumulator -= tickDuration;
+	ticksThisFrame++;
+	tickCount++;
+	inTick = true;
+	tickStart = now;
+	return true;
+}
+
+void GameLoop::endFrame(){
+	if (targetFrameRate <= 0.0)
+		return;
+
+	Clock::time_point start = Clock::now();
+	Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / targetFrameRate));
+
+	// Count from the previous deadline rather than from the start of the frame, so that
+	// the time between endFrame() and beginFrame() doesn't add up into a lower frame rate.
+	// After a late frame, start again from now.
+	if (deadline + period <= frameStart || deadline > frameStart + period)
+		deadline = frameStart + period;
+	else
+		deadline += period;
+	if (start >= deadline)
+		return; // Late already
+	PROFILE_SCOPE("GameLoop::endFrame wait");
+
+	// Sleep most of the time away : the core can idle, which is what saves power
+	double remaining = seconds(deadline - start);
+	if (remaining > spinMargin){
+		Clock::duration request = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(remaining - spinMargin));
+		std::this_thread::sleep_for(request);
+
+		// Learn how late the OS wakes us up : spin at least that long next time
+		double oversleep = seconds(Clock::now() - start - request);
+		spinMargin = std::max(spinMargin * 0.99, oversleep * 1.25);
+		spinMargin = std::min(std::max(spinMargin, MIN_SPIN_MARGIN), MAX_SPIN_MARGIN);
+	}
+
+	// Then spin for the last fraction of a millisecond
+	while (Clock::now() < deadline)
+		std::this_thread::yield();
+
+	sleepSum += seconds(Clock::now() - start);
+}
@@ -0,0 +1,88 @@
+#ifndef GAMELOOP_HPP
+#define GAMELOOP_HPP
+
+#include <chrono>
+
+// Game loop scheduler.
+// The simulation advances in fixed ticks, so it behaves the same at any frame
+// rate : the time of each frame goes into an accumulator, which is spent one
+// tick at a time. What is left is the fraction of a tick the renderer must
+// interpolate by. A frame limiter then sleeps the rest of the frame away, and
+// spins only for the last moments, which the OS scheduler can't hit precisely.
+//
+//	loop.beginFrame();
+//	while (loop.tick())
+//		simulate(loop.getTickDuration());
+//	render(loop.getAlpha());
+//	loop.endFrame();
+
+// Averages over the last second
+struct GameLoopStats {
+	float frameMs;    // Whole frame, limiter included
+	float workMs;     // Frame without the limiter
+	float tickMs;     // One simulation tick
+	float sleepMs;    // Spent in the limiter, sleeping or spinning
+	float framesPerSecond;
+	float ticksPerSecond;
+	int droppedTicks; // Ticks skipped because the simulation couldn't keep up
+};
+
+class GameLoop {
+public:
+	// targetFrameRate = 0 disables the limiter
+	GameLoop(double tickRate = 60.0, double targetFrameRate = 60.0);
+
+	void setTargetFrameRate(double framesPerSecond);
+	double getTargetFrameRate() const { return targetFrameRate; }
+
+	// Every frame then advances the simulation by exactly this much, however long it really took.
+	// For repeatable runs. 0 goes back to real time.
+	void setFixedFrameTime(double seconds) { fixedFrameTime = seconds; }
+
+	// Measures the time since the previous frame and adds it to the accumulator
+	void beginFrame();
+
+	// True while a whole tick is left in the accumulator. Call it until it returns false.
+	bool tick();
+
+	unsigned int getFrameCount() const { return frames; }
+
+	double getTickDuration() const { return tickDuration; }
+	unsigned int getTickCount() const { return tickCount; }
+
+	// Position between the previous tick (0) and the last one (1)
+	float getAlpha() const { return (float)(accumulator / tickDuration); }
+
+	// Waits for the end of the frame, if there is a limit
+	void endFrame();
+
+	// True once per second, when the statistics have just been updated
+	bool hasNewStats() const { return newStats; }
+	const GameLoopStats & getStats() const { return stats; }
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	double tickDuration;
+	double targetFrameRate;
+	double accumulator;
+	double fixedFrameTime;
+	int ticksThisFrame;
+	bool inTick;
+	unsigned int tickCount;
+	unsigned int frames;
+	double spinMargin;        // Oversleep the limiter allows for, learnt from the previous frames
+	Clock::time_point frameStart;
+	Clock::time_point deadline;   // End of the last limited frame
+	Clock::time_point tickStart;
+	bool started;
+
+	// Sums since the last statistics update
+	Clock::time_point statsStart;
+	double frameSum, tickSum, sleepSum;
+	int frameCount, tickSumCount, droppedCount;
+	bool newStats;
+	GameLoopStats stats;
+};
+
+#endif
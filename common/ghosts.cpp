@@ -0,0 +1,516 @@
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/constants.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define GHOSTS_USE_SSE
+#endif
+
+#include "shader.hpp"
+#include "vboindexer.hpp"
+#include "uniformstream.hpp"
+#include "instanceculling.hpp"
+#include "jobsystem.hpp"
+#include "profiler.hpp"
+#include "ghosttracks.hpp"
+#include "ghosts.hpp"
+#include "glstats.hpp"
+
+// Screen tiles the ghosts are sorted in, on each axis
+static const int TILES = 8;
+static const int BUCKET_COUNT = GHOST_LOD_COUNT * TILES * TILES;
+static const unsigned short CULLED = 0xffff;
+static const float GHOST_OPACITY = 0.3f;
+
+void GhostInstances::clear(){
+	for (int l=0; l<GHOST_LOD_COUNT; l++)
+		lods[l].clear();
+}
+
+int GhostInstances::getCount() const {
+	int count = 0;
+	for (int l=0; l<GHOST_LOD_COUNT; l++)
+		count += (int)lods[l].size();
+	return count;
+}
+
+GhostPlayback::GhostPlayback(JobSystem * jobs){
+	this->jobs = jobs;
+	count = padded = 0;
+	sample = -1;
+	lodDistances[0] = 3.0f;
+	lodDistances[1] = 6.0f;
+}
+
+void GhostPlayback::setRace(const GhostRace & race){
+	PROFILE_FUNCTION();
+	this->race = race;
+	count = (int)race.tracks.size();
+	padded = (count + 3) & ~3;
+	firstKeyframe.resize(count + 1);
+	firstKeyframe[0] = 0;
+	for (int g=0; g<count; g++)
+		firstKeyframe[g + 1] = firstKeyframe[g] + (race.tracks[g].sampleCount + GHOST_KEYFRAME_SAMPLES - 1) / GHOST_KEYFRAME_SAMPLES;
+	keyframes.resize(firstKeyframe[count]);
+
+	// Every track once through : where its keyframes start, and how much of it is valid
+	GhostRace & tracks = this->race;
+	std::vector<unsigned int> & offsets = keyframes;
+	const std::vector<unsigned int> & first = firstKeyframe;
+	auto index = [&tracks, &offsets, &first](int begin, int end){
+		for (int g=begin; g<end; g++){
+			GhostTrack & track = tracks.tracks[g];
+			unsigned int cursor = 0;
+			int qx = 0, qy = 0, qz = 0;
+			for (unsigned int s=0; s<track.sampleCount; s++){
+				if (s % GHOST_KEYFRAME_SAMPLES == 0)
+					offsets[first[g] + s / GHOST_KEYFRAME_SAMPLES] = cursor;
+				if (!decodeGhostSample(track.data, cursor, s, qx, qy, qz)){
+					track.sampleCount = s;
+					break;
+				}
+			}
+		}
+	};
+	if (jobs)
+		jobs->parallelFor(0, count, 64, index);
+	else
+		index(0, count);
+
+	cursor.assign(count, 0);
+	decoded.assign(count, 0);
+	qx.assign(count, 0);
+	qy.assign(count, 0);
+	qz.assign(count, 0);
+	x0.assign(padded, 0.0f); y0.assign(padded, 0.0f); z0.assign(padded, 0.0f);
+	x1.assign(padded, 0.0f); y1.assign(padded, 0.0f); z1.assign(padded, 0.0f);
+	x.assign(padded, 0.0f);  y.assign(padded, 0.0f);  z.assign(padded, 0.0f);
+	sample = -1;
+}
+
+void GhostPlayback::decodeRange(int begin, int end, bool seek){
+	for (int g=begin; g<end; g++){
+		const GhostTrack & track = race.tracks[g];
+		unsigned int n = track.sampleCount;
+		if (n == 0)
+			continue; // Never drawn
+		unsigned int s0 = (unsigned int)sample < n - 1 ? (unsigned int)sample : n - 1;
+		unsigned int s1 = (unsigned int)sample + 1 < n - 1 ? (unsigned int)sample + 1 : n - 1;
+		if (seek){
+			// From the keyframe before, up to the sample before the time
+			unsigned int keyframe = s0 / GHOST_KEYFRAME_SAMPLES;
+			cursor[g] = keyframes[firstKeyframe[g] + keyframe];
+			for (decoded[g] = keyframe * GHOST_KEYFRAME_SAMPLES; decoded[g] <= s0; decoded[g]++)
+				decodeGhostSample(track.data, cursor[g], decoded[g], qx[g], qy[g], qz[g]);
+			x0[g] = qx[g] / GHOST_UNITS_PER_METER;
+			y0[g] = qy[g] / GHOST_UNITS_PER_METER;
+			z0[g] = qz[g] / GHOST_UNITS_PER_METER;
+		}else{
+			x0[g] = x1[g];
+			y0[g] = y1[g];
+			z0[g] = z1[g];
+		}
+		// And the one after. At the end of its run, the ghost stays there.
+		if (decoded[g] <= s1){
+			decodeGhostSample(track.data, cursor[g], decoded[g], qx[g], qy[g], qz[g]);
+			decoded[g]++;
+		}
+		x1[g] = qx[g] / GHOST_UNITS_PER_METER;
+		y1[g] = qy[g] / GHOST_UNITS_PER_METER;
+		z1[g] = qz[g] / GHOST_UNITS_PER_METER;
+	}
+}
+
+void GhostPlayback::update(double tick){
+	PROFILE_FUNCTION();
+	if (count == 0)
+		return;
+	double time = tick > 0.0 ? tick / race.interval : 0.0;
+	int target = (int)time;
+	float alpha = (float)(time - target);
+	if (target != sample){
+		// One sample on from the last update : only the next one is decoded. The
+		// first update after setRace() has no sample before to start from.
+		bool seek = sample < 0 || target != sample + 1;
+		sample = target;
+		if (jobs)
+			jobs->parallelFor(0, count, 512, [this, seek](int begin, int end){ decodeRange(begin, end, seek); });
+		else
+			decodeRange(0, count, seek);
+	}
+
+#ifdef GHOSTS_USE_SSE
+	const __m128 a = _mm_set1_ps(alpha);
+	for (int i=0; i<padded; i+=4){
+		__m128 from = _mm_loadu_ps(&x0[i]);
+		_mm_storeu_ps(&x[i], _mm_add_ps(from, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&x1[i]), from), a)));
+		from = _mm_loadu_ps(&y0[i]);
+		_mm_storeu_ps(&y[i], _mm_add_ps(from, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&y1[i]), from), a)));
+		from = _mm_loadu_ps(&z0[i]);
+		_mm_storeu_ps(&z[i], _mm_add_ps(from, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&z1[i]), from), a)));
+	}
+#else
+	for (int i=0; i<padded; i++){
+		x[i] = x0[i] + (x1[i] - x0[i]) * alpha;
+		y[i] = y0[i] + (y1[i] - y0[i]) * alpha;
+		z[i] = z0[i] + (z1[i] - z0[i]) * alpha;
+	}
+#endif
+}
+
+void GhostPlayback::buildInstances(const glm::mat4 & viewProjection, const glm::vec3 & camera, float radius, GhostInstances & out){
+	PROFILE_FUNCTION();
+	out.clear();
+	if (count == 0)
+		return;
+	glm::vec4 planes[6];
+	extractFrustumPlanes(viewProjection, planes);
+	const glm::mat4 & m = viewProjection;
+	float lodSquared[GHOST_LOD_COUNT - 1];
+	for (int l=0; l<GHOST_LOD_COUNT - 1; l++)
+		lodSquared[l] = lodDistances[l] * lodDistances[l];
+	buckets.resize(padded);
+	depths.resize(padded);
+	bucketStart.assign(BUCKET_COUNT + 1, 0);
+
+	// Visible ghosts, with their tile, depth and distance
+	for (int i=0; i<padded; i+=4){
+		float sx[4], sy[4], sw[4], distance[4];
+		int visible;
+#ifdef GHOSTS_USE_SSE
+		__m128 px = _mm_loadu_ps(&x[i]), py = _mm_loadu_ps(&y[i]), pz = _mm_loadu_ps(&z[i]);
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		const __m128 margin = _mm_set1_ps(-radius);
+		for (int p=0; p<6; p++){
+			__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p].x), px), _mm_mul_ps(_mm_set1_ps(planes[p].y), py)),
+			                      _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p].z), pz), _mm_set1_ps(planes[p].w)));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(d, margin));
+		}
+		visible = _mm_movemask_ps(inside);
+		if (visible == 0){
+			for (int k=0; k<4; k++)
+				buckets[i + k] = CULLED;
+			continue;
+		}
+		_mm_storeu_ps(sx, _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[0][0]), px), _mm_mul_ps(_mm_set1_ps(m[1][0]), py)),
+		                             _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[2][0]), pz), _mm_set1_ps(m[3][0]))));
+		_mm_storeu_ps(sy, _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[0][1]), px), _mm_mul_ps(_mm_set1_ps(m[1][1]), py)),
+		                             _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[2][1]), pz), _mm_set1_ps(m[3][1]))));
+		_mm_storeu_ps(sw, _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[0][3]), px), _mm_mul_ps(_mm_set1_ps(m[1][3]), py)),
+		                             _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[2][3]), pz), _mm_set1_ps(m[3][3]))));
+		__m128 dx = _mm_sub_ps(px, _mm_set1_ps(camera.x));
+		__m128 dy = _mm_sub_ps(py, _mm_set1_ps(camera.y));
+		__m128 dz = _mm_sub_ps(pz, _mm_set1_ps(camera.z));
+		_mm_storeu_ps(distance, _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+#else
+		visible = 0;
+		for (int k=0; k<4; k++){
+			glm::vec3 position(x[i + k], y[i + k], z[i + k]);
+			bool in = true;
+			for (int p=0; p<6 && in; p++)
+				in = glm::dot(glm::vec3(planes[p]), position) + planes[p].w >= -radius;
+			if (in)
+				visible |= 1 << k;
+			glm::vec4 clip = m * glm::vec4(position, 1.0f);
+			sx[k] = clip.x;
+			sy[k] = clip.y;
+			sw[k] = clip.w;
+			glm::vec3 d = position - camera;
+			distance[k] = glm::dot(d, d);
+		}
+#endif
+		for (int k=0; k<4; k++){
+			int g = i + k;
+			if (!(visible & (1 << k)) || g >= count || race.tracks[g].sampleCount == 0){
+				buckets[g] = CULLED;
+				continue;
+			}
+			// Ghosts partly off screen, or partly behind the camera, go to the nearest tile
+			float w = sw[k] > 1e-4f ? sw[k] : 1e-4f;
+			int tileX = (int)((sx[k] / w * 0.5f + 0.5f) * TILES);
+			int tileY = (int)((sy[k] / w * 0.5f + 0.5f) * TILES);
+			tileX = tileX < 0 ? 0 : (tileX >= TILES ? TILES - 1 : tileX);
+			tileY = tileY < 0 ? 0 : (tileY >= TILES ? TILES - 1 : tileY);
+			int lod = 0;
+			while (lod < GHOST_LOD_COUNT - 1 && distance[k] >= lodSquared[lod])
+				lod++;
+			int bucket = (lod * TILES + tileY) * TILES + tileX;
+			buckets[g] = (unsigned short)bucket;
+			depths[g] = sw[k];
+			bucketStart[bucket + 1]++;
+		}
+	}
+
+	// Counting sort into the tiles of every level of detail
+	for (int b=0; b<BUCKET_COUNT; b++)
+		bucketStart[b + 1] += bucketStart[b];
+	order.resize(bucketStart[BUCKET_COUNT]);
+	next.assign(bucketStart.begin(), bucketStart.end() - 1);
+	for (int g=0; g<count; g++)
+		if (buckets[g] != CULLED)
+			order[next[buckets[g]]++] = g;
+
+	// Back to front in each tile : a few ghosts each, an insertion sort is enough
+	for (int b=0; b<BUCKET_COUNT; b++){
+		int begin = bucketStart[b], end = bucketStart[b + 1];
+		if (end - begin > 32){
+			std::sort(order.begin() + begin, order.begin() + end, [this](int a, int b){ return depths[a] > depths[b]; });
+			continue;
+		}
+		for (int j=begin + 1; j<end; j++){
+			int g = order[j];
+			float depth = depths[g];
+			int k = j;
+			while (k > begin && depths[order[k - 1]] < depth){
+				order[k] = order[k - 1];
+				k--;
+			}
+			order[k] = g;
+		}
+	}
+
+	for (int l=0; l<GHOST_LOD_COUNT; l++){
+		std::vector<glm::vec4> & instances = out.lods[l];
+		int begin = bucketStart[l * TILES * TILES], end = bucketStart[(l + 1) * TILES * TILES];
+		instances.resize(end - begin);
+		for (int j=begin; j<end; j++){
+			int g = order[j];
+			instances[j - begin] = glm::vec4(x[g], y[g], z[g], GHOST_OPACITY);
+		}
+	}
+}
+
+size_t GhostPlayback::getMemoryBytes() const {
+	size_t bytes = (keyframes.capacity() + firstKeyframe.capacity() + cursor.capacity() + decoded.capacity()) * sizeof(unsigned int)
+	             + (qx.capacity() + qy.capacity() + qz.capacity() + bucketStart.capacity() + order.capacity() + next.capacity()) * sizeof(int)
+	             + (x0.capacity() * 9 + depths.capacity()) * sizeof(float) + buckets.capacity() * sizeof(unsigned short);
+	for (size_t i=0; i<race.tracks.size(); i++)
+		bytes += race.tracks[i].data.capacity();
+	return bytes;
+}
+
+GhostRenderer::GhostRenderer(){
+	programID = 0;
+	for (int l=0; l<GHOST_LOD_COUNT; l++){
+		vao[l] = vertexBuffer[l] = elementBuffer[l] = instanceBuffer[l] = 0;
+		indexCount[l] = 0;
+		instanceCapacity[l] = 0;
+	}
+}
+
+GhostRenderer::~GhostRenderer(){
+	cleanup();
+}
+
+// Latitude and longitude sphere
+static void makeSphere(float radius, int slices, int stacks, std::vector<glm::vec3> & vertices, std::vector<unsigned short> & indices){
+	vertices.clear();
+	indices.clear();
+	for (int j=0; j<=stacks; j++){
+		float theta = glm::pi<float>() * j / stacks;
+		for (int i=0; i<=slices; i++){
+			float phi = 2.0f * glm::pi<float>() * i / slices;
+			vertices.push_back(radius * glm::vec3(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi)));
+		}
+	}
+	for (int j=0; j<stacks; j++){
+		for (int i=0; i<slices; i++){
+			unsigned short a = (unsigned short)(j * (slices + 1) + i), b = (unsigned short)(a + slices + 1);
+			if (j > 0){
+				indices.push_back(a); indices.push_back(b); indices.push_back((unsigned short)(a + 1));
+			}
+			if (j < stacks - 1){
+				indices.push_back((unsigned short)(a + 1)); indices.push_back(b); indices.push_back((unsigned short)(b + 1));
+			}
+		}
+	}
+}
+
+bool GhostRenderer::init(const std::vector<glm::vec3> & ballVertices, const glm::vec3 & center){
+	programID = LoadShaders("GhostVertexShader.vertexshader", "GhostFragmentShader.fragmentshader");
+	if (programID == 0)
+		return false;
+	bindUniformBlocks(programID);
+
+	// The ball itself up close, around its center, then spheres of its size
+	std::vector<glm::vec3> vertices[GHOST_LOD_COUNT];
+	std::vector<unsigned short> indices[GHOST_LOD_COUNT];
+	std::vector<glm::vec3> centered(ballVertices.size());
+	float radius = 0.0f;
+	for (size_t i=0; i<ballVertices.size(); i++){
+		centered[i] = ballVertices[i] - center;
+		radius = std::max(radius, glm::length(centered[i]));
+	}
+	std::vector<glm::vec2> uvs(centered.size(), glm::vec2(0.0f)), indexedUVs;
+	std::vector<glm::vec3> normals(centered.size(), glm::vec3(0.0f)), indexedNormals;
+	indexVBO(centered, uvs, normals, indices[0], vertices[0], indexedUVs, indexedNormals);
+	makeSphere(radius, 16, 10, vertices[1], indices[1]);
+	makeSphere(radius, 8, 5, vertices[2], indices[2]);
+
+	glGenVertexArrays(GHOST_LOD_COUNT, vao);
+	glGenBuffers(GHOST_LOD_COUNT, vertexBuffer);
+	glGenBuffers(GHOST_LOD_COUNT, elementBuffer);
+	glGenBuffers(GHOST_LOD_COUNT, instanceBuffer);
+	for (int l=0; l<GHOST_LOD_COUNT; l++){
+		glBindVertexArray(vao[l]);
+		glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer[l]);
+		glBufferData(GL_ARRAY_BUFFER, vertices[l].size() * sizeof(glm::vec3), &vertices[l][0], GL_STATIC_DRAW);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer[l]);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices[l].size() * sizeof(unsigned short), &indices[l][0], GL_STATIC_DRAW);
+		indexCount[l] = (GLsizei)indices[l].size();
+
+		// Position and opacity of every ghost
+		glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer[l]);
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 0, (void*)0);
+		glVertexAttribDivisor(1, 1);
+	}
+	glBindVertexArray(0);
+	return true;
+}
+
+void GhostRenderer::draw(const GhostInstances & instances){
+	PROFILE_FUNCTION();
+	if (programID == 0 || instances.getCount() == 0)
+		return;
+	glUseProgram(programID);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	// No depth test, as for the rest of the scene : blended over it in the order of the sort
+	// The far ones first : levels of detail follow the distance
+	for (int l=GHOST_LOD_COUNT - 1; l>=0; l--){
+		const std::vector<glm::vec4> & lod = instances.lods[l];
+		if (lod.empty())
+			continue;
+		GLsizeiptr bytes = lod.size() * sizeof(glm::vec4);
+		glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer[l]);
+		if (bytes > instanceCapacity[l])
+			instanceCapacity[l] = std::max(bytes, 2 * instanceCapacity[l]);
+		// Orphaned : the previous frame may still be drawing from it
+		glBufferData(GL_ARRAY_BUFFER, instanceCapacity[l], NULL, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, &lod[0]);
+		glBindVertexArray(vao[l]);
+		glDrawElementsInstanced(GL_TRIANGLES, indexCount[l], GL_UNSIGNED_SHORT, (void*)0, (GLsizei)lod.size());
+	}
+	glDisable(GL_BLEND);
+}
+
+void GhostRenderer::cleanup(){
+	if (programID == 0)
+		return;
+	glDeleteVertexArrays(GHOST_LOD_COUNT, vao);
+	glDeleteBuffers(GHOST_LOD_COUNT, vertexBuffer);
+	glDeleteBuffers(GHOST_LOD_COUNT, elementBuffer);
+	glDeleteBuffers(GHOST_LOD_COUNT, instanceBuffer);
+	glDeleteProgram(programID);
+	programID = 0;
+}
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start){
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void runGhostBenchmark(int ghostCount){
+	const int tickRate = 60;
+	const int seconds = 60;
+	GhostRace race;
+	printf("Ghost benchmark : %d ghosts, %d s runs sampled every %d ticks\n", ghostCount, seconds, race.interval);
+
+	// Loops over the track, each at its own pace
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	int sampleCount = seconds * tickRate / race.interval + 1;
+	std::vector<glm::vec3> positions(sampleCount);
+	for (int g=0; g<ghostCount; g++){
+		float speed = 0.4f + 0.3f * (g % 17) / 17.0f, phase = 0.61f * g;
+		for (int s=0; s<sampleCount; s++){
+			float t = (float)s * race.interval / tickRate;
+			positions[s] = glm::vec3(1.1f + 1.2f * sinf(speed * t + phase), 0.09f, 1.2f * sinf(1.7f * speed * t + 0.5f * phase));
+		}
+		addGhostTrack(race, positions);
+	}
+	size_t bytes = 0;
+	for (int g=0; g<ghostCount; g++)
+		bytes += race.tracks[g].data.size();
+	printf("  encoded in %.1f ms : %.2f MB, %.2f bytes per sample\n", millisecondsSince(start),
+		bytes / (1024.0 * 1024.0), (double)bytes / ((double)ghostCount * sampleCount));
+
+	JobSystem jobs;
+	GhostPlayback playback(&jobs);
+	start = std::chrono::steady_clock::now();
+	playback.setRace(race);
+	printf("  indexed on %d thread(s) in %.1f ms, %.2f MB in memory\n", jobs.getThreadCount(), millisecondsSince(start),
+		playback.getMemoryBytes() / (1024.0 * 1024.0));
+
+	// The usual camera, and a closer one, at 60 frames per second
+	glm::mat4 projection = glm::perspective(glm::radians(30.0f), 4.0f / 3.0f, 0.1f, 100.0f);
+	const glm::vec3 eyes[2] = { glm::vec3(0.0f, 5.0f, 4.0f), glm::vec3(3.0f, 1.5f, 2.0f) };
+	const glm::vec3 targets[2] = { glm::vec3(0.0f, 0.7f, 1.0f), glm::vec3(1.0f, 0.0f, 0.0f) };
+	GhostInstances instances;
+	for (int c=0; c<2; c++){
+		glm::mat4 viewProjection = projection * glm::lookAt(eyes[c], targets[c], glm::vec3(0, 1, 0));
+		double updateMs = 0.0, buildMs = 0.0, worstMs = 0.0;
+		long long drawn = 0, lods[GHOST_LOD_COUNT] = {};
+		int slowFrames = 0; // Over the 1 ms budget
+		int frames = seconds * tickRate;
+		// From the start : a seek, timed below
+		playback.update(0.0);
+		playback.buildInstances(viewProjection, eyes[c], 0.09f, instances);
+		for (int f=0; f<frames; f++){
+			std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+			playback.update(f + 0.5);
+			double update = millisecondsSince(frameStart);
+			playback.buildInstances(viewProjection, eyes[c], 0.09f, instances);
+			double frame = millisecondsSince(frameStart);
+			updateMs += update;
+			buildMs += frame - update;
+			worstMs = std::max(worstMs, frame);
+			slowFrames += frame > 1.0 ? 1 : 0;
+			drawn += instances.getCount();
+			for (int l=0; l<GHOST_LOD_COUNT; l++)
+				lods[l] += instances.lods[l].size();
+		}
+		printf("  camera %d : %.3f ms per frame (update %.3f, cull and sort %.3f), worst %.3f, %d of %d over 1 ms, %lld drawn (%lld, %lld, %lld by level of detail)\n",
+			c, (updateMs + buildMs) / frames, updateMs / frames, buildMs / frames, worstMs, slowFrames, frames,
+			drawn / frames, lods[0] / frames, lods[1] / frames, lods[2] / frames);
+	}
+
+	// Rewinds and jumps : every ghost decodes from its keyframe
+	start = std::chrono::steady_clock::now();
+	const int jumps = 100;
+	for (int j=0; j<jumps; j++)
+		playback.update((j * 7919) % (seconds * tickRate) + 0.25);
+	printf("  seeking : %.3f ms\n", millisecondsSince(start) / jumps);
+
+	// Decoded positions against the ones encoded, on a sample : after a seek, then
+	// after playing from the start one tick at a time
+	const int checkedTick = 999;
+	auto largestError = [&](){
+		float error = 0.0f;
+		for (int g=0; g<ghostCount; g++){
+			float speed = 0.4f + 0.3f * (g % 17) / 17.0f, phase = 0.61f * g;
+			float t = (float)checkedTick / tickRate;
+			glm::vec3 expected(1.1f + 1.2f * sinf(speed * t + phase), 0.09f, 1.2f * sinf(1.7f * speed * t + 0.5f * phase));
+			error = std::max(error, glm::length(playback.getPosition(g) - expected));
+		}
+		return error;
+	};
+	playback.update(checkedTick);
+	float seekError = largestError();
+	playback.setRace(race);
+	for (int tick=0; tick<=checkedTick; tick++)
+		playback.update(tick);
+	printf("  largest error at tick %d : %.2f mm after a seek, %.2f mm played from the start\n", checkedTick,
+		seekError * 1000.0f, largestError() * 1000.0f);
+}
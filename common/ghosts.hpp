@@ -0,0 +1,101 @@
+#ifndef GHOSTS_HPP
+#define GHOSTS_HPP
+
+// Ghost racers : the balls of earlier runs, raced against.
+// A run is a track of the center of its ball (ghosttracks.hpp, included first).
+// GhostPlayback decodes one sample ahead of the time of every ghost, in
+// parallel, into arrays of x, y and z (SoA), and interpolates four ghosts at a
+// time with SSE. Then it culls them against the frustum, picks a level of
+// detail from the distance, and sorts the visible ones back to front only
+// within tiles of the screen : ghosts far apart on the screen don't overlap,
+// so a counting sort into tiles and small sorts in each tile blend as well as
+// a full sort. Every level of detail is then a single instanced draw, the far
+// ones first (GhostRenderer).
+
+#define GHOST_LOD_COUNT 3
+
+// What the render thread draws : for every level of detail, the ghosts to draw as their
+// position and opacity, back to front within each tile of the screen
+struct GhostInstances {
+	std::vector<glm::vec4> lods[GHOST_LOD_COUNT];
+
+	void clear();
+	int getCount() const;
+};
+
+class JobSystem;
+
+class GhostPlayback {
+public:
+	// jobs : decodes on every core. NULL decodes on the caller.
+	GhostPlayback(JobSystem * jobs = NULL);
+
+	// Copies the tracks, and finds where their keyframes start
+	void setRace(const GhostRace & race);
+	int getCount() const { return count; }
+
+	// Moves every ghost to a time, in ticks since the start of the race. Going back in time,
+	// or jumping ahead, decodes from the keyframes.
+	void update(double tick);
+	glm::vec3 getPosition(int ghost) const { return glm::vec3(x[ghost], y[ghost], z[ghost]); }
+
+	// radius : of a ball. lodDistances : from the camera, where levels of detail 1 and 2 start.
+	void buildInstances(const glm::mat4 & viewProjection, const glm::vec3 & camera, float radius, GhostInstances & out);
+	void setLodDistances(float lod1, float lod2) { lodDistances[0] = lod1; lodDistances[1] = lod2; }
+
+	size_t getMemoryBytes() const;
+
+private:
+	void decodeRange(int begin, int end, bool seek);
+
+	JobSystem * jobs;
+	GhostRace race;
+	int count;
+	int padded; // Count rounded up to 4, for SSE
+	std::vector<unsigned int> keyframes; // Byte offsets, GHOST_KEYFRAME_SAMPLES samples apart, track after track
+	std::vector<unsigned int> firstKeyframe; // Per track, in keyframes
+
+	// Decoding, per ghost
+	int sample; // The time is between sample and sample + 1. -1 before the first update.
+	std::vector<unsigned int> cursor; // Next byte to decode
+	std::vector<unsigned int> decoded; // Samples decoded so far
+	std::vector<int> qx, qy, qz; // Last one, in millimeters
+	// Positions around the time, and at the time, in SoA
+	std::vector<float> x0, y0, z0, x1, y1, z1;
+	std::vector<float> x, y, z;
+
+	float lodDistances[GHOST_LOD_COUNT - 1];
+	// Scratch of buildInstances
+	std::vector<unsigned short> buckets; // Level of detail and tile of every ghost, 0xffff when culled
+	std::vector<float> depths;
+	std::vector<int> bucketStart;
+	std::vector<int> order;
+	std::vector<int> next; // Where the counting sort puts the next ghost of every bucket
+};
+
+// Draws GhostInstances on the render thread : a translucent Ball.obj near the camera,
+// lower spheres further away
+class GhostRenderer {
+public:
+	GhostRenderer();
+	~GhostRenderer();
+
+	// ballVertices : three per triangle, around center
+	bool init(const std::vector<glm::vec3> & ballVertices, const glm::vec3 & center);
+	// With the FrameConstants block bound
+	void draw(const GhostInstances & instances);
+	void cleanup();
+
+private:
+	GLuint programID;
+	GLuint vao[GHOST_LOD_COUNT];
+	GLuint vertexBuffer[GHOST_LOD_COUNT], elementBuffer[GHOST_LOD_COUNT], instanceBuffer[GHOST_LOD_COUNT];
+	GLsizei indexCount[GHOST_LOD_COUNT];
+	GLsizeiptr instanceCapacity[GHOST_LOD_COUNT]; // Bytes
+};
+
+// ghostCount made-up runs along the track : size of the tracks, then the CPU cost
+// of every frame of a 60 s race seen by the usual camera, and of jumps in time
+void runGhostBenchmark(int ghostCount);
+
+#endif
@@ -0,0 +1,133 @@
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include <glm/glm.hpp>
+
+#include "ghosttracks.hpp"
+
+static const unsigned char MAGIC[4] = { 'G', 'H', 'S', 'T' };
+
+static void putVarint(std::vector<unsigned char> & out, uint32_t value){
+	while (value >= 0x80){
+		out.push_back((unsigned char)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((unsigned char)value);
+}
+
+// False past the end
+static bool getVarint(const std::vector<unsigned char> & in, unsigned int & cursor, uint32_t & value){
+	value = 0;
+	for (int shift=0; shift<35; shift+=7){
+		if (cursor >= in.size())
+			return false;
+		unsigned char byte = in[cursor++];
+		value |= (uint32_t)(byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+			return true;
+	}
+	return false;
+}
+
+static uint32_t zigzag(int value){
+	return value >= 0 ? 2 * (uint32_t)value : 2 * (uint32_t)(-(int64_t)value) - 1;
+}
+
+static int unzigzag(uint32_t value){
+	return (value & 1) ? -(int)((value + 1) / 2) : (int)(value / 2);
+}
+
+bool decodeGhostSample(const std::vector<unsigned char> & data, unsigned int & cursor, unsigned int index, int & x, int & y, int & z){
+	uint32_t dx, dy, dz;
+	if (!getVarint(data, cursor, dx) || !getVarint(data, cursor, dy) || !getVarint(data, cursor, dz))
+		return false;
+	if (index % GHOST_KEYFRAME_SAMPLES == 0){
+		x = y = z = 0;
+	}
+	x += unzigzag(dx);
+	y += unzigzag(dy);
+	z += unzigzag(dz);
+	return true;
+}
+
+void addGhostTrack(GhostRace & race, const std::vector<glm::vec3> & positions){
+	GhostTrack track;
+	track.sampleCount = (unsigned int)positions.size();
+	int last[3] = { 0, 0, 0 };
+	for (size_t i=0; i<positions.size(); i++){
+		if (i % GHOST_KEYFRAME_SAMPLES == 0)
+			last[0] = last[1] = last[2] = 0;
+		for (int axis=0; axis<3; axis++){
+			int value = (int)floorf(positions[i][axis] * GHOST_UNITS_PER_METER + 0.5f);
+			putVarint(track.data, zigzag(value - last[axis]));
+			last[axis] = value;
+		}
+	}
+	race.tracks.push_back(track);
+}
+
+bool saveGhostRace(const char * path, const GhostRace & race){
+	std::vector<unsigned char> header(MAGIC, MAGIC + 4);
+	putVarint(header, (uint32_t)race.interval);
+	putVarint(header, (uint32_t)race.tracks.size());
+	for (size_t i=0; i<race.tracks.size(); i++){
+		putVarint(header, race.tracks[i].sampleCount);
+		putVarint(header, (uint32_t)race.tracks[i].data.size());
+	}
+	FILE * file = fopen(path, "wb");
+	if (file == NULL){
+		printf("Can't write the ghosts %s\n", path);
+		return false;
+	}
+	bool written = fwrite(&header[0], 1, header.size(), file) == header.size();
+	for (size_t i=0; i<race.tracks.size() && written; i++)
+		written = race.tracks[i].data.empty() || fwrite(&race.tracks[i].data[0], 1, race.tracks[i].data.size(), file) == race.tracks[i].data.size();
+	fclose(file);
+	if (!written)
+		printf("Can't write the ghosts %s\n", path);
+	return written;
+}
+
+bool loadGhostRace(const char * path, GhostRace & race){
+	FILE * file = fopen(path, "rb");
+	if (file == NULL){
+		printf("Can't open the ghosts %s\n", path);
+		return false;
+	}
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	std::vector<unsigned char> data(size > 0 ? size : 0);
+	bool read = data.empty() || fread(&data[0], 1, data.size(), file) == data.size();
+	fclose(file);
+
+	unsigned int cursor = 4;
+	uint32_t interval = 0, trackCount = 0;
+	bool valid = read && data.size() > 4 && memcmp(&data[0], MAGIC, 4) == 0 &&
+		getVarint(data, cursor, interval) && getVarint(data, cursor, trackCount) && interval > 0;
+	std::vector<uint32_t> sizes;
+	race.tracks.clear();
+	for (uint32_t i=0; valid && i<trackCount; i++){
+		GhostTrack track;
+		uint32_t bytes;
+		valid = getVarint(data, cursor, track.sampleCount) && getVarint(data, cursor, bytes);
+		race.tracks.push_back(track);
+		sizes.push_back(bytes);
+	}
+	for (uint32_t i=0; valid && i<trackCount; i++){
+		valid = cursor + sizes[i] <= data.size();
+		if (valid)
+			race.tracks[i].data.assign(data.begin() + cursor, data.begin() + cursor + sizes[i]);
+		cursor += sizes[i];
+	}
+	if (!valid){
+		printf("%s is not a ghost file\n", path);
+		race.tracks.clear();
+		return false;
+	}
+	race.interval = (int)interval;
+	return true;
+}
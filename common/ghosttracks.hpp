@@ -0,0 +1,34 @@
+#ifndef GHOSTTRACKS_HPP
+#define GHOSTTRACKS_HPP
+
+// Ghost tracks : where the ball of a run was, every few ticks, for ghosts.hpp.
+// Positions are in millimeters, each sample stored as the difference from the
+// one before in zigzag varints, and every GHOST_KEYFRAME_SAMPLES samples as it
+// is, to seek to any time. No GL : the headless games write them.
+
+#define GHOST_UNITS_PER_METER 1000.0f
+#define GHOST_KEYFRAME_SAMPLES 64
+
+struct GhostTrack {
+	unsigned int sampleCount;
+	std::vector<unsigned char> data;
+};
+
+// Every ghost of a race, sampled at the same rate
+struct GhostRace {
+	int interval; // Ticks between two samples. Sample i is the ball after tick i * interval.
+	std::vector<GhostTrack> tracks;
+
+	GhostRace() : interval(3) {}
+};
+
+// Encodes the positions of the ball, one per sample, as a new track of the race
+void addGhostTrack(GhostRace & race, const std::vector<glm::vec3> & positions);
+bool saveGhostRace(const char * path, const GhostRace & race);
+bool loadGhostRace(const char * path, GhostRace & race);
+
+// Decodes sample `index` at cursor, and moves cursor past it. Keyframes replace x, y
+// and z, the other samples add to them. False past the end of the data.
+bool decodeGhostSample(const std::vector<unsigned char> & data, unsigned int & cursor, unsigned int index, int & x, int & y, int & z);
+
+#endif
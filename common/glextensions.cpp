@@ -0,0 +1,15 @@
+#include <string.h>
+
+#include <GL/glew.h>
+
+#include "glextensions.hpp"
+
+bool isExtensionSupported(const char * name){
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i=0; i<count; i++){
+		if (strcmp((const char *)glGetStringi(GL_EXTENSIONS, i), name) == 0)
+			return true;
+	}
+	return false;
+}
@@ -0,0 +1,8 @@
+#ifndef GLEXTENSIONS_HPP
+#define GLEXTENSIONS_HPP
+
+// GLEW only looks at glGetString(GL_EXTENSIONS), which core profiles don't support,
+// so its GLEW_ARB_xxx flags stay false there. This one uses glGetStringi.
+bool isExtensionSupported(const char * name);
+
+#endif
@@ -0,0 +1,381 @@
+#ifdef ENABLE_GL_STATS
+
+#include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+#include <GL/glew.h>
+
+#define GL_STATS_NO_REDIRECT
+#include "glstats.hpp"
+
+// Entry points loaded by GLEW, and whether they change the state
+#define GLEW_ENTRY_POINTS(X) \
+	X(BindBuffer, true) X(BindBufferRange, true) X(BindBufferBase, true) X(BindVertexArray, true) \
+	X(UseProgram, true) X(ActiveTexture, true) X(BindFramebuffer, true) X(BindRenderbuffer, true) \
+	X(EnableVertexAttribArray, true) X(DisableVertexAttribArray, true) X(VertexAttribPointer, true) X(VertexAttribDivisor, true) \
+	X(Uniform1i, true) X(Uniform2f, true) X(Uniform4f, true) X(Uniform4fv, true) X(UniformMatrix4fv, true) X(UniformBlockBinding, true) \
+	X(BeginTransformFeedback, true) X(EndTransformFeedback, true) \
+	X(BufferData, false) X(BufferSubData, false) X(BufferStorage, false) X(MapBufferRange, false) X(UnmapBuffer, false) \
+	X(TexImage3D, false) X(CompressedTexImage2D, false) X(GenerateMipmap, false) \
+	X(DrawArraysInstanced, false) X(DrawElementsInstanced, false) X(DrawElementsBaseVertex, false) \
+	X(DrawArraysIndirect, false) X(DrawElementsIndirect, false) \
+	X(FenceSync, false) X(ClientWaitSync, false) X(DeleteSync, false) \
+	X(QueryCounter, false) X(BeginQuery, false) X(EndQuery, false) \
+	X(GetQueryObjectiv, false) X(GetQueryObjectuiv, false) X(GetQueryObjectui64v, false) \
+	X(GenBuffers, false) X(DeleteBuffers, false) X(GetUniformLocation, false)
+
+// GL 1.1 entry points, exported by the GL library
+#define GL11_ENTRY_POINTS(X) \
+	X(DrawArrays, false) X(DrawElements, false) X(Clear, false) X(TexImage2D, false) X(TexSubImage2D, false) \
+	X(BindTexture, true) X(Enable, true) X(Disable, true) X(BlendFunc, true) X(PolygonMode, true) X(Viewport, true) \
+	X(ReadPixels, false)
+
+enum EntryPoint {
+#define ENTRY(name, state) GLS_##name,
+	GLEW_ENTRY_POINTS(ENTRY)
+	GL11_ENTRY_POINTS(ENTRY)
+#undef ENTRY
+	ENTRY_POINT_COUNT
+};
+
+struct EntryPointInfo {
+	const char * name;
+	bool stateChange;
+};
+
+static const EntryPointInfo entryPoints[ENTRY_POINT_COUNT] = {
+#define ENTRY(name, state) { "gl" #name, state },
+	GLEW_ENTRY_POINTS(ENTRY)
+	GL11_ENTRY_POINTS(ENTRY)
+#undef ENTRY
+};
+
+// Until installed, the 1.1 pointers go straight to the GL library
+#define ENTRY(name, state) decltype(&::gl##name) glStats_gl##name = ::gl##name;
+GL11_ENTRY_POINTS(ENTRY)
+#undef ENTRY
+
+static GLFrameStats frame, lastFrame;
+static long long callCounts[ENTRY_POINT_COUNT];   // This frame
+static long long secondCounts[ENTRY_POINT_COUNT]; // Since the last print
+static long long totalCounts[ENTRY_POINT_COUNT];
+static int argumentBytes[ENTRY_POINT_COUNT];
+
+// Sums since the last print
+static GLFrameStats secondSum;
+static int secondFrames;
+static std::chrono::steady_clock::time_point secondStart;
+static int frameNumber;
+static int totalFrames;
+
+// Trace
+static bool tracing;
+static std::string tracePath;
+static int traceFirst, traceCount;
+static std::vector<unsigned char> trace;
+
+// Last value bound to a few binding points, to spot binds that change nothing
+struct Binding {
+	GLenum point;
+	GLuint value;
+};
+static std::vector<Binding> bindings;
+static GLenum activeTexture = GL_TEXTURE0;
+
+static void bind(GLenum point, GLuint value){
+	for (size_t i=0; i<bindings.size(); i++){
+		if (bindings[i].point == point){
+			if (bindings[i].value == value)
+				frame.redundantBinds++;
+			bindings[i].value = value;
+			return;
+		}
+	}
+	Binding binding = { point, value };
+	bindings.push_back(binding);
+}
+
+static void draw(GLenum mode, GLsizei count, GLsizei instances){
+	long long primitives;
+	switch (mode){
+	case GL_TRIANGLES:      primitives = count / 3; break;
+	case GL_TRIANGLE_STRIP:
+	case GL_TRIANGLE_FAN:   primitives = std::max(count - 2, 0); break;
+	case GL_LINES:          primitives = count / 2; break;
+	case GL_LINE_STRIP:     primitives = std::max(count - 1, 0); break;
+	default:                primitives = count; break; // Points, line loops
+	}
+	frame.drawCalls++;
+	frame.primitives += primitives * instances;
+}
+
+// Bytes of an uncompressed image, for the usual formats
+static long long imageBytes(GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type){
+	int components;
+	switch (format){
+	case GL_RED: case GL_DEPTH_COMPONENT: components = 1; break;
+	case GL_RG:  case GL_DEPTH_STENCIL:   components = 2; break;
+	case GL_RGB: case GL_BGR:             components = 3; break;
+	default:                              components = 4; break;
+	}
+	int size;
+	switch (type){
+	case GL_UNSIGNED_BYTE: case GL_BYTE:   size = 1; break;
+	case GL_UNSIGNED_SHORT: case GL_SHORT: case GL_HALF_FLOAT: size = 2; break;
+	case GL_UNSIGNED_INT_24_8:             size = 4; components = 1; break;
+	default:                               size = 4; break;
+	}
+	return (long long)width * height * depth * components * size;
+}
+
+// What each entry point adds to the totals, besides being counted
+template <int ID> struct Account {
+	template <typename... Args> static void run(Args...){}
+};
+template <> struct Account<GLS_BufferData> {
+	static void run(GLenum, GLsizeiptr size, const void * data, GLenum){ if (data) frame.bytesUploaded += size; }
+};
+template <> struct Account<GLS_BufferSubData> {
+	static void run(GLenum, GLintptr, GLsizeiptr size, const void *){ frame.bytesUploaded += size; }
+};
+template <> struct Account<GLS_BufferStorage> {
+	static void run(GLenum, GLsizeiptr size, const void * data, GLbitfield){ if (data) frame.bytesUploaded += size; }
+};
+template <> struct Account<GLS_TexImage2D> {
+	static void run(GLenum, GLint, GLint, GLsizei width, GLsizei height, GLint, GLenum format, GLenum type, const void * pixels){
+		if (pixels) frame.bytesUploaded += imageBytes(width, height, 1, format, type);
+	}
+};
+template <> struct Account<GLS_TexSubImage2D> {
+	static void run(GLenum, GLint, GLint, GLint, GLsizei width, GLsizei height, GLenum format, GLenum type, const void *){
+		frame.bytesUploaded += imageBytes(width, height, 1, format, type);
+	}
+};
+template <> struct Account<GLS_TexImage3D> {
+	static void run(GLenum, GLint, GLint, GLsizei width, GLsizei height, GLsizei depth, GLint, GLenum format, GLenum type, const void * pixels){
+		if (pixels) frame.bytesUploaded += imageBytes(width, height, depth, format, type);
+	}
+};
+template <> struct Account<GLS_CompressedTexImage2D> {
+	static void run(GLenum, GLint, GLenum, GLsizei, GLsizei, GLint, GLsizei imageSize, const void *){ frame.bytesUploaded += imageSize; }
+};
+template <> struct Account<GLS_DrawArrays> {
+	static void run(GLenum mode, GLint, GLsizei count){ draw(mode, count, 1); }
+};
+template <> struct Account<GLS_DrawElements> {
+	static void run(GLenum mode, GLsizei count, GLenum, const void *){ draw(mode, count, 1); }
+};
+template <> struct Account<GLS_DrawArraysInstanced> {
+	static void run(GLenum mode, GLint, GLsizei count, GLsizei instances){ draw(mode, count, instances); }
+};
+template <> struct Account<GLS_DrawElementsInstanced> {
+	static void run(GLenum mode, GLsizei count, GLenum, const void *, GLsizei instances){ draw(mode, count, instances); }
+};
+template <> struct Account<GLS_DrawElementsBaseVertex> {
+	static void run(GLenum mode, GLsizei count, GLenum, const void *, GLint){ draw(mode, count, 1); }
+};
+// The GPU reads the counts of indirect draws : only the call is known
+template <> struct Account<GLS_DrawArraysIndirect> {
+	static void run(GLenum, const void *){ frame.drawCalls++; }
+};
+template <> struct Account<GLS_DrawElementsIndirect> {
+	static void run(GLenum, GLenum, const void *){ frame.drawCalls++; }
+};
+// The element array binding belongs to the vertex array : it isn't tracked
+template <> struct Account<GLS_BindBuffer> {
+	static void run(GLenum target, GLuint buffer){ if (target != GL_ELEMENT_ARRAY_BUFFER) bind(target, buffer); }
+};
+template <> struct Account<GLS_BindVertexArray> {
+	static void run(GLuint array){ bind(GL_VERTEX_ARRAY_BINDING, array); }
+};
+template <> struct Account<GLS_UseProgram> {
+	static void run(GLuint program){ bind(GL_CURRENT_PROGRAM, program); }
+};
+template <> struct Account<GLS_BindFramebuffer> {
+	static void run(GLenum target, GLuint framebuffer){ bind(target, framebuffer); }
+};
+template <> struct Account<GLS_ActiveTexture> {
+	static void run(GLenum texture){ activeTexture = texture; }
+};
+template <> struct Account<GLS_BindTexture> {
+	static void run(GLenum target, GLuint texture){ bind(target + 0x10000 * (activeTexture - GL_TEXTURE0 + 1), texture); }
+};
+
+template <typename T> static void traceValue(const T & value){
+	const unsigned char * bytes = (const unsigned char *)&value;
+	trace.insert(trace.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename... Args> static int sizeOfArguments(){
+	int sizes[] = { 0, (int)sizeof(Args)... };
+	int sum = 0;
+	for (size_t i=0; i<sizeof(sizes)/sizeof(sizes[0]); i++)
+		sum += sizes[i];
+	return sum;
+}
+
+// Replaces the GL function of entry point ID, whatever its signature
+template <int ID, typename R, typename... Args>
+struct Hook {
+	static R (GLAPIENTRY * original)(Args...);
+
+	static R GLAPIENTRY call(Args... args){
+		frame.calls++;
+		callCounts[ID]++;
+		if (entryPoints[ID].stateChange)
+			frame.stateChanges++;
+		Account<ID>::run(args...);
+		if (tracing){
+			traceValue((unsigned short)ID);
+			int expand[] = { 0, (traceValue(args), 0)... };
+			(void)expand;
+		}
+		return original(args...);
+	}
+};
+template <int ID, typename R, typename... Args>
+R (GLAPIENTRY * Hook<ID, R, Args...>::original)(Args...) = NULL;
+
+template <int ID, typename R, typename... Args>
+static void install(R (GLAPIENTRY ** pointer)(Args...)){
+	argumentBytes[ID] = sizeOfArguments<Args...>();
+	if (*pointer == NULL)
+		return; // Not supported by the driver
+	Hook<ID, R, Args...>::original = *pointer;
+	*pointer = Hook<ID, R, Args...>::call;
+}
+
+void glStatsInstall(){
+#define ENTRY(name, state) install<GLS_##name>(&__glew##name);
+	GLEW_ENTRY_POINTS(ENTRY)
+#undef ENTRY
+#define ENTRY(name, state) install<GLS_##name>(&glStats_gl##name);
+	GL11_ENTRY_POINTS(ENTRY)
+#undef ENTRY
+	secondStart = std::chrono::steady_clock::now();
+	printf("GL call accounting on, %d entry points\n", (int)ENTRY_POINT_COUNT);
+}
+
+static void writeTrace(){
+	FILE * file = fopen(tracePath.c_str(), "wb");
+	if (file == NULL){
+		printf("Impossible to open %s\n", tracePath.c_str());
+		return;
+	}
+	fwrite("GLTRACE1", 1, 8, file);
+	unsigned short count = ENTRY_POINT_COUNT;
+	fwrite(&count, 2, 1, file);
+	for (unsigned short i=0; i<count; i++){
+		unsigned char length = (unsigned char)strlen(entryPoints[i].name);
+		unsigned short bytes = (unsigned short)argumentBytes[i];
+		fwrite(&i, 2, 1, file);
+		fwrite(&length, 1, 1, file);
+		fwrite(entryPoints[i].name, 1, length, file);
+		fwrite(&bytes, 2, 1, file);
+	}
+	if (!trace.empty())
+		fwrite(&trace[0], 1, trace.size(), file);
+	fclose(file);
+	printf("GL trace of %d frames written to %s, %d bytes\n", traceCount, tracePath.c_str(), (int)trace.size());
+	trace.clear();
+}
+
+static void beginTracedFrame(){
+	traceValue((unsigned short)0xffff);
+	traceValue((unsigned int)frameNumber);
+}
+
+void glStatsTraceFrames(const char * path, int firstFrame, int frameCount){
+	tracePath = path;
+	traceFirst = firstFrame;
+	traceCount = frameCount;
+	tracing = frameNumber == firstFrame && frameCount > 0;
+	if (tracing)
+		beginTracedFrame();
+}
+
+const GLFrameStats & glStatsGetLastFrame(){
+	return lastFrame;
+}
+
+void glStatsEndFrame(){
+	lastFrame = frame;
+	secondSum.calls += frame.calls;
+	secondSum.stateChanges += frame.stateChanges;
+	secondSum.redundantBinds += frame.redundantBinds;
+	secondSum.drawCalls += frame.drawCalls;
+	secondSum.primitives += frame.primitives;
+	secondSum.bytesUploaded += frame.bytesUploaded;
+	secondFrames++;
+	for (int i=0; i<ENTRY_POINT_COUNT; i++){
+		secondCounts[i] += callCounts[i];
+		totalCounts[i] += callCounts[i];
+		callCounts[i] = 0;
+	}
+	GLFrameStats none = {};
+	frame = none;
+	frameNumber++;
+	totalFrames++;
+
+	if (tracing && frameNumber == traceFirst + traceCount){
+		tracing = false;
+		writeTrace();
+	}else if (!tracing && traceCount > 0 && frameNumber == traceFirst){
+		tracing = true;
+		beginTracedFrame();
+	}else if (tracing){
+		beginTracedFrame();
+	}
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (now - secondStart < std::chrono::seconds(1))
+		return;
+
+	double n = secondFrames;
+	printf("GL : %.0f calls/frame, %.0f state changes, %.0f redundant binds, %.1f draws, %.0f primitives, %.1f KB uploaded. Most called :",
+		secondSum.calls / n, secondSum.stateChanges / n, secondSum.redundantBinds / n, secondSum.drawCalls / n,
+		secondSum.primitives / n, secondSum.bytesUploaded / n / 1024.0);
+	for (int top=0; top<4; top++){
+		int best = 0;
+		for (int i=1; i<ENTRY_POINT_COUNT; i++)
+			if (secondCounts[i] > secondCounts[best])
+				best = i;
+		if (secondCounts[best] == 0)
+			break;
+		printf(" %s %.1f", entryPoints[best].name, secondCounts[best] / n);
+		secondCounts[best] = -secondCounts[best]; // Skipped by the next rounds
+	}
+	printf("\n");
+
+	for (int i=0; i<ENTRY_POINT_COUNT; i++)
+		secondCounts[i] = 0;
+	GLFrameStats zero = {};
+	secondSum = zero;
+	secondFrames = 0;
+	secondStart = now;
+}
+
+void glStatsPrintSummary(){
+	if (tracing){
+		tracing = false;
+		writeTrace(); // Ended before the last traced frame
+	}
+	if (totalFrames == 0)
+		return;
+
+	std::vector<int> order;
+	for (int i=0; i<ENTRY_POINT_COUNT; i++)
+		if (totalCounts[i] > 0)
+			order.push_back(i);
+	std::sort(order.begin(), order.end(), [](int a, int b){ return totalCounts[a] > totalCounts[b]; });
+
+	printf("GL calls per frame, over %d frames :\n", totalFrames);
+	for (size_t i=0; i<order.size(); i++)
+		printf("  %-28s %10.2f\n", entryPoints[order[i]].name, (double)totalCounts[order[i]] / totalFrames);
+}
+
+#endif
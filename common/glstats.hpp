@@ -0,0 +1,75 @@
+#ifndef GLSTATS_HPP
+#define GLSTATS_HPP
+
+// GL call accounting.
+// glStatsInstall() replaces GLEW's function pointers by ones that count the
+// calls per entry point, the state changes and the binds of what is already
+// bound, the bytes given to glBufferData / glBufferSubData / glTexImage*, and
+// the draws and primitives, then call the driver. Nothing is replaced unless
+// it is installed, and nothing at all is compiled without ENABLE_GL_STATS
+// (see CMakeLists.txt).
+// GL 1.1 entry points are exported by the GL library rather than loaded by
+// GLEW : in the files that include this header, after GL/glew.h, they go
+// through pointers too.
+// Counters are plain integers : only the thread that owns the context calls GL.
+
+#ifdef ENABLE_GL_STATS
+
+// Totals of one frame
+struct GLFrameStats {
+	int calls;
+	int stateChanges;
+	int redundantBinds;     // Binding what was already bound
+	int drawCalls;
+	long long primitives;   // Triangles, lines or points
+	long long bytesUploaded;
+};
+
+// Hooks GLEW's pointers. Call once, after glewInit() and before any other thread uses GL.
+void glStatsInstall();
+
+// Ends the frame : its totals go to the per-second averages, printed once per second
+void glStatsEndFrame();
+const GLFrameStats & glStatsGetLastFrame();
+
+// Writes every call of frames [firstFrame, firstFrame + frameCount) to a binary file :
+// "GLTRACE1", the entry points (u16 id, u8 name length, name, u16 argument bytes),
+// then u16 id and the raw arguments for each call. Id 0xffff starts a frame, with its u32 number.
+void glStatsTraceFrames(const char * path, int firstFrame, int frameCount);
+
+// Calls per frame of every entry point since glStatsInstall(), most called first
+void glStatsPrintSummary();
+
+#define GL_STATS_POINTER(name) extern decltype(&::name) glStats_##name;
+GL_STATS_POINTER(glDrawArrays)
+GL_STATS_POINTER(glDrawElements)
+GL_STATS_POINTER(glClear)
+GL_STATS_POINTER(glTexImage2D)
+GL_STATS_POINTER(glTexSubImage2D)
+GL_STATS_POINTER(glBindTexture)
+GL_STATS_POINTER(glEnable)
+GL_STATS_POINTER(glDisable)
+GL_STATS_POINTER(glBlendFunc)
+GL_STATS_POINTER(glPolygonMode)
+GL_STATS_POINTER(glViewport)
+GL_STATS_POINTER(glReadPixels)
+#undef GL_STATS_POINTER
+
+#ifndef GL_STATS_NO_REDIRECT
+#define glDrawArrays    glStats_glDrawArrays
+#define glDrawElements  glStats_glDrawElements
+#define glClear         glStats_glClear
+#define glTexImage2D    glStats_glTexImage2D
+#define glTexSubImage2D glStats_glTexSubImage2D
+#define glBindTexture   glStats_glBindTexture
+#define glEnable        glStats_glEnable
+#define glDisable       glStats_glDisable
+#define glBlendFunc     glStats_glBlendFunc
+#define glPolygonMode   glStats_glPolygonMode
+#define glViewport      glStats_glViewport
+#define glReadPixels    glStats_glReadPixels
+#endif
+
+#endif
+
+#endif
@@ -0,0 +1,187 @@
+#include <vector>
+#include <chrono>
+#include <stdio.h>
+
+#include <GL/glew.h>
+
+#include "glextensions.hpp"
+#include "profiler.hpp"
+#include "gpuprofiler.hpp"
+
+GpuProfiler::GpuProfiler(){
+	supported = false;
+	enabled = true;
+	active = false;
+	maxScopes = 0;
+	currentFrame = 0;
+	lostFrames = 0;
+	frameSum = 0.0;
+	frameCount = 0;
+	frameMs = 0.0f;
+	lastFrameMs = 0.0f;
+	newStats = false;
+}
+
+GpuProfiler::~GpuProfiler(){
+	cleanup();
+}
+
+void GpuProfiler::cleanup(){
+	for (size_t i=0; i<frames.size(); i++)
+		glDeleteQueries((GLsizei)frames[i].queries.size(), &frames[i].queries[0]);
+	frames.clear();
+	supported = false;
+}
+
+void GpuProfiler::init(int frameLatency, int maxScopesPerFrame){
+	supported = GLEW_VERSION_3_3 || isExtensionSupported("GL_ARB_timer_query");
+	if (supported){
+		// Some implementations expose the entry points but count nothing
+		GLint bits = 0;
+		glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+		supported = bits > 0;
+	}
+	if (!supported){
+		printf("GPU timer queries not supported : no GPU timings\n");
+		return;
+	}
+
+	maxScopes = maxScopesPerFrame;
+	frames.resize(frameLatency);
+	for (int i=0; i<frameLatency; i++){
+		frames[i].queries.resize(2 * maxScopes);
+		glGenQueries(2 * maxScopes, &frames[i].queries[0]);
+		frames[i].scopes.reserve(maxScopes);
+		frames[i].pending = false;
+	}
+	stack.reserve(maxScopes);
+	statsStart = std::chrono::steady_clock::now();
+
+#ifdef ENABLE_PROFILER
+	GLint64 now;
+	glGetInteger64v(GL_TIMESTAMP, &now);
+	profilerCalibrateGpu((uint64_t)now);
+#endif
+}
+
+void GpuProfiler::beginFrame(){
+	active = supported && enabled;
+	if (!active)
+		return;
+	currentFrame = (currentFrame + 1) % (int)frames.size();
+	Frame & frame = frames[currentFrame];
+	if (frame.pending)
+		readBack(frame); // Issued frames.size() frames ago
+	frame.scopes.clear();
+	stack.clear();
+	beginScope("GPU frame");
+}
+
+void GpuProfiler::endFrame(){
+	if (!active)
+		return;
+	while (!stack.empty())
+		endScope();
+	frames[currentFrame].pending = true;
+}
+
+void GpuProfiler::beginScope(const char * name){
+	if (!active)
+		return;
+	Frame & frame = frames[currentFrame];
+	if ((int)frame.scopes.size() >= maxScopes){
+		stack.push_back(-1); // Out of queries for this frame
+		return;
+	}
+	Scope scope = { name, (int)stack.size() };
+	int index = (int)frame.scopes.size();
+	frame.scopes.push_back(scope);
+	glQueryCounter(frame.queries[2*index], GL_TIMESTAMP);
+	stack.push_back(index);
+}
+
+void GpuProfiler::endScope(){
+	if (!active || stack.empty())
+		return;
+	int index = stack.back();
+	stack.pop_back();
+	if (index >= 0)
+		glQueryCounter(frames[currentFrame].queries[2*index+1], GL_TIMESTAMP);
+}
+
+void GpuProfiler::readBack(Frame & frame){
+	frame.pending = false;
+
+	// The end of the frame scope is the last query issued : if it is there, all of them are
+	GLint available = 0;
+	glGetQueryObjectiv(frame.queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available){
+		lostFrames++;
+		return;
+	}
+
+	for (size_t i=0; i<frame.scopes.size(); i++){
+		const Scope & scope = frame.scopes[i];
+		GLuint64 begin, end;
+		glGetQueryObjectui64v(frame.queries[2*i],   GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(frame.queries[2*i+1], GL_QUERY_RESULT, &end);
+		double ms = (end - begin) / 1e6;
+		if (i == 0){
+			frameSum += ms;
+			lastFrameMs = (float)ms;
+		}
+
+		size_t a = 0;
+		while (a < averages.size() && (averages[a].name != scope.name || averages[a].depth != scope.depth))
+			a++;
+		if (a == averages.size()){
+			Average average = { scope.name, scope.depth, 0.0, 0.0f };
+			averages.push_back(average);
+		}
+		averages[a].sum += ms;
+
+#ifdef ENABLE_PROFILER
+		if (profilerRecording.load(std::memory_order_relaxed))
+			profilerRecordGpu(scope.name, begin, end);
+#endif
+	}
+	frameCount++;
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (now - statsStart >= std::chrono::seconds(1)){
+		frameMs = (float)(frameSum / frameCount);
+		for (size_t a=0; a<averages.size(); a++){
+			averages[a].ms = (float)(averages[a].sum / frameCount);
+			averages[a].sum = 0.0;
+		}
+		frameSum = 0.0;
+		frameCount = 0;
+		statsStart = now;
+		newStats = true;
+
+#ifdef ENABLE_PROFILER
+		// The GL clock and the time stamp counter drift apart slowly
+		GLint64 glNow;
+		glGetInteger64v(GL_TIMESTAMP, &glNow);
+		profilerCalibrateGpu((uint64_t)glNow);
+#endif
+	}
+}
+
+bool GpuProfiler::hasNewStats(){
+	bool result = newStats;
+	newStats = false;
+	return result;
+}
+
+void GpuProfiler::printStats() const {
+	printf("GPU : %.3f ms/frame (", frameMs);
+	bool first = true;
+	for (size_t a=0; a<averages.size(); a++){
+		if (averages[a].depth == 0)
+			continue;
+		printf("%s%s %.3f ms", first ? "" : ", ", averages[a].name, averages[a].ms);
+		first = false;
+	}
+	printf("), %d frames lost\n", lostFrames);
+}
@@ -0,0 +1,98 @@
+#ifndef GPUPROFILER_HPP
+#define GPUPROFILER_HPP
+
+#include <vector>
+#include <chrono>
+
+// GPU timings.
+// Every scope puts a glQueryCounter(GL_TIMESTAMP) at its beginning and at its
+// end, so scopes can nest, unlike GL_TIME_ELAPSED queries. The queries of a
+// frame are only read frameLatency frames later : by then the GPU is done, and
+// reading never stalls. If it still isn't, the results of that frame are lost
+// rather than waited for.
+// Timings are averaged and printed once per second. With ENABLE_PROFILER, they
+// also go into the CPU trace, on a "GPU" track.
+// Without timer queries (GL_ARB_timer_query, core in 3.3), everything is a no-op.
+
+class GpuProfiler {
+public:
+	GpuProfiler();
+	~GpuProfiler();
+
+	// Creates the queries. Needs a current context.
+	void init(int frameLatency = 4, int maxScopesPerFrame = 64);
+	// Deletes the queries, with the context current. Everything is a no-op after it.
+	void cleanup();
+
+	// All of these must be called on the thread that draws
+	void beginFrame();
+	void endFrame();
+	// name must be a string literal
+	void beginScope(const char * name);
+	void endScope();
+
+	bool isSupported() const { return supported; }
+	// Disabling takes effect at the next beginFrame()
+	void setEnabled(bool enabled) { this->enabled = enabled; }
+
+	// Average GPU time of the whole frame over the last second, in milliseconds
+	float getFrameMs() const { return frameMs; }
+	// GPU time of the last frame read back, frameLatency frames ago
+	float getLastFrameMs() const { return lastFrameMs; }
+	// True once per second, when new averages are available
+	bool hasNewStats();
+	// Average per scope over the last second, as "name 1.23 ms, ..."
+	void printStats() const;
+	// Same averages, scope 0 being the whole frame
+	int getScopeCount() const { return (int)averages.size(); }
+	const char * getScopeName(int scope) const { return averages[scope].name; }
+	float getScopeMs(int scope) const { return averages[scope].ms; }
+
+private:
+	struct Scope {
+		const char * name;
+		int depth;      // 0 for the whole frame
+	};
+	struct Frame {
+		std::vector<GLuint> queries; // Begin and end of each scope
+		std::vector<Scope> scopes;
+		bool pending;                // Issued, not read yet
+	};
+	struct Average {
+		const char * name;
+		int depth;
+		double sum;
+		float ms;
+	};
+
+	void readBack(Frame & frame);
+
+	bool supported;
+	bool enabled;
+	bool active;                 // Timing the current frame
+	int maxScopes;
+	std::vector<Frame> frames;
+	int currentFrame;
+	std::vector<int> stack;      // Open scopes of the current frame, -1 for an ignored one
+	int lostFrames;
+
+	// Accumulated until the next stats
+	std::vector<Average> averages;
+	double frameSum;
+	int frameCount;
+	float frameMs;
+	float lastFrameMs;
+	bool newStats;
+	std::chrono::steady_clock::time_point statsStart;
+};
+
+// Times the rest of the enclosing block
+class GpuScope {
+public:
+	GpuScope(GpuProfiler & profiler, const char * name) : profiler(profiler) { profiler.beginScope(name); }
+	~GpuScope(){ profiler.endScope(); }
+private:
+	GpuProfiler & profiler;
+};
+
+#endif
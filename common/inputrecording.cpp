@@ -0,0 +1,320 @@
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "collision.hpp"
+#include "physics.hpp"
+#include "triggers.hpp"
+#include "simulation.hpp"
+#include "inputrecording.hpp"
+
+static const unsigned char MAGIC[4] = { 'R', 'E', 'C', 'I' };
+static const unsigned char VERSION = 1;
+// Low bits of an entry : which axes changed, or none for a checkpoint
+static const int CHECKPOINT = 0;
+static const int AXIS_X = 1;
+static const int AXIS_Z = 2;
+static const int AXIS_BITS = 2;
+static const size_t FLUSH_SIZE = 4096;
+
+static void putVarint(std::vector<unsigned char> & out, uint64_t value){
+	while (value >= 0x80){
+		out.push_back((unsigned char)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((unsigned char)value);
+}
+
+static bool getVarint(const std::vector<unsigned char> & in, size_t & cursor, uint64_t & value){
+	value = 0;
+	for (int shift=0; shift<64; shift+=7){
+		if (cursor >= in.size())
+			return false;
+		unsigned char byte = in[cursor++];
+		value |= (uint64_t)(byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+			return true;
+	}
+	return false;
+}
+
+// Small changes either way in a single byte
+static uint64_t zigzag(int value){
+	return value >= 0 ? 2 * (uint64_t)value : 2 * (uint64_t)(-(int64_t)value) - 1;
+}
+
+static int unzigzag(uint64_t value){
+	return (value & 1) ? -(int)((value + 1) / 2) : (int)(value / 2);
+}
+
+static void putUint32(std::vector<unsigned char> & out, uint32_t value){
+	for (int i=0; i<4; i++)
+		out.push_back((unsigned char)(value >> (8 * i)));
+}
+
+static bool getUint32(const std::vector<unsigned char> & in, size_t & cursor, uint32_t & value){
+	if (cursor + 4 > in.size())
+		return false;
+	value = 0;
+	for (int i=0; i<4; i++)
+		value |= (uint32_t)in[cursor++] << (8 * i);
+	return true;
+}
+
+static void putFloat(std::vector<unsigned char> & out, float value){
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	putUint32(out, bits);
+}
+
+static bool getFloat(const std::vector<unsigned char> & in, size_t & cursor, float & value){
+	uint32_t bits;
+	if (!getUint32(in, cursor, bits))
+		return false;
+	memcpy(&value, &bits, sizeof(value));
+	return true;
+}
+
+// An axis in [-1, 1], in steps of 1/127 : digital input stays exact
+static int quantize(float value){
+	return (int)floorf(glm::clamp(value, -1.0f, 1.0f) * 127.0f + 0.5f);
+}
+
+static float dequantize(int value){
+	return value / 127.0f;
+}
+
+InputRecorder::InputRecorder(){
+	file = NULL;
+	bytes = 0;
+	checkpointInterval = 60;
+	ticks = position = 0;
+	previous[0] = previous[1] = 0;
+	lastHash = 0;
+	lastCheckpoint = 0;
+}
+
+InputRecorder::~InputRecorder(){
+	if (file)
+		close();
+}
+
+bool InputRecorder::open(const char * path, const GameRules & rules, int tickRate, int checkpointInterval){
+	file = fopen(path, "wb");
+	if (file == NULL){
+		printf("Can't write the input recording %s\n", path);
+		return false;
+	}
+	this->checkpointInterval = checkpointInterval > 0 ? checkpointInterval : 60;
+	ticks = position = 0;
+	previous[0] = previous[1] = 0;
+	lastHash = 0;
+	lastCheckpoint = 0;
+	bytes = 0;
+
+	// Header : what a replay needs besides the input
+	buffer.assign(MAGIC, MAGIC + 4);
+	buffer.push_back(VERSION);
+	putVarint(buffer, (uint64_t)tickRate);
+	putVarint(buffer, (uint64_t)this->checkpointInterval);
+	putFloat(buffer, rules.timeLimit);
+	putFloat(buffer, rules.spikePenalty);
+	putFloat(buffer, rules.pushForce);
+	putFloat(buffer, rules.fallHeight);
+	return true;
+}
+
+void InputRecorder::writeEntry(unsigned int tick, int code){
+	putVarint(buffer, ((uint64_t)(tick - position) << AXIS_BITS) | (uint64_t)code);
+	position = tick;
+}
+
+GameInput InputRecorder::record(const GameInput & input){
+	int value[2] = { quantize(input.pushX), quantize(input.pushZ) };
+	if (file){
+		int code = (value[0] != previous[0] ? AXIS_X : 0) | (value[1] != previous[1] ? AXIS_Z : 0);
+		if (code != 0){
+			writeEntry(ticks, code);
+			for (int axis=0; axis<2; axis++)
+				if (code & (1 << axis))
+					putVarint(buffer, zigzag(value[axis] - previous[axis]));
+			previous[0] = value[0];
+			previous[1] = value[1];
+		}
+	}
+	GameInput rounded = { dequantize(value[0]), dequantize(value[1]) };
+	return rounded;
+}
+
+void InputRecorder::endTick(unsigned int stateHash){
+	if (file == NULL)
+		return;
+	ticks++;
+	lastHash = stateHash;
+	if (ticks % checkpointInterval == 0){
+		writeEntry(ticks, CHECKPOINT);
+		putUint32(buffer, stateHash);
+		lastCheckpoint = ticks;
+	}
+	if (buffer.size() >= FLUSH_SIZE)
+		flush();
+}
+
+void InputRecorder::flush(){
+	if (buffer.empty())
+		return;
+	fwrite(&buffer[0], 1, buffer.size(), file);
+	bytes += buffer.size();
+	buffer.clear();
+}
+
+void InputRecorder::close(){
+	if (file == NULL)
+		return;
+	// The replay lasts until the last checkpoint
+	if (ticks != lastCheckpoint){
+		writeEntry(ticks, CHECKPOINT);
+		putUint32(buffer, lastHash);
+		lastCheckpoint = ticks;
+	}
+	flush();
+	fclose(file);
+	file = NULL;
+}
+
+InputReplay::InputReplay(){
+	start = 0;
+	tickRate = 60;
+	tickCount = 0;
+	checkpointCount = 0;
+	cursor = 0;
+	ticks = position = 0;
+	current[0] = current[1] = 0;
+	desyncTick = 0;
+	checkpointsPassed = 0;
+}
+
+bool InputReplay::readEntry(size_t & at, unsigned int & tick, int & code, int deltas[2], unsigned int & hash) const {
+	uint64_t header;
+	if (!getVarint(data, at, header))
+		return false;
+	code = (int)(header & ((1 << AXIS_BITS) - 1));
+	tick += (unsigned int)(header >> AXIS_BITS);
+	if (code == CHECKPOINT){
+		uint32_t value;
+		if (!getUint32(data, at, value))
+			return false;
+		hash = value;
+		return true;
+	}
+	for (int axis=0; axis<2; axis++){
+		deltas[axis] = 0;
+		uint64_t value;
+		if ((code & (1 << axis)) && !getVarint(data, at, value))
+			return false;
+		if (code & (1 << axis))
+			deltas[axis] = unzigzag(value);
+	}
+	return true;
+}
+
+bool InputReplay::open(const char * path){
+	FILE * file = fopen(path, "rb");
+	if (file == NULL){
+		printf("Can't open the input recording %s\n", path);
+		return false;
+	}
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	data.resize(size > 0 ? size : 0);
+	bool read = data.empty() || fread(&data[0], 1, data.size(), file) == data.size();
+	fclose(file);
+
+	size_t at = 0;
+	uint64_t rate, interval;
+	bool valid = read && data.size() > 5 && memcmp(&data[0], MAGIC, 4) == 0 && data[4] == VERSION;
+	at = 5;
+	valid = valid && getVarint(data, at, rate) && getVarint(data, at, interval) &&
+		getFloat(data, at, rules.timeLimit) && getFloat(data, at, rules.spikePenalty) &&
+		getFloat(data, at, rules.pushForce) && getFloat(data, at, rules.fallHeight);
+	if (!valid || rate == 0){
+		printf("%s is not an input recording, or not of this version\n", path);
+		return false;
+	}
+	tickRate = (int)rate;
+	start = at;
+
+	// Length : up to the last checkpoint
+	unsigned int tick = 0;
+	tickCount = 0;
+	checkpointCount = 0;
+	int code, deltas[2];
+	unsigned int hash;
+	while (at < data.size()){
+		if (!readEntry(at, tick, code, deltas, hash))
+			break;
+		if (code == CHECKPOINT){
+			tickCount = tick;
+			checkpointCount++;
+		}
+	}
+	if (at != data.size())
+		printf("%s is truncated : replaying up to its last checkpoint, tick %u\n", path, tickCount);
+
+	cursor = start;
+	ticks = position = 0;
+	current[0] = current[1] = 0;
+	desyncTick = 0;
+	checkpointsPassed = 0;
+	return true;
+}
+
+GameInput InputReplay::next(){
+	// Changes up to this tick. Checkpoints check() didn't read are skipped.
+	for (;;){
+		size_t at = cursor;
+		unsigned int tick = position;
+		int code, deltas[2];
+		unsigned int hash;
+		if (!readEntry(at, tick, code, deltas, hash) || tick > ticks)
+			break;
+		if (code != CHECKPOINT){
+			current[0] += deltas[0];
+			current[1] += deltas[1];
+		}
+		cursor = at;
+		position = tick;
+	}
+	ticks++;
+	GameInput input = { dequantize(current[0]), dequantize(current[1]) };
+	return input;
+}
+
+bool InputReplay::check(unsigned int stateHash){
+	bool same = true;
+	for (;;){
+		size_t at = cursor;
+		unsigned int tick = position;
+		int code, deltas[2];
+		unsigned int hash;
+		if (!readEntry(at, tick, code, deltas, hash) || tick > ticks || code != CHECKPOINT)
+			break;
+		if (hash == stateHash)
+			checkpointsPassed++;
+		else{
+			same = false;
+			if (desyncTick == 0)
+				desyncTick = tick;
+		}
+		cursor = at;
+		position = tick;
+	}
+	return same;
+}
@@ -0,0 +1,93 @@
+#ifndef INPUTRECORDING_HPP
+#define INPUTRECORDING_HPP
+
+// Input recordings, to play a session again exactly.
+// The game only depends on the input of each tick (see simulation.hpp), so a
+// session is its rules and the input of every tick. Each axis of the input
+// is rounded to a byte, and only changes are written : how many ticks since
+// the previous entry and which axes changed in one varint, then the change of
+// each of them as a zigzag varint. Holding a key costs nothing, steering with
+// an analog input a few bytes per tick. Every checkpointInterval ticks, the
+// hash of the state is written too : a replay that doesn't reach the same
+// state is stopped at the first checkpoint that differs.
+//
+// Recording, at every tick :              Replaying, at every tick :
+//	input = recorder.record(input);         input = replay.next();
+//	game.tick(input);                       game.tick(input);
+//	recorder.endTick(game.hashState());     if (!replay.check(game.hashState())) ...
+
+class InputRecorder {
+public:
+	InputRecorder();
+	~InputRecorder();
+
+	bool open(const char * path, const GameRules & rules, int tickRate, int checkpointInterval = 60);
+	// Input of the next tick, rounded as it is stored : the game must play this one, not the original
+	GameInput record(const GameInput & input);
+	// Once the tick is over, with the hash of the state it led to
+	void endTick(unsigned int stateHash);
+	// Writes the last checkpoint and closes the file
+	void close();
+
+	bool isOpen() const { return file != NULL; }
+	unsigned int getTickCount() const { return ticks; }
+	size_t getByteCount() const { return bytes; }
+
+private:
+	void writeEntry(unsigned int position, int code);
+	void flush();
+
+	FILE * file;
+	std::vector<unsigned char> buffer; // Written to the file when it fills up
+	size_t bytes;
+	int checkpointInterval;
+	unsigned int ticks;    // Recorded so far
+	unsigned int position; // Tick of the last entry
+	int previous[2];       // Last input recorded, rounded
+	unsigned int lastHash;
+	unsigned int lastCheckpoint;
+};
+
+class InputReplay {
+public:
+	InputReplay();
+
+	// Reads the whole recording, and checks it is complete
+	bool open(const char * path);
+
+	const GameRules & getRules() const { return rules; }
+	int getTickRate() const { return tickRate; }
+	unsigned int getTickCount() const { return tickCount; }
+	int getCheckpointCount() const { return checkpointCount; }
+
+	// Input of the next tick
+	GameInput next();
+	// Once the tick is over : false if the state differs from the recorded one at a checkpoint
+	bool check(unsigned int stateHash);
+	// Every tick was played
+	bool isOver() const { return ticks >= tickCount; }
+	// Tick after which the state first differed, 0 if it never did
+	unsigned int getDesyncTick() const { return desyncTick; }
+	int getCheckpointsPassed() const { return checkpointsPassed; }
+
+private:
+	// Decodes the entry at cursor, false at the end
+	bool readEntry(size_t & cursor, unsigned int & position, int & code, int deltas[2], unsigned int & hash) const;
+
+	std::vector<unsigned char> data;
+	size_t start; // Of the entries
+	GameRules rules;
+	int tickRate;
+	unsigned int tickCount;
+	int checkpointCount;
+
+	// Playback
+	size_t cursor;
+	unsigned int ticks; // Played so far
+	unsigned int position;
+	int current[2];
+	unsigned int desyncTick;
+	int checkpointsPassed;
+};
+
+#endif
@@ -0,0 +1,339 @@
+#include <vector>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+#include <stddef.h>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "shader.hpp"
+#include "objloader.hpp"
+#include "glextensions.hpp"
+#include "occlusion.hpp"
+#include "instanceculling.hpp"
+#include "glstats.hpp"
+
+// Layout of a glDrawArraysIndirect command
+struct DrawArraysIndirectCommand {
+	GLuint count;
+	GLuint instanceCount;
+	GLuint first;
+	GLuint baseInstance; // Must be 0 before GL 4.2
+};
+
+void extractFrustumPlanes(const glm::mat4 & m, glm::vec4 planes[6]){
+	// Rows of the matrix (GLM is column major)
+	glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+	glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+	glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+	glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+	planes[0] = row3 + row0; // Left
+	planes[1] = row3 - row0; // Right
+	planes[2] = row3 + row1; // Bottom
+	planes[3] = row3 - row1; // Top
+	planes[4] = row3 + row2; // Near
+	planes[5] = row3 - row2; // Far
+	for (int i=0; i<6; i++)
+		planes[i] /= glm::length(glm::vec3(planes[i]));
+}
+
+void cullInstancesCPU(
+	const std::vector<glm::mat4> & transforms,
+	const glm::vec4 & localSphere,
+	const glm::vec4 planes[6],
+	std::vector<glm::mat4> & out_visible
+){
+	out_visible.clear();
+	for (size_t i=0; i<transforms.size(); i++){
+		const glm::mat4 & model = transforms[i];
+		// Same test as CullingVertexShader
+		glm::vec3 center = glm::vec3(model * glm::vec4(glm::vec3(localSphere), 1.0f));
+		float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+		float radius = localSphere.w * scale;
+		bool visible = true;
+		for (int p=0; p<6 && visible; p++)
+			visible = glm::dot(glm::vec3(planes[p]), center) + planes[p].w >= -radius;
+		if (visible)
+			out_visible.push_back(model);
+	}
+}
+
+// Points attributes [first, first+3] to a tightly packed array of mat4, one per instance
+static void setInstanceAttributes(GLuint first, GLuint buffer, GLuint divisor){
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	for (GLuint c=0; c<4; c++){
+		glEnableVertexAttribArray(first + c);
+		glVertexAttribPointer(first + c, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(c * sizeof(glm::vec4)));
+		glVertexAttribDivisor(first + c, divisor);
+	}
+}
+
+InstanceCuller::InstanceCuller(){
+	cullProgram = drawProgram = 0;
+	planesID = sphereID = viewProjectionID = 0;
+	cullVAO = drawVAO[0] = drawVAO[1] = 0;
+	instanceBuffer = visibleBuffer = cpuVisibleBuffer = indirectBuffer = 0;
+	primitivesQuery = 0;
+	meshVertexCount = 0;
+	instanceCount = 0;
+	cpuVisibleCount = 0;
+	indirectDraw = false;
+	lastCullOnGPU = false;
+}
+
+InstanceCuller::~InstanceCuller(){
+	cleanup();
+}
+
+void InstanceCuller::cleanup(){
+	if (cullProgram == 0 && drawProgram == 0)
+		return;
+	glDeleteProgram(cullProgram);
+	glDeleteProgram(drawProgram);
+	glDeleteVertexArrays(1, &cullVAO);
+	glDeleteVertexArrays(2, drawVAO);
+	glDeleteBuffers(1, &instanceBuffer);
+	glDeleteBuffers(1, &visibleBuffer);
+	glDeleteBuffers(1, &cpuVisibleBuffer);
+	glDeleteBuffers(1, &indirectBuffer);
+	glDeleteQueries(1, &primitivesQuery);
+	cullProgram = drawProgram = 0;
+	cullVAO = drawVAO[0] = drawVAO[1] = 0;
+	instanceBuffer = visibleBuffer = cpuVisibleBuffer = indirectBuffer = 0;
+	primitivesQuery = 0;
+}
+
+bool InstanceCuller::init(){
+	static const char * varyings[] = { "Model0", "Model1", "Model2", "Model3" };
+	cullProgram = LoadTransformFeedbackShaders("CullingVertexShader.vertexshader", "CullingGeometryShader.geometryshader", varyings, 4);
+	drawProgram = LoadShaders("InstancedVertexShader.vertexshader", "SimpleFragmentShader.fragmentshader");
+	if (cullProgram == 0 || drawProgram == 0)
+		return false;
+
+	planesID = glGetUniformLocation(cullProgram, "FrustumPlanes");
+	sphereID = glGetUniformLocation(cullProgram, "BoundingSphere");
+	viewProjectionID = glGetUniformLocation(drawProgram, "VP");
+
+	glGenVertexArrays(1, &cullVAO);
+	glGenVertexArrays(2, drawVAO);
+	glGenBuffers(1, &instanceBuffer);
+	glGenBuffers(1, &visibleBuffer);
+	glGenBuffers(1, &cpuVisibleBuffer);
+	glGenQueries(1, &primitivesQuery);
+
+	// Without these, the visible count has to come back to the CPU before drawing
+	indirectDraw = (GLEW_VERSION_4_0 || isExtensionSupported("GL_ARB_draw_indirect"))
+	            && (GLEW_VERSION_4_4 || isExtensionSupported("GL_ARB_query_buffer_object"));
+	if (indirectDraw){
+		glGenBuffers(1, &indirectBuffer);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawArraysIndirectCommand), NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+	printf("GPU instance culling ready, %s draws\n", indirectDraw ? "indirect" : "query read-back");
+	return true;
+}
+
+void InstanceCuller::setMesh(GLuint vertexbuffer, GLsizei vertexCount, const glm::vec4 & localSphere){
+	meshVertexCount = vertexCount;
+	meshSphere = localSphere;
+
+	GLint previousVAO;
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVAO);
+	for (int i=0; i<2; i++){
+		glBindVertexArray(drawVAO[i]);
+		glEnableVertexAttribArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+		setInstanceAttributes(1, i == 0 ? visibleBuffer : cpuVisibleBuffer, 1);
+	}
+	glBindVertexArray(previousVAO);
+
+	if (indirectDraw){
+		DrawArraysIndirectCommand command = { (GLuint)vertexCount, 0, 0, 0 };
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+		glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(command), &command);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+}
+
+void InstanceCuller::setInstances(const std::vector<glm::mat4> & newTransforms){
+	transforms = newTransforms;
+	instanceCount = (GLsizei)transforms.size();
+
+	GLint previousVAO;
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVAO);
+	glBindVertexArray(cullVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	glBufferData(GL_ARRAY_BUFFER, instanceCount * sizeof(glm::mat4), instanceCount ? &transforms[0] : NULL, GL_STATIC_DRAW);
+	setInstanceAttributes(0, instanceBuffer, 0);
+	glBindVertexArray(previousVAO);
+
+	// Worst case : everything is visible
+	glBindBuffer(GL_ARRAY_BUFFER, visibleBuffer);
+	glBufferData(GL_ARRAY_BUFFER, instanceCount * sizeof(glm::mat4), NULL, GL_DYNAMIC_COPY);
+}
+
+void InstanceCuller::cullOnGPU(const glm::mat4 & viewProjection){
+	glm::vec4 planes[6];
+	extractFrustumPlanes(viewProjection, planes);
+
+	GLint previousVAO;
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVAO);
+
+	glUseProgram(cullProgram);
+	glUniform4fv(planesID, 6, &planes[0][0]);
+	glUniform4fv(sphereID, 1, &meshSphere[0]);
+
+	// Nothing is rasterized : we only want the geometry shader output
+	glEnable(GL_RASTERIZER_DISCARD);
+	glBindVertexArray(cullVAO);
+	glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, visibleBuffer);
+	glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, primitivesQuery);
+	glBeginTransformFeedback(GL_POINTS);
+	glDrawArrays(GL_POINTS, 0, instanceCount);
+	glEndTransformFeedback();
+	glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+	glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+	glDisable(GL_RASTERIZER_DISCARD);
+
+	// Let the GPU write the instance count straight into the draw command
+	if (indirectDraw){
+		glBindBuffer(GL_QUERY_BUFFER, indirectBuffer);
+		glGetQueryObjectuiv(primitivesQuery, GL_QUERY_RESULT, (GLuint*)offsetof(DrawArraysIndirectCommand, instanceCount));
+		glBindBuffer(GL_QUERY_BUFFER, 0);
+	}
+
+	glBindVertexArray(previousVAO);
+	lastCullOnGPU = true;
+}
+
+void InstanceCuller::cullOnCPU(const glm::mat4 & viewProjection){
+	glm::vec4 planes[6];
+	extractFrustumPlanes(viewProjection, planes);
+	cullInstancesCPU(transforms, meshSphere, planes, cpuVisible);
+	cpuVisibleCount = (GLsizei)cpuVisible.size();
+
+	// Orphan the previous buffer so that we don't wait for the draws still using it
+	glBindBuffer(GL_ARRAY_BUFFER, cpuVisibleBuffer);
+	glBufferData(GL_ARRAY_BUFFER, instanceCount * sizeof(glm::mat4), NULL, GL_STREAM_DRAW);
+	if (cpuVisibleCount)
+		glBufferSubData(GL_ARRAY_BUFFER, 0, cpuVisibleCount * sizeof(glm::mat4), &cpuVisible[0]);
+	lastCullOnGPU = false;
+}
+
+GLuint InstanceCuller::getVisibleCount(){
+	if (!lastCullOnGPU)
+		return cpuVisibleCount;
+	GLuint count = 0;
+	glGetQueryObjectuiv(primitivesQuery, GL_QUERY_RESULT, &count);
+	return count;
+}
+
+void InstanceCuller::draw(const glm::mat4 & viewProjection){
+	GLint previousVAO;
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVAO);
+
+	glUseProgram(drawProgram);
+	glUniformMatrix4fv(viewProjectionID, 1, GL_FALSE, &viewProjection[0][0]);
+
+	if (lastCullOnGPU){
+		glBindVertexArray(drawVAO[0]);
+		if (indirectDraw){
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+			glDrawArraysIndirect(GL_TRIANGLES, (void*)0);
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		}else{
+			glDrawArraysInstanced(GL_TRIANGLES, 0, meshVertexCount, getVisibleCount());
+		}
+	}else{
+		glBindVertexArray(drawVAO[1]);
+		glDrawArraysInstanced(GL_TRIANGLES, 0, meshVertexCount, cpuVisibleCount);
+	}
+
+	glBindVertexArray(previousVAO);
+}
+
+static float randomFloat(float min, float max){
+	return min + (max - min) * (rand() / (float)RAND_MAX);
+}
+
+void runInstanceCullingBenchmark(){
+	printf("Instance culling benchmark (%s)\n", glGetString(GL_RENDERER));
+
+	std::vector<glm::vec3> vertices;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec3> normals;
+	if (!loadOBJ("Coin1.obj", vertices, uvs, normals))
+		return;
+
+	GLuint vertexbuffer;
+	glGenBuffers(1, &vertexbuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), &vertices[0], GL_STATIC_DRAW);
+
+	InstanceCuller culler;
+	if (!culler.init()){
+		printf("GPU culling unavailable\n");
+		culler.cleanup();
+		glDeleteBuffers(1, &vertexbuffer);
+		return;
+	}
+	culler.setMesh(vertexbuffer, (GLsizei)vertices.size(), computeBoundingSphere(vertices));
+
+	// Looking down -Z : roughly a third of the field is inside the frustum
+	glm::mat4 viewProjection = glm::perspective(glm::radians(45.0f), 1080.0f / 720.0f, 0.1f, 200.0f)
+	                         * glm::lookAt(glm::vec3(0, 0, 0), glm::vec3(0, 0, -1), glm::vec3(0, 1, 0));
+
+	static const int counts[] = { 1000, 10000, 100000 };
+	for (int c=0; c<3; c++){
+		srand(42); // Same field for every run
+		std::vector<glm::mat4> transforms(counts[c]);
+		for (int i=0; i<counts[c]; i++){
+			glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(randomFloat(-100, 100), randomFloat(-100, 100), randomFloat(-150, 0)));
+			model = glm::rotate(model, randomFloat(0, 6.28f), glm::vec3(0, 1, 0));
+			transforms[i] = glm::scale(model, glm::vec3(randomFloat(0.5f, 1.5f)));
+		}
+		culler.setInstances(transforms);
+
+		// The cull alone, then the cull followed by the draw it feeds
+		const int frames = 30;
+		double cullMs[2], frameMs[2];
+		GLuint visible[2];
+		for (int path=0; path<2; path++){
+			for (int withDraw=0; withDraw<2; withDraw++){
+				glFinish();
+				std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+				for (int f=0; f<frames; f++){
+					glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+					if (path == 0)
+						culler.cullOnCPU(viewProjection);
+					else
+						culler.cullOnGPU(viewProjection);
+					if (withDraw)
+						culler.draw(viewProjection);
+					glFinish();
+				}
+				std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+				double ms = std::chrono::duration<double, std::milli>(end - start).count() / frames;
+				if (withDraw)
+					frameMs[path] = ms;
+				else
+					cullMs[path] = ms;
+			}
+			visible[path] = culler.getVisibleCount();
+		}
+		printf("  %6d instances : CPU cull %.3f ms, +draw %.3f ms (%u visible) | GPU cull %.3f ms, +draw %.3f ms (%u visible)\n",
+			counts[c], cullMs[0], frameMs[0], visible[0], cullMs[1], frameMs[1], visible[1]);
+	}
+
+	culler.cleanup();
+	glDeleteBuffers(1, &vertexbuffer);
+}
@@ -0,0 +1,71 @@
+#ifndef INSTANCECULLING_HPP
+#define INSTANCECULLING_HPP
+
+// Frustum culling of many instances of the same mesh.
+// On the GPU path, a vertex shader tests the bounding sphere of every instance
+// and a geometry shader streams the visible model matrices out with transform
+// feedback. They are then drawn with a single instanced draw call, whose
+// instance count comes from a GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN query.
+// When GL_ARB_draw_indirect and GL_ARB_query_buffer_object are available, the
+// query result is copied to the indirect buffer on the GPU, so nothing stalls.
+
+// Frustum planes (normal, distance) of a view-projection matrix, normals pointing inside
+void extractFrustumPlanes(const glm::mat4 & viewProjection, glm::vec4 planes[6]);
+
+// CPU reference : keeps the transforms whose bounding sphere touches the frustum
+void cullInstancesCPU(
+	const std::vector<glm::mat4> & transforms,
+	const glm::vec4 & localSphere,
+	const glm::vec4 planes[6],
+	std::vector<glm::mat4> & out_visible
+);
+
+class InstanceCuller {
+public:
+	InstanceCuller();
+	~InstanceCuller();
+
+	// Loads the shaders. Returns false if the GPU path can't be used.
+	bool init();
+	// Deletes the programs and buffers, with the context current
+	void cleanup();
+
+	// The mesh drawn for every instance (a non-indexed triangle list)
+	void setMesh(GLuint vertexbuffer, GLsizei vertexCount, const glm::vec4 & localSphere);
+	void setInstances(const std::vector<glm::mat4> & transforms);
+
+	void cullOnGPU(const glm::mat4 & viewProjection);
+	void cullOnCPU(const glm::mat4 & viewProjection);
+
+	// Draws the instances that survived the last cull
+	void draw(const glm::mat4 & viewProjection);
+
+	// Number of instances that survived the last cull. Waits for the GPU on the GPU path.
+	GLuint getVisibleCount();
+
+	bool usesIndirectDraw() const { return indirectDraw; }
+
+private:
+	GLuint cullProgram, drawProgram;
+	GLuint planesID, sphereID, viewProjectionID;
+	GLuint cullVAO;
+	GLuint drawVAO[2];           // [0] reads the transform feedback output, [1] the CPU upload
+	GLuint instanceBuffer;       // Every instance
+	GLuint visibleBuffer;        // Instances that passed the GPU cull
+	GLuint cpuVisibleBuffer;     // Instances that passed the CPU cull
+	GLuint indirectBuffer;
+	GLuint primitivesQuery;
+	GLsizei meshVertexCount;
+	glm::vec4 meshSphere;
+	GLsizei instanceCount;
+	GLsizei cpuVisibleCount;
+	bool indirectDraw;
+	bool lastCullOnGPU;
+	std::vector<glm::mat4> transforms;
+	std::vector<glm::mat4> cpuVisible;
+};
+
+// Compares CPU and GPU culling at 1k, 10k and 100k instances. Needs a current GL context.
+void runInstanceCullingBenchmark();
+
+#endif
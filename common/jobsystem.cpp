@@ -0,0 +1,319 @@
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+#include <stdio.h>
+#include <math.h>
+
+#include "jobsystem.hpp"
+#include "profiler.hpp"
+
+// Maximum number of unfinished jobs pushed by one thread.
+// If a deque is full, the job simply runs right away.
+static const int MAX_JOBS_PER_THREAD = 4096;
+
+struct Job {
+	JobFunction function;
+	void * data;
+	int begin, end;
+	JobCounter * counter;
+};
+
+// Chase-Lev work-stealing deque, with the C11 memory orderings of
+// "Correct and Efficient Work-Stealing for Weak Memory Models" (Le et al. 2013).
+// Only the owner calls push() and pop(), anybody can call steal().
+// Jobs are stored by value : a slot is only overwritten once top has moved past
+// it, and a thief copies the job before claiming it, so nobody reads a reused slot.
+class JobDeque {
+public:
+	JobDeque() : top(0), bottom(0) {}
+
+	bool push(const Job & job){
+		long b = bottom.load(std::memory_order_relaxed);
+		long t = top.load(std::memory_order_acquire);
+		if (b - t >= MAX_JOBS_PER_THREAD)
+			return false;
+		buffer[b & (MAX_JOBS_PER_THREAD-1)] = job;
+		bottom.store(b + 1, std::memory_order_release); // Publishes the job to the thieves
+		return true;
+	}
+
+	bool pop(Job & job){
+		long b = bottom.load(std::memory_order_relaxed) - 1;
+		bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		long t = top.load(std::memory_order_relaxed);
+		if (t > b){
+			// Empty
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return false;
+		}
+		job = buffer[b & (MAX_JOBS_PER_THREAD-1)];
+		if (t == b){
+			// Last job : race against the thieves for it
+			bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return won;
+		}
+		return true;
+	}
+
+	bool steal(Job & job){
+		long t = top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		long b = bottom.load(std::memory_order_acquire);
+		if (t >= b)
+			return false;
+		job = buffer[t & (MAX_JOBS_PER_THREAD-1)];
+		// Lost the race : the copy may be garbage, drop it
+		return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+	}
+
+private:
+	// Keep the thieves' and the owner's ends on separate cache lines
+	std::atomic<long> top;
+	char padding[64];
+	std::atomic<long> bottom;
+	Job buffer[MAX_JOBS_PER_THREAD];
+};
+
+struct ThreadState {
+	JobDeque deque;
+	unsigned int random; // For picking a victim to steal from
+};
+
+struct JobSystemData {
+	int threadCount;
+	std::vector<ThreadState *> threads;
+	std::vector<std::thread> workers;
+	std::atomic<bool> quit;
+	std::mutex sleepMutex;
+	std::condition_variable wakeUp;
+	std::atomic<int> sleeping;
+};
+
+// Which system the current thread works for, and its index there
+static thread_local JobSystemData * currentSystem = NULL;
+static thread_local int currentIndex = 0;
+
+static int getIndex(JobSystemData * d){
+	return currentSystem == d ? currentIndex : 0;
+}
+
+static void execute(const Job & job){
+	job.function(job.data, job.begin, job.end);
+	if (job.counter)
+		job.counter->pending.fetch_sub(1, std::memory_order_release);
+}
+
+static bool findJob(JobSystemData * d, int index, Job & job){
+	ThreadState * self = d->threads[index];
+	if (self->deque.pop(job))
+		return true;
+
+	// Nothing to do : steal, starting from a random thread
+	self->random ^= self->random << 13;
+	self->random ^= self->random >> 17;
+	self->random ^= self->random << 5;
+	int start = (int)(self->random % d->threadCount);
+	for (int i=0; i<d->threadCount; i++){
+		int victim = (start + i) % d->threadCount;
+		if (victim == index)
+			continue;
+		if (d->threads[victim]->deque.steal(job))
+			return true;
+	}
+	return false;
+}
+
+static void workerLoop(JobSystemData * d, int index){
+	currentSystem = d;
+	currentIndex = index;
+#ifdef ENABLE_PROFILER
+	char name[32];
+	sprintf(name, "worker %d", index);
+	PROFILE_THREAD_NAME(name);
+#endif
+
+	int idle = 0;
+	Job job;
+	while (!d->quit.load(std::memory_order_relaxed)){
+		if (findJob(d, index, job)){
+			execute(job);
+			idle = 0;
+		}else if (++idle < 64){
+			std::this_thread::yield();
+		}else{
+			// Stop burning a core. run() wakes us up, the timeout covers a missed notification.
+			std::unique_lock<std::mutex> lock(d->sleepMutex);
+			d->sleeping++;
+			d->wakeUp.wait_for(lock, std::chrono::milliseconds(1));
+			d->sleeping--;
+			idle = 0;
+		}
+	}
+}
+
+JobSystem::JobSystem(int threadCount){
+	if (threadCount <= 0)
+		threadCount = (int)std::thread::hardware_concurrency();
+	threadCount = std::max(1, threadCount);
+
+	d = new JobSystemData;
+	d->threadCount = threadCount;
+	d->quit = false;
+	d->sleeping = 0;
+	for (int i=0; i<threadCount; i++){
+		ThreadState * state = new ThreadState;
+		state->random = 2463534242u + i * 7919u;
+		d->threads.push_back(state);
+	}
+
+	// Thread 0 is the caller
+	for (int i=1; i<threadCount; i++)
+		d->workers.push_back(std::thread(workerLoop, d, i));
+}
+
+JobSystem::~JobSystem(){
+	d->quit = true;
+	d->wakeUp.notify_all();
+	for (size_t i=0; i<d->workers.size(); i++)
+		d->workers[i].join();
+	for (size_t i=0; i<d->threads.size(); i++)
+		delete d->threads[i];
+	delete d;
+}
+
+int JobSystem::getThreadCount() const {
+	return d->threadCount;
+}
+
+int JobSystem::getThreadIndex() const {
+	return getIndex(d);
+}
+
+void JobSystem::run(JobFunction function, void * data, JobCounter * counter, int begin, int end){
+	Job job;
+	job.function = function;
+	job.data = data;
+	job.begin = begin;
+	job.end = end;
+	job.counter = counter;
+	if (counter)
+		counter->pending.fetch_add(1, std::memory_order_relaxed);
+
+	if (!d->threads[getIndex(d)]->deque.push(job)){
+		execute(job); // Too many jobs in flight
+		return;
+	}
+	if (d->sleeping.load(std::memory_order_relaxed) > 0)
+		d->wakeUp.notify_one();
+}
+
+void JobSystem::wait(JobCounter * counter){
+	PROFILE_SCOPE("JobSystem::wait");
+	int index = getIndex(d);
+	Job job;
+	while (counter->pending.load(std::memory_order_acquire) > 0){
+		if (findJob(d, index, job))
+			execute(job);
+		else
+			std::this_thread::yield();
+	}
+}
+
+struct ParallelForTask {
+	JobSystem * system;
+	JobFunction function;
+	void * data;
+	int grain;
+	JobCounter counter;
+};
+
+// Keeps the first half of its range and hands the second half over, until the range is small enough
+static void parallelForJob(void * data, int begin, int end){
+	ParallelForTask * task = (ParallelForTask *)data;
+	while (end - begin > task->grain){
+		int middle = begin + (end - begin) / 2;
+		task->system->run(parallelForJob, task, &task->counter, middle, end);
+		end = middle;
+	}
+	task->function(task->data, begin, end);
+}
+
+void JobSystem::parallelFor(int begin, int end, int grain, JobFunction function, void * data){
+	if (end <= begin)
+		return;
+	ParallelForTask task;
+	task.system = this;
+	task.function = function;
+	task.data = data;
+	task.grain = std::max(1, grain);
+	if (d->threadCount == 1 || end - begin <= task.grain){
+		function(data, begin, end);
+		return;
+	}
+	parallelForJob(&task, begin, end);
+	wait(&task.counter);
+}
+
+static void emptyJob(void *, int, int){
+}
+
+static double secondsSince(std::chrono::high_resolution_clock::time_point start){
+	return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void runJobSystemBenchmark(){
+	int maxThreads = std::max(1, (int)std::thread::hardware_concurrency());
+	printf("Job system benchmark, up to %d threads\n", maxThreads);
+
+	double singleThreadSeconds = 0.0;
+	for (int threads=1; ; threads = std::min(threads*2, maxThreads)){
+		JobSystem jobs(threads);
+
+		// Empty-job throughput : batches of jobs submitted by the main thread
+		const int batches = 200, batchSize = 1000;
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		for (int b=0; b<batches; b++){
+			JobCounter counter;
+			for (int i=0; i<batchSize; i++)
+				jobs.run(emptyJob, NULL, &counter);
+			jobs.wait(&counter);
+		}
+		double throughput = batches * batchSize / secondsSince(start);
+
+		// Fan-out/fan-in latency : one small job per thread, then wait for all of them
+		const int rounds = 10000;
+		start = std::chrono::high_resolution_clock::now();
+		for (int r=0; r<rounds; r++){
+			JobCounter counter;
+			for (int i=0; i<threads; i++)
+				jobs.run(emptyJob, NULL, &counter);
+			jobs.wait(&counter);
+		}
+		double latency = secondsSince(start) / rounds;
+
+		// Scaling : a parallel for over a million items of real work
+		const int items = 1 << 20;
+		std::vector<float> values(items);
+		start = std::chrono::high_resolution_clock::now();
+		for (int repeat=0; repeat<10; repeat++){
+			jobs.parallelFor(0, items, 4096, [&values](int begin, int end){
+				for (int i=begin; i<end; i++)
+					values[i] = sqrtf((float)i) * sinf((float)i);
+			});
+		}
+		double seconds = secondsSince(start);
+		if (threads == 1)
+			singleThreadSeconds = seconds;
+
+		printf("  %2d thread(s) : %.2f M empty jobs/s, fan-out/fan-in %.2f us, parallel for %.2f ms (x%.2f)\n",
+			threads, throughput / 1e6, latency * 1e6, seconds * 100.0, singleThreadSeconds / seconds);
+
+		if (threads == maxThreads)
+			break;
+	}
+}
@@ -0,0 +1,61 @@
+#ifndef JOBSYSTEM_HPP
+#define JOBSYSTEM_HPP
+
+#include <atomic>
+
+// Work-stealing job system.
+// Every thread owns a Chase-Lev deque : it pushes and pops jobs at the bottom,
+// while idle threads steal from the top of the others. Jobs are plain function
+// pointers with a range, so scheduling one never allocates. A JobCounter counts
+// the unfinished jobs of a group ; wait() runs other jobs until it drops to 0,
+// so the waiting thread helps instead of blocking.
+// Jobs may be submitted by the thread that created the JobSystem, and by jobs.
+
+typedef void (*JobFunction)(void * data, int begin, int end);
+
+struct JobCounter {
+	std::atomic<int> pending;
+	JobCounter() : pending(0) {}
+};
+
+struct JobSystemData;
+
+class JobSystem {
+public:
+	// threadCount includes the calling thread. 0 uses every core of the machine.
+	JobSystem(int threadCount = 0);
+	~JobSystem();
+
+	int getThreadCount() const;
+
+	// Schedules function(data, begin, end). counter may be NULL.
+	void run(JobFunction function, void * data, JobCounter * counter, int begin = 0, int end = 0);
+
+	// Runs jobs until every job of the counter is done
+	void wait(JobCounter * counter);
+
+	// Calls function on sub-ranges of [begin, end) of at most grain items, in parallel, and waits.
+	// Ranges are split in halves, so idle threads steal big chunks first.
+	void parallelFor(int begin, int end, int grain, JobFunction function, void * data);
+
+	template <typename F>
+	void parallelFor(int begin, int end, int grain, const F & f){
+		parallelFor(begin, end, grain, &callRange<F>, (void*)&f);
+	}
+
+	// Index of the calling thread in [0, getThreadCount()), 0 for the creating thread
+	int getThreadIndex() const;
+
+private:
+	template <typename F>
+	static void callRange(void * data, int begin, int end){
+		(*(const F *)data)(begin, end);
+	}
+
+	JobSystemData * d;
+};
+
+// Microbenchmarks : empty-job throughput, fan-out/fan-in latency, scaling from 1 to N threads
+void runJobSystemBenchmark();
+
+#endif
@@ -0,0 +1,101 @@
+#include <vector>
+#include <stdio.h>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "vboindexer.hpp"
+#include "mesh.hpp"
+#include "profiler.hpp"
+#include "glstats.hpp"
+
+// Typical size of the post-transform cache, for the statistics only
+static const int POST_TRANSFORM_CACHE_SIZE = 32;
+
+void createIndexedMesh(
+	std::vector<glm::vec3> & vertices,
+	std::vector<glm::vec2> & uvs,
+	std::vector<glm::vec3> & normals,
+	IndexedMesh & out_mesh
+){
+	PROFILE_FUNCTION();
+	std::vector<unsigned int> indices;
+	std::vector<glm::vec3> indexed_vertices;
+	std::vector<glm::vec2> indexed_uvs;
+	std::vector<glm::vec3> indexed_normals;
+	indexVBO(vertices, uvs, normals, indices, indexed_vertices, indexed_uvs, indexed_normals);
+
+	out_mesh.indexCount = (GLsizei)indices.size();
+	out_mesh.vertexCount = (GLsizei)indexed_vertices.size();
+
+	glGenVertexArrays(1, &out_mesh.vao);
+	glBindVertexArray(out_mesh.vao);
+
+	glGenBuffers(1, &out_mesh.vertexbuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, out_mesh.vertexbuffer);
+	glBufferData(GL_ARRAY_BUFFER, indexed_vertices.size() * sizeof(glm::vec3), indexed_vertices.empty() ? NULL : &indexed_vertices[0], GL_STATIC_DRAW);
+
+	// 1rst attribute buffer : vertices
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(
+		0,                  // attribute 0. No particular reason for 0, but must match the layout in the shader.
+		3,                  // size
+		GL_FLOAT,           // type
+		GL_FALSE,           // normalized?
+		0,                  // stride
+		(void*)0            // array buffer offset
+	);
+
+	// Element buffer, 16 bits indices whenever they fit
+	glGenBuffers(1, &out_mesh.elementbuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, out_mesh.elementbuffer);
+	if (indexed_vertices.size() <= 65536){
+		std::vector<unsigned short> shortIndices(indices.begin(), indices.end());
+		out_mesh.indexType = GL_UNSIGNED_SHORT;
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(unsigned short), shortIndices.empty() ? NULL : &shortIndices[0], GL_STATIC_DRAW);
+	}else{
+		out_mesh.indexType = GL_UNSIGNED_INT;
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+	}
+
+	glBindVertexArray(0);
+
+	int invocations = countVertexShaderInvocations(indices, POST_TRANSFORM_CACHE_SIZE);
+	printf("Indexed mesh : %d vertices -> %d unique, %d vertex shader invocations saved (%.0f%%)\n",
+		out_mesh.indexCount, out_mesh.vertexCount, out_mesh.indexCount - invocations,
+		out_mesh.indexCount ? 100.0 * (out_mesh.indexCount - invocations) / out_mesh.indexCount : 0.0);
+}
+
+void drawIndexedMesh(const IndexedMesh & mesh){
+	glBindVertexArray(mesh.vao);
+	glDrawElements(
+		GL_TRIANGLES,      // mode
+		mesh.indexCount,   // count
+		mesh.indexType,    // type
+		(void*)0           // element array buffer offset
+	);
+}
+
+void deleteIndexedMesh(IndexedMesh & mesh){
+	glDeleteBuffers(1, &mesh.vertexbuffer);
+	glDeleteBuffers(1, &mesh.elementbuffer);
+	glDeleteVertexArrays(1, &mesh.vao);
+}
+
+int countVertexShaderInvocations(const std::vector<unsigned int> & indices, int cacheSize){
+	std::vector<unsigned int> cache(cacheSize, 0xFFFFFFFFu);
+	int next = 0;
+	int invocations = 0;
+	for (size_t i=0; i<indices.size(); i++){
+		bool hit = false;
+		for (int c=0; c<cacheSize && !hit; c++)
+			hit = cache[c] == indices[i];
+		if (!hit){
+			invocations++;
+			cache[next] = indices[i];
+			next = (next + 1) % cacheSize;
+		}
+	}
+	return invocations;
+}
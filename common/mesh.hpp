@@ -0,0 +1,30 @@
+#ifndef MESH_HPP
+#define MESH_HPP
+
+// A mesh ready to be drawn with glDrawElements.
+// The VAO captures both the vertex buffer and the element buffer.
+struct IndexedMesh {
+	GLuint vao;
+	GLuint vertexbuffer;
+	GLuint elementbuffer;
+	GLsizei indexCount;
+	GLenum indexType;      // GL_UNSIGNED_SHORT, or GL_UNSIGNED_INT for big meshes
+	GLsizei vertexCount;   // Unique vertices after indexing
+};
+
+// Indexes the de-indexed arrays returned by loadOBJ with indexVBO, and uploads them
+void createIndexedMesh(
+	std::vector<glm::vec3> & vertices,
+	std::vector<glm::vec2> & uvs,
+	std::vector<glm::vec3> & normals,
+	IndexedMesh & out_mesh
+);
+
+void drawIndexedMesh(const IndexedMesh & mesh);
+
+void deleteIndexedMesh(IndexedMesh & mesh);
+
+// Vertex shader invocations with a FIFO post-transform cache of cacheSize entries
+int countVertexShaderInvocations(const std::vector<unsigned int> & indices, int cacheSize);
+
+#endif
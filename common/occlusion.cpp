@@ -0,0 +1,399 @@
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <float.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OCCLUSION_USE_SSE
+#endif
+
+#include "jobsystem.hpp"
+#include "occlusion.hpp"
+#include "profiler.hpp"
+
+// Tiles are the unit of work of the rasterizer jobs.
+// TILE_WIDTH must be a multiple of 4 : pixels are processed 4 at a time.
+static const int TILE_WIDTH = 32;
+static const int TILE_HEIGHT = 32;
+
+// Anything closer to the eye than this is considered to cross the near plane
+static const float MIN_W = 1e-5f;
+
+OcclusionBuffer::OcclusionBuffer(int width, int height, JobSystem * jobs){
+	this->width  = (width + 3) & ~3; // Rows must be a whole number of SIMD words
+	this->height = height;
+	tilesX = (this->width  + TILE_WIDTH  - 1) / TILE_WIDTH;
+	tilesY = (this->height + TILE_HEIGHT - 1) / TILE_HEIGHT;
+	bins.resize(tilesX * tilesY);
+
+	this->jobs = jobs;
+
+	// Allocate the whole pyramid once, down to a single texel
+	int w = this->width, h = this->height;
+	while (true){
+		Level level;
+		level.width = w;
+		level.height = h;
+		level.minDepth.resize(w*h, 1.0f);
+		level.maxDepth.resize(w*h, 1.0f);
+		levels.push_back(level);
+		if (w == 1 && h == 1)
+			break;
+		w = (w+1) / 2;
+		h = (h+1) / 2;
+	}
+}
+
+size_t OcclusionBuffer::getMemoryBytes() const {
+	size_t bytes = triangles.capacity() * sizeof(OcclusionTriangle);
+	for (size_t i=0; i<bins.size(); i++)
+		bytes += bins[i].capacity() * sizeof(int);
+	for (size_t l=0; l<levels.size(); l++)
+		bytes += (levels[l].minDepth.capacity() + levels[l].maxDepth.capacity()) * sizeof(float);
+	return bytes;
+}
+
+void OcclusionBuffer::clear(){
+	triangles.clear();
+	for (size_t i=0; i<bins.size(); i++)
+		bins[i].clear();
+}
+
+void OcclusionBuffer::addOccluder(const std::vector<glm::vec3> & vertices, const glm::mat4 & mvp){
+	for (size_t i=0; i+2<vertices.size(); i+=3){
+
+		// Project the 3 corners to pixels
+		float x[3], y[3], z[3];
+		bool crossesNearPlane = false;
+		for (int v=0; v<3; v++){
+			glm::vec4 clip = mvp * glm::vec4(vertices[i+v], 1.0f);
+			if (clip.w <= MIN_W){
+				crossesNearPlane = true;
+				break;
+			}
+			float invW = 1.0f / clip.w;
+			x[v] = (clip.x * invW * 0.5f + 0.5f) * width;
+			y[v] = (clip.y * invW * 0.5f + 0.5f) * height;
+			z[v] =  clip.z * invW * 0.5f + 0.5f;
+		}
+		// We don't clip : dropping an occluder is always safe, it just occludes less
+		if (crossesNearPlane)
+			continue;
+
+		OcclusionTriangle t;
+		t.minX = std::max(0,          (int)floorf(std::min(x[0], std::min(x[1], x[2]))));
+		t.minY = std::max(0,          (int)floorf(std::min(y[0], std::min(y[1], y[2]))));
+		t.maxX = std::min(width  - 1, (int)ceilf (std::max(x[0], std::max(x[1], x[2]))));
+		t.maxY = std::min(height - 1, (int)ceilf (std::max(y[0], std::max(y[1], y[2]))));
+		if (t.minX > t.maxX || t.minY > t.maxY)
+			continue; // Off-screen
+
+		// Edge i is the one opposite to vertex i
+		for (int e=0; e<3; e++){
+			int v1 = (e+1) % 3, v2 = (e+2) % 3;
+			t.a[e] = y[v1] - y[v2];
+			t.b[e] = x[v2] - x[v1];
+			t.c[e] = x[v1]*y[v2] - x[v2]*y[v1];
+		}
+		float area = t.a[0]*x[0] + t.b[0]*y[0] + t.c[0];
+		if (fabsf(area) < 1e-6f)
+			continue; // Degenerate, or seen edge-on
+		if (area < 0.0f){
+			// Occluders are double-sided : flip the edges so that inside is always positive
+			for (int e=0; e<3; e++){
+				t.a[e] = -t.a[e];
+				t.b[e] = -t.b[e];
+				t.c[e] = -t.c[e];
+			}
+			area = -area;
+		}
+
+		// Depth is affine in screen space, interpolate it with the barycentrics
+		float invArea = 1.0f / area;
+		t.za = (t.a[0]*z[0] + t.a[1]*z[1] + t.a[2]*z[2]) * invArea;
+		t.zb = (t.b[0]*z[0] + t.b[1]*z[1] + t.b[2]*z[2]) * invArea;
+		t.zc = (t.c[0]*z[0] + t.c[1]*z[1] + t.c[2]*z[2]) * invArea;
+
+		int index = (int)triangles.size();
+		triangles.push_back(t);
+
+		// Bin the triangle in every tile its bounding box touches
+		for (int ty = t.minY / TILE_HEIGHT; ty <= t.maxY / TILE_HEIGHT; ty++)
+			for (int tx = t.minX / TILE_WIDTH; tx <= t.maxX / TILE_WIDTH; tx++)
+				bins[ty*tilesX + tx].push_back(index);
+	}
+}
+
+void OcclusionBuffer::rasterizeTile(int tile){
+	PROFILE_SCOPE("OcclusionBuffer::rasterizeTile");
+	int tileX = (tile % tilesX) * TILE_WIDTH;
+	int tileY = (tile / tilesX) * TILE_HEIGHT;
+	int tileEndX = std::min(tileX + TILE_WIDTH,  width);
+	int tileEndY = std::min(tileY + TILE_HEIGHT, height);
+	float * depth = &levels[0].maxDepth[0];
+
+	// Clear this tile only : the other threads own the rest of the buffer
+	for (int y=tileY; y<tileEndY; y++)
+		std::fill(depth + y*width + tileX, depth + y*width + tileEndX, 1.0f);
+
+	const std::vector<int> & bin = bins[tile];
+	for (size_t i=0; i<bin.size(); i++){
+		const OcclusionTriangle & t = triangles[bin[i]];
+
+		// Clamp the bounding box to the tile, starting on a SIMD boundary
+		int startX = std::max(t.minX, tileX) & ~3;
+		int endX   = std::min(t.maxX + 1, tileEndX);
+		int startY = std::max(t.minY, tileY);
+		int endY   = std::min(t.maxY + 1, tileEndY);
+
+#ifdef OCCLUSION_USE_SSE
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+		const __m128 a0 = _mm_set1_ps(t.a[0]), a1 = _mm_set1_ps(t.a[1]), a2 = _mm_set1_ps(t.a[2]);
+		const __m128 za = _mm_set1_ps(t.za);
+		for (int y=startY; y<endY; y++){
+			float py = y + 0.5f;
+			// Row constants : everything but the x term
+			__m128 r0 = _mm_set1_ps(t.b[0]*py + t.c[0]);
+			__m128 r1 = _mm_set1_ps(t.b[1]*py + t.c[1]);
+			__m128 r2 = _mm_set1_ps(t.b[2]*py + t.c[2]);
+			__m128 rz = _mm_set1_ps(t.zb*py + t.zc);
+			float * row = depth + y*width;
+			for (int x=startX; x<endX; x+=4){
+				__m128 px = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+				__m128 e0 = _mm_add_ps(_mm_mul_ps(a0, px), r0);
+				__m128 e1 = _mm_add_ps(_mm_mul_ps(a1, px), r1);
+				__m128 e2 = _mm_add_ps(_mm_mul_ps(a2, px), r2);
+				__m128 inside = _mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_and_ps(_mm_cmpge_ps(e1, zero), _mm_cmpge_ps(e2, zero)));
+				if (_mm_movemask_ps(inside) == 0)
+					continue;
+				__m128 z = _mm_add_ps(_mm_mul_ps(za, px), rz);
+				__m128 current = _mm_loadu_ps(row + x);
+				__m128 nearest = _mm_min_ps(current, z);
+				_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+			}
+		}
+#else
+		for (int y=startY; y<endY; y++){
+			float py = y + 0.5f;
+			float * row = depth + y*width;
+			for (int x=startX; x<endX; x++){
+				float px = x + 0.5f;
+				if (t.a[0]*px + t.b[0]*py + t.c[0] < 0.0f) continue;
+				if (t.a[1]*px + t.b[1]*py + t.c[1] < 0.0f) continue;
+				if (t.a[2]*px + t.b[2]*py + t.c[2] < 0.0f) continue;
+				row[x] = std::min(row[x], t.za*px + t.zb*py + t.zc);
+			}
+		}
+#endif
+	}
+}
+
+void OcclusionBuffer::buildHierarchy(){
+	PROFILE_SCOPE("OcclusionBuffer::buildHierarchy");
+	levels[0].minDepth = levels[0].maxDepth;
+
+	for (size_t l=1; l<levels.size(); l++){
+		const Level & src = levels[l-1];
+		Level & dst = levels[l];
+		for (int y=0; y<dst.height; y++){
+			int y0 = 2*y, y1 = std::min(2*y+1, src.height-1);
+			for (int x=0; x<dst.width; x++){
+				int x0 = 2*x, x1 = std::min(2*x+1, src.width-1);
+				dst.minDepth[y*dst.width + x] = std::min(
+					std::min(src.minDepth[y0*src.width + x0], src.minDepth[y0*src.width + x1]),
+					std::min(src.minDepth[y1*src.width + x0], src.minDepth[y1*src.width + x1]));
+				dst.maxDepth[y*dst.width + x] = std::max(
+					std::max(src.maxDepth[y0*src.width + x0], src.maxDepth[y0*src.width + x1]),
+					std::max(src.maxDepth[y1*src.width + x0], src.maxDepth[y1*src.width + x1]));
+			}
+		}
+	}
+}
+
+void OcclusionBuffer::rasterize(){
+	PROFILE_SCOPE("OcclusionBuffer::rasterize");
+	int tileCount = tilesX * tilesY;
+	auto rasterizeTiles = [this](int begin, int end){
+		for (int tile=begin; tile<end; tile++)
+			rasterizeTile(tile);
+	};
+
+	// One tile per job : tiles differ a lot in cost, idle threads steal the rest
+	if (jobs)
+		jobs->parallelFor(0, tileCount, 1, rasterizeTiles);
+	else
+		rasterizeTiles(0, tileCount);
+
+	buildHierarchy();
+}
+
+// Tests the pixel rectangle [x0,x1]x[y0,y1] inside texel (tx,ty) of a level,
+// and refines on the level below when the texel alone can't decide.
+bool OcclusionBuffer::isRegionVisible(int level, int tx, int ty, int x0, int y0, int x1, int y1, float minZ, float maxZ) const {
+	const Level & L = levels[level];
+	int i = ty*L.width + tx;
+	if (minZ > L.maxDepth[i])
+		return false; // Behind everything in this texel
+	if (maxZ < L.minDepth[i] || level == 0)
+		return true;  // In front of everything in this texel
+
+	// Partially hidden : look at the (up to) 4 children that overlap the rectangle
+	int child = level - 1;
+	int cx0 = std::max(2*tx,   x0 >> child), cx1 = std::min(2*tx+1, x1 >> child);
+	int cy0 = std::max(2*ty,   y0 >> child), cy1 = std::min(2*ty+1, y1 >> child);
+	cx1 = std::min(cx1, levels[child].width - 1);
+	cy1 = std::min(cy1, levels[child].height - 1);
+	for (int cy=cy0; cy<=cy1; cy++)
+		for (int cx=cx0; cx<=cx1; cx++)
+			if (isRegionVisible(child, cx, cy, x0, y0, x1, y1, minZ, maxZ))
+				return true;
+	return false;
+}
+
+bool OcclusionBuffer::isVisible(const glm::vec3 & aabbMin, const glm::vec3 & aabbMax, const glm::mat4 & mvp) const {
+	float minX = FLT_MAX, minY = FLT_MAX, minZ = FLT_MAX;
+	float maxX = -FLT_MAX, maxY = -FLT_MAX, maxZ = -FLT_MAX;
+
+	// Screen-space bounds of the 8 corners
+	for (int i=0; i<8; i++){
+		glm::vec3 corner(
+			(i & 1) ? aabbMax.x : aabbMin.x,
+			(i & 2) ? aabbMax.y : aabbMin.y,
+			(i & 4) ? aabbMax.z : aabbMin.z
+		);
+		glm::vec4 clip = mvp * glm::vec4(corner, 1.0f);
+		if (clip.w <= MIN_W)
+			return true; // Crosses the near plane : too close to be worth testing
+		float invW = 1.0f / clip.w;
+		float x = (clip.x * invW * 0.5f + 0.5f) * width;
+		float y = (clip.y * invW * 0.5f + 0.5f) * height;
+		float z =  clip.z * invW * 0.5f + 0.5f;
+		minX = std::min(minX, x); maxX = std::max(maxX, x);
+		minY = std::min(minY, y); maxY = std::max(maxY, y);
+		minZ = std::min(minZ, z); maxZ = std::max(maxZ, z);
+	}
+
+	// Outside of the view frustum
+	if (maxX < 0.0f || maxY < 0.0f || minX >= width || minY >= height || minZ > 1.0f)
+		return false;
+
+	int x0 = std::max(0, (int)minX), x1 = std::min(width  - 1, (int)maxX);
+	int y0 = std::max(0, (int)minY), y1 = std::min(height - 1, (int)maxY);
+
+	// Start on the level where the rectangle covers at most 2x2 texels
+	int level = 0;
+	while (level+1 < (int)levels.size() && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1))
+		level++;
+
+	for (int ty = y0 >> level; ty <= (y1 >> level); ty++)
+		for (int tx = x0 >> level; tx <= (x1 >> level); tx++)
+			if (isRegionVisible(level, tx, ty, x0, y0, x1, y1, minZ, maxZ))
+				return true;
+	return false;
+}
+
+void computeAABB(const std::vector<glm::vec3> & vertices, glm::vec3 & aabbMin, glm::vec3 & aabbMax){
+	aabbMin = glm::vec3( FLT_MAX);
+	aabbMax = glm::vec3(-FLT_MAX);
+	for (size_t i=0; i<vertices.size(); i++){
+		aabbMin = glm::min(aabbMin, vertices[i]);
+		aabbMax = glm::max(aabbMax, vertices[i]);
+	}
+}
+
+glm::vec4 computeBoundingSphere(const std::vector<glm::vec3> & vertices){
+	glm::vec3 aabbMin, aabbMax;
+	computeAABB(vertices, aabbMin, aabbMax);
+	glm::vec3 center = (aabbMin + aabbMax) * 0.5f;
+	float radius = 0.0f;
+	for (size_t i=0; i<vertices.size(); i++)
+		radius = std::max(radius, glm::length(vertices[i] - center));
+	return glm::vec4(center, radius);
+}
+
+void makeBoxOccluder(const glm::vec3 & aabbMin, const glm::vec3 & aabbMax, std::vector<glm::vec3> & out_triangles){
+	// Corner i has bit 0 = x, bit 1 = y, bit 2 = z set to the max
+	static const int faces[6][4] = {
+		{0,2,6,4}, {1,5,7,3}, // -X, +X
+		{0,4,5,1}, {2,3,7,6}, // -Y, +Y
+		{0,1,3,2}, {4,6,7,5}  // -Z, +Z
+	};
+	glm::vec3 corners[8];
+	for (int i=0; i<8; i++)
+		corners[i] = glm::vec3((i & 1) ? aabbMax.x : aabbMin.x, (i & 2) ? aabbMax.y : aabbMin.y, (i & 4) ? aabbMax.z : aabbMin.z);
+	for (int f=0; f<6; f++){
+		out_triangles.push_back(corners[faces[f][0]]);
+		out_triangles.push_back(corners[faces[f][1]]);
+		out_triangles.push_back(corners[faces[f][2]]);
+		out_triangles.push_back(corners[faces[f][0]]);
+		out_triangles.push_back(corners[faces[f][2]]);
+		out_triangles.push_back(corners[faces[f][3]]);
+	}
+}
+
+static float randomFloat(float min, float max){
+	return min + (max - min) * (rand() / (float)RAND_MAX);
+}
+
+void runOcclusionBenchmark(){
+	srand(42); // Always the same scene
+
+	glm::mat4 mvp = glm::perspective(glm::radians(45.0f), 2.0f, 0.1f, 100.0f)
+	              * glm::lookAt(glm::vec3(0, 0, 10), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+
+	// A wall hiding the left half of the screen, plus a field of small random occluders
+	std::vector<glm::vec3> occluders;
+	makeBoxOccluder(glm::vec3(-20, -10, 0), glm::vec3(0, 10, 0.5f), occluders);
+	for (int i=0; i<2000; i++){
+		glm::vec3 center(randomFloat(-10, 10), randomFloat(-5, 5), randomFloat(-20, 5));
+		for (int v=0; v<3; v++)
+			occluders.push_back(center + glm::vec3(randomFloat(-1, 1), randomFloat(-1, 1), randomFloat(-1, 1)));
+	}
+
+	// Occludees, mostly behind the wall
+	const int boxCount = 10000;
+	std::vector<glm::vec3> boxMin(boxCount), boxMax(boxCount);
+	for (int i=0; i<boxCount; i++){
+		boxMin[i] = glm::vec3(randomFloat(-12, 12), randomFloat(-6, 6), randomFloat(-30, -1));
+		boxMax[i] = boxMin[i] + glm::vec3(randomFloat(0.1f, 1), randomFloat(0.1f, 1), randomFloat(0.1f, 1));
+	}
+
+	printf("Occlusion benchmark : 256x128, %d occluder triangles, %d boxes\n", (int)occluders.size()/3, boxCount);
+
+	int maxThreads = std::max(1, (int)std::thread::hardware_concurrency());
+	for (int threads=1; ; threads = std::min(threads*2, maxThreads)){
+		JobSystem jobs(threads);
+		OcclusionBuffer buffer(256, 128, &jobs);
+		const int frames = 100;
+
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		for (int f=0; f<frames; f++){
+			buffer.clear();
+			buffer.addOccluder(occluders, mvp);
+			buffer.rasterize();
+		}
+		std::chrono::high_resolution_clock::time_point rasterized = std::chrono::high_resolution_clock::now();
+		int visible = 0;
+		for (int f=0; f<frames; f++)
+			for (int i=0; i<boxCount; i++)
+				visible += buffer.isVisible(boxMin[i], boxMax[i], mvp) ? 1 : 0;
+		std::chrono::high_resolution_clock::time_point queried = std::chrono::high_resolution_clock::now();
+
+		double rasterMs = std::chrono::duration<double, std::milli>(rasterized - start).count() / frames;
+		double queryNs  = std::chrono::duration<double, std::nano>(queried - rasterized).count() / (frames * boxCount);
+		printf("  %2d thread(s) : setup+raster %.3f ms/frame, query %.1f ns/box, %d/%d visible\n",
+			threads, rasterMs, queryNs, visible / frames, boxCount);
+
+		if (threads == maxThreads)
+			break;
+	}
+}
@@ -0,0 +1,76 @@
+#ifndef OCCLUSION_HPP
+#define OCCLUSION_HPP
+
+// Software occlusion culling.
+// A few big occluders are rasterized on the CPU into a small depth buffer,
+// and the bounding boxes of everything else are tested against a min/max
+// depth hierarchy built from it, so that hidden objects are never drawn.
+// Depth is stored like OpenGL does : 0 = near plane, 1 = far plane.
+
+// Screen-space triangle, ready to be rasterized
+struct OcclusionTriangle {
+	float a[3], b[3], c[3];     // Edge equations : a*x + b*y + c >= 0 inside
+	float za, zb, zc;           // Depth plane : z = za*x + zb*y + zc
+	int minX, minY, maxX, maxY; // Bounding box in pixels, inclusive
+};
+
+class JobSystem;
+
+class OcclusionBuffer {
+public:
+	// Tiles are rasterized as jobs of the given system, or on the calling thread if it is NULL
+	OcclusionBuffer(int width = 256, int height = 128, JobSystem * jobs = NULL);
+
+	// Forgets the occluders of the previous frame
+	void clear();
+
+	// Queues a triangle soup (3 vertices per triangle, as returned by loadOBJ)
+	void addOccluder(const std::vector<glm::vec3> & triangles, const glm::mat4 & mvp);
+
+	// Rasterizes every queued occluder, one tile per job, then builds the hierarchy
+	void rasterize();
+
+	// Conservative test : false only if the box is completely hidden or off-screen
+	bool isVisible(const glm::vec3 & aabbMin, const glm::vec3 & aabbMax, const glm::mat4 & mvp) const;
+
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+	int getTriangleCount() const { return (int)triangles.size(); }
+	size_t getMemoryBytes() const;
+
+	// Takes effect at the next rasterize()
+	void setJobSystem(JobSystem * jobs) { this->jobs = jobs; }
+	const float * getDepth() const { return &levels[0].maxDepth[0]; }
+
+private:
+	struct Level {
+		int width, height;
+		std::vector<float> minDepth; // Nearest occluder in the texel
+		std::vector<float> maxDepth; // Farthest occluder in the texel
+	};
+
+	void rasterizeTile(int tile);
+	void buildHierarchy();
+	bool isRegionVisible(int level, int tx, int ty, int x0, int y0, int x1, int y1, float minZ, float maxZ) const;
+
+	int width, height;
+	int tilesX, tilesY;
+	JobSystem * jobs;
+	std::vector<OcclusionTriangle> triangles;
+	std::vector< std::vector<int> > bins; // Triangles touching each tile
+	std::vector<Level> levels;            // levels[0] is the full resolution depth buffer
+};
+
+// Bounding box of a vertex array
+void computeAABB(const std::vector<glm::vec3> & vertices, glm::vec3 & aabbMin, glm::vec3 & aabbMax);
+
+// Bounding sphere (center, radius) of a vertex array, around the center of its box
+glm::vec4 computeBoundingSphere(const std::vector<glm::vec3> & vertices);
+
+// The 12 triangles of a box, to be used as a cheap occluder proxy
+void makeBoxOccluder(const glm::vec3 & aabbMin, const glm::vec3 & aabbMax, std::vector<glm::vec3> & out_triangles);
+
+// Headless benchmark : rasterization and query cost from 1 to N threads
+void runOcclusionBenchmark();
+
+#endif
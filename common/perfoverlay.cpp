@@ -0,0 +1,308 @@
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <algorithm>
+#include <stdio.h>
+
+#include <GL/glew.h>
+#include <glfw3.h>
+#include <AntTweakBar.h>
+
+#include <glm/glm.hpp>
+
+#include "shader.hpp"
+#include "gpuprofiler.hpp"
+#include "benchmark.hpp"
+#include "perfoverlay.hpp"
+#include "glstats.hpp"
+
+// Frames in the graph, and its size in pixels
+static const int HISTORY_SIZE = 240;
+static const float GRAPH_WIDTH = 240.0f;
+static const float GRAPH_HEIGHT = 100.0f;
+static const float GRAPH_MAX_MS = 33.3f;  // Top of the graph
+
+// Room reserved for the variables the panel points to
+static const int MAX_MEMORY_CATEGORIES = 16;
+static const int MAX_GPU_SCOPES = 32;
+
+PerfOverlay::PerfOverlay() : visible(false) {
+	settings = NULL;
+	gpuProfiler = NULL;
+	width = height = 0;
+	initialized = false;
+	wheel = 0;
+	programID = vertexArrayID = vertexBuffer = 0;
+	scaleUniform = colorUniform = -1;
+	historyIndex = 0;
+	FrameStats none = {};
+	shown = none;
+	peakMemoryMB = 0.0f;
+	performanceBar = NULL;
+}
+
+PerfOverlay::~PerfOverlay(){
+}
+
+static void TW_CALL setAtomicBool(const void * value, void * clientData){
+	((std::atomic<bool> *)clientData)->store(*(const bool *)value);
+}
+static void TW_CALL getAtomicBool(void * value, void * clientData){
+	*(bool *)value = ((std::atomic<bool> *)clientData)->load();
+}
+static void TW_CALL setAtomicInt(const void * value, void * clientData){
+	((std::atomic<int> *)clientData)->store(*(const int *)value);
+}
+static void TW_CALL getAtomicInt(void * value, void * clientData){
+	*(int *)value = ((std::atomic<int> *)clientData)->load();
+}
+
+bool PerfOverlay::init(int width, int height, PerfSettings * settings, GpuProfiler * gpuProfiler){
+	this->width = width;
+	this->height = height;
+	this->settings = settings;
+	this->gpuProfiler = gpuProfiler;
+
+	programID = LoadShaders("OverlayVertexShader.vertexshader", "OverlayFragmentShader.fragmentshader");
+	if (programID == 0)
+		return false;
+	scaleUniform = glGetUniformLocation(programID, "Scale");
+	colorUniform = glGetUniformLocation(programID, "Color");
+
+	glGenVertexArrays(1, &vertexArrayID);
+	glBindVertexArray(vertexArrayID);
+	glGenBuffers(1, &vertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
+	glBindVertexArray(0);
+
+	cpuHistory.assign(HISTORY_SIZE, 0.0f);
+	gpuHistory.assign(HISTORY_SIZE, 0.0f);
+	memory.reserve(MAX_MEMORY_CATEGORIES);
+	gpuScopes.reserve(MAX_GPU_SCOPES);
+
+	if (!TwInit(TW_OPENGL_CORE, NULL)){
+		printf("AntTweakBar : %s\n", TwGetLastError());
+		return false;
+	}
+	TwWindowSize(width, height);
+
+	// Measures, refreshed twice per second so that they can be read
+	performanceBar = TwNewBar("Performance");
+	TwDefine(" Performance position='10 10' size='250 510' refresh=0.5 valueswidth=70 alpha=180 help='F1 : show or hide' ");
+	TwAddVarRO(performanceBar, "frame",      TW_TYPE_FLOAT, &shown.frameMs,      " label='frame ms' precision=2 group=CPU ");
+	TwAddVarRO(performanceBar, "simulation", TW_TYPE_FLOAT, &shown.simulationMs, " label='simulation ms' precision=3 group=CPU ");
+	TwAddVarRO(performanceBar, "transforms", TW_TYPE_FLOAT, &shown.transformsMs, " label='transforms ms' precision=3 group=CPU ");
+	TwAddVarRO(performanceBar, "occlusion",  TW_TYPE_FLOAT, &shown.occlusionMs,  " label='occlusion ms' precision=3 group=CPU ");
+	TwAddVarRO(performanceBar, "record",     TW_TYPE_FLOAT, &shown.recordMs,     " label='record ms' precision=3 group=CPU ");
+	TwAddVarRO(performanceBar, "physics",    TW_TYPE_FLOAT, &shown.physicsMs,    " label='physics step ms' precision=3 group=CPU ");
+	TwAddVarRO(performanceBar, "ghostsMs",   TW_TYPE_FLOAT, &shown.ghostsMs,     " label='ghosts ms' precision=3 group=CPU ");
+	TwAddVarRO(performanceBar, "draws",      TW_TYPE_INT32, &shown.drawCalls,     " label='draw calls' group=Scene ");
+	TwAddVarRO(performanceBar, "triangles",  TW_TYPE_INT32, &shown.triangles,     " group=Scene ");
+	TwAddVarRO(performanceBar, "culled",     TW_TYPE_INT32, &shown.culledObjects, " label='culled objects' group=Scene ");
+	TwAddVarRO(performanceBar, "contacts",   TW_TYPE_INT32, &shown.contacts,      " group=Scene ");
+	TwAddVarRO(performanceBar, "ghosts",     TW_TYPE_INT32, &shown.ghosts,        " group=Scene ");
+	TwAddVarRO(performanceBar, "peak",       TW_TYPE_FLOAT, &peakMemoryMB,        " label='process peak MB' precision=1 group=Memory ");
+
+	// Features to compare, applied from the next frame on
+	TwBar * tuningBar = TwNewBar("Tuning");
+	TwDefine(" Tuning position='10 530' size='250 110' valueswidth=70 alpha=180 ");
+	TwAddVarCB(tuningBar, "culling",  TW_TYPE_BOOLCPP, setAtomicBool, getAtomicBool, &settings->occlusionCulling,  " label='occlusion culling' key=c ");
+	TwAddVarCB(tuningBar, "parallel", TW_TYPE_BOOLCPP, setAtomicBool, getAtomicBool, &settings->parallelOcclusion, " label='parallel occlusion' key=p ");
+	TwAddVarCB(tuningBar, "cap",      TW_TYPE_INT32,   setAtomicInt,  getAtomicInt,  &settings->frameCap,          " label='frame cap' min=0 max=240 step=10 help='0 : none' ");
+	TwAddVarCB(tuningBar, "gpu",      TW_TYPE_BOOLCPP, setAtomicBool, getAtomicBool, &settings->gpuTimings,        " label='GPU timings' ");
+
+	lastMemoryUpdate = std::chrono::steady_clock::now() - std::chrono::seconds(1);
+	initialized = true;
+	return true;
+}
+
+void PerfOverlay::addMemoryCategory(const char * name, size_t bytes){
+	if (!initialized || (int)memory.size() >= MAX_MEMORY_CATEGORIES)
+		return;
+	Memory category = { name, bytes / (1024.0f * 1024.0f) };
+	memory.push_back(category);
+	char definition[128];
+	snprintf(definition, sizeof(definition), " label='%s MB' precision=2 group=Memory ", name);
+	TwAddVarRO(performanceBar, name, TW_TYPE_FLOAT, &memory.back().megabytes, definition);
+}
+
+static void TW_CALL getGpuScopeMs(void * value, void * clientData){
+	const GpuScopeVar * var = (const GpuScopeVar *)clientData;
+	*(float *)value = var->profiler->getScopeMs(var->scope);
+}
+
+void PerfOverlay::draw(const FrameStats & stats){
+	if (!initialized)
+		return;
+
+	cpuHistory[historyIndex] = stats.frameMs;
+	gpuHistory[historyIndex] = gpuProfiler ? gpuProfiler->getLastFrameMs() : 0.0f;
+	historyIndex = (historyIndex + 1) % HISTORY_SIZE;
+	if (gpuProfiler)
+		gpuProfiler->setEnabled(settings->gpuTimings);
+
+	{
+		std::lock_guard<std::mutex> lock(inputMutex);
+		replay.swap(input);
+	}
+	if (!visible){
+		replay.clear();
+		return;
+	}
+	for (size_t i=0; i<replay.size(); i++){
+		const InputEvent & event = replay[i];
+		switch (event.type){
+		case InputEvent::MOVE:   TwMouseMotion(event.a, event.b); break;
+		case InputEvent::BUTTON: TwMouseButton((TwMouseAction)event.a, (TwMouseButtonID)event.b); break;
+		case InputEvent::WHEEL:  TwMouseWheel(event.a); break;
+		case InputEvent::KEY:    TwKeyPressed(event.a, event.b); break;
+		}
+	}
+	replay.clear();
+
+	shown = stats;
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (now - lastMemoryUpdate >= std::chrono::seconds(1)){
+		peakMemoryMB = getPeakMemoryKB() / 1024.0f;
+		lastMemoryUpdate = now;
+	}
+
+	// GPU scopes appear once they have been timed
+	while (gpuProfiler && (int)gpuScopes.size() < std::min(gpuProfiler->getScopeCount(), MAX_GPU_SCOPES)){
+		GpuScopeVar var = { gpuProfiler, (int)gpuScopes.size() };
+		gpuScopes.push_back(var);
+		char name[32], definition[128];
+		snprintf(name, sizeof(name), "gpu%d", var.scope);
+		snprintf(definition, sizeof(definition), " label='%s ms' precision=3 group=GPU ", gpuProfiler->getScopeName(var.scope));
+		TwAddVarCB(performanceBar, name, TW_TYPE_FLOAT, NULL, getGpuScopeMs, &gpuScopes.back(), definition);
+	}
+
+	drawGraph();
+	TwDraw();
+}
+
+void PerfOverlay::drawGraph(){
+	float x0 = width - GRAPH_WIDTH - 10.0f, y0 = 10.0f;
+	float x1 = x0 + GRAPH_WIDTH, y1 = y0 + GRAPH_HEIGHT;
+	float pixelsPerMs = GRAPH_HEIGHT / GRAPH_MAX_MS;
+	float budget = y0 + 1000.0f / 60.0f * pixelsPerMs;
+
+	vertices.clear();
+	float background[] = { x0,y0, x1,y0, x1,y1, x0,y0, x1,y1, x0,y1 };
+	vertices.insert(vertices.end(), background, background + 12);
+	float budgetLine[] = { x0,budget, x1,budget };
+	vertices.insert(vertices.end(), budgetLine, budgetLine + 4);
+	const std::vector<float> * histories[2] = { &cpuHistory, &gpuHistory };
+	for (int h=0; h<2; h++){
+		for (int i=0; i<HISTORY_SIZE; i++){
+			float ms = (*histories[h])[(historyIndex + i) % HISTORY_SIZE]; // Oldest first
+			vertices.push_back(x0 + i * GRAPH_WIDTH / (HISTORY_SIZE - 1));
+			vertices.push_back(y0 + std::min(ms, GRAPH_MAX_MS) * pixelsPerMs);
+		}
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), &vertices[0], GL_STREAM_DRAW);
+	glUseProgram(programID);
+	glUniform2f(scaleUniform, 2.0f / width, 2.0f / height);
+	glBindVertexArray(vertexArrayID);
+	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	glUniform4f(colorUniform, 0.0f, 0.0f, 0.0f, 0.6f);
+	glDrawArrays(GL_TRIANGLES, 0, 6);
+	glUniform4f(colorUniform, 0.6f, 0.6f, 0.6f, 1.0f);
+	glDrawArrays(GL_LINES, 6, 2);
+	glUniform4f(colorUniform, 0.2f, 1.0f, 0.2f, 1.0f);
+	glDrawArrays(GL_LINE_STRIP, 8, HISTORY_SIZE);
+	glUniform4f(colorUniform, 1.0f, 0.3f, 0.2f, 1.0f);
+	glDrawArrays(GL_LINE_STRIP, 8 + HISTORY_SIZE, HISTORY_SIZE);
+
+	glDisable(GL_BLEND);
+	glBindVertexArray(0);
+	glUseProgram(0);
+}
+
+void PerfOverlay::cleanup(){
+	if (!initialized)
+		return;
+	TwTerminate();
+	glDeleteBuffers(1, &vertexBuffer);
+	glDeleteVertexArrays(1, &vertexArrayID);
+	glDeleteProgram(programID);
+	initialized = false;
+}
+
+void PerfOverlay::queue(InputEvent::Type type, int a, int b){
+	InputEvent event = { type, a, b };
+	std::lock_guard<std::mutex> lock(inputMutex);
+	input.push_back(event);
+}
+
+void PerfOverlay::attachInput(GLFWwindow * window){
+	glfwSetWindowUserPointer(window, this);
+	glfwSetCursorPosCallback(window, onCursorPos);
+	glfwSetMouseButtonCallback(window, onMouseButton);
+	glfwSetScrollCallback(window, onScroll);
+	glfwSetKeyCallback(window, onKey);
+	glfwSetCharCallback(window, onChar);
+	if (visible)
+		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+}
+
+void PerfOverlay::onCursorPos(GLFWwindow * window, double x, double y){
+	PerfOverlay * overlay = (PerfOverlay *)glfwGetWindowUserPointer(window);
+	overlay->queue(InputEvent::MOVE, (int)x, (int)y);
+}
+
+void PerfOverlay::onMouseButton(GLFWwindow * window, int button, int action, int){
+	PerfOverlay * overlay = (PerfOverlay *)glfwGetWindowUserPointer(window);
+	TwMouseButtonID id = button == GLFW_MOUSE_BUTTON_RIGHT ? TW_MOUSE_RIGHT : button == GLFW_MOUSE_BUTTON_MIDDLE ? TW_MOUSE_MIDDLE : TW_MOUSE_LEFT;
+	overlay->queue(InputEvent::BUTTON, action == GLFW_PRESS ? TW_MOUSE_PRESSED : TW_MOUSE_RELEASED, id);
+}
+
+void PerfOverlay::onScroll(GLFWwindow * window, double, double y){
+	PerfOverlay * overlay = (PerfOverlay *)glfwGetWindowUserPointer(window);
+	overlay->wheel += (int)y; // AntTweakBar wants the absolute position
+	overlay->queue(InputEvent::WHEEL, overlay->wheel, 0);
+}
+
+void PerfOverlay::onKey(GLFWwindow * window, int key, int, int action, int mods){
+	PerfOverlay * overlay = (PerfOverlay *)glfwGetWindowUserPointer(window);
+	if (action == GLFW_RELEASE)
+		return;
+	if (key == GLFW_KEY_F1 && action == GLFW_PRESS){
+		bool visible = !overlay->visible;
+		overlay->visible = visible;
+		glfwSetInputMode(window, GLFW_CURSOR, visible ? GLFW_CURSOR_NORMAL : GLFW_CURSOR_DISABLED);
+		return;
+	}
+
+	// Printable keys come through onChar
+	int twKey = 0;
+	switch (key){
+	case GLFW_KEY_ENTER:     twKey = TW_KEY_RETURN; break;
+	case GLFW_KEY_BACKSPACE: twKey = TW_KEY_BACKSPACE; break;
+	case GLFW_KEY_DELETE:    twKey = TW_KEY_DELETE; break;
+	case GLFW_KEY_TAB:       twKey = TW_KEY_TAB; break;
+	case GLFW_KEY_LEFT:      twKey = TW_KEY_LEFT; break;
+	case GLFW_KEY_RIGHT:     twKey = TW_KEY_RIGHT; break;
+	case GLFW_KEY_UP:        twKey = TW_KEY_UP; break;
+	case GLFW_KEY_DOWN:      twKey = TW_KEY_DOWN; break;
+	case GLFW_KEY_HOME:      twKey = TW_KEY_HOME; break;
+	case GLFW_KEY_END:       twKey = TW_KEY_END; break;
+	default: return;
+	}
+	int modifiers = ((mods & GLFW_MOD_SHIFT) ? TW_KMOD_SHIFT : 0) | ((mods & GLFW_MOD_CONTROL) ? TW_KMOD_CTRL : 0) | ((mods & GLFW_MOD_ALT) ? TW_KMOD_ALT : 0);
+	overlay->queue(InputEvent::KEY, twKey, modifiers);
+}
+
+void PerfOverlay::onChar(GLFWwindow * window, unsigned int codepoint){
+	PerfOverlay * overlay = (PerfOverlay *)glfwGetWindowUserPointer(window);
+	if (codepoint < 128)
+		overlay->queue(InputEvent::KEY, (int)codepoint, 0);
+}
@@ -0,0 +1,128 @@
+#ifndef PERFOVERLAY_HPP
+#define PERFOVERLAY_HPP
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <mutex>
+
+// In-game performance overlay.
+// A graph of the last frame times (CPU in green, GPU in red, 16.7 ms line in
+// grey), and an AntTweakBar panel with the per-subsystem timings, draw calls,
+// triangles, culled objects and memory by category. A second panel toggles
+// performance features at runtime, to compare them on the target machine
+// without rebuilding. F1 shows and hides everything.
+// The measures of a frame travel with its command list. The overlay is drawn,
+// and AntTweakBar used, on the render thread only : input is queued by the
+// GLFW callbacks on the main thread, and replayed before drawing.
+
+// Features the tuning panel switches. Written on the render thread, read by the game loop.
+struct PerfSettings {
+	std::atomic<bool> occlusionCulling;
+	std::atomic<bool> parallelOcclusion; // Occluders rasterized by the job system
+	std::atomic<int> frameCap;           // Frames per second, 0 for none
+	std::atomic<bool> gpuTimings;
+
+	PerfSettings() : occlusionCulling(true), parallelOcclusion(true), frameCap(60), gpuTimings(true) {}
+};
+
+// Measures of one frame, taken by the game loop
+struct FrameStats {
+	float frameMs;      // Previous frame, beginning to beginning
+	float simulationMs;
+	float transformsMs;
+	float occlusionMs;
+	float recordMs;
+	float physicsMs;    // Physics step, on its own thread
+	float ghostsMs;     // Ghost racers moved, culled and sorted
+	int drawCalls;
+	int triangles;
+	int culledObjects;
+	int contacts;       // Contact points of the physics step
+	int ghosts;         // Ghost racers drawn
+};
+
+// Milliseconds since start, for the per-subsystem timings
+inline float millisecondsSince(std::chrono::steady_clock::time_point start){
+	return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+class GpuProfiler;
+struct GLFWwindow;
+typedef struct CTwBar TwBar;
+
+// A GPU timing line of the panel
+struct GpuScopeVar {
+	const GpuProfiler * profiler;
+	int scope;
+};
+
+class PerfOverlay {
+public:
+	PerfOverlay();
+	~PerfOverlay();
+
+	// Loads the shaders and creates the panels. Needs a current context.
+	bool init(int width, int height, PerfSettings * settings, GpuProfiler * gpuProfiler);
+
+	// Memory shown under "Memory", in bytes. Call after init(), before the render thread starts.
+	void addMemoryCategory(const char * name, size_t bytes);
+
+	// Installs the mouse and keyboard callbacks of the window. Main thread.
+	void attachInput(GLFWwindow * window);
+
+	// Main thread
+	void setVisible(bool visible) { this->visible = visible; }
+	bool isVisible() const { return visible; }
+
+	// Render thread, last thing before swapping buffers
+	void draw(const FrameStats & stats);
+
+	// Render thread, with the context current
+	void cleanup();
+
+private:
+	struct InputEvent {
+		enum Type { MOVE, BUTTON, WHEEL, KEY } type;
+		int a, b;
+	};
+	struct Memory {
+		const char * name;
+		float megabytes;
+	};
+
+	static void onCursorPos(GLFWwindow * window, double x, double y);
+	static void onMouseButton(GLFWwindow * window, int button, int action, int mods);
+	static void onScroll(GLFWwindow * window, double x, double y);
+	static void onKey(GLFWwindow * window, int key, int scancode, int action, int mods);
+	static void onChar(GLFWwindow * window, unsigned int codepoint);
+	void queue(InputEvent::Type type, int a, int b);
+
+	void drawGraph();
+
+	PerfSettings * settings;
+	GpuProfiler * gpuProfiler;
+	int width, height;
+	std::atomic<bool> visible;
+	bool initialized;
+
+	// Input, from the main thread to the render thread
+	std::mutex inputMutex;
+	std::vector<InputEvent> input, replay;
+	int wheel;
+
+	// Render thread only
+	GLuint programID, vertexArrayID, vertexBuffer;
+	GLint scaleUniform, colorUniform;
+	std::vector<float> cpuHistory, gpuHistory; // Milliseconds, a ring
+	int historyIndex;
+	std::vector<float> vertices;
+	FrameStats shown;                    // What the panel points to
+	float peakMemoryMB;
+	std::vector<Memory> memory;          // Never reallocated : the panel points into it
+	std::vector<GpuScopeVar> gpuScopes;  // Same
+	TwBar * performanceBar;
+	std::chrono::steady_clock::time_point lastMemoryUpdate;
+};
+
+#endif
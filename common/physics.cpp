@@ -0,0 +1,558 @@
+#include <vector>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <btBulletDynamicsCommon.h>
+#ifdef ENABLE_BULLET_MULTITHREADED
+#include <BulletMultiThreaded/PlatformDefinitions.h>
+#ifdef _WIN32
+#include <BulletMultiThreaded/Win32ThreadSupport.h>
+#else
+#include <BulletMultiThreaded/PosixThreadSupport.h>
+#endif
+#include <BulletMultiThreaded/SpuNarrowPhaseCollisionTask/SpuGatheringCollisionTask.h>
+#include <BulletMultiThreaded/SpuGatheringCollisionDispatcher.h>
+#endif
+
+#include "objloader.hpp"
+#include "collision.hpp"
+#include "physics.hpp"
+#include "profiler.hpp"
+
+static btVector3 toBullet(const glm::vec3 & v){
+	return btVector3(v.x, v.y, v.z);
+}
+
+PhysicsWorld::PhysicsWorld(const PhysicsConfig & config){
+	btDefaultCollisionConstructionInfo constructionInfo;
+	constructionInfo.m_defaultMaxPersistentManifoldPoolSize = config.maxManifolds;
+	constructionInfo.m_defaultMaxCollisionAlgorithmPoolSize = config.maxManifolds;
+	collisionConfiguration = new btDefaultCollisionConfiguration(constructionInfo);
+
+	threadSupport = NULL;
+	if (config.collisionThreads > 0){
+#ifdef ENABLE_BULLET_MULTITHREADED
+		// The pairs are gathered on the physics thread, and their contacts found by the workers
+#ifdef _WIN32
+		Win32ThreadSupport::Win32ThreadConstructionInfo info("collision", processCollisionTask, createCollisionLocalStoreMemory, config.collisionThreads);
+		threadSupport = new Win32ThreadSupport(info);
+#else
+		PosixThreadSupport::ThreadConstructionInfo info("collision", processCollisionTask, createCollisionLocalStoreMemory, config.collisionThreads);
+		threadSupport = new PosixThreadSupport(info);
+#endif
+		dispatcher = new SpuGatheringCollisionDispatcher(threadSupport, config.collisionThreads, collisionConfiguration);
+#else
+		printf("Built without ENABLE_BULLET_MULTITHREADED : contacts are found on the physics thread\n");
+#endif
+	}
+	if (threadSupport == NULL)
+		dispatcher = new btCollisionDispatcher(collisionConfiguration);
+	broadphase = new btDbvtBroadphase();
+	solver = new btSequentialImpulseConstraintSolver();
+	world = new btDiscreteDynamicsWorld(dispatcher, broadphase, solver, collisionConfiguration);
+	world->setGravity(btVector3(0.0f, -9.81f, 0.0f));
+
+	stepDuration = 1.0 / 60.0;
+	threaded = config.threaded;
+	current = 0;
+	readable = 0;
+	stepRequested = false;
+	quit = false;
+	stepSum = 0.0;
+	waitSum = 0.0;
+	contactSum = 0;
+	manifoldSum = 0;
+	stepCount = 0;
+	stats = PhysicsStats();
+	newStats = false;
+	for (int i=0; i<2; i++){
+		buffers[i].stepMs = 0.0f;
+		buffers[i].contacts = 0;
+		buffers[i].manifolds = 0;
+	}
+}
+
+PhysicsWorld::~PhysicsWorld(){
+	if (thread.joinable())
+		stop();
+	for (size_t i=0; i<bodies.size(); i++){
+		world->removeRigidBody(bodies[i]);
+		delete bodies[i]->getMotionState();
+		delete bodies[i];
+	}
+	for (size_t i=0; i<shapes.size(); i++)
+		delete shapes[i];
+	for (size_t i=0; i<triangleMeshes.size(); i++)
+		delete triangleMeshes[i];
+	for (size_t i=0; i<cookedData.size(); i++)
+		delete cookedData[i];
+	delete world;
+	delete solver;
+	delete broadphase;
+	delete dispatcher;
+#ifdef ENABLE_BULLET_MULTITHREADED
+	delete threadSupport;
+#endif
+	delete collisionConfiguration;
+}
+
+int PhysicsWorld::addShape(btCollisionShape * shape){
+	shapes.push_back(shape);
+	return (int)shapes.size() - 1;
+}
+
+int PhysicsWorld::addBody(int shape, float mass, const glm::vec3 & position, const glm::quat & rotation){
+	btCollisionShape * collisionShape = shapes[shape];
+	btVector3 inertia(0.0f, 0.0f, 0.0f);
+	if (mass > 0.0f)
+		collisionShape->calculateLocalInertia(mass, inertia);
+	btTransform transform(btQuaternion(rotation.x, rotation.y, rotation.z, rotation.w), toBullet(position));
+	btDefaultMotionState * motionState = new btDefaultMotionState(transform);
+	btRigidBody::btRigidBodyConstructionInfo info(mass, motionState, collisionShape, inertia);
+	info.m_friction = 0.5f;
+	info.m_restitution = 0.3f;
+	info.m_rollingFriction = 0.001f;
+	btRigidBody * body = new btRigidBody(info);
+	if (mass > 0.0f){
+		// Small and fast objects would go through the floor between two steps : their motion is swept
+		btVector3 center;
+		btScalar radius;
+		collisionShape->getBoundingSphere(center, radius);
+		body->setCcdMotionThreshold(0.5f * radius);
+		body->setCcdSweptSphereRadius(0.5f * radius);
+	}
+	world->addRigidBody(body);
+
+	bodies.push_back(body);
+	return (int)bodies.size() - 1;
+}
+
+int PhysicsWorld::createHullShape(const std::vector<glm::vec3> & vertices, glm::vec3 & center, int maxVertices){
+	std::vector<glm::vec3> hull;
+	if (!simplifyHull(vertices, hull, maxVertices))
+		hull = vertices;
+	glm::vec3 minimum(hull[0]), maximum(hull[0]);
+	for (size_t i=1; i<hull.size(); i++){
+		minimum = glm::min(minimum, hull[i]);
+		maximum = glm::max(maximum, hull[i]);
+	}
+	center = 0.5f * (minimum + maximum);
+	for (size_t i=0; i<hull.size(); i++)
+		hull[i] -= center;
+
+	btConvexHullShape * shape = new btConvexHullShape(&hull[0].x, (int)hull.size(), sizeof(glm::vec3));
+	shape->setMargin(COLLISION_MARGIN);
+	return addShape(shape);
+}
+
+int PhysicsWorld::addGround(float height){
+	btStaticPlaneShape * shape = new btStaticPlaneShape(btVector3(0.0f, 1.0f, 0.0f), height);
+	shape->setMargin(COLLISION_MARGIN);
+	return addBody(addShape(shape), 0.0f, glm::vec3(0.0f));
+}
+
+CollisionData * PhysicsWorld::loadCooked(const char * path, int type, const std::vector<glm::vec3> & vertices){
+	unsigned int hash = hashVertices(vertices);
+	CollisionData * data = new CollisionData();
+	if (!data->load(path, (CollisionType)type, hash)){
+		printf("%s is missing or stale : cooking it now. playground --cook-collision does it ahead of time.\n", path);
+		bool cooked = type == COLLISION_MESH ? cookCollisionMesh(vertices, path) : cookCollisionHull(vertices, path);
+		if (!cooked || !data->load(path, (CollisionType)type, hash)){
+			delete data;
+			return NULL;
+		}
+	}
+	cookedData.push_back(data);
+	return data;
+}
+
+int PhysicsWorld::addStaticMesh(const std::vector<glm::vec3> & triangles, const char * cookedPath){
+	PROFILE_FUNCTION();
+	CollisionData * cooked = cookedPath ? loadCooked(cookedPath, COLLISION_MESH, triangles) : NULL;
+	btCollisionShape * cookedShape = cooked ? cooked->createShape() : NULL;
+	if (cookedShape)
+		return addBody(addShape(cookedShape), 0.0f, glm::vec3(0.0f));
+
+	btTriangleMesh * mesh = new btTriangleMesh();
+	for (size_t i=0; i+2<triangles.size(); i+=3)
+		mesh->addTriangle(toBullet(triangles[i]), toBullet(triangles[i+1]), toBullet(triangles[i+2]), true);
+	triangleMeshes.push_back(mesh);
+
+	// Builds the triangle tree the contacts are found with
+	btBvhTriangleMeshShape * shape = new btBvhTriangleMeshShape(mesh, true);
+	shape->setMargin(COLLISION_MARGIN);
+	return addBody(addShape(shape), 0.0f, glm::vec3(0.0f));
+}
+
+int PhysicsWorld::addStaticHull(const std::vector<glm::vec3> & vertices, const char * cookedPath){
+	CollisionData * cooked = cookedPath ? loadCooked(cookedPath, COLLISION_HULL, vertices) : NULL;
+	btCollisionShape * cookedShape = cooked ? cooked->createShape() : NULL;
+	if (cookedShape)
+		return addBody(addShape(cookedShape), 0.0f, glm::vec3(0.0f));
+
+	btConvexHullShape * shape = new btConvexHullShape(&vertices[0].x, (int)vertices.size(), sizeof(glm::vec3));
+	shape->setMargin(COLLISION_MARGIN);
+	return addBody(addShape(shape), 0.0f, glm::vec3(0.0f));
+}
+
+int PhysicsWorld::addSphere(const std::vector<glm::vec3> & vertices, float mass, glm::vec3 & center){
+	glm::vec3 minimum(vertices[0]), maximum(vertices[0]);
+	for (size_t i=1; i<vertices.size(); i++){
+		minimum = glm::min(minimum, vertices[i]);
+		maximum = glm::max(maximum, vertices[i]);
+	}
+	center = 0.5f * (minimum + maximum);
+	glm::vec3 extent = 0.5f * (maximum - minimum);
+	btSphereShape * shape = new btSphereShape(glm::max(extent.x, glm::max(extent.y, extent.z)));
+	int body = addBody(addShape(shape), mass, center);
+	bodies[body]->setActivationState(DISABLE_DEACTIVATION); // The ball is the game : it never sleeps
+	return body;
+}
+
+void PhysicsWorld::setLinearVelocity(int body, const glm::vec3 & velocity){
+	bodies[body]->setLinearVelocity(toBullet(velocity));
+}
+
+void PhysicsWorld::applyForce(int body, const glm::vec3 & force){
+	BodyForce bodyForce = { body, force };
+	forces.push_back(bodyForce);
+}
+
+void PhysicsWorld::start(double stepDuration){
+	this->stepDuration = stepDuration;
+
+	// Until the first step, both buffers hold the initial transforms
+	Buffer & initial = buffers[current];
+	initial.transforms.resize(bodies.size());
+	dynamicBodies.clear();
+	for (size_t i=0; i<bodies.size(); i++){
+		readBody(bodies[i], initial.transforms[i]);
+		if (!bodies[i]->isStaticObject())
+			dynamicBodies.push_back((int)i);
+	}
+	buffers[1 - current] = initial;
+
+	statsStart = std::chrono::steady_clock::now();
+	quit = false;
+	stepRequested = false;
+	if (threaded)
+		thread = std::thread(&PhysicsWorld::run, this);
+}
+
+void PhysicsWorld::step(){
+	std::chrono::steady_clock::time_point waitStart = std::chrono::steady_clock::now();
+	if (threaded){
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			if (stepRequested){
+				PROFILE_SCOPE("Physics wait");
+				stepped.wait(lock, [this]{ return !stepRequested; });
+			}
+
+			// The next step writes the other buffer
+			readable = current;
+			stepForces.swap(forces);
+			stepRequested = true;
+		}
+		wake.notify_one();
+	}else{
+		// The results of the previous step become readable, as above, and the next step runs right away
+		readable = current;
+		stepForces.swap(forces);
+		simulate(buffers[1 - current]);
+		current = 1 - current;
+	}
+	forces.clear();
+
+	const Buffer & buffer = buffers[readable];
+	waitSum += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - waitStart).count();
+	stepSum += buffer.stepMs;
+	contactSum += buffer.contacts;
+	manifoldSum += buffer.manifolds;
+	stepCount++;
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (now - statsStart >= std::chrono::seconds(1)){
+		stats.stepMs = (float)(stepSum / stepCount);
+		stats.waitMs = (float)(waitSum / stepCount);
+		stats.contacts = (float)contactSum / stepCount;
+		stats.manifolds = (float)manifoldSum / stepCount;
+		stepSum = waitSum = 0.0;
+		contactSum = manifoldSum = 0;
+		stepCount = 0;
+		statsStart = now;
+		newStats = true;
+	}
+}
+
+void PhysicsWorld::stop(){
+	if (!thread.joinable())
+		return;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		stepped.wait(lock, [this]{ return !stepRequested; });
+		quit = true;
+	}
+	wake.notify_one();
+	thread.join();
+}
+
+void PhysicsWorld::run(){
+	PROFILE_THREAD_NAME("physics");
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;){
+		wake.wait(lock, [this]{ return stepRequested || quit; });
+		if (quit)
+			return;
+
+		// The game loop reads buffers[current] meanwhile
+		Buffer & buffer = buffers[1 - current];
+		lock.unlock();
+		simulate(buffer);
+		lock.lock();
+
+		current = 1 - current;
+		stepRequested = false;
+		stepped.notify_one();
+	}
+}
+
+void PhysicsWorld::simulate(Buffer & buffer){
+	PROFILE_SCOPE("physics step");
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	// Bullet clears the forces after each step
+	for (size_t i=0; i<stepForces.size(); i++)
+		bodies[stepForces[i].body]->applyCentralForce(toBullet(stepForces[i].force));
+
+	// Exactly one step of the fixed duration : the game loop already keeps the time
+	world->stepSimulation((btScalar)stepDuration, 1, (btScalar)stepDuration);
+
+	buffer.transforms.resize(bodies.size());
+	for (size_t i=0; i<bodies.size(); i++){
+		if (bodies[i]->isStaticObject())
+			continue; // Still the initial transform, in both buffers
+		readBody(bodies[i], buffer.transforms[i]);
+	}
+
+	buffer.contacts = 0;
+	buffer.manifolds = 0;
+	int manifolds = dispatcher->getNumManifolds();
+	for (int i=0; i<manifolds; i++){
+		int contacts = dispatcher->getManifoldByIndexInternal(i)->getNumContacts();
+		if (contacts > 0){
+			buffer.manifolds++;
+			buffer.contacts += contacts;
+		}
+	}
+	buffer.stepMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void PhysicsWorld::readBody(const btRigidBody * body, BodyTransform & transform){
+	const btTransform & bodyTransform = body->getCenterOfMassTransform();
+	const btVector3 & origin = bodyTransform.getOrigin();
+	btQuaternion rotation = bodyTransform.getRotation();
+	const btVector3 & linear = body->getLinearVelocity();
+	const btVector3 & angular = body->getAngularVelocity();
+	transform.position = glm::vec3(origin.x(), origin.y(), origin.z());
+	transform.rotation = glm::quat(rotation.w(), rotation.x(), rotation.y(), rotation.z());
+	transform.linearVelocity = glm::vec3(linear.x(), linear.y(), linear.z());
+	transform.angularVelocity = glm::vec3(angular.x(), angular.y(), angular.z());
+	transform.activation = body->getActivationState();
+}
+
+void PhysicsWorld::getTransform(int body, glm::vec3 & position, glm::quat & rotation) const {
+	const BodyTransform & transform = buffers[readable].transforms[body];
+	position = transform.position;
+	rotation = transform.rotation;
+}
+
+// Every component of every body, one after the other : most of them change little
+// from a tick to the next, so their words only differ in their low bytes.
+void PhysicsWorld::saveState(uint32_t * words) const {
+	const std::vector<BodyTransform> & transforms = buffers[readable].transforms;
+	size_t count = dynamicBodies.size();
+	for (size_t i=0; i<count; i++){
+		const BodyTransform & transform = transforms[dynamicBodies[i]];
+		float components[STATE_COMPONENTS - 1] = {
+			transform.position.x, transform.position.y, transform.position.z,
+			transform.rotation.x, transform.rotation.y, transform.rotation.z, transform.rotation.w,
+			transform.linearVelocity.x, transform.linearVelocity.y, transform.linearVelocity.z,
+			transform.angularVelocity.x, transform.angularVelocity.y, transform.angularVelocity.z };
+		for (int c=0; c<STATE_COMPONENTS - 1; c++)
+			memcpy(&words[c * count + i], &components[c], sizeof(uint32_t));
+		words[(STATE_COMPONENTS - 1) * count + i] = (uint32_t)transform.activation;
+	}
+}
+
+void PhysicsWorld::restoreState(const uint32_t * words){
+	// Nothing steps the world meanwhile
+	if (threaded){
+		std::unique_lock<std::mutex> lock(mutex);
+		stepped.wait(lock, [this]{ return !stepRequested; });
+	}
+
+	size_t count = dynamicBodies.size();
+	for (size_t i=0; i<count; i++){
+		float components[STATE_COMPONENTS - 1];
+		for (int c=0; c<STATE_COMPONENTS - 1; c++)
+			memcpy(&components[c], &words[c * count + i], sizeof(uint32_t));
+		BodyTransform restored;
+		restored.position = glm::vec3(components[0], components[1], components[2]);
+		restored.rotation = glm::quat(components[6], components[3], components[4], components[5]);
+		restored.linearVelocity = glm::vec3(components[7], components[8], components[9]);
+		restored.angularVelocity = glm::vec3(components[10], components[11], components[12]);
+		restored.activation = (int)words[(STATE_COMPONENTS - 1) * count + i];
+		// Both buffers, as saved : the rotation went through a matrix in Bullet
+		buffers[0].transforms[dynamicBodies[i]] = restored;
+		buffers[1].transforms[dynamicBodies[i]] = restored;
+
+		btRigidBody * body = bodies[dynamicBodies[i]];
+		btTransform transform(btQuaternion(components[3], components[4], components[5], components[6]),
+		                      btVector3(components[0], components[1], components[2]));
+		btVector3 linear(components[7], components[8], components[9]);
+		btVector3 angular(components[10], components[11], components[12]);
+		body->setCenterOfMassTransform(transform);
+		body->setInterpolationWorldTransform(transform);
+		body->getMotionState()->setWorldTransform(transform);
+		body->setLinearVelocity(linear);
+		body->setAngularVelocity(angular);
+		body->setInterpolationLinearVelocity(linear);
+		body->setInterpolationAngularVelocity(angular);
+		body->clearForces();
+		body->forceActivationState(restored.activation);
+		body->setDeactivationTime(0.0f);
+		// Contacts of the future state would push the body around
+		world->getBroadphase()->getOverlappingPairCache()->cleanProxyFromPairs(body->getBroadphaseHandle(), dispatcher);
+		world->updateSingleAabb(body);
+	}
+
+	// The results of the saved step are readable again, and the step after it runs, as step() does
+	readable = current;
+	if (threaded){
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			stepForces.swap(forces);
+			stepRequested = true;
+		}
+		wake.notify_one();
+	}else{
+		stepForces.swap(forces);
+		simulate(buffers[1 - current]);
+		current = 1 - current;
+	}
+	forces.clear();
+}
+
+bool PhysicsWorld::hasNewStats(){
+	bool result = newStats;
+	newStats = false;
+	return result;
+}
+
+void PhysicsWorld::printStats() const {
+	printf("Physics : %.3f ms/step, %.3f ms waited, %.1f contacts in %.1f manifolds, %d bodies\n",
+		stats.stepMs, stats.waitMs, stats.contacts, stats.manifolds, (int)bodies.size());
+}
+
+// True if a triangle of the floor is under (x, z)
+static bool isOverFloor(const std::vector<glm::vec3> & floor, float x, float z){
+	for (size_t i=0; i+2<floor.size(); i+=3){
+		glm::vec2 a(floor[i].x, floor[i].z), b(floor[i+1].x, floor[i+1].z), c(floor[i+2].x, floor[i+2].z);
+		glm::vec2 p(x, z);
+		float d1 = (b.x-a.x)*(p.y-a.y) - (b.y-a.y)*(p.x-a.x);
+		float d2 = (c.x-b.x)*(p.y-b.y) - (c.y-b.y)*(p.x-b.x);
+		float d3 = (a.x-c.x)*(p.y-c.y) - (a.y-c.y)*(p.x-c.x);
+		if ((d1 >= 0 && d2 >= 0 && d3 >= 0) || (d1 <= 0 && d2 <= 0 && d3 <= 0))
+			return true;
+	}
+	return false;
+}
+
+// One run of the stress scene, milliseconds per step on average
+static double runPhysicsStress(const PhysicsConfig & config, const std::vector<glm::vec3> & floor,
+                               const std::vector<glm::vec3> & coin, const std::vector<glm::vec3> & spike,
+                               int bodyCount, int steps, int & contacts, int & lost){
+	PhysicsWorld physics(config);
+	physics.addStaticMesh(floor, getCollisionPath("GameFloor.obj").c_str());
+	// The floor is one sided and thin : what sinks through it lands here, and keeps colliding
+	const float groundHeight = -0.05f;
+	int firstBody = physics.addGround(groundHeight) + 1;
+	glm::vec3 coinCenter, spikeCenter;
+	int coinShape = physics.createHullShape(coin, coinCenter);
+	int spikeShape = physics.createHullShape(spike, spikeCenter);
+
+	// Layers of a grid over the track, coins and spikes alternating, each a little turned.
+	// Cells over the hole in the middle, or off the floor, are skipped.
+	const int columns = 20, rows = 20;
+	for (int i=0, cell=0; i<bodyCount; cell++){
+		int layer = cell / (columns * rows);
+		int column = cell % columns, row = (cell / columns) % rows;
+		glm::vec3 position(-0.3f + 2.8f * (column + 0.5f * (layer & 1)) / columns,
+		                   0.3f + 0.15f * layer,
+		                   -1.4f + 2.8f * (row + 0.5f * (layer & 1)) / rows);
+		if (!isOverFloor(floor, position.x, position.z))
+			continue;
+		glm::quat rotation = glm::angleAxis(0.37f * i, glm::normalize(glm::vec3(1.0f, 0.5f * (i % 3), 0.3f)));
+		bool isCoin = (i % 2) == 0;
+		physics.addBody(isCoin ? coinShape : spikeShape, isCoin ? 0.01f : 0.02f, position, rotation);
+		i++;
+	}
+
+	physics.start(1.0 / 60.0);
+	double sum = 0.0;
+	for (int s=0; s<steps; s++){
+		physics.step();
+		sum += physics.getLastStepMs();
+	}
+	physics.step(); // Hands over the last one
+	sum += physics.getLastStepMs();
+	contacts = physics.getLastContacts();
+	lost = 0;
+	for (int body=firstBody; body<physics.getBodyCount(); body++){
+		glm::vec3 position;
+		glm::quat rotation;
+		physics.getTransform(body, position, rotation);
+		if (position.y < 0.5f * groundHeight)
+			lost++;
+	}
+	physics.stop();
+	return sum / steps;
+}
+
+void runPhysicsBenchmark(int bodyCount){
+	std::vector<glm::vec3> floor, coin, spike;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec3> normals;
+	if (!loadOBJ("GameFloor.obj", floor, uvs, normals) || !loadOBJ("Coin1.obj", coin, uvs, normals) || !loadOBJ("Spike3.obj", spike, uvs, normals))
+		return;
+
+	const int steps = 300;
+	printf("Physics benchmark : %d coins and spikes falling on the floor, %d steps of 1/60 s\n", bodyCount, steps);
+
+	PhysicsConfig config;
+	config.maxManifolds = std::max(4096, 4 * bodyCount);
+	int contacts = 0, lost = 0;
+	double serialMs = runPhysicsStress(config, floor, coin, spike, bodyCount, steps, contacts, lost);
+	printf("  physics thread : %.3f ms/step, %d contacts at the end, %d bodies through the floor\n", serialMs, contacts, lost);
+
+#ifdef ENABLE_BULLET_MULTITHREADED
+	int maxThreads = std::max(1, (int)std::thread::hardware_concurrency());
+	for (int threads=1; ; threads = std::min(threads*2, maxThreads)){
+		config.collisionThreads = threads;
+		double ms = runPhysicsStress(config, floor, coin, spike, bodyCount, steps, contacts, lost);
+		printf("  %2d worker(s)   : %.3f ms/step, x%.2f, %d contacts at the end, %d bodies through the floor\n", threads, ms, serialMs / ms, contacts, lost);
+		if (threads == maxThreads)
+			break;
+	}
+#else
+	printf("  Built without ENABLE_BULLET_MULTITHREADED : no parallel narrowphase to compare with\n");
+#endif
+}
@@ -0,0 +1,181 @@
+#ifndef PHYSICS_HPP
+#define PHYSICS_HPP
+
+#include <vector>
+#include <stdint.h>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Rigid body physics, with Bullet.
+// The world steps on a thread of its own, by a fixed duration, once per game
+// tick : step() hands over the results of the previous step and starts the
+// next one, which then runs alongside the rest of the frame. The transforms
+// are written into one of two buffers while the game loop reads the other, so
+// nothing is locked but the hand over. Steps are only ever started by the
+// game loop, so a run simulates the same way at any frame rate or load.
+// With ENABLE_BULLET_MULTITHREADED (see CMakeLists.txt), the narrowphase of a
+// step can also be spread over workers of BulletMultiThreaded.
+// Without the thread, step() simulates in place, with the same hand over : a
+// world stepped either way goes through exactly the same states.
+
+class btDefaultCollisionConfiguration;
+class btCollisionDispatcher;
+class btDbvtBroadphase;
+class btSequentialImpulseConstraintSolver;
+class btDiscreteDynamicsWorld;
+class btCollisionShape;
+class btTriangleMesh;
+class btRigidBody;
+class CollisionData;
+class btThreadSupportInterface;
+
+struct PhysicsConfig {
+	int collisionThreads; // Narrowphase workers, 0 to find the contacts on the physics thread
+	int maxManifolds;     // Contact manifolds allocated up front, more are allocated one by one
+	bool threaded;        // Steps on the physics thread. Off for many worlds stepped side by side.
+
+	PhysicsConfig() : collisionThreads(0), maxManifolds(4096), threaded(true) {}
+};
+
+// Averages over the last second
+struct PhysicsStats {
+	float stepMs;
+	float waitMs;   // Spent by the game loop waiting for a step to end
+	float contacts; // Contact points per step
+	float manifolds;
+};
+
+class PhysicsWorld {
+public:
+	PhysicsWorld(const PhysicsConfig & config = PhysicsConfig());
+	~PhysicsWorld();
+
+	// Scene, before start(). Vertices are in world space, as loaded, three per triangle.
+	// Every function returns the index of the body.
+	// Static shapes load their tree or hull from cookedPath (see collision.hpp), and
+	// cook it first if the file is missing or stale. Without a path, they are built here.
+
+	// Static triangle mesh, for the floor
+	int addStaticMesh(const std::vector<glm::vec3> & triangles, const char * cookedPath = NULL);
+	// Static convex hull of the vertices
+	int addStaticHull(const std::vector<glm::vec3> & vertices, const char * cookedPath = NULL);
+	// Static plane, facing up, at height
+	int addGround(float height);
+	// Dynamic sphere around the vertices. Its transform places the center, returned
+	// in center, rather than the mesh : draw the mesh at -center relative to it.
+	int addSphere(const std::vector<glm::vec3> & vertices, float mass, glm::vec3 & center);
+
+	// Convex hull shape of at most maxVertices corners, around the center of the vertices,
+	// returned in center. Shapes can be shared by any number of bodies.
+	int createHullShape(const std::vector<glm::vec3> & vertices, glm::vec3 & center, int maxVertices = DEFAULT_HULL_VERTICES);
+	// Body of a shape, at position. mass = 0 for a static one.
+	int addBody(int shape, float mass, const glm::vec3 & position, const glm::quat & rotation = glm::quat());
+
+	void setLinearVelocity(int body, const glm::vec3 & velocity);
+	// Pushes the body through the whole next step, the one the next step() starts
+	void applyForce(int body, const glm::vec3 & force);
+
+	// Starts the physics thread, if threaded. Each step advances the world by stepDuration seconds.
+	void start(double stepDuration);
+
+	// Once per game tick : waits for the step started by the previous call, makes
+	// its results readable by getTransform(), and starts the next one.
+	void step();
+
+	// Waits for the last step and stops the physics thread
+	void stop();
+
+	// Transform of a body after the step handed over by the last step()
+	void getTransform(int body, glm::vec3 & position, glm::quat & rotation) const;
+	int getBodyCount() const { return (int)bodies.size(); }
+
+	// State of the moving bodies after the step handed over by the last step(), for snapshots
+	// (see snapshots.hpp) : one array per component, in 32-bit words. After start() only.
+	int getStateWords() const { return STATE_COMPONENTS * (int)dynamicBodies.size(); }
+	void saveState(uint32_t * words) const;
+	// Waits for the step in flight, puts the bodies back as saved, and starts the step after the
+	// saved one again, with the forces applied since the last step(). Contacts are found again from
+	// there, so the steps that follow are close to the original ones, not bit for bit the same.
+	void restoreState(const uint32_t * words);
+
+	// Measures of the step handed over by the last step()
+	float getLastStepMs() const { return buffers[readable].stepMs; }
+	int getLastContacts() const { return buffers[readable].contacts; }
+
+	// True once per second, when the statistics have just been updated
+	bool hasNewStats();
+	const PhysicsStats & getStats() const { return stats; }
+	void printStats() const;
+
+private:
+	struct BodyTransform {
+		glm::vec3 position;
+		glm::quat rotation;
+		glm::vec3 linearVelocity, angularVelocity; // For snapshots
+		int activation;
+	};
+	// Position, rotation, velocities and activation
+	static const int STATE_COMPONENTS = 14;
+	struct BodyForce {
+		int body;
+		glm::vec3 force;
+	};
+	// What one step publishes
+	struct Buffer {
+		std::vector<BodyTransform> transforms;
+		float stepMs;
+		int contacts;
+		int manifolds;
+	};
+
+	static void readBody(const btRigidBody * body, BodyTransform & transform);
+	int addShape(btCollisionShape * shape);
+	CollisionData * loadCooked(const char * path, int type, const std::vector<glm::vec3> & vertices);
+	void run();
+	void simulate(Buffer & buffer);
+
+	btDefaultCollisionConfiguration * collisionConfiguration;
+	btThreadSupportInterface * threadSupport; // NULL without collision workers
+	btCollisionDispatcher * dispatcher;
+	btDbvtBroadphase * broadphase;
+	btSequentialImpulseConstraintSolver * solver;
+	btDiscreteDynamicsWorld * world;
+	std::vector<btCollisionShape *> shapes;
+	std::vector<btTriangleMesh *> triangleMeshes;
+	std::vector<CollisionData *> cookedData; // The shapes point into it
+	std::vector<btRigidBody *> bodies;
+	std::vector<int> dynamicBodies; // Found by start()
+	double stepDuration;
+	bool threaded;
+
+	// Double buffer : the physics thread writes one while the game loop reads the other
+	Buffer buffers[2];
+	int readable; // Read by the game loop. Game loop only.
+
+	// Hand over. Guarded by mutex.
+	std::mutex mutex;
+	int current;  // Written by the last step
+	std::condition_variable wake;    // A step was requested, or quit
+	std::condition_variable stepped; // The step is over
+	bool stepRequested;
+	bool quit;
+	std::vector<BodyForce> stepForces; // Of the step requested
+	std::thread thread;
+
+	// Game loop only
+	std::vector<BodyForce> forces; // For the next step
+	double stepSum, waitSum;
+	long long contactSum, manifoldSum;
+	int stepCount;
+	std::chrono::steady_clock::time_point statsStart;
+	PhysicsStats stats;
+	bool newStats;
+};
+
+// Stress scene : bodyCount coins and spikes falling on the floor, stepped with
+// the narrowphase on the physics thread, then on 1 to N workers
+void runPhysicsBenchmark(int bodyCount);
+
+#endif
@@ -0,0 +1,190 @@
+#ifdef ENABLE_PROFILER
+
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+#include "profiler.hpp"
+
+// Events are stored in chunks that never move, so the exporter can read them while the owner appends
+static const int CHUNK_SIZE = 4096;
+static const int MAX_CHUNKS = 1024; // 4M events per thread, after which events are dropped
+
+struct ProfileEvent {
+	const char * name;
+	uint64_t begin, end;
+};
+
+struct ThreadBuffer {
+	int id;
+	char name[64];           // Guarded by registryMutex
+	std::atomic<int> count;  // Written by the owner thread only, with release
+	ProfileEvent * chunks[MAX_CHUNKS];
+	int dropped;
+	bool gpu;                // Events in GL nanoseconds rather than time stamps
+};
+
+std::atomic<bool> profilerRecording(false);
+
+// Only locked when a thread records for the first time, when it is named, and when exporting
+static std::mutex registryMutex;
+static std::vector<ThreadBuffer *> registry;
+
+// Time stamp counter and clock at profilerStart(), to convert counts into microseconds
+static uint64_t startTimestamp;
+static std::chrono::steady_clock::time_point startTime;
+
+static thread_local ThreadBuffer * threadBuffer = NULL;
+
+// GPU track, only used by the thread of the GL context
+static ThreadBuffer * gpuBuffer = NULL;
+// GL time matching gpuTimestamp. Guarded by registryMutex.
+static uint64_t gpuNanoseconds;
+static uint64_t gpuTimestamp;
+
+static ThreadBuffer * newThreadBuffer(bool gpu){
+	ThreadBuffer * buffer = new ThreadBuffer;
+	buffer->name[0] = 0;
+	buffer->count = 0;
+	buffer->dropped = 0;
+	buffer->gpu = gpu;
+	for (int i=0; i<MAX_CHUNKS; i++)
+		buffer->chunks[i] = NULL;
+	std::lock_guard<std::mutex> lock(registryMutex);
+	buffer->id = (int)registry.size();
+	registry.push_back(buffer);
+	return buffer;
+}
+
+static ThreadBuffer * getThreadBuffer(){
+	if (threadBuffer == NULL)
+		threadBuffer = newThreadBuffer(false);
+	return threadBuffer;
+}
+
+// Only the owner of the buffer appends to it
+static void append(ThreadBuffer * buffer, const char * name, uint64_t begin, uint64_t end){
+	int index = buffer->count.load(std::memory_order_relaxed);
+	int chunk = index / CHUNK_SIZE;
+	if (chunk >= MAX_CHUNKS){
+		buffer->dropped++;
+		return;
+	}
+	if (buffer->chunks[chunk] == NULL)
+		buffer->chunks[chunk] = new ProfileEvent[CHUNK_SIZE];
+
+	ProfileEvent & event = buffer->chunks[chunk][index % CHUNK_SIZE];
+	event.name = name;
+	event.begin = begin;
+	event.end = end;
+	buffer->count.store(index + 1, std::memory_order_release); // Publishes the event
+}
+
+void profilerRecord(const char * name, uint64_t begin, uint64_t end){
+	append(getThreadBuffer(), name, begin, end);
+}
+
+void profilerRecordGpu(const char * name, uint64_t beginNs, uint64_t endNs){
+	if (gpuBuffer == NULL){
+		ThreadBuffer * buffer = newThreadBuffer(true);
+		std::lock_guard<std::mutex> lock(registryMutex);
+		snprintf(buffer->name, sizeof(buffer->name), "GPU");
+		gpuBuffer = buffer;
+	}
+	append(gpuBuffer, name, beginNs, endNs);
+}
+
+void profilerCalibrateGpu(uint64_t gpuNs){
+	uint64_t timestamp = profilerTimestamp();
+	std::lock_guard<std::mutex> lock(registryMutex);
+	gpuNanoseconds = gpuNs;
+	gpuTimestamp = timestamp;
+}
+
+void profilerStart(){
+	startTimestamp = profilerTimestamp();
+	startTime = std::chrono::steady_clock::now();
+	profilerRecording = true;
+}
+
+void profilerStop(){
+	profilerRecording = false;
+}
+
+void profilerSetThreadName(const char * name){
+	ThreadBuffer * buffer = getThreadBuffer();
+	std::lock_guard<std::mutex> lock(registryMutex);
+	snprintf(buffer->name, sizeof(buffer->name), "%s", name);
+}
+
+// Writes a string literal as a JSON string
+static void writeString(FILE * file, const char * s){
+	fputc('"', file);
+	for (; *s; s++){
+		if (*s == '"' || *s == '\\')
+			fputc('\\', file);
+		fputc(*s, file);
+	}
+	fputc('"', file);
+}
+
+bool profilerWriteChromeTrace(const char * path){
+	// Counter ticks per microsecond, measured over the whole recording
+	uint64_t nowTimestamp = profilerTimestamp();
+	double elapsedUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - startTime).count();
+	double ticksPerUs = elapsedUs > 0.0 ? (double)(nowTimestamp - startTimestamp) / elapsedUs : 1.0;
+
+	FILE * file = fopen(path, "w");
+	if (file == NULL){
+		printf("Impossible to open %s\n", path);
+		return false;
+	}
+
+	// Threads that start recording meanwhile wait for their first event
+	std::lock_guard<std::mutex> lock(registryMutex);
+	const std::vector<ThreadBuffer *> & buffers = registry;
+
+	fprintf(file, "{\"traceEvents\":[\n");
+	bool first = true;
+	int eventCount = 0, dropped = 0;
+	for (size_t t=0; t<buffers.size(); t++){
+		ThreadBuffer * buffer = buffers[t];
+		if (buffer->name[0]){
+			fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", first ? "" : ",\n", buffer->id);
+			writeString(file, buffer->name);
+			fprintf(file, "}}");
+			first = false;
+		}
+
+		int count = buffer->count.load(std::memory_order_acquire);
+		for (int i=0; i<count; i++){
+			const ProfileEvent & event = buffer->chunks[i / CHUNK_SIZE][i % CHUNK_SIZE];
+			double ts, duration;
+			if (buffer->gpu){
+				// Relative to the last calibration : the clocks drift little over a trace
+				ts = ((double)event.begin - (double)gpuNanoseconds) / 1000.0 + ((double)gpuTimestamp - (double)startTimestamp) / ticksPerUs;
+				duration = (event.end - event.begin) / 1000.0;
+			}else{
+				ts = ((double)event.begin - (double)startTimestamp) / ticksPerUs;
+				duration = (event.end - event.begin) / ticksPerUs;
+			}
+			if (ts < 0.0)
+				continue; // From an earlier recording
+			fprintf(file, "%s{\"name\":", first ? "" : ",\n");
+			writeString(file, event.name);
+			fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", buffer->id, ts, duration);
+			first = false;
+		}
+		eventCount += count;
+		dropped += buffer->dropped;
+	}
+	fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+	fclose(file);
+
+	printf("Trace written to %s : %d events from %d threads, %d dropped\n", path, eventCount, (int)buffers.size(), dropped);
+	return true;
+}
+
+#endif
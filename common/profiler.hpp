@@ -0,0 +1,86 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+// CPU profiler.
+// PROFILE_SCOPE("name") times the rest of the enclosing block. Names must be
+// string literals : only their address is stored, the compiler interns them.
+// Every thread appends its events to a buffer of its own, so recording takes
+// no lock : two time stamp counter reads and a store. profilerWriteChromeTrace()
+// writes everything in the Trace Event format, that chrome://tracing and
+// https://ui.perfetto.dev open directly.
+// Nothing is recorded until profilerStart(). Building with ENABLE_PROFILER off
+// (see CMakeLists.txt) removes every marker from the code.
+
+#ifdef ENABLE_PROFILER
+
+#include <atomic>
+#include <stdint.h>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define PROFILER_USE_TSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROFILER_USE_TSC
+#else
+#include <chrono>
+#endif
+
+// Time stamp counter : a few cycles to read, converted to microseconds only when exporting
+inline uint64_t profilerTimestamp(){
+#ifdef PROFILER_USE_TSC
+	return __rdtsc();
+#else
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+extern std::atomic<bool> profilerRecording;
+
+void profilerRecord(const char * name, uint64_t begin, uint64_t end);
+
+class ProfileScope {
+public:
+	ProfileScope(const char * name) : name(name) {
+		begin = profilerRecording.load(std::memory_order_relaxed) ? profilerTimestamp() : 0;
+	}
+	~ProfileScope(){
+		if (begin)
+			profilerRecord(name, begin, profilerTimestamp());
+	}
+private:
+	const char * name;
+	uint64_t begin;
+};
+
+// Starts and stops recording, for every thread
+void profilerStart();
+void profilerStop();
+
+// Name of the calling thread in the trace. The name is copied.
+void profilerSetThreadName(const char * name);
+
+// GPU time line, in nanoseconds of the GL clock (see gpuprofiler.hpp).
+// Call both from the thread that owns the GL context.
+void profilerRecordGpu(const char * name, uint64_t beginNs, uint64_t endNs);
+// Pairs a GL time with the current time stamp, to place the GPU events on the CPU time line
+void profilerCalibrateGpu(uint64_t gpuNs);
+
+// Writes what was recorded so far. Safe while other threads record.
+bool profilerWriteChromeTrace(const char * path);
+
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__FUNCTION__)
+#define PROFILE_THREAD_NAME(name) profilerSetThreadName(name)
+
+#else
+
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_FUNCTION() ((void)0)
+#define PROFILE_THREAD_NAME(name) ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,218 @@
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+
+#include <GL/glew.h>
+
+#include <glfw3.h>
+
+#ifdef HAVE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include "rendercontext.hpp"
+#include "glstats.hpp"
+
+void WindowContext::makeCurrent(){
+	glfwMakeContextCurrent(window);
+}
+
+void WindowContext::releaseCurrent(){
+	glfwMakeContextCurrent(NULL);
+}
+
+void WindowContext::swapBuffers(){
+	glfwSwapBuffers(window);
+}
+
+#ifdef HAVE_EGL
+
+struct HeadlessContextData {
+	EGLDisplay display;
+	EGLContext context;
+	EGLSurface surface; // EGL_NO_SURFACE when surfaceless
+};
+
+// Extension strings are space separated : match whole words only
+static bool hasExtension(const char * extensions, const char * name){
+	if (extensions == NULL)
+		return false;
+	size_t length = strlen(name);
+	for (const char * p = strstr(extensions, name); p != NULL; p = strstr(p + length, name))
+		if ((p == extensions || p[-1] == ' ') && (p[length] == ' ' || p[length] == '\0'))
+			return true;
+	return false;
+}
+
+static EGLDisplay getHeadlessDisplay(){
+	// Mesa's surfaceless platform needs neither X11 nor a GPU
+	const char * clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	if (hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless")){
+		PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+			(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+		if (getPlatformDisplay){
+			EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+			if (display != EGL_NO_DISPLAY)
+				return display;
+		}
+	}
+	return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+HeadlessContext::HeadlessContext(){
+	d = new HeadlessContextData;
+	d->display = EGL_NO_DISPLAY;
+	d->context = EGL_NO_CONTEXT;
+	d->surface = EGL_NO_SURFACE;
+	width = height = 0;
+	framebuffer = colorbuffer = depthbuffer = 0;
+}
+
+HeadlessContext::~HeadlessContext(){
+	if (d->context != EGL_NO_CONTEXT){
+		makeCurrent();
+		glDeleteFramebuffers(1, &framebuffer);
+		glDeleteRenderbuffers(1, &colorbuffer);
+		glDeleteRenderbuffers(1, &depthbuffer);
+		releaseCurrent();
+		if (d->surface != EGL_NO_SURFACE)
+			eglDestroySurface(d->display, d->surface);
+		eglDestroyContext(d->display, d->context);
+	}
+	if (d->display != EGL_NO_DISPLAY)
+		eglTerminate(d->display);
+	delete d;
+}
+
+bool HeadlessContext::create(int width, int height){
+	this->width = width;
+	this->height = height;
+
+	d->display = getHeadlessDisplay();
+	EGLint major, minor;
+	if (d->display == EGL_NO_DISPLAY || !eglInitialize(d->display, &major, &minor)){
+		fprintf(stderr, "Failed to initialize EGL\n");
+		return false;
+	}
+	if (!eglBindAPI(EGL_OPENGL_API)){
+		fprintf(stderr, "EGL %d.%d can't create desktop OpenGL contexts\n", major, minor);
+		return false;
+	}
+
+	const char * extensions = eglQueryString(d->display, EGL_EXTENSIONS);
+	bool surfaceless = hasExtension(extensions, "EGL_KHR_surfaceless_context");
+
+	const EGLint configAttributes[] = {
+		EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8,
+		EGL_NONE
+	};
+	EGLConfig config = NULL;
+	EGLint configCount = 0;
+	eglChooseConfig(d->display, configAttributes, &config, 1, &configCount);
+	if (configCount == 0){
+		// The surfaceless platform may have no config at all : none is needed without a surface
+		if (!surfaceless || !hasExtension(extensions, "EGL_KHR_no_config_context")){
+			fprintf(stderr, "No suitable EGL config\n");
+			return false;
+		}
+		config = (EGLConfig)0; // EGL_NO_CONFIG_KHR
+	}
+
+	const EGLint contextAttributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION_KHR, 3,
+		EGL_CONTEXT_MINOR_VERSION_KHR, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+		EGL_NONE
+	};
+	d->context = eglCreateContext(d->display, config, EGL_NO_CONTEXT, contextAttributes);
+	if (d->context == EGL_NO_CONTEXT){
+		fprintf(stderr, "Failed to create an OpenGL 3.3 core context with EGL\n");
+		return false;
+	}
+
+	if (!surfaceless){
+		const EGLint surfaceAttributes[] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+		d->surface = eglCreatePbufferSurface(d->display, config, surfaceAttributes);
+		if (d->surface == EGL_NO_SURFACE){
+			fprintf(stderr, "Failed to create an EGL pbuffer\n");
+			return false;
+		}
+	}
+
+	makeCurrent();
+	printf("Headless context : EGL %d.%d, %s, %dx%d\n", major, minor, surfaceless ? "surfaceless" : "pbuffer", width, height);
+	return true;
+}
+
+void HeadlessContext::makeCurrent(){
+	eglMakeCurrent(d->display, d->surface, d->surface, d->context);
+}
+
+void HeadlessContext::releaseCurrent(){
+	eglMakeCurrent(d->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+}
+
+#else
+
+struct HeadlessContextData {};
+
+HeadlessContext::HeadlessContext(){
+	d = NULL;
+	width = height = 0;
+	framebuffer = colorbuffer = depthbuffer = 0;
+}
+
+HeadlessContext::~HeadlessContext(){
+}
+
+bool HeadlessContext::create(int, int){
+	fprintf(stderr, "Headless rendering needs EGL, which wasn't found when building\n");
+	return false;
+}
+
+void HeadlessContext::makeCurrent(){
+}
+
+void HeadlessContext::releaseCurrent(){
+}
+
+#endif
+
+bool HeadlessContext::createFramebuffer(){
+	glGenRenderbuffers(1, &colorbuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, colorbuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glGenRenderbuffers(1, &depthbuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthbuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorbuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthbuffer);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE){
+		fprintf(stderr, "Incomplete headless framebuffer\n");
+		return false;
+	}
+
+	// Stays bound : everything is drawn into it from now on
+	glViewport(0, 0, width, height);
+	return true;
+}
+
+void HeadlessContext::readPixels(std::vector<unsigned char> & pixels){
+	pixels.resize(width * height * 4);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+}
+
+void HeadlessContext::swapBuffers(){
+	// Nothing to show. Flush, so that the GPU works while the next frame is recorded.
+	glFlush();
+}
@@ -0,0 +1,68 @@
+#ifndef RENDERCONTEXT_HPP
+#define RENDERCONTEXT_HPP
+
+// What the render thread draws into : the GL context of a window, or an
+// offscreen one. Moving a context between threads and presenting a frame are
+// the only things the renderer needs to know about it.
+class RenderContext {
+public:
+	virtual ~RenderContext() {}
+
+	// A context is current on at most one thread at a time
+	virtual void makeCurrent() = 0;
+	virtual void releaseCurrent() = 0;
+
+	// Ends a frame
+	virtual void swapBuffers() = 0;
+};
+
+struct GLFWwindow;
+
+// Context of a GLFW window
+class WindowContext : public RenderContext {
+public:
+	WindowContext(GLFWwindow * window) : window(window) {}
+	virtual void makeCurrent();
+	virtual void releaseCurrent();
+	virtual void swapBuffers();
+
+private:
+	GLFWwindow * window;
+};
+
+struct HeadlessContextData;
+
+// GL 3.3 core context without any window or display, through EGL : surfaceless
+// when the driver allows it (Mesa llvmpipe does), a pbuffer otherwise. Frames are
+// drawn into a framebuffer object, so machines without a GPU can run the renderer.
+class HeadlessContext : public RenderContext {
+public:
+	HeadlessContext();
+	~HeadlessContext();
+
+	// Creates the context and makes it current. False if EGL is missing or fails.
+	bool create(int width, int height);
+
+	// Creates the framebuffer object frames are drawn into, and binds it.
+	// Needs the GL functions, so call it after glewInit().
+	bool createFramebuffer();
+
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+
+	// Reads the framebuffer back, RGBA, bottom row first. The context must be current.
+	void readPixels(std::vector<unsigned char> & pixels);
+
+	virtual void makeCurrent();
+	virtual void releaseCurrent();
+	virtual void swapBuffers();
+
+private:
+	HeadlessContextData * d;
+	int width, height;
+	GLuint framebuffer;
+	GLuint colorbuffer;
+	GLuint depthbuffer;
+};
+
+#endif
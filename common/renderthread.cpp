@@ -0,0 +1,118 @@
+#include <vector>
+#include <chrono>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "uniformstream.hpp"
+#include "perfoverlay.hpp"
+#include "ghosttracks.hpp"
+#include "ghosts.hpp"
+#include "rendercontext.hpp"
+#include "renderthread.hpp"
+#include "profiler.hpp"
+
+// Spins that often before sleeping when there is nothing to do
+static const int SPIN_COUNT = 64;
+
+// Yields for a while, then sleeps, so that waiting does not steal the core of the other thread
+static void backOff(int & spins){
+	if (++spins < SPIN_COUNT)
+		std::this_thread::yield();
+	else
+		std::this_thread::sleep_for(std::chrono::microseconds(100));
+}
+
+RenderThread::RenderThread() : submitted(0), rendered(0), quit(false) {
+	context = NULL;
+	render = NULL;
+	data = NULL;
+	threaded = false;
+	waitCount = 0;
+}
+
+RenderThread::~RenderThread(){
+	if (thread.joinable())
+		stop();
+}
+
+void RenderThread::start(RenderContext * context, RenderFunction render, void * data, int listCount, bool threaded){
+	this->context = context;
+	this->render = render;
+	this->data = data;
+	this->threaded = threaded;
+	lists.resize(listCount < 1 ? 1 : listCount);
+	submitted = 0;
+	rendered = 0;
+	quit = false;
+
+	if (threaded){
+		// A context can only be current on one thread at a time
+		context->releaseCurrent();
+		thread = std::thread(&RenderThread::run, this);
+	}
+}
+
+CommandList & RenderThread::beginRecording(){
+	unsigned int frame = submitted.load(std::memory_order_relaxed);
+
+	// The list is free once the render thread has drawn it
+	if (frame - rendered.load(std::memory_order_acquire) >= lists.size()){
+		PROFILE_SCOPE("RenderThread wait");
+		waitCount++;
+		int spins = 0;
+		while (frame - rendered.load(std::memory_order_acquire) >= lists.size())
+			backOff(spins);
+	}
+
+	CommandList & commands = lists[frame % lists.size()];
+	commands.frameNumber = frame;
+	commands.draws.clear(); // Keeps the memory of the previous frames
+	commands.ghosts.clear();
+	return commands;
+}
+
+void RenderThread::submit(){
+	unsigned int frame = submitted.load(std::memory_order_relaxed);
+	if (!threaded){
+		render(data, lists[frame % lists.size()]);
+		context->swapBuffers();
+		rendered.store(frame + 1, std::memory_order_relaxed);
+	}
+	submitted.store(frame + 1, std::memory_order_release); // Publishes the list
+}
+
+void RenderThread::stop(){
+	if (!threaded)
+		return;
+	quit = true;
+	thread.join();
+	context->makeCurrent();
+}
+
+void RenderThread::run(){
+	PROFILE_THREAD_NAME("render");
+	context->makeCurrent();
+
+	int spins = 0;
+	while (true){
+		// Read quit first : a list submitted before stop() is then always seen below,
+		// so that every list is drawn before leaving and stopping is deterministic too
+		bool quitting = quit.load(std::memory_order_acquire);
+		unsigned int frame = rendered.load(std::memory_order_relaxed);
+		if (frame == submitted.load(std::memory_order_acquire)){
+			if (quitting)
+				break;
+			backOff(spins);
+			continue;
+		}
+		spins = 0;
+
+		render(data, lists[frame % lists.size()]);
+		context->swapBuffers();
+		rendered.store(frame + 1, std::memory_order_release); // Gives the list back
+	}
+
+	context->releaseCurrent();
+}
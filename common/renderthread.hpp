@@ -0,0 +1,72 @@
+#ifndef RENDERTHREAD_HPP
+#define RENDERTHREAD_HPP
+
+#include <atomic>
+#include <thread>
+
+// Render thread.
+// The GL context belongs to a thread of its own, which draws the command lists
+// recorded by the simulation thread. Recording frame N+1 thus overlaps the
+// submission of frame N, and input is polled even while the GL is busy.
+// The lists form a small ring handed over with two atomic counters, without locks.
+// Every list is drawn exactly once and in order, and nothing flows back from the
+// render thread : the simulation never depends on how fast the GPU is, so a
+// replayed session simulates exactly the same frames.
+
+// One mesh to draw, with its constants
+struct DrawCommand {
+	int mesh;
+	DrawConstants constants;
+};
+
+// Everything needed to draw one frame, as plain data
+struct CommandList {
+	unsigned int frameNumber;
+	FrameConstants frame;
+	std::vector<DrawCommand> draws;
+	GhostInstances ghosts;          // Empty without a ghost race
+	FrameStats stats;               // Measures of the game loop, for the overlay
+};
+
+class RenderContext;
+
+// Called on the render thread, with the context current, to draw one list
+typedef void (*RenderFunction)(void * data, const CommandList & commands);
+
+class RenderThread {
+public:
+	RenderThread();
+	~RenderThread();
+
+	// Moves the context from the calling thread to a new render thread, with listCount
+	// lists in flight. threaded = false draws on the caller in submit(), for debugging.
+	void start(RenderContext * context, RenderFunction render, void * data, int listCount = 2, bool threaded = true);
+
+	// List of the next frame. Waits if the render thread is listCount frames behind.
+	CommandList & beginRecording();
+
+	// Hands the list returned by beginRecording() over to the render thread
+	void submit();
+
+	// Draws the submitted lists, stops the render thread and gives the context back to the caller
+	void stop();
+
+	// How often the simulation had to wait for the render thread
+	int getWaitCount() const { return waitCount; }
+
+private:
+	void run();
+
+	RenderContext * context;
+	RenderFunction render;
+	void * data;
+	bool threaded;
+	std::vector<CommandList> lists;
+	std::atomic<unsigned int> submitted; // Lists written by the simulation thread
+	std::atomic<unsigned int> rendered;  // Lists drawn by the render thread
+	std::atomic<bool> quit;
+	std::thread thread;
+	int waitCount;
+};
+
+#endif
@@ -13,8 +13,10 @@ using namespace std;
 #include <GL/glew.h>
 
 #include "shader.hpp"
+#include "profiler.hpp"
 
 GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path){
+	PROFILE_FUNCTION();
 
 	// Create the shaders
 	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
@@ -110,3 +112,84 @@ GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path
 }
 
 
+
+
+// Reads and compiles one shader stage. Returns 0 if the file can't be read.
+static GLuint compileShaderFile(GLenum type, const char * file_path){
+
+	std::string ShaderCode;
+	std::ifstream ShaderStream(file_path, std::ios::in);
+	if(ShaderStream.is_open()){
+		std::stringstream sstr;
+		sstr << ShaderStream.rdbuf();
+		ShaderCode = sstr.str();
+		ShaderStream.close();
+	}else{
+		printf("Impossible to open %s. Are you in the right directory ? Don't forget to read the FAQ !\n", file_path);
+		return 0;
+	}
+
+	GLint Result = GL_FALSE;
+	int InfoLogLength;
+
+	printf("Compiling shader : %s\n", file_path);
+	GLuint ShaderID = glCreateShader(type);
+	char const * SourcePointer = ShaderCode.c_str();
+	glShaderSource(ShaderID, 1, &SourcePointer , NULL);
+	glCompileShader(ShaderID);
+
+	glGetShaderiv(ShaderID, GL_COMPILE_STATUS, &Result);
+	glGetShaderiv(ShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+	if ( InfoLogLength > 0 ){
+		std::vector<char> ShaderErrorMessage(InfoLogLength+1);
+		glGetShaderInfoLog(ShaderID, InfoLogLength, NULL, &ShaderErrorMessage[0]);
+		printf("%s\n", &ShaderErrorMessage[0]);
+	}
+
+	return ShaderID;
+}
+
+GLuint LoadTransformFeedbackShaders(const char * vertex_file_path, const char * geometry_file_path, const char * const * varyings, int varyingCount){
+	PROFILE_FUNCTION();
+
+	GLuint VertexShaderID = compileShaderFile(GL_VERTEX_SHADER, vertex_file_path);
+	GLuint GeometryShaderID = geometry_file_path ? compileShaderFile(GL_GEOMETRY_SHADER, geometry_file_path) : 0;
+	if (VertexShaderID == 0 || (geometry_file_path && GeometryShaderID == 0)){
+		glDeleteShader(VertexShaderID);
+		glDeleteShader(GeometryShaderID);
+		return 0;
+	}
+
+	// Link the program. The captured outputs must be declared before linking.
+	printf("Linking program\n");
+	GLuint ProgramID = glCreateProgram();
+	glAttachShader(ProgramID, VertexShaderID);
+	if (GeometryShaderID)
+		glAttachShader(ProgramID, GeometryShaderID);
+	glTransformFeedbackVaryings(ProgramID, varyingCount, varyings, GL_INTERLEAVED_ATTRIBS);
+	glLinkProgram(ProgramID);
+
+	// Check the program
+	GLint Result = GL_FALSE;
+	int InfoLogLength;
+	glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
+	glGetProgramiv(ProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+	if ( InfoLogLength > 0 ){
+		std::vector<char> ProgramErrorMessage(InfoLogLength+1);
+		glGetProgramInfoLog(ProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
+		printf("%s\n", &ProgramErrorMessage[0]);
+	}
+
+	glDetachShader(ProgramID, VertexShaderID);
+	glDeleteShader(VertexShaderID);
+	if (GeometryShaderID){
+		glDetachShader(ProgramID, GeometryShaderID);
+		glDeleteShader(GeometryShaderID);
+	}
+
+	if (Result != GL_TRUE){
+		glDeleteProgram(ProgramID);
+		return 0;
+	}
+	return ProgramID;
+}
@@ -3,4 +3,8 @@
 
 GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path);
 
+// Program without fragment stage whose outputs are captured with transform feedback.
+// geometry_file_path may be NULL. Returns 0 on failure.
+GLuint LoadTransformFeedbackShaders(const char * vertex_file_path, const char * geometry_file_path, const char * const * varyings, int varyingCount);
+
 #endif
@@ -0,0 +1,469 @@
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "collision.hpp"
+#include "physics.hpp"
+#include "triggers.hpp"
+#include "occlusion.hpp"
+#include "jobsystem.hpp"
+#include "benchmark.hpp"
+#include "profiler.hpp"
+#include "simulation.hpp"
+#include "inputrecording.hpp"
+#include "ghosttracks.hpp"
+
+GameSimulation::GameSimulation(const GameObject * objects, int objectCount, const GameRules & rules, const PhysicsConfig & physicsConfig)
+	: rules(rules), physics(physicsConfig){
+	triggerTypes.resize(objectCount);
+	centers.resize(objectCount);
+	collected.assign(objectCount, 0);
+	ball = ballBody = -1;
+	push = glm::vec3(0.0f);
+	ballCenter = glm::vec3(0.0f);
+	ballRadius = 0.0f;
+	tickDuration = 1.0 / 60.0;
+	coinCount = 0;
+	for (int i=0; i<objectCount; i++){
+		const std::vector<glm::vec3> & vertices = *objects[i].vertices;
+		glm::vec4 sphere = computeBoundingSphere(vertices);
+		centers[i] = glm::vec3(sphere);
+
+		// Collision shapes, in world space like the geometry, cooked ahead of time for the static ones
+		if (objects[i].physics == PHYSICS_MESH)
+			physics.addStaticMesh(vertices, getCollisionPath(objects[i].file).c_str());
+		else if (objects[i].physics == PHYSICS_HULL)
+			physics.addStaticHull(vertices, getCollisionPath(objects[i].file).c_str());
+		else if (objects[i].physics == PHYSICS_BALL){
+			ballBody = physics.addSphere(vertices, 0.05f, ballCenter);
+			physics.setLinearVelocity(ballBody, glm::vec3(0.0f, 0.0f, -1.0f));
+			ballRadius = sphere.w;
+			ball = i;
+		}
+
+		// Trigger volumes, in world space too : coins and spikes don't move
+		triggerTypes[i] = objects[i].trigger;
+		if (objects[i].trigger == COIN_TRIGGER){
+			triggers.addSphere(centers[i], sphere.w, i);
+			coinCount++;
+		}else if (objects[i].trigger == SPIKE_TRIGGER){
+			glm::vec3 aabbMin, aabbMax;
+			computeAABB(vertices, aabbMin, aabbMax);
+			triggers.addBox(aabbMin, aabbMax, i);
+		}
+	}
+
+	status = GAME_RUNNING;
+	tickCount = 0;
+	timeLeft = rules.timeLimit;
+	coinsCollected = 0;
+	spikeHits = 0;
+}
+
+void GameSimulation::start(double tickDuration){
+	this->tickDuration = tickDuration;
+	physics.start(tickDuration);
+}
+
+void GameSimulation::stop(){
+	physics.stop();
+}
+
+void GameSimulation::tick(const GameInput & input){
+	PROFILE_FUNCTION();
+	events.clear();
+	push = glm::vec3(0.0f);
+	if (ballBody >= 0 && status == GAME_RUNNING && (input.pushX != 0.0f || input.pushZ != 0.0f)){
+		push = rules.pushForce * glm::vec3(glm::clamp(input.pushX, -1.0f, 1.0f), 0.0f, glm::clamp(input.pushZ, -1.0f, 1.0f));
+		physics.applyForce(ballBody, push);
+	}
+
+	// Results of the step started by the previous tick, while this tick's step runs alongside the frame
+	physics.step();
+	tickCount++;
+	if (status != GAME_RUNNING)
+		return;
+
+	// What the ball touched during the step
+	glm::vec3 position(0.0f);
+	if (ballBody >= 0){
+		glm::quat rotation;
+		physics.getTransform(ballBody, position, rotation);
+		triggerEvents.clear();
+		triggers.track(position, ballRadius, triggerEvents);
+		for (size_t e=0; e<triggerEvents.size(); e++){
+			if (!triggerEvents[e].entered)
+				continue;
+			int object = triggers.getTag(triggerEvents[e].trigger);
+			if (triggerTypes[object] == COIN_TRIGGER){
+				// Collected coins keep their trigger, for a rewind to bring them back
+				if (collected[object])
+					continue;
+				collected[object] = 1;
+				coinsCollected++;
+			}else{
+				timeLeft -= rules.spikePenalty;
+				spikeHits++;
+			}
+			GameEvent event = { triggerTypes[object], object };
+			events.push_back(event);
+		}
+	}
+
+	timeLeft -= (float)tickDuration;
+	if (coinCount > 0 && coinsCollected == coinCount)
+		status = GAME_WON;
+	else if (timeLeft <= 0.0f){
+		timeLeft = 0.0f;
+		status = GAME_TIME_UP;
+	}else if (ballBody >= 0 && position.y < rules.fallHeight)
+		status = GAME_FELL;
+}
+
+void GameSimulation::getBallTransform(glm::vec3 & position, glm::quat & rotation) const {
+	if (ballBody < 0){
+		position = glm::vec3(0.0f);
+		rotation = glm::quat();
+		return;
+	}
+	physics.getTransform(ballBody, position, rotation);
+}
+
+unsigned int GameSimulation::hashState() const {
+	glm::vec3 position;
+	glm::quat rotation;
+	getBallTransform(position, rotation);
+	uint32_t words[12];
+	words[0] = tickCount;
+	words[1] = (uint32_t)status;
+	words[2] = (uint32_t)coinsCollected;
+	words[3] = (uint32_t)spikeHits;
+	float floats[8] = { timeLeft, position.x, position.y, position.z, rotation.x, rotation.y, rotation.z, rotation.w };
+	memcpy(&words[4], floats, sizeof(floats));
+	std::vector<unsigned char> bytes((const unsigned char *)words, (const unsigned char *)words + sizeof(words));
+	bytes.insert(bytes.end(), collected.begin(), collected.end());
+	return hashBytes(&bytes[0], bytes.size());
+}
+
+int GameSimulation::getStateWords() const {
+	return 8 + (int)(collected.size() + 31) / 32 + physics.getStateWords();
+}
+
+void GameSimulation::saveState(uint32_t * words) const {
+	words[0] = tickCount;
+	words[1] = (uint32_t)status;
+	words[2] = (uint32_t)coinsCollected;
+	words[3] = (uint32_t)spikeHits;
+	float floats[4] = { timeLeft, push.x, push.y, push.z };
+	memcpy(&words[4], floats, sizeof(floats));
+	uint32_t * bits = &words[8];
+	memset(bits, 0, (collected.size() + 31) / 32 * sizeof(uint32_t));
+	for (size_t i=0; i<collected.size(); i++)
+		if (collected[i])
+			bits[i / 32] |= 1u << (i % 32);
+	physics.saveState(&bits[(collected.size() + 31) / 32]);
+}
+
+void GameSimulation::restoreState(const uint32_t * words){
+	tickCount = words[0];
+	status = (GameStatus)words[1];
+	coinsCollected = (int)words[2];
+	spikeHits = (int)words[3];
+	float floats[4];
+	memcpy(floats, &words[4], sizeof(floats));
+	timeLeft = floats[0];
+	push = glm::vec3(floats[1], floats[2], floats[3]);
+	const uint32_t * bits = &words[8];
+	for (size_t i=0; i<collected.size(); i++)
+		collected[i] = (bits[i / 32] >> (i % 32)) & 1;
+	events.clear();
+
+	// The step the saved tick started runs again, with its push
+	if (ballBody >= 0 && push != glm::vec3(0.0f))
+		physics.applyForce(ballBody, push);
+	physics.restoreState(&bits[(collected.size() + 31) / 32]);
+	if (ballBody >= 0){
+		glm::vec3 position;
+		glm::quat rotation;
+		physics.getTransform(ballBody, position, rotation);
+		triggers.setTracked(position, ballRadius);
+	}
+}
+
+// Headless games
+
+// Input from its tick on
+struct InputKey {
+	unsigned int tick;
+	GameInput input;
+};
+
+// Text script, one key per line : "tick pushX pushZ". # starts a comment.
+static bool loadInputScript(const char * path, std::vector<InputKey> & keys){
+	FILE * file = fopen(path, "r");
+	if (file == NULL){
+		printf("Can't open the input script %s\n", path);
+		return false;
+	}
+	char line[256];
+	int lineNumber = 0;
+	bool valid = true;
+	while (fgets(line, sizeof(line), file)){
+		lineNumber++;
+		char * comment = strchr(line, '#');
+		if (comment)
+			*comment = '\0';
+		InputKey key;
+		char extra;
+		int fields = sscanf(line, "%u %f %f %c", &key.tick, &key.input.pushX, &key.input.pushZ, &extra);
+		if (fields <= 0)
+			continue; // Blank
+		if (fields != 3 || (!keys.empty() && key.tick < keys.back().tick)){
+			printf("%s:%d : expected \"tick pushX pushZ\", in tick order\n", path, lineNumber);
+			valid = false;
+			break;
+		}
+		keys.push_back(key);
+	}
+	fclose(file);
+	return valid;
+}
+
+static unsigned int nextRandom(unsigned int & state){
+	// xorshift32 : every game has its own sequence, rand() is shared
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+// Seeded player : heads for the nearest coin left, weaving a little on the way
+static GameInput getAutopilotInput(const GameSimulation & game, const std::vector<int> & coins, unsigned int & seed, float & weave){
+	if (game.getTickCount() % 30 == 0)
+		weave = ((nextRandom(seed) & 0xffff) / 65535.0f * 2.0f - 1.0f) * 0.8f;
+	glm::vec3 position;
+	glm::quat rotation;
+	game.getBallTransform(position, rotation);
+	glm::vec2 ball(position.x, position.z), target(ball);
+	float nearest = 1e30f;
+	for (size_t c=0; c<coins.size(); c++){
+		if (game.isCollected(coins[c]))
+			continue;
+		glm::vec2 coin(game.getCenter(coins[c]).x, game.getCenter(coins[c]).z);
+		float distance = glm::dot(coin - ball, coin - ball);
+		if (distance < nearest){
+			nearest = distance;
+			target = coin;
+		}
+	}
+	GameInput input = { 0.0f, 0.0f };
+	glm::vec2 direction = target - ball;
+	if (glm::dot(direction, direction) > 0.0f){
+		direction = glm::normalize(direction);
+		float c = cosf(weave), s = sinf(weave);
+		input.pushX = c * direction.x - s * direction.y;
+		input.pushZ = s * direction.x + c * direction.y;
+	}
+	return input;
+}
+
+struct RunResult {
+	GameStatus status;
+	unsigned int ticks;
+	int coins, spikeHits;
+	float timeLeft;
+	float pushForce;
+	unsigned int hash;
+	double setupMs;
+	unsigned int desyncTick; // Of a replay, 0 if none
+};
+
+static const char * getStatusName(GameStatus status){
+	switch (status){
+	case GAME_WON:     return "won";
+	case GAME_TIME_UP: return "time up";
+	case GAME_FELL:    return "fell";
+	default:           return "running";
+	}
+}
+
+bool runSimulations(const GameObject * objects, int objectCount, const SimulationRuns & runs, unsigned int & hash){
+	hash = 0;
+	std::vector<InputKey> script;
+	if (runs.inputPath && !loadInputScript(runs.inputPath, script))
+		return false;
+	// Every game plays its own copy of the recording
+	InputReplay recording;
+	if (runs.replayPath && !recording.open(runs.replayPath))
+		return false;
+	std::vector<int> coins;
+	for (int i=0; i<objectCount; i++)
+		if (objects[i].trigger == COIN_TRIGGER)
+			coins.push_back(i);
+
+	int tickRate = runs.replayPath ? recording.getTickRate() : 60;
+	const double tickDuration = 1.0 / tickRate;
+	GameRules baseRules = runs.replayPath ? recording.getRules() : runs.rules;
+	unsigned int maxTicks = runs.maxTicks > 0 ? runs.maxTicks : (unsigned int)(baseRules.timeLimit / tickDuration) + 2;
+	if (runs.replayPath && (runs.maxTicks == 0 || recording.getTickCount() < maxTicks))
+		maxTicks = recording.getTickCount();
+	// One world per game, small : the scene only has a few contacts
+	PhysicsConfig physicsConfig;
+	physicsConfig.threaded = false;
+	physicsConfig.maxManifolds = 64;
+	{
+		// Cooks the collision data that is missing once, before the games load it side by side
+		GameSimulation cook(objects, objectCount, baseRules, physicsConfig);
+	}
+	InputRecorder recorder;
+	if (runs.recordPath && !recorder.open(runs.recordPath, baseRules, tickRate))
+		return false;
+
+	GhostRace ghosts;
+	std::vector<std::vector<glm::vec3> > ghostPaths(runs.ghostPath ? runs.runCount : 0);
+
+	JobSystem jobs(runs.threads);
+	printf("Simulation : %d game(s) on %d thread(s), %s, at most %u ticks each\n", runs.runCount, jobs.getThreadCount(),
+		runs.replayPath ? runs.replayPath : (runs.inputPath ? runs.inputPath : "autopilot"), maxTicks);
+	std::vector<RunResult> results(runs.runCount);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	jobs.parallelFor(0, runs.runCount, 1, [&](int begin, int end){
+		for (int r=begin; r<end; r++){
+			std::chrono::steady_clock::time_point setupStart = std::chrono::steady_clock::now();
+			GameRules rules = baseRules;
+			if (runs.sweep && runs.runCount > 1)
+				rules.pushForce *= 0.5f * powf(4.0f, (float)r / (runs.runCount - 1));
+			GameSimulation game(objects, objectCount, rules, physicsConfig);
+			game.start(tickDuration);
+			RunResult & result = results[r];
+			result.setupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - setupStart).count();
+
+			unsigned int seed = 0x9e3779b9u * (r + 1);
+			float weave = 0.0f;
+			size_t key = 0;
+			GameInput input = { 0.0f, 0.0f };
+			InputReplay replay;
+			if (runs.replayPath)
+				replay = recording;
+			InputRecorder * record = r == 0 && recorder.isOpen() ? &recorder : NULL;
+			result.desyncTick = 0;
+			std::vector<glm::vec3> * ghostPath = runs.ghostPath ? &ghostPaths[r] : NULL;
+			glm::vec3 position;
+			glm::quat rotation;
+			if (ghostPath){
+				game.getBallTransform(position, rotation);
+				ghostPath->push_back(position);
+			}
+			// A replay goes on once its game is over : the physics still moves, and is checked
+			while ((game.getStatus() == GAME_RUNNING || runs.replayPath) && game.getTickCount() < maxTicks){
+				if (runs.replayPath){
+					input = replay.next();
+				}else if (runs.inputPath){
+					while (key < script.size() && script[key].tick <= game.getTickCount())
+						input = script[key++].input;
+				}else{
+					input = getAutopilotInput(game, coins, seed, weave);
+				}
+				if (record)
+					input = record->record(input);
+				game.tick(input);
+				if (record)
+					record->endTick(game.hashState());
+				if (ghostPath && game.getTickCount() % ghosts.interval == 0){
+					game.getBallTransform(position, rotation);
+					ghostPath->push_back(position);
+				}
+				if (runs.replayPath && !replay.check(game.hashState())){
+					result.desyncTick = replay.getDesyncTick();
+					break;
+				}
+			}
+			game.stop();
+
+			result.status = game.getStatus();
+			result.ticks = game.getTickCount();
+			result.coins = game.getCoinsCollected();
+			result.spikeHits = game.getSpikeHits();
+			result.timeLeft = game.getTimeLeft();
+			result.pushForce = rules.pushForce;
+			result.hash = game.hashState();
+		}
+	});
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	// Every game, when there are few, then the totals
+	unsigned long long totalTicks = 0;
+	double setupMs = 0.0;
+	int outcomes[4] = { 0, 0, 0, 0 };
+	int desyncs = 0;
+	long long totalCoins = 0;
+	std::vector<unsigned int> hashes(runs.runCount);
+	for (int r=0; r<runs.runCount; r++){
+		const RunResult & result = results[r];
+		if (runs.runCount <= 16)
+			printf("  game %2d : %-7s after %5u ticks, %d/%d coins, %d spike hit(s), %5.2f s left, push %.3f N, hash 0x%08x\n",
+				r, getStatusName(result.status), result.ticks, result.coins, (int)coins.size(), result.spikeHits, result.timeLeft, result.pushForce, result.hash);
+		if (result.desyncTick > 0 && (runs.runCount <= 16 || desyncs == 0))
+			printf("  game %2d : the replay differs from the recording at its checkpoint of tick %u\n", r, result.desyncTick);
+		desyncs += result.desyncTick > 0 ? 1 : 0;
+		totalTicks += result.ticks;
+		setupMs += result.setupMs;
+		outcomes[result.status]++;
+		totalCoins += result.coins;
+		hashes[r] = result.hash;
+	}
+	hash = hashBytes((const unsigned char *)&hashes[0], hashes.size() * sizeof(unsigned int));
+	printf("  %llu ticks in %.2f s : %.0f ticks/s, %.0f ticks/s per thread, %.2f ms to set a game up\n",
+		totalTicks, seconds, totalTicks / seconds, totalTicks / seconds / jobs.getThreadCount(), setupMs / runs.runCount);
+	printf("  %d won, %d time up, %d fell, %d still running, %.2f coins on average\n",
+		outcomes[GAME_WON], outcomes[GAME_TIME_UP], outcomes[GAME_FELL], outcomes[GAME_RUNNING], (double)totalCoins / runs.runCount);
+	if (runs.replayPath)
+		printf("  Replay of %u ticks : %d game(s) out of %d reached all %d checkpoints\n",
+			recording.getTickCount(), runs.runCount - desyncs, runs.runCount, recording.getCheckpointCount());
+	if (recorder.isOpen()){
+		recorder.close();
+		printf("  Game 0 recorded in %s : %u ticks, %u bytes, %.2f bytes per tick\n", runs.recordPath,
+			recorder.getTickCount(), (unsigned int)recorder.getByteCount(), recorder.getTickCount() ? (double)recorder.getByteCount() / recorder.getTickCount() : 0.0);
+	}
+	if (runs.ghostPath){
+		size_t bytes = 0;
+		for (int r=0; r<runs.runCount; r++){
+			addGhostTrack(ghosts, ghostPaths[r]);
+			bytes += ghosts.tracks[r].data.size();
+		}
+		if (!saveGhostRace(runs.ghostPath, ghosts))
+			return false;
+		printf("  %d ghost(s) written in %s : %u bytes, %.2f bytes per sample\n", runs.runCount, runs.ghostPath,
+			(unsigned int)bytes, (double)bytes / ((double)totalTicks / ghosts.interval + runs.runCount));
+	}
+
+	if (runs.sweep && runs.runCount > 1){
+		// Balancing : how the outcome changes with the push force
+		const int bucketCount = std::min(8, runs.runCount);
+		for (int b=0; b<bucketCount; b++){
+			int first = b * runs.runCount / bucketCount, last = (b + 1) * runs.runCount / bucketCount;
+			int won = 0;
+			double wonTicks = 0.0;
+			for (int r=first; r<last; r++){
+				if (results[r].status == GAME_WON){
+					won++;
+					wonTicks += results[r].ticks;
+				}
+			}
+			printf("  push %.3f to %.3f N : %3d%% won", results[first].pushForce, results[last-1].pushForce, 100 * won / (last - first));
+			if (won > 0)
+				printf(", in %.2f s on average", wonTicks / won * tickDuration);
+			printf("\n");
+		}
+	}
+	printf("  Hash of the final states : 0x%08x\n", hash);
+	return desyncs == 0;
+}
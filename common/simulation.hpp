@@ -0,0 +1,147 @@
+#ifndef SIMULATION_HPP
+#define SIMULATION_HPP
+
+// Rules of the game, without rendering.
+// The ball, the coins, the spikes and the timer advance one fixed tick at a
+// time, from the input of that tick only, so a game plays out the same
+// wherever it runs : behind the window, or headless with no GL context at all,
+// as fast as the physics steps. Headless games step their physics in place
+// rather than on a thread of their own, so that thousands of them can run side
+// by side on every core, for balancing sweeps and CI checks (runSimulations).
+
+// How an object takes part in the physics
+enum PhysicsType {
+	NO_PHYSICS,
+	PHYSICS_MESH,  // Static, collides with its own triangles
+	PHYSICS_HULL,  // Static, collides with its convex hull
+	PHYSICS_BALL   // Moving sphere
+};
+
+// What touching an object does, found by the trigger grid rather than the physics
+enum TriggerType {
+	NOT_A_TRIGGER,
+	COIN_TRIGGER, // Collected, around its bounding sphere
+	SPIKE_TRIGGER // Hurts, around its bounding box
+};
+
+// An object of the scene, as the rules see it
+struct GameObject {
+	const char * file; // Its cooked collision data is next to it
+	PhysicsType physics;
+	TriggerType trigger;
+	const std::vector<glm::vec3> * vertices; // World space, three per triangle. Only read while constructing.
+};
+
+// What the player does during one tick
+struct GameInput {
+	float pushX, pushZ; // Push on the ball along the floor, from -1 to 1
+};
+
+struct GameRules {
+	float timeLimit;    // Seconds to collect every coin
+	float spikePenalty; // Seconds lost per spike hit
+	float pushForce;    // Newtons, at full input
+	float fallHeight;   // Below it, the ball left the track
+
+	GameRules() : timeLimit(60.0f), spikePenalty(5.0f), pushForce(0.15f), fallHeight(-1.0f) {}
+};
+
+enum GameStatus {
+	GAME_RUNNING,
+	GAME_WON,     // Every coin collected in time
+	GAME_TIME_UP,
+	GAME_FELL
+};
+
+struct GameEvent {
+	TriggerType type; // The coin was collected, or the spike hit
+	int object;
+};
+
+class GameSimulation {
+public:
+	// Builds the physics and the triggers of the scene
+	GameSimulation(const GameObject * objects, int objectCount, const GameRules & rules = GameRules(),
+	               const PhysicsConfig & physicsConfig = PhysicsConfig());
+
+	void start(double tickDuration);
+	// Advances the game by one tick. Once it's over, only the physics goes on.
+	void tick(const GameInput & input);
+	void stop();
+
+	GameStatus getStatus() const { return status; }
+	unsigned int getTickCount() const { return tickCount; }
+	float getTimeLeft() const { return timeLeft; }
+	int getCoinsCollected() const { return coinsCollected; }
+	int getCoinCount() const { return coinCount; }
+	int getSpikeHits() const { return spikeHits; }
+	bool isCollected(int object) const { return collected[object] != 0; }
+	// What the ball touched during the last tick
+	const std::vector<GameEvent> & getEvents() const { return events; }
+
+	// Object of the ball, -1 for none
+	int getBall() const { return ball; }
+	// Center of the ball as loaded : the mesh is drawn at -getBallCenter() relative to the transform
+	const glm::vec3 & getBallCenter() const { return ballCenter; }
+	float getBallRadius() const { return ballRadius; }
+	// Transform of the ball at the last tick
+	void getBallTransform(glm::vec3 & position, glm::quat & rotation) const;
+	// Center of the bounding sphere of an object
+	const glm::vec3 & getCenter(int object) const { return centers[object]; }
+
+	// Hash of the tick count, the score, the timer and the transform of the ball :
+	// two runs that end with the same hash played the same game
+	unsigned int hashState() const;
+
+	// For rewinding (see snapshots.hpp) : the whole state of the game in 32-bit words, as many at
+	// every tick. After start().
+	int getStateWords() const;
+	void saveState(uint32_t * words) const;
+	// Back to a saved tick : what happened after it is undone, and the game goes on from there
+	void restoreState(const uint32_t * words);
+
+	PhysicsWorld & getPhysics() { return physics; }
+	const TriggerGrid & getTriggers() const { return triggers; }
+
+private:
+	GameRules rules;
+	PhysicsWorld physics;
+	TriggerGrid triggers; // Tags are object indices
+	std::vector<TriggerType> triggerTypes;
+	std::vector<glm::vec3> centers;
+	std::vector<char> collected;
+	int ball, ballBody;
+	glm::vec3 ballCenter;
+	float ballRadius;
+	double tickDuration;
+	glm::vec3 push; // Applied to the step in flight
+
+	GameStatus status;
+	unsigned int tickCount;
+	float timeLeft;
+	int coinCount, coinsCollected, spikeHits;
+	std::vector<GameEvent> events;
+	std::vector<TriggerEvent> triggerEvents; // Scratch
+};
+
+// Headless games, for playground --simulate
+struct SimulationRuns {
+	int runCount;           // Independent games, spread over the threads
+	unsigned int maxTicks;  // Per game. The timer ends them anyway.
+	const char * inputPath; // Input script, NULL for a seeded autopilot in every game
+	const char * replayPath; // Input recording (inputrecording.hpp) : its rules and input, checked at its checkpoints
+	const char * recordPath; // Records the first game
+	const char * ghostPath; // Writes the ball of every game as a ghost race (ghosts.hpp)
+	bool sweep;             // Push force from half to twice the rules' one across the games
+	int threads;            // 0 for every core
+	GameRules rules;
+
+	SimulationRuns() : runCount(1), maxTicks(0), inputPath(NULL), replayPath(NULL), recordPath(NULL), ghostPath(NULL), sweep(false), threads(0) {}
+};
+
+// Plays the games as fast as the cores allow, then prints ticks per second, the end of
+// every game and the hash of its final state. hash is the hash of all of them, in order.
+// False if the input couldn't be read, or if a replay differed from its recording.
+bool runSimulations(const GameObject * objects, int objectCount, const SimulationRuns & runs, unsigned int & hash);
+
+#endif
@@ -0,0 +1,328 @@
+#include <vector>
+#include <string>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "objloader.hpp"
+#include "collision.hpp"
+#include "physics.hpp"
+#include "triggers.hpp"
+#include "simulation.hpp"
+#include "snapshots.hpp"
+
+// A literal run goes on through fewer zeros than this : a new run would cost as much
+static const size_t MIN_ZERO_RUN = 3;
+
+static void putVarint(std::vector<unsigned char> & out, size_t value){
+	while (value >= 0x80){
+		out.push_back((unsigned char)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((unsigned char)value);
+}
+
+static size_t getVarint(const unsigned char * & in){
+	size_t value = 0;
+	for (int shift=0; ; shift+=7){
+		unsigned char byte = *in++;
+		value |= (size_t)(byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+			return value;
+	}
+}
+
+SnapshotRing::SnapshotRing(int wordCount, int capacity, int keyframeInterval){
+	this->wordCount = wordCount;
+	this->keyframeInterval = keyframeInterval > 0 ? keyframeInterval : 1;
+	snapshots.resize(capacity > 0 ? capacity : 1);
+	// Every keyframe a tick of the window depends on
+	keyframes.resize(snapshots.size() / this->keyframeInterval + 2);
+	planes.resize(4 * (size_t)wordCount);
+	clear();
+}
+
+void SnapshotRing::clear(){
+	first = count = 0;
+	oldestTick = 0;
+	firstKeyframe = keyframeCount = 0;
+}
+
+void SnapshotRing::encode(const uint32_t * words, const uint32_t * keyframe, std::vector<unsigned char> & out){
+	// Planes of bytes, high first
+	unsigned char * plane[4] = { &planes[0], &planes[wordCount], &planes[2 * (size_t)wordCount], &planes[3 * (size_t)wordCount] };
+	for (int i=0; i<wordCount; i++){
+		uint32_t x = words[i] ^ keyframe[i];
+		plane[0][i] = (unsigned char)(x >> 24);
+		plane[1][i] = (unsigned char)(x >> 16);
+		plane[2][i] = (unsigned char)(x >> 8);
+		plane[3][i] = (unsigned char)x;
+	}
+
+	// Runs : zeros skipped, then bytes as they are. The zeros at the end aren't written.
+	out.clear();
+	const unsigned char * bytes = &planes[0];
+	size_t size = planes.size(), i = 0;
+	while (i < size){
+		size_t literal = i;
+		while (literal < size && bytes[literal] == 0)
+			literal++;
+		if (literal == size)
+			break;
+		size_t end = literal;
+		while (end < size){
+			if (bytes[end] != 0){
+				end++;
+				continue;
+			}
+			size_t zeros = end;
+			while (zeros < size && zeros - end < MIN_ZERO_RUN && bytes[zeros] == 0)
+				zeros++;
+			if (zeros - end >= MIN_ZERO_RUN || zeros == size)
+				break;
+			end = zeros;
+		}
+		putVarint(out, literal - i);
+		putVarint(out, end - literal);
+		out.insert(out.end(), bytes + literal, bytes + end);
+		i = end;
+	}
+}
+
+void SnapshotRing::capture(unsigned int tick, const uint32_t * words){
+	if (count > 0 && tick != getNewestTick() + 1)
+		clear();
+	if (count == 0)
+		oldestTick = tick;
+
+	// The oldest tick makes room, and its keyframe once no tick depends on it
+	if (count == (int)snapshots.size()){
+		int keyframe = snapshots[first].keyframe;
+		first = (first + 1) % (int)snapshots.size();
+		count--;
+		oldestTick++;
+		if (count == 0 || snapshots[first].keyframe != keyframe){
+			firstKeyframe = (firstKeyframe + 1) % (int)keyframes.size();
+			keyframeCount--;
+		}
+	}
+
+	int last = (firstKeyframe + keyframeCount - 1) % (int)keyframes.size();
+	Snapshot & snapshot = snapshots[(first + count) % snapshots.size()];
+	count++;
+	if (keyframeCount == 0 || tick - keyframes[last].tick >= (unsigned int)keyframeInterval){
+		last = (firstKeyframe + keyframeCount) % (int)keyframes.size();
+		keyframeCount++;
+		keyframes[last].tick = tick;
+		keyframes[last].words.assign(words, words + wordCount);
+		snapshot.delta.clear();
+	}else
+		encode(words, &keyframes[last].words[0], snapshot.delta);
+	snapshot.keyframe = last;
+}
+
+bool SnapshotRing::restore(unsigned int tick, uint32_t * words) const {
+	if (count == 0 || tick < oldestTick || tick > getNewestTick())
+		return false;
+	const Snapshot & snapshot = getSnapshot(tick);
+	memcpy(words, &keyframes[snapshot.keyframe].words[0], wordCount * sizeof(uint32_t));
+	if (snapshot.delta.empty())
+		return true;
+
+	// Byte p of the planes is byte 3 - p / wordCount of word p % wordCount
+	const unsigned char * in = &snapshot.delta[0];
+	const unsigned char * end = in + snapshot.delta.size();
+	int plane = 0, word = 0;
+	while (in < end){
+		size_t zeros = getVarint(in);
+		size_t literals = getVarint(in);
+		word += (int)(zeros % wordCount);
+		plane += (int)(zeros / wordCount);
+		if (word >= wordCount){
+			word -= wordCount;
+			plane++;
+		}
+		for (size_t b=0; b<literals; b++){
+			words[word] ^= (uint32_t)*in++ << (8 * (3 - plane));
+			if (++word == wordCount){
+				word = 0;
+				plane++;
+			}
+		}
+	}
+	return true;
+}
+
+void SnapshotRing::discardAfter(unsigned int tick){
+	if (count == 0 || tick >= getNewestTick())
+		return;
+	if (tick < oldestTick){
+		clear();
+		return;
+	}
+	count = (int)(tick - oldestTick) + 1;
+	// Keyframes after the newest tick left
+	int keyframe = getSnapshot(tick).keyframe;
+	keyframeCount = (keyframe - firstKeyframe + (int)keyframes.size()) % (int)keyframes.size() + 1;
+}
+
+size_t SnapshotRing::getStoredBytes() const {
+	size_t bytes = (size_t)keyframeCount * wordCount * sizeof(uint32_t);
+	for (int i=0; i<count; i++)
+		bytes += snapshots[(first + i) % snapshots.size()].delta.size();
+	return bytes;
+}
+
+size_t SnapshotRing::getMemoryBytes() const {
+	size_t bytes = snapshots.capacity() * sizeof(Snapshot) + keyframes.capacity() * sizeof(Keyframe) + planes.capacity();
+	for (size_t i=0; i<snapshots.size(); i++)
+		bytes += snapshots[i].delta.capacity();
+	for (size_t i=0; i<keyframes.size(); i++)
+		bytes += keyframes[i].words.capacity() * sizeof(uint32_t);
+	return bytes;
+}
+
+static unsigned int nextRandom(unsigned int & state){
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+static double microsecondsSince(std::chrono::steady_clock::time_point start){
+	return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Size and speed of the history of one run, once it is full
+static void printHistory(const SnapshotRing & history, double captureUs, double restoreUs, int tickRate){
+	double seconds = history.getCount() / (double)tickRate;
+	size_t stored = history.getStoredBytes();
+	printf("  %d words a tick, %.1f s kept : %.2f MB stored, %.1f KB per second, %.2f MB allocated\n",
+		history.getWordCount(), seconds, stored / (1024.0 * 1024.0), stored / 1024.0 / seconds,
+		history.getMemoryBytes() / (1024.0 * 1024.0));
+	printf("  %.1f bytes a tick against %u raw, capture %.2f us, restore %.2f us\n",
+		(double)stored / history.getCount(), (unsigned int)(history.getWordCount() * sizeof(uint32_t)), captureUs, restoreUs);
+}
+
+void runRewindBenchmark(const GameObject * objects, int objectCount, int bodyCount){
+	const int tickRate = 60;
+	const int historySeconds = 30;
+	const unsigned int ticks = 40 * tickRate;
+	const int rewinds = 500;
+
+	// The game, pushed around by seeded input
+	{
+		printf("Rewind benchmark : the game, %u ticks, rewound %d times\n", ticks, rewinds);
+		GameRules rules;
+		rules.timeLimit = 1000.0f; // Goes on for the whole run
+		GameSimulation game(objects, objectCount, rules);
+		game.start(1.0 / tickRate);
+		int wordCount = game.getStateWords();
+		SnapshotRing history(wordCount, historySeconds * tickRate);
+		std::vector<uint32_t> words(wordCount), saved(wordCount);
+		std::vector<unsigned int> hashes(ticks + 1);
+		unsigned int seed = 12345;
+		GameInput input = { 0.0f, 0.0f };
+		double captureUs = 0.0;
+		for (unsigned int t=0; t<ticks; t++){
+			if (t % 30 == 0){
+				input.pushX = (int)(nextRandom(seed) % 3) - 1.0f;
+				input.pushZ = (int)(nextRandom(seed) % 3) - 1.0f;
+			}
+			game.tick(input);
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			game.saveState(&words[0]);
+			history.capture(game.getTickCount(), &words[0]);
+			captureUs += microsecondsSince(start);
+			hashes[game.getTickCount()] = game.hashState();
+		}
+
+		// Every restored state must be the one saved, bit for bit
+		int wrong = 0;
+		double restoreUs = 0.0;
+		unsigned int window = history.getNewestTick() - history.getOldestTick() + 1;
+		for (int r=0; r<rewinds; r++){
+			unsigned int tick = history.getOldestTick() + nextRandom(seed) % window;
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			history.restore(tick, &words[0]);
+			restoreUs += microsecondsSince(start);
+			game.restoreState(&words[0]);
+			game.saveState(&saved[0]);
+			if (game.hashState() != hashes[tick] || saved != words)
+				wrong++;
+		}
+		game.stop();
+		printHistory(history, captureUs / ticks, restoreUs / rewinds, tickRate);
+		printf("  %d of %d rewinds to a different state\n", wrong, rewinds);
+	}
+
+	// The physics alone, with many more bodies
+	std::vector<glm::vec3> floor, coin, spike;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec3> normals;
+	if (!loadOBJ("GameFloor.obj", floor, uvs, normals) || !loadOBJ("Coin1.obj", coin, uvs, normals) || !loadOBJ("Spike3.obj", spike, uvs, normals))
+		return;
+	printf("Rewind benchmark : %d coins and spikes falling on the floor, %u ticks\n", bodyCount, ticks);
+	PhysicsConfig config;
+	config.threaded = false;
+	config.maxManifolds = 4 * bodyCount > 4096 ? 4 * bodyCount : 4096;
+	PhysicsWorld physics(config);
+	physics.addStaticMesh(floor, getCollisionPath("GameFloor.obj").c_str());
+	physics.addGround(-0.05f);
+	glm::vec3 coinCenter, spikeCenter;
+	int coinShape = physics.createHullShape(coin, coinCenter);
+	int spikeShape = physics.createHullShape(spike, spikeCenter);
+	const int columns = 20, rows = 20;
+	for (int i=0; i<bodyCount; i++){
+		int layer = i / (columns * rows);
+		int column = i % columns, row = (i / columns) % rows;
+		glm::vec3 position(-0.3f + 2.8f * (column + 0.5f * (layer & 1)) / columns, 0.3f + 0.15f * layer,
+		                   -1.4f + 2.8f * (row + 0.5f * (layer & 1)) / rows);
+		glm::quat rotation = glm::angleAxis(0.37f * i, glm::normalize(glm::vec3(1.0f, 0.5f * (i % 3), 0.3f)));
+		bool isCoin = (i % 2) == 0;
+		physics.addBody(isCoin ? coinShape : spikeShape, isCoin ? 0.01f : 0.02f, position, rotation);
+	}
+	physics.start(1.0 / tickRate);
+
+	int wordCount = physics.getStateWords();
+	SnapshotRing history(wordCount, historySeconds * tickRate);
+	std::vector<uint32_t> words(wordCount);
+	// Some ticks are kept whole too, to check the restored ones
+	const unsigned int checkEvery = 97;
+	std::vector<unsigned int> checkTicks;
+	std::vector<std::vector<uint32_t> > checkWords;
+	double captureUs = 0.0;
+	for (unsigned int t=1; t<=ticks; t++){
+		physics.step();
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		physics.saveState(&words[0]);
+		history.capture(t, &words[0]);
+		captureUs += microsecondsSince(start);
+		if (t % checkEvery == 0){
+			checkTicks.push_back(t);
+			checkWords.push_back(words);
+		}
+		if (t == 2 * tickRate)
+			printf("  Falling, after 2 s : %.1f bytes a tick\n", (double)history.getStoredBytes() / history.getCount());
+	}
+
+	int wrong = 0, checked = 0;
+	double restoreUs = 0.0;
+	for (size_t c=0; c<checkTicks.size(); c++){
+		if (checkTicks[c] < history.getOldestTick())
+			continue;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		history.restore(checkTicks[c], &words[0]);
+		restoreUs += microsecondsSince(start);
+		checked++;
+		if (words != checkWords[c])
+			wrong++;
+	}
+	physics.stop();
+	printHistory(history, captureUs / ticks, checked > 0 ? restoreUs / checked : 0.0, tickRate);
+	printf("  %d of %d restored ticks differ from the captured ones\n", wrong, checked);
+}
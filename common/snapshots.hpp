@@ -0,0 +1,70 @@
+#ifndef SNAPSHOTS_HPP
+#define SNAPSHOTS_HPP
+
+// History of the game state, to rewind it.
+// A snapshot is the whole state of a tick as a block of 32-bit words, always
+// as many, laid out component by component (see GameSimulation::saveState) so
+// that the words of a component sit next to each other. Every
+// keyframeInterval ticks, the block is kept whole : a keyframe. The other
+// ticks only keep how they differ from the last keyframe : the words are
+// XORed with it, split into four planes of bytes, high bytes first, and the
+// runs of zeros are skipped. What didn't move is all zeros, and what moved a
+// little mostly keeps its sign, exponent and high mantissa bits, so the high
+// planes are long runs of zeros too.
+// The last `capacity` ticks are kept in a ring : capturing a tick costs one
+// pass over the block, and restoring any of them one keyframe and one delta.
+// Once the ring is full, the buffers of the oldest tick are reused, so a
+// steady game doesn't allocate.
+
+class SnapshotRing {
+public:
+	SnapshotRing(int wordCount, int capacity, int keyframeInterval = 60);
+
+	// State of the tick after the newest one. Any other tick starts the history again.
+	void capture(unsigned int tick, const uint32_t * words);
+	// Writes the state of a tick in the window to words, false if it isn't in it
+	bool restore(unsigned int tick, uint32_t * words) const;
+	// Forgets the ticks after this one : once rewound, the game goes on from there
+	void discardAfter(unsigned int tick);
+	void clear();
+
+	bool isEmpty() const { return count == 0; }
+	unsigned int getOldestTick() const { return oldestTick; }
+	unsigned int getNewestTick() const { return oldestTick + count - 1; }
+	int getCount() const { return count; }
+	int getWordCount() const { return wordCount; }
+	// Kept for the ticks in the window : keyframes, and deltas as encoded
+	size_t getStoredBytes() const;
+	// Allocated, buffers being reused included
+	size_t getMemoryBytes() const;
+
+private:
+	struct Snapshot {
+		int keyframe; // Slot in keyframes
+		std::vector<unsigned char> delta; // Empty for the keyframe itself
+	};
+	struct Keyframe {
+		unsigned int tick;
+		std::vector<uint32_t> words;
+	};
+
+	Snapshot & getSnapshot(unsigned int tick) { return snapshots[(first + (tick - oldestTick)) % snapshots.size()]; }
+	const Snapshot & getSnapshot(unsigned int tick) const { return snapshots[(first + (tick - oldestTick)) % snapshots.size()]; }
+	void encode(const uint32_t * words, const uint32_t * keyframe, std::vector<unsigned char> & out);
+
+	int wordCount;
+	int keyframeInterval;
+	std::vector<Snapshot> snapshots; // Ring, one per tick
+	int first, count;
+	unsigned int oldestTick;
+	std::vector<Keyframe> keyframes; // Ring, oldest first
+	int firstKeyframe, keyframeCount;
+	std::vector<unsigned char> planes; // Scratch
+};
+
+// The game, pushed around for 40 s with a snapshot every tick, rewound to random
+// ticks : the restored state must have the hash it had. Then bodyCount coins and
+// spikes falling on the floor, for the cost of a bigger state.
+void runRewindBenchmark(const GameObject * objects, int objectCount, int bodyCount);
+
+#endif
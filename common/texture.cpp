@@ -6,8 +6,12 @@
 
 #include <glfw3.h>
 
+#include "profiler.hpp"
+#include "glstats.hpp"
+
 
 GLuint loadBMP_custom(const char * imagepath){
+	PROFILE_FUNCTION();
 
 	printf("Reading image %s\n", imagepath);
 
@@ -125,6 +129,7 @@ GLuint loadBMP_custom(const char * imagepath){
 #define FOURCC_DXT5 0x35545844 // Equivalent to "DXT5" in ASCII
 
 GLuint loadDDS(const char * imagepath){
+	PROFILE_FUNCTION();
 
 	unsigned char header[124];
 
@@ -0,0 +1,182 @@
+#include <vector>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define TRANSFORM_USE_SSE
+#endif
+
+#include "transform.hpp"
+
+// out = a * b. Each column of the result is a linear combination of the columns of a.
+static inline void multiplyMatrix(const glm::mat4 & a, const glm::mat4 & b, glm::mat4 & out){
+#ifdef TRANSFORM_USE_SSE
+	const float * pa = &a[0][0];
+	const float * pb = &b[0][0];
+	__m128 a0 = _mm_loadu_ps(pa);
+	__m128 a1 = _mm_loadu_ps(pa + 4);
+	__m128 a2 = _mm_loadu_ps(pa + 8);
+	__m128 a3 = _mm_loadu_ps(pa + 12);
+	__m128 columns[4];
+	for (int j=0; j<4; j++){
+		__m128 r = _mm_mul_ps(a0, _mm_set1_ps(pb[4*j + 0]));
+		r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_set1_ps(pb[4*j + 1])));
+		r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_set1_ps(pb[4*j + 2])));
+		r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_set1_ps(pb[4*j + 3])));
+		columns[j] = r;
+	}
+	// Stored last, so that out can alias a or b
+	float * po = &out[0][0];
+	for (int j=0; j<4; j++)
+		_mm_storeu_ps(po + 4*j, columns[j]);
+#else
+	out = a * b;
+#endif
+}
+
+void multiplyMatrices(const glm::mat4 * a, const glm::mat4 * b, glm::mat4 * out, int count){
+	for (int i=0; i<count; i++)
+		multiplyMatrix(a[i], b[i], out[i]);
+}
+
+void multiplyMatrices(const glm::mat4 & a, const glm::mat4 * b, glm::mat4 * out, int count){
+	for (int i=0; i<count; i++)
+		multiplyMatrix(a, b[i], out[i]);
+}
+
+void multiplyMatrices(const glm::mat4 & a, const glm::mat4 * b, glm::mat4 * out, const int * indices, int count){
+	for (int i=0; i<count; i++)
+		multiplyMatrix(a, b[indices[i]], out[indices[i]]);
+}
+
+TransformHierarchy::TransformHierarchy(){
+	firstDirty = 0;
+	anyWorldDirty = false;
+	mvpsValid = false;
+	updatedWorldCount = 0;
+	updatedMVPCount = 0;
+}
+
+int TransformHierarchy::create(int parent){
+	int node = (int)parents.size();
+	parents.push_back(parent);
+	positions.push_back(glm::vec3(0.0f));
+	rotations.push_back(glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+	scales.push_back(glm::vec3(1.0f));
+	worlds.push_back(glm::mat4(1.0f));
+	mvps.push_back(glm::mat4(1.0f));
+	localDirty.push_back(0);
+	worldDirty.push_back(0);
+	updated.push_back(0);
+	markDirty(node);
+	return node;
+}
+
+void TransformHierarchy::markDirty(int node){
+	localDirty[node] = 1;
+	firstDirty = std::min(firstDirty, node);
+}
+
+void TransformHierarchy::setPosition(int node, const glm::vec3 & position){
+	positions[node] = position;
+	markDirty(node);
+}
+
+void TransformHierarchy::setRotation(int node, const glm::quat & rotation){
+	rotations[node] = rotation;
+	markDirty(node);
+}
+
+void TransformHierarchy::setScale(int node, const glm::vec3 & scale){
+	scales[node] = scale;
+	markDirty(node);
+}
+
+void TransformHierarchy::interpolate(const TransformHierarchy & from, const TransformHierarchy & to, float alpha){
+	int count = (int)parents.size();
+	for (int i=0; i<count; i++){
+		glm::vec3 position = from.positions[i];
+		glm::quat rotation = from.rotations[i];
+		glm::vec3 scale = from.scales[i];
+		if (position != to.positions[i])
+			position = glm::mix(position, to.positions[i], alpha);
+		if (rotation != to.rotations[i])
+			rotation = glm::slerp(rotation, to.rotations[i], alpha);
+		if (scale != to.scales[i])
+			scale = glm::mix(scale, to.scales[i], alpha);
+
+		if (position != positions[i] || rotation != rotations[i] || scale != scales[i]){
+			positions[i] = position;
+			rotations[i] = rotation;
+			scales[i] = scale;
+			markDirty(i);
+		}
+	}
+}
+
+void TransformHierarchy::update(){
+	updatedWorldCount = 0;
+	int count = (int)parents.size();
+	if (firstDirty >= count)
+		return; // Nothing moved
+
+	// Parents come first, so a single pass sees every parent before its children
+	for (int i=firstDirty; i<count; i++){
+		int parent = parents[i];
+		bool parentUpdated = parent >= firstDirty && updated[parent];
+		updated[i] = localDirty[i] || parentUpdated;
+		if (!updated[i])
+			continue;
+
+		// Local matrix : Translation * Rotation * Scale
+		glm::mat4 local = glm::mat4_cast(rotations[i]);
+		local[0] *= scales[i].x;
+		local[1] *= scales[i].y;
+		local[2] *= scales[i].z;
+		local[3] = glm::vec4(positions[i], 1.0f);
+
+		if (parent < 0)
+			worlds[i] = local;
+		else
+			multiplyMatrix(worlds[parent], local, worlds[i]);
+
+		localDirty[i] = 0;
+		worldDirty[i] = 1;
+		updatedWorldCount++;
+	}
+
+	for (int i=firstDirty; i<count; i++)
+		updated[i] = 0;
+	firstDirty = count;
+	anyWorldDirty = true;
+}
+
+void TransformHierarchy::computeMVP(const glm::mat4 & viewProjection){
+	updatedMVPCount = 0;
+	int count = (int)parents.size();
+	if (count == 0)
+		return;
+
+	if (!mvpsValid || viewProjection != lastViewProjection){
+		// The camera moved : everything changes
+		multiplyMatrices(viewProjection, &worlds[0], &mvps[0], count);
+		updatedMVPCount = count;
+		lastViewProjection = viewProjection;
+		mvpsValid = true;
+	}else if (anyWorldDirty){
+		batch.clear();
+		for (int i=0; i<count; i++)
+			if (worldDirty[i])
+				batch.push_back(i);
+		multiplyMatrices(viewProjection, &worlds[0], &mvps[0], &batch[0], (int)batch.size());
+		updatedMVPCount = (int)batch.size();
+	}else{
+		return; // Static scene, static camera
+	}
+
+	std::fill(worldDirty.begin(), worldDirty.end(), 0);
+	anyWorldDirty = false;
+}
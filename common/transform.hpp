@@ -0,0 +1,75 @@
+#ifndef TRANSFORM_HPP
+#define TRANSFORM_HPP
+
+// Transform hierarchy.
+// Nodes are stored in flat arrays in topological order : a parent is always
+// created, and so stored, before its children. Changing a node only marks it
+// dirty ; update() then walks the arrays once and recomputes the dirty nodes
+// and everything below them. Nothing is done for the nodes that didn't move.
+class TransformHierarchy {
+public:
+	TransformHierarchy();
+
+	// Adds a node at the identity. parent = -1 for a root.
+	int create(int parent = -1);
+	int getCount() const { return (int)parents.size(); }
+	int getParent(int node) const { return parents[node]; }
+
+	// Local transform, relative to the parent
+	void setPosition(int node, const glm::vec3 & position);
+	void setRotation(int node, const glm::quat & rotation);
+	void setScale(int node, const glm::vec3 & scale);
+	const glm::vec3 & getPosition(int node) const { return positions[node]; }
+	const glm::quat & getRotation(int node) const { return rotations[node]; }
+	const glm::vec3 & getScale(int node) const { return scales[node]; }
+
+	// Sets the local transforms to a blend of two states of the same hierarchy, e.g. the
+	// last two simulation ticks : alpha = 0 gives from, 1 gives to. Only nodes that change are marked dirty.
+	void interpolate(const TransformHierarchy & from, const TransformHierarchy & to, float alpha);
+
+	// Recomputes the world matrices of the dirty subtrees
+	void update();
+
+	// Recomputes the ModelViewProjection matrices that changed : all of them if the
+	// camera moved, only the nodes whose world matrix changed otherwise
+	void computeMVP(const glm::mat4 & viewProjection);
+
+	const glm::mat4 & getWorld(int node) const { return worlds[node]; }
+	const glm::mat4 & getMVP(int node) const { return mvps[node]; }
+
+	// Matrices recomputed by the last update() and computeMVP(), for statistics
+	int getUpdatedWorldCount() const { return updatedWorldCount; }
+	int getUpdatedMVPCount() const { return updatedMVPCount; }
+
+private:
+	void markDirty(int node);
+
+	std::vector<int> parents;
+	std::vector<glm::vec3> positions;
+	std::vector<glm::quat> rotations;
+	std::vector<glm::vec3> scales;
+	std::vector<glm::mat4> worlds;
+	std::vector<glm::mat4> mvps;
+	std::vector<unsigned char> localDirty;  // Position, rotation or scale changed
+	std::vector<unsigned char> worldDirty;  // World matrix changed since the last computeMVP()
+	std::vector<unsigned char> updated;     // Scratch : recomputed by the current update()
+	std::vector<int> batch;                 // Scratch : nodes whose MVP must be recomputed
+	int firstDirty;                         // Nothing before this node is dirty
+	bool anyWorldDirty;
+	bool mvpsValid;                         // computeMVP() was called at least once
+	glm::mat4 lastViewProjection;
+	int updatedWorldCount;
+	int updatedMVPCount;
+};
+
+// out[i] = a[i] * b[i] for count matrices, 4 floats at a time with SSE when available.
+// out may alias a or b.
+void multiplyMatrices(const glm::mat4 * a, const glm::mat4 * b, glm::mat4 * out, int count);
+
+// out[i] = a * b[i] for count matrices
+void multiplyMatrices(const glm::mat4 & a, const glm::mat4 * b, glm::mat4 * out, int count);
+
+// out[j] = a * b[j] for every j in indices
+void multiplyMatrices(const glm::mat4 & a, const glm::mat4 * b, glm::mat4 * out, const int * indices, int count);
+
+#endif
@@ -0,0 +1,371 @@
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <glm/glm.hpp>
+
+#include "objloader.hpp"
+#include "occlusion.hpp"
+#include "triggers.hpp"
+
+static bool sphereOverlapsSphere(const glm::vec3 & center, float radius, const glm::vec3 & otherCenter, float otherRadius){
+	glm::vec3 d = center - otherCenter;
+	return glm::dot(d, d) <= (radius + otherRadius) * (radius + otherRadius);
+}
+
+static bool sphereOverlapsBox(const glm::vec3 & center, float radius, const glm::vec3 & aabbMin, const glm::vec3 & aabbMax){
+	glm::vec3 d = center - glm::clamp(center, aabbMin, aabbMax);
+	return glm::dot(d, d) <= radius * radius;
+}
+
+static const int FREE_SLOT = -2;
+
+TriggerGrid::TriggerGrid(float cellSize, int expectedTriggers){
+	inverseCellSize = 1.0f / cellSize;
+	liveCount = 0;
+	usedCells = 0;
+	freeBlocks = -1;
+	size_t slotCount = 16;
+	while (slotCount < 4 * (size_t)expectedTriggers)
+		slotCount *= 2;
+	Cell unused = { 0, 0, 0, FREE_SLOT };
+	cells.assign(slotCount, unused);
+}
+
+static unsigned int hashCell(int x, int y, int z){
+	unsigned int hash = (unsigned int)x * 73856093u ^ (unsigned int)y * 19349663u ^ (unsigned int)z * 83492791u;
+	// The products leave the low bits of neighbouring cells alike : mix the high ones in
+	hash ^= hash >> 16;
+	hash *= 0x7feb352du;
+	hash ^= hash >> 15;
+	return hash;
+}
+
+int TriggerGrid::findCell(int x, int y, int z) const {
+	unsigned int mask = (unsigned int)cells.size() - 1;
+	for (unsigned int slot = hashCell(x, y, z) & mask; ; slot = (slot + 1) & mask){
+		const Cell & cell = cells[slot];
+		if (cell.block == FREE_SLOT)
+			return -1;
+		if (cell.x == x && cell.y == y && cell.z == z)
+			return (int)slot;
+	}
+}
+
+int TriggerGrid::insertCell(int x, int y, int z){
+	int slot = findCell(x, y, z);
+	if (slot >= 0)
+		return slot;
+	// Cells stay in the table once emptied, until it grows : only the ones holding triggers are moved
+	if (2 * (size_t)(usedCells + 1) > cells.size())
+		resizeCells(2 * cells.size());
+	unsigned int mask = (unsigned int)cells.size() - 1;
+	slot = (int)(hashCell(x, y, z) & mask);
+	while (cells[slot].block != FREE_SLOT)
+		slot = (slot + 1) & mask;
+	Cell cell = { x, y, z, -1 };
+	cells[slot] = cell;
+	usedCells++;
+	return slot;
+}
+
+void TriggerGrid::resizeCells(size_t slotCount){
+	std::vector<Cell> old;
+	old.swap(cells);
+	Cell unused = { 0, 0, 0, FREE_SLOT };
+	cells.assign(slotCount, unused);
+	usedCells = 0;
+	unsigned int mask = (unsigned int)slotCount - 1;
+	for (size_t i=0; i<old.size(); i++){
+		if (old[i].block < 0)
+			continue;
+		unsigned int slot = hashCell(old[i].x, old[i].y, old[i].z) & mask;
+		while (cells[slot].block != FREE_SLOT)
+			slot = (slot + 1) & mask;
+		cells[slot] = old[i];
+		usedCells++;
+	}
+}
+
+void TriggerGrid::getCells(const glm::vec3 & aabbMin, const glm::vec3 & aabbMax, int cellMin[3], int cellMax[3]) const {
+	for (int axis=0; axis<3; axis++){
+		cellMin[axis] = (int)floorf(aabbMin[axis] * inverseCellSize);
+		cellMax[axis] = (int)floorf(aabbMax[axis] * inverseCellSize);
+	}
+}
+
+int TriggerGrid::addSphere(const glm::vec3 & center, float radius, int tag){
+	CellItem item = { center - glm::vec3(radius), radius, center + glm::vec3(radius), 0 };
+	return add(item, tag);
+}
+
+int TriggerGrid::addBox(const glm::vec3 & aabbMin, const glm::vec3 & aabbMax, int tag){
+	CellItem item = { aabbMin, -1.0f, aabbMax, 0 };
+	return add(item, tag);
+}
+
+int TriggerGrid::add(const CellItem & item, int tag){
+	int index;
+	if (!freeTriggers.empty()){
+		index = freeTriggers.back();
+		freeTriggers.pop_back();
+	}else{
+		index = (int)triggers.size();
+		triggers.push_back(Trigger());
+	}
+	Trigger & trigger = triggers[index];
+	trigger.item = item;
+	trigger.item.trigger = index;
+	trigger.tag = tag;
+	trigger.live = true;
+
+	int cellMin[3], cellMax[3];
+	getCells(item.aabbMin, item.aabbMax, cellMin, cellMax);
+	for (int z=cellMin[2]; z<=cellMax[2]; z++)
+	for (int y=cellMin[1]; y<=cellMax[1]; y++)
+	for (int x=cellMin[0]; x<=cellMax[0]; x++){
+		int slot = insertCell(x, y, z);
+		int block = cells[slot].block;
+		if (block < 0 || blocks[block].count == (int)(sizeof(blocks[block].items) / sizeof(CellItem))){
+			// A new block in front of the full one
+			int newBlock;
+			if (freeBlocks >= 0){
+				newBlock = freeBlocks;
+				freeBlocks = blocks[newBlock].next;
+			}else{
+				newBlock = (int)blocks.size();
+				blocks.push_back(CellBlock());
+			}
+			blocks[newBlock].count = 0;
+			blocks[newBlock].next = block;
+			cells[slot].block = block = newBlock;
+		}
+		CellBlock & b = blocks[block];
+		b.items[b.count++] = trigger.item;
+	}
+	liveCount++;
+	return index;
+}
+
+void TriggerGrid::remove(int trigger){
+	Trigger & t = triggers[trigger];
+	if (!t.live)
+		return;
+	int cellMin[3], cellMax[3];
+	getCells(t.item.aabbMin, t.item.aabbMax, cellMin, cellMax);
+	for (int z=cellMin[2]; z<=cellMax[2]; z++)
+	for (int y=cellMin[1]; y<=cellMax[1]; y++)
+	for (int x=cellMin[0]; x<=cellMax[0]; x++){
+		Cell & cell = cells[findCell(x, y, z)];
+		// The last item of the newest block takes the place of the removed one
+		CellBlock & newest = blocks[cell.block];
+		for (int block = cell.block; block >= 0; block = blocks[block].next){
+			CellBlock & b = blocks[block];
+			int i = 0;
+			while (i < b.count && b.items[i].trigger != trigger)
+				i++;
+			if (i == b.count)
+				continue;
+			b.items[i] = newest.items[--newest.count];
+			break;
+		}
+		if (newest.count == 0){
+			int freed = cell.block;
+			cell.block = newest.next;
+			newest.next = freeBlocks;
+			freeBlocks = freed;
+		}
+	}
+	t.live = false;
+	freeTriggers.push_back(trigger);
+	liveCount--;
+
+	std::vector<int>::iterator found = std::lower_bound(inside.begin(), inside.end(), trigger);
+	if (found != inside.end() && *found == trigger)
+		inside.erase(found);
+}
+
+int TriggerGrid::query(const glm::vec3 & center, float radius, std::vector<int> & overlaps) const {
+	int queryMin[3], queryMax[3];
+	getCells(center - glm::vec3(radius), center + glm::vec3(radius), queryMin, queryMax);
+	int found = 0;
+	for (int z=queryMin[2]; z<=queryMax[2]; z++)
+	for (int y=queryMin[1]; y<=queryMax[1]; y++)
+	for (int x=queryMin[0]; x<=queryMax[0]; x++){
+		int slot = findCell(x, y, z);
+		if (slot < 0)
+			continue;
+		for (int block = cells[slot].block; block >= 0; block = blocks[block].next){
+			const CellBlock & b = blocks[block];
+			for (int i=0; i<b.count; i++){
+				const CellItem & item = b.items[i];
+				// A trigger filed in several of the cells is only tested in the first one, no need to remember
+				// what was seen. Past the first row of the query on an axis, that is the first row of the trigger.
+				if ((x != queryMin[0] && (int)floorf(item.aabbMin.x * inverseCellSize) != x) ||
+					(y != queryMin[1] && (int)floorf(item.aabbMin.y * inverseCellSize) != y) ||
+					(z != queryMin[2] && (int)floorf(item.aabbMin.z * inverseCellSize) != z))
+					continue;
+				bool overlap = item.radius >= 0.0f ? sphereOverlapsSphere(center, radius, 0.5f * (item.aabbMin + item.aabbMax), item.radius)
+				                                   : sphereOverlapsBox(center, radius, item.aabbMin, item.aabbMax);
+				if (overlap){
+					overlaps.push_back(item.trigger);
+					found++;
+				}
+			}
+		}
+	}
+	return found;
+}
+
+void TriggerGrid::track(const glm::vec3 & center, float radius, std::vector<TriggerEvent> & events){
+	current.clear();
+	query(center, radius, current);
+	std::sort(current.begin(), current.end());
+
+	// Both lists are sorted : one pass finds what was entered and what was left
+	size_t i = 0, j = 0;
+	while (i < current.size() || j < inside.size()){
+		if (j == inside.size() || (i < current.size() && current[i] < inside[j])){
+			TriggerEvent event = { current[i++], true };
+			events.push_back(event);
+		}else if (i == current.size() || inside[j] < current[i]){
+			TriggerEvent event = { inside[j++], false };
+			events.push_back(event);
+		}else{
+			i++;
+			j++;
+		}
+	}
+	inside.swap(current);
+}
+
+void TriggerGrid::setTracked(const glm::vec3 & center, float radius){
+	inside.clear();
+	query(center, radius, inside);
+	std::sort(inside.begin(), inside.end());
+}
+
+size_t TriggerGrid::getMemoryBytes() const {
+	return triggers.capacity() * sizeof(Trigger) + freeTriggers.capacity() * sizeof(int)
+	     + cells.capacity() * sizeof(Cell) + blocks.capacity() * sizeof(CellBlock)
+	     + (inside.capacity() + current.capacity()) * sizeof(int);
+}
+
+static float randomFloat(float min, float max){
+	return min + (max - min) * (rand() / (float)RAND_MAX);
+}
+
+// Nanoseconds per query, and overlaps found
+static double timeQueries(const TriggerGrid & grid, const std::vector<glm::vec3> & queries, float radius, long long & hits){
+	std::vector<int> overlaps;
+	hits = 0;
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	for (size_t i=0; i<queries.size(); i++){
+		overlaps.clear();
+		hits += grid.query(queries[i], radius, overlaps);
+	}
+	return std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count() / queries.size();
+}
+
+// The ball rolling along the track, weaving across it
+static glm::vec3 getBallPosition(float x, float width, float radius){
+	return glm::vec3(x, radius, 0.4f * width * sinf(x));
+}
+
+void runTriggerBenchmark(int triggerCount){
+	// Sizes of the real coins, spikes and ball
+	std::vector<glm::vec3> coin, spike, ball;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec3> normals;
+	if (!loadOBJ("Coin1.obj", coin, uvs, normals) || !loadOBJ("Spike3.obj", spike, uvs, normals) || !loadOBJ("Ball.obj", ball, uvs, normals))
+		return;
+	float coinRadius = computeBoundingSphere(coin).w;
+	float ballRadius = computeBoundingSphere(ball).w;
+	glm::vec3 spikeMin, spikeMax;
+	computeAABB(spike, spikeMin, spikeMax);
+	glm::vec3 spikeSize = spikeMax - spikeMin;
+
+	// A track 3 units wide, long enough for a trigger every 0.05 square unit : a little denser than the scene
+	srand(42); // Always the same track
+	const float width = 3.0f;
+	const float length = triggerCount * 0.05f / width;
+	std::vector<glm::vec3> centers(triggerCount);
+	for (int i=0; i<triggerCount; i++)
+		centers[i] = glm::vec3(randomFloat(0.0f, length), randomFloat(0.0f, 0.3f), randomFloat(-0.5f * width, 0.5f * width));
+
+	printf("Trigger benchmark : %d coins and spikes on a %.0f x %.0f track, ball radius %.3f\n", triggerCount, length, width, ballRadius);
+
+	typedef std::chrono::high_resolution_clock Clock;
+	Clock::time_point start = Clock::now();
+	TriggerGrid grid(0.4f, triggerCount);
+	std::vector<int> triggers(triggerCount);
+	for (int i=0; i<triggerCount; i++){
+		if (i % 2 == 0)
+			triggers[i] = grid.addSphere(centers[i], coinRadius, i);
+		else
+			triggers[i] = grid.addBox(centers[i] - 0.5f * spikeSize, centers[i] + 0.5f * spikeSize, i);
+	}
+	double insertNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / triggerCount;
+	printf("  insert  : %.1f ns/trigger, %.1f MB\n", insertNs, grid.getMemoryBytes() / (1024.0 * 1024.0));
+
+	// Queries along the path of the ball, as the game does them, then anywhere on the track : every cell is a cache miss
+	const int queryCount = 1000000;
+	std::vector<glm::vec3> queries(queryCount);
+	for (int i=0; i<queryCount; i++)
+		queries[i] = getBallPosition(length * i / queryCount, width, ballRadius);
+	long long hits;
+	double queryNs = timeQueries(grid, queries, ballRadius, hits);
+	printf("  query   : %.1f ns/query along the ball path, %.3f overlaps/query\n", queryNs, (double)hits / queryCount);
+	for (int i=0; i<queryCount; i++)
+		queries[i] = glm::vec3(randomFloat(0.0f, length), randomFloat(0.0f, 0.3f), randomFloat(-0.5f * width, 0.5f * width));
+	queryNs = timeQueries(grid, queries, ballRadius, hits);
+	printf("  query   : %.1f ns/query at random, %.3f overlaps/query\n", queryNs, (double)hits / queryCount);
+
+	// The same answers as testing every trigger, which is what the grid saves
+	const int bruteCount = 1000;
+	long long bruteHits = 0, gridHits = 0;
+	start = Clock::now();
+	for (int q=0; q<bruteCount; q++){
+		for (int i=0; i<triggerCount; i++){
+			bool overlap = i % 2 == 0 ? sphereOverlapsSphere(queries[q], ballRadius, centers[i], coinRadius)
+			                          : sphereOverlapsBox(queries[q], ballRadius, centers[i] - 0.5f * spikeSize, centers[i] + 0.5f * spikeSize);
+			bruteHits += overlap ? 1 : 0;
+		}
+	}
+	double bruteNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / bruteCount;
+	std::vector<int> overlaps;
+	for (int q=0; q<bruteCount; q++){
+		overlaps.clear();
+		gridHits += grid.query(queries[q], ballRadius, overlaps);
+	}
+	printf("  brute   : %.1f ns/query, %s the grid\n", bruteNs, bruteHits == gridHits ? "same overlaps as" : "MISMATCH with");
+
+	// Enter and exit events along the path
+	const int stepCount = 100000;
+	std::vector<TriggerEvent> events;
+	long long entered = 0;
+	start = Clock::now();
+	for (int s=0; s<stepCount; s++){
+		events.clear();
+		grid.track(getBallPosition(length * s / stepCount, width, ballRadius), ballRadius, events);
+		for (size_t e=0; e<events.size(); e++)
+			entered += events[e].entered ? 1 : 0;
+	}
+	double trackNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / stepCount;
+	printf("  track   : %.1f ns/step, %lld triggers entered\n", trackNs, entered);
+
+	// Every coin collected, then put back
+	start = Clock::now();
+	for (int i=0; i<triggerCount; i+=2)
+		grid.remove(triggers[i]);
+	double removeNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / ((triggerCount + 1) / 2);
+	int left = grid.getCount();
+	start = Clock::now();
+	for (int i=0; i<triggerCount; i+=2)
+		triggers[i] = grid.addSphere(centers[i], coinRadius, i);
+	double reinsertNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / ((triggerCount + 1) / 2);
+	printf("  remove  : %.1f ns/coin, %d spikes left, add back %.1f ns/coin\n", removeNs, left, reinsertNs);
+}
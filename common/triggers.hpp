@@ -0,0 +1,93 @@
+#ifndef TRIGGERS_HPP
+#define TRIGGERS_HPP
+
+// Trigger volumes.
+// Coins and spikes only need to know when the ball touches them : no rigid
+// body, only overlap tests between one sphere and many static volumes. The
+// volumes are bounding spheres or boxes, filed in a uniform grid of cells
+// found by hashing their coordinates, so the grid has no bounds and only
+// costs memory where there are volumes. A query only looks at the few cells
+// around the sphere. Volumes can be added and removed at any time.
+// With many volumes, a query is bound by cache misses rather than tests : a
+// cell holds copies of the bounds of its volumes, in blocks next to each
+// other, so that testing them reads one cell and one or two blocks.
+
+struct TriggerEvent {
+	int trigger;
+	bool entered; // False when the sphere left it
+};
+
+class TriggerGrid {
+public:
+	// cellSize : about the size of the biggest volumes. expectedTriggers sizes the hash table, which grows anyway.
+	TriggerGrid(float cellSize = 0.4f, int expectedTriggers = 256);
+
+	// Both return the index of the trigger. tag is the caller's own, see getTag().
+	int addSphere(const glm::vec3 & center, float radius, int tag = 0);
+	int addBox(const glm::vec3 & aabbMin, const glm::vec3 & aabbMax, int tag = 0);
+	// No exit event is sent for it. Its index is reused by the next add.
+	void remove(int trigger);
+
+	// Appends the triggers the sphere overlaps to overlaps, and returns how many there are
+	int query(const glm::vec3 & center, float radius, std::vector<int> & overlaps) const;
+
+	// Moves the tracked sphere, the ball : appends an event for every trigger it entered
+	// or left since the previous call
+	void track(const glm::vec3 & center, float radius, std::vector<TriggerEvent> & events);
+	// Moves the tracked sphere without any event, as if it had been there all along : after a rewind
+	void setTracked(const glm::vec3 & center, float radius);
+
+	int getTag(int trigger) const { return triggers[trigger].tag; }
+	int getCount() const { return liveCount; }
+	size_t getMemoryBytes() const;
+
+private:
+	// What a cell knows of a trigger : enough to test it
+	struct CellItem {
+		glm::vec3 aabbMin; // Bounds, of the sphere too
+		float radius;      // < 0 for a box
+		glm::vec3 aabbMax;
+		int trigger;
+	};
+	// Items of a cell. Only the newest block of a cell, the one the cell points to, is not full.
+	struct CellBlock {
+		int count;
+		int next; // Older block of the same cell, -1 for none. Next free block once freed.
+		CellItem items[3];
+	};
+	// Slot of the open addressing table of cells
+	struct Cell {
+		int x, y, z;
+		int block; // Newest block, -1 for an empty cell, FREE_SLOT for a slot no cell uses
+	};
+	struct Trigger {
+		CellItem item;
+		int tag;
+		bool live;
+	};
+
+	int add(const CellItem & item, int tag);
+	void getCells(const glm::vec3 & aabbMin, const glm::vec3 & aabbMax, int cellMin[3], int cellMax[3]) const;
+	int findCell(int x, int y, int z) const; // -1 if it was never used
+	int insertCell(int x, int y, int z);
+	void resizeCells(size_t slotCount);
+
+	float inverseCellSize;
+	std::vector<Trigger> triggers;
+	std::vector<int> freeTriggers;
+	int liveCount;
+	std::vector<Cell> cells; // A power of two of them, at most half used
+	int usedCells;
+	std::vector<CellBlock> blocks;
+	int freeBlocks;          // Chained through next
+
+	// Tracked sphere
+	std::vector<int> inside;  // Triggers it overlapped at the previous call, sorted
+	std::vector<int> current; // Scratch
+};
+
+// triggerCount coins and spikes along a long track : insertion, queries checked against
+// brute force, a ball rolling along it, then coins collected and put back
+void runTriggerBenchmark(int triggerCount);
+
+#endif
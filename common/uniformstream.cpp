@@ -0,0 +1,156 @@
+#include <vector>
+#include <string.h>
+#include <stdio.h>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "glextensions.hpp"
+#include "uniformstream.hpp"
+#include "profiler.hpp"
+
+static GLsizeiptr alignUp(GLsizeiptr size, GLsizeiptr alignment){
+	return (size + alignment - 1) / alignment * alignment;
+}
+
+UniformStream::UniformStream(){
+	buffer = 0;
+	frameCount = 0;
+	currentFrame = 0;
+	drawStride = frameOffset = segmentSize = 0;
+	segmentStart = 0;
+	writeOffset = 0;
+	persistent = false;
+	mapped = NULL;
+	stallCount = 0;
+	mapFailureCount = 0;
+}
+
+UniformStream::~UniformStream(){
+	cleanup();
+}
+
+void UniformStream::cleanup(){
+	if (buffer == 0)
+		return;
+	for (size_t i=0; i<fences.size(); i++)
+		if (fences[i])
+			glDeleteSync(fences[i]);
+	fences.clear();
+	if (mapped){
+		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+		glUnmapBuffer(GL_UNIFORM_BUFFER);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		mapped = NULL;
+	}
+	glDeleteBuffers(1, &buffer);
+	buffer = 0;
+}
+
+bool UniformStream::init(int maxDrawsPerFrame, int frameCount){
+	this->frameCount = frameCount;
+	fences.assign(frameCount, (GLsync)0);
+
+	// glBindBufferRange offsets must be multiples of this (often 256 bytes)
+	GLint alignment = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	drawStride  = alignUp(sizeof(DrawConstants), alignment);
+	frameOffset = alignUp(sizeof(FrameConstants), alignment);
+	segmentSize = alignUp(frameOffset + maxDrawsPerFrame * drawStride, alignment);
+	GLsizeiptr ringSize = segmentSize * frameCount;
+
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+
+	persistent = GLEW_VERSION_4_4 || isExtensionSupported("GL_ARB_buffer_storage");
+	if (persistent){
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_UNIFORM_BUFFER, ringSize, NULL, flags);
+		mapped = (unsigned char *)glMapBufferRange(GL_UNIFORM_BUFFER, 0, ringSize, flags);
+		if (mapped == NULL){
+			printf("Failed to map the uniform ring buffer\n");
+			return false;
+		}
+	}else{
+		glBufferData(GL_UNIFORM_BUFFER, ringSize, NULL, GL_STREAM_DRAW);
+	}
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	printf("Uniform ring : %d frames of %d bytes, %s mapping\n", frameCount, (int)segmentSize, persistent ? "persistent" : "per-frame");
+	return true;
+}
+
+void UniformStream::beginFrame(const FrameConstants & constants){
+	currentFrame = (currentFrame + 1) % frameCount;
+	segmentStart = currentFrame * segmentSize;
+
+	// The GPU may still be reading the constants of frame N - frameCount
+	GLsync & fence = fences[currentFrame];
+	if (fence){
+		GLenum result = glClientWaitSync(fence, 0, 0);
+		if (result == GL_TIMEOUT_EXPIRED){
+			PROFILE_SCOPE("UniformStream stall");
+			stallCount++;
+			do {
+				result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms
+			} while (result == GL_TIMEOUT_EXPIRED);
+		}
+		glDeleteSync(fence);
+		fence = 0;
+	}
+
+	if (!persistent){
+		// Unsynchronized : the fence above already guarantees the GPU is done with it
+		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+		mapped = (unsigned char *)glMapBufferRange(GL_UNIFORM_BUFFER, segmentStart, segmentSize,
+			GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		if (mapped == NULL){
+			// Nothing can be written : the frame is full, and its draws are skipped
+			if (mapFailureCount++ == 0)
+				printf("Failed to map the uniform ring buffer, frames are skipped\n");
+			writeOffset = segmentSize;
+			return;
+		}
+	}
+
+	memcpy(mapped + (persistent ? segmentStart : 0), &constants, sizeof(FrameConstants));
+	writeOffset = frameOffset;
+}
+
+GLintptr UniformStream::pushDraw(const DrawConstants & constants){
+	if (writeOffset + drawStride > segmentSize)
+		return -1;
+	memcpy(mapped + (persistent ? segmentStart : 0) + writeOffset, &constants, sizeof(DrawConstants));
+	GLintptr offset = segmentStart + writeOffset;
+	writeOffset += drawStride;
+	return offset;
+}
+
+void UniformStream::endWrites(){
+	if (!persistent && mapped){
+		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+		glUnmapBuffer(GL_UNIFORM_BUFFER);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		mapped = NULL;
+	}
+	glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_CONSTANTS_BINDING, buffer, segmentStart, sizeof(FrameConstants));
+}
+
+void UniformStream::bindDraw(GLintptr offset){
+	glBindBufferRange(GL_UNIFORM_BUFFER, DRAW_CONSTANTS_BINDING, buffer, offset, sizeof(DrawConstants));
+}
+
+void UniformStream::endFrame(){
+	fences[currentFrame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void bindUniformBlocks(GLuint programID){
+	GLuint frameIndex = glGetUniformBlockIndex(programID, "FrameConstants");
+	if (frameIndex != GL_INVALID_INDEX)
+		glUniformBlockBinding(programID, frameIndex, FRAME_CONSTANTS_BINDING);
+	GLuint drawIndex = glGetUniformBlockIndex(programID, "DrawConstants");
+	if (drawIndex != GL_INVALID_INDEX)
+		glUniformBlockBinding(programID, drawIndex, DRAW_CONSTANTS_BINDING);
+}
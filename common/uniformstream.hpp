@@ -0,0 +1,77 @@
+#ifndef UNIFORMSTREAM_HPP
+#define UNIFORMSTREAM_HPP
+
+// Streaming of uniforms through uniform buffers.
+// Constants shared by the whole frame live in one block, per-draw constants are
+// written into a ring buffer with a memcpy and selected with glBindBufferRange.
+// The ring holds a few frames : a fence per frame tells when the GPU is done
+// with a part of it, so that it can be written again without synchronizing.
+// With GL_ARB_buffer_storage the ring is mapped once, persistently. Otherwise
+// the part of the current frame is mapped with GL_MAP_UNSYNCHRONIZED_BIT.
+
+// Binding points of the uniform blocks, see bindUniformBlocks()
+#define FRAME_CONSTANTS_BINDING 0
+#define DRAW_CONSTANTS_BINDING  1
+
+// std140 layout of the "FrameConstants" block
+struct FrameConstants {
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::mat4 viewProjection;
+};
+
+// std140 layout of the "DrawConstants" block
+struct DrawConstants {
+	glm::mat4 model;
+	glm::vec4 tint;
+};
+
+class UniformStream {
+public:
+	UniformStream();
+	~UniformStream();
+
+	bool init(int maxDrawsPerFrame = 1024, int frameCount = 3);
+	// Deletes the buffer and the fences, with the context current
+	void cleanup();
+
+	// Waits until the GPU has finished the frame that last used this part of the ring
+	void beginFrame(const FrameConstants & constants);
+
+	// Copies the constants of one draw. Returns their offset, or -1 if the frame is full,
+	// or if its part of the ring couldn't be mapped.
+	GLintptr pushDraw(const DrawConstants & constants);
+
+	// Must be called after the last pushDraw() and before the first draw call
+	void endWrites();
+
+	// Selects the constants of one draw, as returned by pushDraw()
+	void bindDraw(GLintptr offset);
+
+	// Fences the commands that read this frame's constants
+	void endFrame();
+
+	bool isPersistent() const { return persistent; }
+	int getStallCount() const { return stallCount; }
+	GLsizeiptr getSize() const { return segmentSize * frameCount; }
+
+private:
+	GLuint buffer;
+	int frameCount;
+	int currentFrame;
+	GLsizeiptr drawStride;   // sizeof(DrawConstants) rounded up to the offset alignment
+	GLsizeiptr frameOffset;  // Where the draws start in a frame segment
+	GLsizeiptr segmentSize;  // Bytes per frame
+	GLintptr segmentStart;
+	GLsizeiptr writeOffset;  // Next free byte in the current segment
+	bool persistent;
+	unsigned char * mapped;  // Whole ring when persistent, current segment otherwise
+	std::vector<GLsync> fences;
+	int stallCount;
+	int mapFailureCount;
+};
+
+// Binds the "FrameConstants" and "DrawConstants" blocks of a program, if it has them
+void bindUniformBlocks(GLuint programID);
+
+#endif
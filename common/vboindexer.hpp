@@ -12,6 +12,18 @@ void indexVBO(
 	std::vector<glm::vec3> & out_normals
 );
 
+// Same, for meshes with more than 65536 unique vertices
+void indexVBO(
+	std::vector<glm::vec3> & in_vertices,
+	std::vector<glm::vec2> & in_uvs,
+	std::vector<glm::vec3> & in_normals,
+
+	std::vector<unsigned int> & out_indices,
+	std::vector<glm::vec3> & out_vertices,
+	std::vector<glm::vec2> & out_uvs,
+	std::vector<glm::vec3> & out_normals
+);
+
 
 void indexVBO_TBN(
 	std::vector<glm::vec3> & in_vertices,
@@ -3,7 +3,15 @@
 
 
 void TakeScreenshot(){
-	char * buffer = new char[54 + 1024*768*3];
+	// Whatever the size of the window
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	int width = viewport[2];
+	int height = viewport[3];
+	int rowSize = (width*3 + 3) & ~3; // BMP rows are padded to 4 bytes
+	int imageSize = rowSize*height;
+
+	char * buffer = new char[54 + imageSize];
 
 	char header[54] = {
 		0x42,0x4D,0x36,0x00,0x24,0x00,0x00,0x00,
@@ -15,16 +23,19 @@ void TakeScreenshot(){
 		0x00,0x00,0x00,0x00,0x00,0x00
 	};
 	for(int i=0; i<54;i++) buffer[i] = header[i];
-	*(int*)&(buffer[0x22]) = 1024*768*3;
-	*(int*)&(buffer[0x12]) = 1024;
-	*(int*)&(buffer[0x16]) = 768;
+	*(int*)&(buffer[0x02]) = 54 + imageSize;
+	*(int*)&(buffer[0x22]) = imageSize;
+	*(int*)&(buffer[0x12]) = width;
+	*(int*)&(buffer[0x16]) = height;
 
-	glReadPixels(0,0,1024,768, GL_BGR, GL_UNSIGNED_BYTE, buffer+54);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4); // Same padding as BMP
+	glReadPixels(0,0,width,height, GL_BGR, GL_UNSIGNED_BYTE, buffer+54);
 	
 	FILE * file = fopen("screenshot.bmp", "wb");
-	fwrite(buffer, 54+1024*768*3, 1, file);
+	fwrite(buffer, 54+imageSize, 1, file);
 	fclose(file);
 
+	delete[] buffer;
 };
 
 double Zero(){
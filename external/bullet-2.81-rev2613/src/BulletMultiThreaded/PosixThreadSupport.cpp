@@ -250,9 +250,14 @@ void PosixThreadSupport::stopSPU()
 		checkPThreadFunction(pthread_join(spuStatus.thread,0));
 
         }
-	printf("destroy main semaphore\n");
-        destroySem(mainSemaphore);
-	printf("main semaphore destroyed\n");
+	// Called again by the destructor after SpuCollisionTaskProcess stopped the threads
+	if (mainSemaphore)
+	{
+		printf("destroy main semaphore\n");
+		destroySem(mainSemaphore);
+		mainSemaphore = 0;
+		printf("main semaphore destroyed\n");
+	}
 	m_activeSpuStatus.clear();
 }
 
@@ -18,53 +18,368 @@ using namespace glm;
 #include "common/controls.hpp"
 
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
 
 #include <vector>
+#include <string>
+#include <string.h>
 #include "common/objloader.hpp"
-
-glm::mat4 getMVPMatrix() {
-	glm::mat4 Projection = glm::perspective(
+#include "common/mesh.hpp"
+#include "common/occlusion.hpp"
+#include "common/instanceculling.hpp"
+#include "common/uniformstream.hpp"
+#include "common/transform.hpp"
+#include "common/jobsystem.hpp"
+#include "common/perfoverlay.hpp"
+#include "common/ghosttracks.hpp"
+#include "common/ghosts.hpp"
+#include "common/renderthread.hpp"
+#include "common/gameloop.hpp"
+#include "common/rendercontext.hpp"
+#include "common/profiler.hpp"
+#include "common/benchmark.hpp"
+#include "common/capture.hpp"
+#include "common/gpuprofiler.hpp"
+#include "common/glstats.hpp"
+#include "common/collision.hpp"
+#include "common/physics.hpp"
+#include "common/triggers.hpp"
+#include "common/bvh.hpp"
+#include "common/simulation.hpp"
+#include "common/inputrecording.hpp"
+#include "common/snapshots.hpp"
+#include "common/ecs.hpp"
+
+// How an object takes part in the software occlusion culling
+enum OccluderType {
+	NOT_AN_OCCLUDER,
+	OCCLUDER_BOX,  // Flat objects : their bounding box is a good enough proxy
+	OCCLUDER_MESH  // Low-poly objects : their own triangles are rasterized
+};
+
+struct SceneMesh {
+	const char * file;
+	OccluderType occluder;
+	PhysicsType physics;
+	TriggerType trigger;
+};
+
+// Every object of the scene, in drawing order
+static const SceneMesh sceneMeshes[] = {
+	{ "GameFloor.obj", OCCLUDER_BOX,    PHYSICS_MESH, NOT_A_TRIGGER },
+	{ "Ball.obj",      NOT_AN_OCCLUDER, PHYSICS_BALL, NOT_A_TRIGGER },
+	{ "Spike1.obj",    NOT_AN_OCCLUDER, PHYSICS_HULL, SPIKE_TRIGGER },
+	{ "Spike2.obj",    NOT_AN_OCCLUDER, PHYSICS_HULL, SPIKE_TRIGGER },
+	{ "Spike3.obj",    OCCLUDER_MESH,   PHYSICS_HULL, SPIKE_TRIGGER },
+	{ "Spike4.obj",    OCCLUDER_MESH,   PHYSICS_HULL, SPIKE_TRIGGER },
+	{ "Spike5.obj",    OCCLUDER_MESH,   PHYSICS_HULL, SPIKE_TRIGGER },
+	{ "Spike6.obj",    NOT_AN_OCCLUDER, PHYSICS_HULL, SPIKE_TRIGGER },
+	{ "Spike7.obj",    NOT_AN_OCCLUDER, PHYSICS_HULL, SPIKE_TRIGGER },
+	{ "Spike8.obj",    NOT_AN_OCCLUDER, PHYSICS_HULL, SPIKE_TRIGGER },
+	{ "Spike9.obj",    OCCLUDER_MESH,   PHYSICS_HULL, SPIKE_TRIGGER },
+	{ "Spike10.obj",   OCCLUDER_MESH,   PHYSICS_HULL, SPIKE_TRIGGER },
+	{ "Spike11.obj",   NOT_AN_OCCLUDER, PHYSICS_HULL, SPIKE_TRIGGER },
+	{ "Coin1.obj",     NOT_AN_OCCLUDER, NO_PHYSICS,   COIN_TRIGGER },
+	{ "Coin2.obj",     NOT_AN_OCCLUDER, NO_PHYSICS,   COIN_TRIGGER },
+	{ "Coin3.obj",     NOT_AN_OCCLUDER, NO_PHYSICS,   COIN_TRIGGER },
+	{ "Coin4.obj",     NOT_AN_OCCLUDER, NO_PHYSICS,   COIN_TRIGGER },
+	{ "Coin5.obj",     NOT_AN_OCCLUDER, NO_PHYSICS,   COIN_TRIGGER },
+	{ "Coin6.obj",     NOT_AN_OCCLUDER, NO_PHYSICS,   COIN_TRIGGER },
+};
+static const int meshCount = sizeof(sceneMeshes) / sizeof(sceneMeshes[0]);
+
+// Color of every object
+static const glm::vec4 meshTint(0.0f, 0.0f, 1.0f, 1.0f);
+
+// Camera of the scene. It is the same for every object, so it goes in the per-frame constants.
+void getCameraMatrices(glm::mat4 & Projection, glm::mat4 & View) {
+	Projection = glm::perspective(
 		glm::radians(30.0f), // The vertical Field of View, usually between 90(extra wide) and 30(quite zoomed in)
 		4.0f / 3.0f, // Aspect Ratio. Depends on the sizeof your window.
 		0.1f, // Near clipping plane. Keep as big aspossible, or you'll get precision issues.
 		100.0f // Far clipping plane. Keep as littleas possible.
 	);
-	glm::mat4 View = glm::lookAt(
+	View = glm::lookAt(
 		glm::vec3(0, 5, 4), // Camera is at (4,3,3), in World Space
 		glm::vec3(0, 0.7, 1), // and looks at the origin
 		glm::vec3(0, 1, 0) // Head is up (set to 0,-1,0 to look upside - down)
 		);
-	glm::mat4 Model = glm::mat4(1.0f); // keep an identity matrix so the geometry stays where it was placed originally
-										// Our ModelViewProjection : multiplication of our 3 matrices
-	glm::mat4 mvp = Projection * View * Model; // Remember, matrix multiplication is the other way around
-	return mvp;
 }
 
-int main( void )
-{
-	// Initialise GLFW
-	if( !glfwInit() )
+// Camera of the benchmark : around the track and back to the usual view, in 10 seconds
+static const CameraKey benchmarkCameraPath[] = {
+	{  0.0f, glm::vec3( 0.0f, 5.0f,  4.0f), glm::vec3(0.0f, 0.7f,  1.0f) },
+	{  2.0f, glm::vec3( 3.0f, 3.0f,  3.0f), glm::vec3(1.0f, 0.0f,  0.0f) },
+	{  4.0f, glm::vec3( 4.0f, 1.5f, -2.5f), glm::vec3(1.0f, 0.0f,  0.0f) },
+	{  6.0f, glm::vec3(-1.5f, 1.0f, -3.0f), glm::vec3(1.0f, 0.0f, -0.5f) },
+	{  8.0f, glm::vec3(-2.0f, 3.0f,  2.0f), glm::vec3(0.5f, 0.0f,  0.5f) },
+	{ 10.0f, glm::vec3( 0.0f, 5.0f,  4.0f), glm::vec3(0.0f, 0.7f,  1.0f) },
+};
+static const int benchmarkCameraKeyCount = sizeof(benchmarkCameraPath) / sizeof(benchmarkCameraPath[0]);
+
+// Value following a command line option, NULL if the option isn't there
+static const char * getOption(int argc, char * argv[], const char * name){
+	for (int i=1; i<argc; i++)
+		if (strcmp(argv[i], name) == 0)
+			return i+1 < argc ? argv[i+1] : "";
+	return NULL;
+}
+
+// Collision cooking step : builds the collision data of every static object, next to its .obj
+static bool cookSceneCollision(){
+	bool cooked = true;
+	for (int i=0; i<meshCount; i++){
+		if (sceneMeshes[i].physics != PHYSICS_MESH && sceneMeshes[i].physics != PHYSICS_HULL)
+			continue;
+		std::vector<glm::vec3> vertices;
+		std::vector<glm::vec2> uvs;
+		std::vector<glm::vec3> normals;
+		if (!loadOBJ(sceneMeshes[i].file, vertices, uvs, normals))
+			return false;
+		std::string path = getCollisionPath(sceneMeshes[i].file);
+		if (sceneMeshes[i].physics == PHYSICS_MESH)
+			cooked = cookCollisionMesh(vertices, path.c_str()) && cooked;
+		else
+			cooked = cookCollisionHull(vertices, path.c_str()) && cooked;
+	}
+	return cooked;
+}
+
+// GL objects of the scene, only used by the render thread once the game runs
+struct SceneRenderer {
+	GLuint programID;
+	GLuint vertexArrayID;
+	const IndexedMesh * meshes;
+	UniformStream * uniformStream;
+	std::vector<GLintptr> drawConstants;
+	FrameCapture * capture; // NULL when not recording
+	GpuProfiler * gpuProfiler;
+	PerfOverlay * overlay;  // NULL without one
+	GhostRenderer * ghosts; // NULL without a ghost race
+	bool glStats;           // GL calls counted
+};
+
+// Draws a command list recorded by the game loop
+static void renderScene(void * data, const CommandList & commands){
+	PROFILE_FUNCTION();
+	SceneRenderer * scene = (SceneRenderer *)data;
+	GpuProfiler & gpuProfiler = *scene->gpuProfiler;
+	gpuProfiler.beginFrame();
+
+	// Clear the screen. It's not mentioned before Tutorial 02, but it can cause flickering, so it's there nonetheless.
 	{
-		fprintf( stderr, "Failed to initialize GLFW\n" );
-		getchar();
-		return -1;
+		GpuScope scope(gpuProfiler, "clear");
+		glClear( GL_COLOR_BUFFER_BIT );
 	}
 
-	glfwWindowHint(GLFW_SAMPLES, 4);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // To make MacOS happy; should not be needed
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	// Use our shader
+	glUseProgram(scene->programID);
 
-	// Open a window and create its OpenGL context
-	window = glfwCreateWindow( 1080, 720, "The Race against time!", NULL, NULL);
-	if( window == NULL ){
-		fprintf( stderr, "Failed to open GLFW window. If you have an Intel GPU, they are not 3.3 compatible. Try the 2.1 version of the tutorials.\n" );
-		getchar();
-		glfwTerminate();
-		return -1;
+	// Write the constants of every draw before drawing anything
+	scene->uniformStream->beginFrame(commands.frame);
+	scene->drawConstants.resize(commands.draws.size());
+	for (size_t i=0; i<commands.draws.size(); i++)
+		scene->drawConstants[i] = scene->uniformStream->pushDraw(commands.draws[i].constants);
+	scene->uniformStream->endWrites();
+
+	{
+		GpuScope scope(gpuProfiler, "scene");
+		for (size_t i=0; i<commands.draws.size(); i++){
+			if (scene->drawConstants[i] < 0)
+				continue;
+			scene->uniformStream->bindDraw(scene->drawConstants[i]);
+
+			// Draw the triangles
+			drawIndexedMesh(scene->meshes[commands.draws[i].mesh]);
+		}
+	}
+	if (scene->ghosts && commands.ghosts.getCount() > 0){
+		GpuScope scope(gpuProfiler, "ghosts");
+		scene->ghosts->draw(commands.ghosts);
+	}
+	glBindVertexArray(scene->vertexArrayID);
+	scene->uniformStream->endFrame();
+
+	if (scene->overlay){
+		GpuScope scope(gpuProfiler, "overlay");
+		scene->overlay->draw(commands.stats);
+		glBindVertexArray(scene->vertexArrayID);
+	}
+
+	glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+
+	if (scene->capture){
+		GpuScope scope(gpuProfiler, "capture");
+		scene->capture->capture();
+	}
+
+	gpuProfiler.endFrame();
+	if (gpuProfiler.hasNewStats())
+		gpuProfiler.printStats();
+#ifdef ENABLE_GL_STATS
+	if (scene->glStats)
+		glStatsEndFrame();
+#endif
+}
+
+int main( int argc, char * argv[] )
+{
+	// Chrome trace of the CPU markers, from startup to exit : --trace trace.json,
+	// then open it in chrome://tracing or https://ui.perfetto.dev
+	const char * tracePath = getOption(argc, argv, "--trace");
+	if (tracePath){
+#ifdef ENABLE_PROFILER
+		PROFILE_THREAD_NAME("main");
+		profilerStart();
+#else
+		printf("Built without ENABLE_PROFILER : --trace is ignored\n");
+		tracePath = NULL;
+#endif
+	}
+
+	// Times the startup phases, and the frames if it's a benchmark run
+	Benchmark benchmark;
+
+	// Headless benchmarks, no window needed
+	if (getOption(argc, argv, "--bench-occlusion")){
+		runOcclusionBenchmark();
+		return 0;
+	}
+	if (getOption(argc, argv, "--bench-jobs")){
+		runJobSystemBenchmark();
+		return 0;
+	}
+	// Writes the collision data the game then loads as is
+	if (getOption(argc, argv, "--cook-collision"))
+		return cookSceneCollision() ? 0 : 1;
+	// Ball against coins and spikes, without the physics : --bench-triggers [triggers]
+	if (getOption(argc, argv, "--bench-triggers")){
+		int triggerCount = atoi(getOption(argc, argv, "--bench-triggers"));
+		runTriggerBenchmark(triggerCount > 0 ? triggerCount : 100000);
+		return 0;
+	}
+	// Ray casts and sphere sweeps against the floor triangles
+	if (getOption(argc, argv, "--bench-bvh")){
+		runBvhBenchmark();
+		return 0;
+	}
+	// Decoding, culling and sorting of many ghost racers : --bench-ghosts [ghosts]
+	if (getOption(argc, argv, "--bench-ghosts")){
+		int ghostCount = atoi(getOption(argc, argv, "--bench-ghosts"));
+		runGhostBenchmark(ghostCount > 0 ? ghostCount : 5000);
+		return 0;
+	}
+	// Spawning, iterating and despawning entities : --bench-ecs [entities]
+	if (getOption(argc, argv, "--bench-ecs")){
+		int entityCount = atoi(getOption(argc, argv, "--bench-ecs"));
+		runEcsBenchmark(entityCount > 0 ? entityCount : 1000000);
+		return 0;
+	}
+	// Game rules only, as fast as they go, no GL : --simulate [games] [--ticks N] [--input script.txt]
+	// [--replay session.rec] [--record session.rec] [--record-ghosts race.ghosts] [--sweep] [--threads N] [--expect hash].
+	// Prints ticks per second and the hash of every final state.
+	// Or the cost of the rewind history, of the game then of many bodies : --bench-rewind [bodies]
+	if (getOption(argc, argv, "--simulate") || getOption(argc, argv, "--bench-rewind")){
+		std::vector<glm::vec3> vertices[meshCount];
+		GameObject objects[meshCount];
+		for (int i=0; i<meshCount; i++){
+			std::vector<glm::vec2> uvs;
+			std::vector<glm::vec3> normals;
+			if (!loadOBJ(sceneMeshes[i].file, vertices[i], uvs, normals))
+				return 1;
+			GameObject object = { sceneMeshes[i].file, sceneMeshes[i].physics, sceneMeshes[i].trigger, &vertices[i] };
+			objects[i] = object;
+		}
+		if (getOption(argc, argv, "--bench-rewind")){
+			int bodyCount = atoi(getOption(argc, argv, "--bench-rewind"));
+			runRewindBenchmark(objects, meshCount, bodyCount > 0 ? bodyCount : 200);
+			return 0;
+		}
+
+		SimulationRuns runs;
+		int runCount = atoi(getOption(argc, argv, "--simulate"));
+		runs.runCount = runCount > 0 ? runCount : 1;
+		if (getOption(argc, argv, "--ticks"))
+			runs.maxTicks = (unsigned int)atoi(getOption(argc, argv, "--ticks"));
+		runs.inputPath = getOption(argc, argv, "--input");
+		runs.replayPath = getOption(argc, argv, "--replay");
+		runs.recordPath = getOption(argc, argv, "--record");
+		runs.ghostPath = getOption(argc, argv, "--record-ghosts");
+		runs.sweep = getOption(argc, argv, "--sweep") != NULL;
+		if (getOption(argc, argv, "--threads"))
+			runs.threads = atoi(getOption(argc, argv, "--threads"));
+		unsigned int hash;
+		if (!runSimulations(objects, meshCount, runs, hash))
+			return 1;
+		// CI : fails if the games didn't end the same way as before
+		const char * expected = getOption(argc, argv, "--expect");
+		if (expected && strtoul(expected, NULL, 16) != hash){
+			printf("Expected 0x%08lx : the games played differently\n", strtoul(expected, NULL, 16));
+			return 1;
+		}
+		return 0;
+	}
+	// Thousands of falling bodies, to see how the physics scales : --bench-physics [bodies]
+	if (getOption(argc, argv, "--bench-physics")){
+		int bodyCount = atoi(getOption(argc, argv, "--bench-physics"));
+		runPhysicsBenchmark(bodyCount > 0 ? bodyCount : 2000);
+		return 0;
+	}
+	// Benchmarks that need a GL context run in a hidden window, or headless
+	bool benchCulling = getOption(argc, argv, "--bench-culling") != NULL;
+	// Draws on the main thread, to tell render thread issues from rendering ones
+	bool noRenderThread = getOption(argc, argv, "--no-render-thread") != NULL;
+	// No window nor display : draws offscreen, [N] frames (600 by default), then exits
+	const char * headlessOption = getOption(argc, argv, "--headless");
+	bool headless = headlessOption != NULL;
+	int frameLimit = headless ? (atoi(headlessOption) > 0 ? atoi(headlessOption) : 600) : 0;
+	// Repeatable run of N frames : fixed time step, scripted camera, measures written as JSON
+	//   --benchmark N [--json out.json] [--baseline earlier.json] [--threshold 0.1]
+	const char * benchmarkOption = getOption(argc, argv, "--benchmark");
+	bool benchmarking = benchmarkOption != NULL;
+	if (benchmarking)
+		frameLimit = atoi(benchmarkOption) > 0 ? atoi(benchmarkOption) : 600;
+	// Frame limit, 0 for none. Low on the kiosks, where power and heat matter more than frame rate.
+	double targetFrameRate = headless || benchmarking ? 0.0 : 60.0;
+	if (getOption(argc, argv, "--fps"))
+		targetFrameRate = atof(getOption(argc, argv, "--fps"));
+	// Records every frame, for QA : --capture video.y4m, or --capture frame%05d.bmp for one image per frame
+	const char * capturePath = getOption(argc, argv, "--capture");
+	// Performance overlay and tuning panel (F1), shown by default in a window unless benchmarking
+	bool showOverlay = getOption(argc, argv, "--overlay") != NULL;
+
+	HeadlessContext headlessContext;
+	if (headless){
+		// Offscreen context, drawn into a framebuffer object
+		if (!headlessContext.create(1080, 720))
+			return -1;
+	}else{
+		// Initialise GLFW
+		if( !glfwInit() )
+		{
+			fprintf( stderr, "Failed to initialize GLFW\n" );
+			getchar();
+			return -1;
+		}
+
+		glfwWindowHint(GLFW_SAMPLES, 4);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+		glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // To make MacOS happy; should not be needed
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+		if (benchCulling)
+			glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+
+		// Open a window and create its OpenGL context
+		window = glfwCreateWindow( 1080, 720, "The Race against time!", NULL, NULL);
+		if( window == NULL ){
+			fprintf( stderr, "Failed to open GLFW window. If you have an Intel GPU, they are not 3.3 compatible. Try the 2.1 version of the tutorials.\n" );
+			getchar();
+			glfwTerminate();
+			return -1;
+		}
+		glfwMakeContextCurrent(window);
 	}
-	glfwMakeContextCurrent(window);
 
 	// Initialize GLEW
 	glewExperimental = true; // Needed for core profile
@@ -75,13 +390,47 @@ int main( void )
 		return -1;
 	}
 
-	// Ensure we can capture the escape key being pressed below
-	glfwSetInputMode(window, GLFW_STICKY_KEYS, GL_TRUE);
-	// Hide the mouse and enable unlimited mouvement
-	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-	// Set the mouse at the center of the screen
-	glfwPollEvents();
-	glfwSetCursorPos(window, 1080 / 2, 720 / 2);
+	// GL calls per frame : --gl-stats. --gl-trace calls.gltrace [frame] also writes
+	// every call of one frame (the 60th by default) to a binary file.
+	bool glStats = getOption(argc, argv, "--gl-stats") || getOption(argc, argv, "--gl-trace");
+	if (glStats){
+#ifdef ENABLE_GL_STATS
+		glStatsInstall();
+		const char * glTracePath = getOption(argc, argv, "--gl-trace");
+		if (glTracePath && glTracePath[0]){
+			int traceFrame = 60;
+			for (int i=1; i<argc-2; i++)
+				if (strcmp(argv[i], "--gl-trace") == 0 && argv[i+2][0] != '-')
+					traceFrame = atoi(argv[i+2]);
+			glStatsTraceFrames(glTracePath, traceFrame, 1);
+		}
+#else
+		printf("Built without ENABLE_GL_STATS : --gl-stats and --gl-trace are ignored\n");
+		glStats = false;
+#endif
+	}
+
+	if (headless && !headlessContext.createFramebuffer())
+		return -1;
+	benchmark.endPhase("context");
+
+	if (benchCulling){
+		runInstanceCullingBenchmark();
+		glfwTerminate();
+		return 0;
+	}
+	WindowContext windowContext(window);
+	RenderContext * renderContext = headless ? (RenderContext *)&headlessContext : &windowContext;
+
+	if (window){
+		// Ensure we can capture the escape key being pressed below
+		glfwSetInputMode(window, GLFW_STICKY_KEYS, GL_TRUE);
+		// Hide the mouse and enable unlimited mouvement
+		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+		// Set the mouse at the center of the screen
+		glfwPollEvents();
+		glfwSetCursorPos(window, 1080 / 2, 720 / 2);
+	}
 
 	// Moccasin background
 	glClearColor(1.0f, 0.894f, 0.710f, 0.0f);	
@@ -91,233 +440,69 @@ int main( void )
 	glGenVertexArrays(1, &VertexArrayID);
 	glBindVertexArray(VertexArrayID);
 
-	//game floor
-	std::vector<glm::vec3> vertices;
-	std::vector<glm::vec2> uvs; // Won't be used at the moment.
-	std::vector<glm::vec3> normals; // Won't be used at the moment.
-	bool res = loadOBJ("GameFloor.obj", vertices, uvs, normals);
+	// Load every object of the scene
+	std::vector<glm::vec3> vertices[meshCount];
+	std::vector<glm::vec2> uvs[meshCount]; // Won't be used at the moment.
+	std::vector<glm::vec3> normals[meshCount]; // Won't be used at the moment.
+	IndexedMesh meshes[meshCount];
+	TransformHierarchy simulation; // State at the last tick
+	int sceneNodes[meshCount];
+	glm::vec3 aabbMin[meshCount], aabbMax[meshCount];
+	std::vector<glm::vec3> occluderTriangles[meshCount];
+	GameObject objects[meshCount];
+	for (int i=0; i<meshCount; i++){
+		loadOBJ(sceneMeshes[i].file, vertices[i], uvs[i], normals[i]);
+
+		// Shared vertices are only stored, and transformed, once
+		createIndexedMesh(vertices[i], uvs[i], normals[i], meshes[i]);
+
+		// Bounds and occluder proxy for the software occlusion culling
+		computeAABB(vertices[i], aabbMin[i], aabbMax[i]);
+		if (sceneMeshes[i].occluder == OCCLUDER_BOX)
+			makeBoxOccluder(aabbMin[i], aabbMax[i], occluderTriangles[i]);
+		else if (sceneMeshes[i].occluder == OCCLUDER_MESH)
+			occluderTriangles[i] = vertices[i];
+
+		GameObject object = { sceneMeshes[i].file, sceneMeshes[i].physics, sceneMeshes[i].trigger, &vertices[i] };
+		objects[i] = object;
+	}
 
-	GLuint vertexbuffer;
-	glGenBuffers(1, &vertexbuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-	//glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data), g_vertex_buffer_data, GL_STATIC_DRAW);
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), &vertices[0], GL_STATIC_DRAW);
-
-	//ball
-	std::vector<glm::vec3> vertices1;
-	std::vector<glm::vec2> uvs1; // Won't be used at the moment.
-	std::vector<glm::vec3> normals1; // Won't be used at the moment.
-	bool res1 = loadOBJ("Ball.obj", vertices1, uvs1, normals1);
-
-	GLuint vertexbuffer1;
-	glGenBuffers(1, &vertexbuffer1);
-	glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer1);
-	//glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data), g_vertex_buffer_data, GL_STATIC_DRAW);
-	glBufferData(GL_ARRAY_BUFFER, vertices1.size() * sizeof(glm::vec3), &vertices1[0], GL_STATIC_DRAW);
-
-	//Spike1
-	std::vector<glm::vec3> vertices2;
-	std::vector<glm::vec2> uvs2; // Won't be used at the moment.
-	std::vector<glm::vec3> normals2; // Won't be used at the moment.
-	bool res2 = loadOBJ("Spike1.obj", vertices2, uvs2, normals2);
-
-	GLuint vertexbuffer2;
-	glGenBuffers(1, &vertexbuffer2);
-	glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer2);
-	//glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data), g_vertex_buffer_data, GL_STATIC_DRAW);
-	glBufferData(GL_ARRAY_BUFFER, vertices2.size() * sizeof(glm::vec3), &vertices2[0], GL_STATIC_DRAW);
-
-	//Spike2
-	std::vector<glm::vec3> vertices3;
-	std::vector<glm::vec2> uvs3; // Won't be used at the moment.
-	std::vector<glm::vec3> normals3; // Won't be used at the moment.
-	bool res3 = loadOBJ("Spike2.obj", vertices3, uvs3, normals3);
-
-	GLuint vertexbuffer3;
-	glGenBuffers(1, &vertexbuffer3);
-	glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer3);
-	//glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data), g_vertex_buffer_data, GL_STATIC_DRAW);
-	glBufferData(GL_ARRAY_BUFFER, vertices3.size() * sizeof(glm::vec3), &vertices3[0], GL_STATIC_DRAW);
-
-	//Spike3
-	std::vector<glm::vec3> vertices4;
-	std::vector<glm::vec2> uvs4; // Won't be used at the moment.
-	std::vector<glm::vec3> normals4; // Won't be used at the moment.
-	bool res4 = loadOBJ("Spike3.obj", vertices4, uvs4, normals4);
-
-	GLuint vertexbuffer4;
-	glGenBuffers(1, &vertexbuffer4);
-	glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer4);
-	//glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data), g_vertex_buffer_data, GL_STATIC_DRAW);
-	glBufferData(GL_ARRAY_BUFFER, vertices4.size() * sizeof(glm::vec3), &vertices4[0], GL_STATIC_DRAW);
-
-	//Spike4
-	std::vector<glm::vec3> vertices5;
-	std::vector<glm::vec2> uvs5; // Won't be used at the moment.
-	std::vector<glm::vec3> normals5; // Won't be used at the moment.
-	bool res5 = loadOBJ("Spike4.obj", vertices5, uvs5, normals5);
-
-	GLuint vertexbuffer5;
-	glGenBuffers(1, &vertexbuffer5);
-	glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer5);
-	//glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data), g_vertex_buffer_data, GL_STATIC_DRAW);
-	glBufferData(GL_ARRAY_BUFFER, vertices5.size() * sizeof(glm::vec3), &vertices5[0], GL_STATIC_DRAW);
-
-	//Spike5
-	std::vector<glm::vec3> vertices6;
-	std::vector<glm::vec2> uvs6; // Won't be used at the moment.
-	std::vector<glm::vec3> normals6; // Won't be used at the moment.
-	bool res6 = loadOBJ("Spike5.obj", vertices6, uvs6, normals6);
-
-	GLuint vertexbuffer6;
-	glGenBuffers(1, &vertexbuffer6);
-	glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer6);
-	//glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data), g_vertex_buffer_data, GL_STATIC_DRAW);
-	glBufferData(GL_ARRAY_BUFFER, vertices6.size() * sizeof(glm::vec3), &vertices6[0], GL_STATIC_DRAW);
-
-	//Spike6
-	std::vector<glm::vec3> vertices7;
-	std::vector<glm::vec2> uvs7; // Won't be used at the moment.
-	std::vector<glm::vec3> normals7; // Won't be used at the moment.
-	bool res7 = loadOBJ("Spike6.obj", vertices7, uvs7, normals7);
-
-	GLuint vertexbuffer7;
-	glGenBuffers(1, &vertexbuffer7);
-	glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer7);
-	//glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data), g_vertex_buffer_data, GL_STATIC_DRAW);
-	glBufferData(GL_ARRAY_BUFFER, vertices7.size() * sizeof(glm::vec3), &vertices7[0], GL_STATIC_DRAW);
-
-	//Spike7
-	std::vector<glm::vec3> vertices8;
-	std::vector<glm::vec2> uvs8; // Won't be used at the moment.
-	std::vector<glm::vec3> normals8; // Won't be used at the moment.
-	bool res8 = loadOBJ("Spike7.obj", vertices8, uvs8, normals8);
-
-	GLuint vertexbuffer8;
-	glGenBuffers(1, &vertexbuffer8);
-	glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer8);
-	//glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data), g_vertex_buffer_data, GL_STATIC_DRAW);
-	glBufferData(GL_ARRAY_BUFFER, vertices8.size() * sizeof(glm::vec3), &vertices8[0], GL_STATIC_DRAW);
-
-	//Spike8
-	std::vector<glm::vec3> vertices9;
-	std::vector<glm::vec2> uvs9; // Won't be used at the moment.
-	std::vector<glm::vec3> normals9; // Won't be used at the moment.
-	bool res9 = loadOBJ("Spike8.obj", vertices9, uvs9, normals9);
-
-	GLuint vertexbuffer9;
-	glGenBuffers(1, &vertexbuffer9);
-	glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer9);
-	//glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data), g_vertex_buffer_data, GL_STATIC_DRAW);
-	glBufferData(GL_ARRAY_BUFFER, vertices9.size() * sizeof(glm::vec3), &vertices9[0], GL_STATIC_DRAW);
-
-	//Spike9
-	std::vector<glm::vec3> vertices10;
-	std::vector<glm::vec2> uvs10; // Won't be used at the moment.
-	std::vector<glm::vec3> normals10; // Won't be used at the moment.
-	bool res10 = loadOBJ("Spike9.obj", vertices10, uvs10, normals10);
-
-	GLuint vertexbuffer10;
-	glGenBuffers(1, &vertexbuffer10);
-	glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer10);
-	//glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data), g_vertex_buffer_data, GL_STATIC_DRAW);
-	glBufferData(GL_ARRAY_BUFFER, vertices10.size() * sizeof(glm::vec3), &vertices10[0], GL_STATIC_DRAW);
-
-	//Spike10
-	std::vector<glm::vec3> vertices11;
-	std::vector<glm::vec2> uvs11; // Won't be used at the moment.
-	std::vector<glm::vec3> normals11; // Won't be used at the moment.
-	bool res11 = loadOBJ("Spike10.obj", vertices11, uvs11, normals11);
-
-	GLuint vertexbuffer11;
-	glGenBuffers(1, &vertexbuffer11);
-	glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer11);
-	//glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data), g_vertex_buffer_data, GL_STATIC_DRAW);
-	glBufferData(GL_ARRAY_BUFFER, vertices11.size() * sizeof(glm::vec3), &vertices11[0], GL_STATIC_DRAW);
-
-	//Spike11
-	std::vector<glm::vec3> vertices12;
-	std::vector<glm::vec2> uvs12; // Won't be used at the moment.
-	std::vector<glm::vec3> normals12; // Won't be used at the moment.
-	bool res12 = loadOBJ("Spike11.obj", vertices12, uvs12, normals12);
-
-	GLuint vertexbuffer12;
-	glGenBuffers(1, &vertexbuffer12);
-	glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer12);
-	//glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data), g_vertex_buffer_data, GL_STATIC_DRAW);
-	glBufferData(GL_ARRAY_BUFFER, vertices12.size() * sizeof(glm::vec3), &vertices12[0], GL_STATIC_DRAW);
-
-	//Coin1
-	std::vector<glm::vec3> vertices13;
-	std::vector<glm::vec2> uvs13; // Won't be used at the moment.
-	std::vector<glm::vec3> normals13; // Won't be used at the moment.
-	bool res13 = loadOBJ("Coin1.obj", vertices13, uvs13, normals13);
-
-	GLuint vertexbuffer13;
-	glGenBuffers(1, &vertexbuffer13);
-	glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer13);
-	//glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data), g_vertex_buffer_data, GL_STATIC_DRAW);
-	glBufferData(GL_ARRAY_BUFFER, vertices13.size() * sizeof(glm::vec3), &vertices13[0], GL_STATIC_DRAW);
-
-	//Coin2
-	std::vector<glm::vec3> vertices14;
-	std::vector<glm::vec2> uvs14; // Won't be used at the moment.
-	std::vector<glm::vec3> normals14; // Won't be used at the moment.
-	bool res14 = loadOBJ("Coin2.obj", vertices14, uvs14, normals14);
-
-	GLuint vertexbuffer14;
-	glGenBuffers(1, &vertexbuffer14);
-	glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer14);
-	//glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data), g_vertex_buffer_data, GL_STATIC_DRAW);
-	glBufferData(GL_ARRAY_BUFFER, vertices14.size() * sizeof(glm::vec3), &vertices14[0], GL_STATIC_DRAW);
-
-	//Coin3
-	std::vector<glm::vec3> vertices15;
-	std::vector<glm::vec2> uvs15; // Won't be used at the moment.
-	std::vector<glm::vec3> normals15; // Won't be used at the moment.
-	bool res15 = loadOBJ("Coin3.obj", vertices15, uvs15, normals15);
-
-	GLuint vertexbuffer15;
-	glGenBuffers(1, &vertexbuffer15);
-	glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer15);
-	//glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data), g_vertex_buffer_data, GL_STATIC_DRAW);
-	glBufferData(GL_ARRAY_BUFFER, vertices15.size() * sizeof(glm::vec3), &vertices15[0], GL_STATIC_DRAW);
-
-	//Coin4
-	std::vector<glm::vec3> vertices16;
-	std::vector<glm::vec2> uvs16; // Won't be used at the moment.
-	std::vector<glm::vec3> normals16; // Won't be used at the moment.
-	bool res16 = loadOBJ("Coin4.obj", vertices16, uvs16, normals16);
-
-	GLuint vertexbuffer16;
-	glGenBuffers(1, &vertexbuffer16);
-	glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer16);
-	//glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data), g_vertex_buffer_data, GL_STATIC_DRAW);
-	glBufferData(GL_ARRAY_BUFFER, vertices16.size() * sizeof(glm::vec3), &vertices16[0], GL_STATIC_DRAW);
-
-	//Coin5
-	std::vector<glm::vec3> vertices17;
-	std::vector<glm::vec2> uvs17; // Won't be used at the moment.
-	std::vector<glm::vec3> normals17; // Won't be used at the moment.
-	bool res17 = loadOBJ("Coin5.obj", vertices17, uvs17, normals17);
-
-	GLuint vertexbuffer17;
-	glGenBuffers(1, &vertexbuffer17);
-	glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer17);
-	//glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data), g_vertex_buffer_data, GL_STATIC_DRAW);
-	glBufferData(GL_ARRAY_BUFFER, vertices17.size() * sizeof(glm::vec3), &vertices17[0], GL_STATIC_DRAW);
-
-	//Coin6
-	std::vector<glm::vec3> vertices18;
-	std::vector<glm::vec2> uvs18; // Won't be used at the moment.
-	std::vector<glm::vec3> normals18; // Won't be used at the moment.
-	bool res18 = loadOBJ("Coin6.obj", vertices18, uvs18, normals18);
-
-	GLuint vertexbuffer18;
-	glGenBuffers(1, &vertexbuffer18);
-	glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer18);
-	//glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data), g_vertex_buffer_data, GL_STATIC_DRAW);
-	glBufferData(GL_ARRAY_BUFFER, vertices18.size() * sizeof(glm::vec3), &vertices18[0], GL_STATIC_DRAW);
+	// The rules : ball, coins, spikes and timer.
+	// Narrowphase workers, none by default : the scene has only a few contacts
+	PhysicsConfig physicsConfig;
+	if (getOption(argc, argv, "--physics-threads"))
+		physicsConfig.collisionThreads = atoi(getOption(argc, argv, "--physics-threads"));
+	// Replays a recorded session instead of the keyboard : --replay session.rec. It stops at the end of
+	// the recording, unless a number of frames is set, and at the first checkpoint that differs.
+	const char * replayPath = getOption(argc, argv, "--replay");
+	InputReplay replay;
+	if (replayPath && !replay.open(replayPath))
+		return -1;
+	GameSimulation game(objects, meshCount, replayPath ? replay.getRules() : GameRules(), physicsConfig);
+	int ball = game.getBall();
+	int ballNode = -1; // Node moved by the ball's body
+	for (int i=0; i<meshCount; i++){
+		if (i == ball){
+			// The body node follows the sphere, and the mesh is drawn around its center
+			ballNode = simulation.create();
+			simulation.setPosition(ballNode, game.getBallCenter());
+			sceneNodes[i] = simulation.create(ballNode);
+			simulation.setPosition(sceneNodes[i], -game.getBallCenter());
+		}else{
+			sceneNodes[i] = simulation.create(); // keep an identity matrix so the geometry stays where it was placed originally
+		}
+	}
+	benchmark.endPhase("meshes");
+
+	// State at the tick before, and in between the two for rendering
+	TransformHierarchy previousTick = simulation;
+	TransformHierarchy transforms = simulation;
+
+	// Worker threads for the CPU side of the frame, one per core
+	JobSystem jobs;
+
+	// Small CPU depth buffer the occluders are rasterized into
+	OcclusionBuffer occlusionBuffer(256, 128, &jobs);
 
 	/*/static const GLfloat g_vertex_buffer_data[] = {
 		-1.0f,-1.0f,-1.0f, // triangle 1 : begin
@@ -431,376 +616,249 @@ int main( void )
 	glBufferData(GL_ARRAY_BUFFER, sizeof(g_color_buffer_data), g_color_buffer_data, GL_STATIC_DRAW);*/
 
 	GLuint programID = LoadShaders("SimpleVertexShader.vertexshader", "SimpleFragmentShader.fragmentshader");
+	benchmark.endPhase("shaders");
 
-	GLuint MatrixID1 = glGetUniformLocation(programID, "MVP");
-
-	do{
-		// Clear the screen. It's not mentioned before Tutorial 02, but it can cause flickering, so it's there nonetheless.
-		glClear( GL_COLOR_BUFFER_BIT );
-
-		glm::mat4 mvp1 = getMVPMatrix();
-		glUniformMatrix4fv(MatrixID1, 1, GL_FALSE, &mvp1[0][0]);
-
-		// Use our shader
-		glUseProgram(programID);
-
-		// 1rst attribute buffer : vertices
-
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-		glVertexAttribPointer(
-			0,                  // attribute 0. No particular reason for 0, but must match the layout in the shader.
-			3,                  // size
-			GL_FLOAT,           // type
-			GL_FALSE,           // normalized?
-			0,                  // stride
-			(void*)0            // array buffer offset
-		);
-
-		glDrawArrays(GL_TRIANGLES, 0, vertices.size() * sizeof(res));
-
-		glm::mat4 mvp2 = getMVPMatrix();
-		glUniformMatrix4fv(MatrixID1, 1, GL_FALSE, &mvp2[0][0]);
-
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer1);
-		glVertexAttribPointer(
-			0,                  // attribute 0. No particular reason for 0, but must match the layout in the shader.
-			3,                  // size
-			GL_FLOAT,           // type
-			GL_FALSE,           // normalized?
-			0,                  // stride
-			(void*)0            // array buffer offset
-		);
-
-		// Draw the triangles
-		
-		glDrawArrays(GL_TRIANGLES, 0, vertices1.size() * sizeof(res1));
-
-		//New mvp
-		glm::mat4 mvp3 = getMVPMatrix();
-		glUniformMatrix4fv(MatrixID1, 1, GL_FALSE, &mvp3[0][0]);
-
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer2);
-		glVertexAttribPointer(
-			0,                  // attribute 0. No particular reason for 0, but must match the layout in the shader.
-			3,                  // size
-			GL_FLOAT,           // type
-			GL_FALSE,           // normalized?
-			0,                  // stride
-			(void*)0            // array buffer offset
-		);
-
-		// Draw the triangles
-
-		glDrawArrays(GL_TRIANGLES, 0, vertices2.size() * sizeof(res2));
-
-		//New mvp
-		glm::mat4 mvp4 = getMVPMatrix();
-		glUniformMatrix4fv(MatrixID1, 1, GL_FALSE, &mvp4[0][0]);
-
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer3);
-		glVertexAttribPointer(
-			0,                  // attribute 0. No particular reason for 0, but must match the layout in the shader.
-			3,                  // size
-			GL_FLOAT,           // type
-			GL_FALSE,           // normalized?
-			0,                  // stride
-			(void*)0            // array buffer offset
-		);
-
-		// Draw the triangles
-
-		glDrawArrays(GL_TRIANGLES, 0, vertices3.size() * sizeof(res3));
-
-		//New mvp
-		glm::mat4 mvp5 = getMVPMatrix();
-		glUniformMatrix4fv(MatrixID1, 1, GL_FALSE, &mvp5[0][0]);
-
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer4);
-		glVertexAttribPointer(
-			0,                  // attribute 0. No particular reason for 0, but must match the layout in the shader.
-			3,                  // size
-			GL_FLOAT,           // type
-			GL_FALSE,           // normalized?
-			0,                  // stride
-			(void*)0            // array buffer offset
-		);
-
-		// Draw the triangles
-
-		glDrawArrays(GL_TRIANGLES, 0, vertices4.size() * sizeof(res4));
-
-		//New mvp
-		glm::mat4 mvp6 = getMVPMatrix();
-		glUniformMatrix4fv(MatrixID1, 1, GL_FALSE, &mvp6[0][0]);
-
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer5);
-		glVertexAttribPointer(
-			0,                  // attribute 0. No particular reason for 0, but must match the layout in the shader.
-			3,                  // size
-			GL_FLOAT,           // type
-			GL_FALSE,           // normalized?
-			0,                  // stride
-			(void*)0            // array buffer offset
-		);
-
-		// Draw the triangles
-
-		glDrawArrays(GL_TRIANGLES, 0, vertices5.size() * sizeof(res5));
-
-		//New mvp
-		glm::mat4 mvp7 = getMVPMatrix();
-		glUniformMatrix4fv(MatrixID1, 1, GL_FALSE, &mvp7[0][0]);
-
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer6);
-		glVertexAttribPointer(
-			0,                  // attribute 0. No particular reason for 0, but must match the layout in the shader.
-			3,                  // size
-			GL_FLOAT,           // type
-			GL_FALSE,           // normalized?
-			0,                  // stride
-			(void*)0            // array buffer offset
-		);
+	bindUniformBlocks(programID);
 
-		// Draw the triangles
-
-		glDrawArrays(GL_TRIANGLES, 0, vertices6.size() * sizeof(res6));
-
-		//New mvp
-		glm::mat4 mvp8 = getMVPMatrix();
-		glUniformMatrix4fv(MatrixID1, 1, GL_FALSE, &mvp8[0][0]);
-
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer7);
-		glVertexAttribPointer(
-			0,                  // attribute 0. No particular reason for 0, but must match the layout in the shader.
-			3,                  // size
-			GL_FLOAT,           // type
-			GL_FALSE,           // normalized?
-			0,                  // stride
-			(void*)0            // array buffer offset
-		);
-
-		// Draw the triangles
-
-		glDrawArrays(GL_TRIANGLES, 0, vertices7.size() * sizeof(res7));
-
-		//New mvp
-		glm::mat4 mvp9 = getMVPMatrix();
-		glUniformMatrix4fv(MatrixID1, 1, GL_FALSE, &mvp9[0][0]);
-
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer8);
-		glVertexAttribPointer(
-			0,                  // attribute 0. No particular reason for 0, but must match the layout in the shader.
-			3,                  // size
-			GL_FLOAT,           // type
-			GL_FALSE,           // normalized?
-			0,                  // stride
-			(void*)0            // array buffer offset
-		);
-
-		// Draw the triangles
-
-		glDrawArrays(GL_TRIANGLES, 0, vertices8.size() * sizeof(res8));
-
-		//New mvp
-		glm::mat4 mvp10 = getMVPMatrix();
-		glUniformMatrix4fv(MatrixID1, 1, GL_FALSE, &mvp10[0][0]);
-
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer9);
-		glVertexAttribPointer(
-			0,                  // attribute 0. No particular reason for 0, but must match the layout in the shader.
-			3,                  // size
-			GL_FLOAT,           // type
-			GL_FALSE,           // normalized?
-			0,                  // stride
-			(void*)0            // array buffer offset
-		);
-
-		// Draw the triangles
-
-		glDrawArrays(GL_TRIANGLES, 0, vertices9.size() * sizeof(res9));
-
-		//New mvp
-		glm::mat4 mvp11 = getMVPMatrix();
-		glUniformMatrix4fv(MatrixID1, 1, GL_FALSE, &mvp11[0][0]);
-
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer10);
-		glVertexAttribPointer(
-			0,                  // attribute 0. No particular reason for 0, but must match the layout in the shader.
-			3,                  // size
-			GL_FLOAT,           // type
-			GL_FALSE,           // normalized?
-			0,                  // stride
-			(void*)0            // array buffer offset
-		);
-
-		// Draw the triangles
-
-		glDrawArrays(GL_TRIANGLES, 0, vertices10.size() * sizeof(res10));
-
-		//New mvp
-		glm::mat4 mvp12 = getMVPMatrix();
-		glUniformMatrix4fv(MatrixID1, 1, GL_FALSE, &mvp12[0][0]);
-
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer11);
-		glVertexAttribPointer(
-			0,                  // attribute 0. No particular reason for 0, but must match the layout in the shader.
-			3,                  // size
-			GL_FLOAT,           // type
-			GL_FALSE,           // normalized?
-			0,                  // stride
-			(void*)0            // array buffer offset
-		);
-
-		// Draw the triangles
-
-		glDrawArrays(GL_TRIANGLES, 0, vertices11.size() * sizeof(res11));
-
-		//New mvp
-		glm::mat4 mvp13 = getMVPMatrix();
-		glUniformMatrix4fv(MatrixID1, 1, GL_FALSE, &mvp13[0][0]);
-
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer12);
-		glVertexAttribPointer(
-			0,                  // attribute 0. No particular reason for 0, but must match the layout in the shader.
-			3,                  // size
-			GL_FLOAT,           // type
-			GL_FALSE,           // normalized?
-			0,                  // stride
-			(void*)0            // array buffer offset
-		);
-
-		// Draw the triangles
-
-		glDrawArrays(GL_TRIANGLES, 0, vertices12.size() * sizeof(res12));
-
-		//New mvp
-		glm::mat4 mvp14 = getMVPMatrix();
-		glUniformMatrix4fv(MatrixID1, 1, GL_FALSE, &mvp14[0][0]);
-
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer13);
-		glVertexAttribPointer(
-			0,                  // attribute 0. No particular reason for 0, but must match the layout in the shader.
-			3,                  // size
-			GL_FLOAT,           // type
-			GL_FALSE,           // normalized?
-			0,                  // stride
-			(void*)0            // array buffer offset
-		);
-
-		// Draw the triangles
-
-		glDrawArrays(GL_TRIANGLES, 0, vertices13.size() * sizeof(res13));
-
-		//New mvp
-		glm::mat4 mvp15 = getMVPMatrix();
-		glUniformMatrix4fv(MatrixID1, 1, GL_FALSE, &mvp15[0][0]);
-
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer14);
-		glVertexAttribPointer(
-			0,                  // attribute 0. No particular reason for 0, but must match the layout in the shader.
-			3,                  // size
-			GL_FLOAT,           // type
-			GL_FALSE,           // normalized?
-			0,                  // stride
-			(void*)0            // array buffer offset
-		);
-
-		// Draw the triangles
-
-		glDrawArrays(GL_TRIANGLES, 0, vertices14.size() * sizeof(res14));
-
-		//New mvp
-		glm::mat4 mvp16 = getMVPMatrix();
-		glUniformMatrix4fv(MatrixID1, 1, GL_FALSE, &mvp16[0][0]);
-
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer15);
-		glVertexAttribPointer(
-			0,                  // attribute 0. No particular reason for 0, but must match the layout in the shader.
-			3,                  // size
-			GL_FLOAT,           // type
-			GL_FALSE,           // normalized?
-			0,                  // stride
-			(void*)0            // array buffer offset
-		);
-
-		// Draw the triangles
-
-		glDrawArrays(GL_TRIANGLES, 0, vertices15.size() * sizeof(res15));
-
-		//New mvp
-		glm::mat4 mvp17 = getMVPMatrix();
-		glUniformMatrix4fv(MatrixID1, 1, GL_FALSE, &mvp17[0][0]);
-
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer16);
-		glVertexAttribPointer(
-			0,                  // attribute 0. No particular reason for 0, but must match the layout in the shader.
-			3,                  // size
-			GL_FLOAT,           // type
-			GL_FALSE,           // normalized?
-			0,                  // stride
-			(void*)0            // array buffer offset
-		);
-
-		// Draw the triangles
-
-		glDrawArrays(GL_TRIANGLES, 0, vertices16.size() * sizeof(res16));
-
-		//New mvp
-		glm::mat4 mvp18 = getMVPMatrix();
-		glUniformMatrix4fv(MatrixID1, 1, GL_FALSE, &mvp18[0][0]);
-
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer17);
-		glVertexAttribPointer(
-			0,                  // attribute 0. No particular reason for 0, but must match the layout in the shader.
-			3,                  // size
-			GL_FLOAT,           // type
-			GL_FALSE,           // normalized?
-			0,                  // stride
-			(void*)0            // array buffer offset
-		);
-
-		// Draw the triangles
-
-		glDrawArrays(GL_TRIANGLES, 0, vertices17.size() * sizeof(res17));
-
-		//New mvp
-		glm::mat4 mvp19 = getMVPMatrix();
-		glUniformMatrix4fv(MatrixID1, 1, GL_FALSE, &mvp19[0][0]);
-
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer18);
-		glVertexAttribPointer(
-			0,                  // attribute 0. No particular reason for 0, but must match the layout in the shader.
-			3,                  // size
-			GL_FLOAT,           // type
-			GL_FALSE,           // normalized?
-			0,                  // stride
-			(void*)0            // array buffer offset
-		);
-
-		// Draw the triangles
+	// Camera constants once per frame, model matrix and tint once per draw
+	UniformStream uniformStream;
+	if (!uniformStream.init(meshCount)){
+		fprintf(stderr, "Failed to create the uniform ring buffer\n");
+		uniformStream.cleanup();
+		glfwTerminate();
+		return -1;
+	}
 
-		glDrawArrays(GL_TRIANGLES, 0, vertices18.size() * sizeof(res18));
+	// The render thread owns the context from now on, the game loop only records command lists
+	SceneRenderer sceneRenderer;
+	sceneRenderer.programID = programID;
+	sceneRenderer.vertexArrayID = VertexArrayID;
+	sceneRenderer.meshes = meshes;
+	sceneRenderer.uniformStream = &uniformStream;
+	sceneRenderer.capture = NULL;
+	// Balls of earlier games raced against, written by --simulate --record-ghosts : --ghosts race.ghosts
+	GhostPlayback ghostPlayback(&jobs);
+	GhostRenderer ghostRenderer;
+	sceneRenderer.ghosts = NULL;
+	if (getOption(argc, argv, "--ghosts") && ball >= 0){
+		GhostRace race;
+		if (!loadGhostRace(getOption(argc, argv, "--ghosts"), race))
+			return -1;
+		ghostPlayback.setRace(race);
+		if (ghostRenderer.init(vertices[ball], game.getBallCenter()))
+			sceneRenderer.ghosts = &ghostRenderer;
+		printf("%d ghost(s), %.2f MB\n", ghostPlayback.getCount(), ghostPlayback.getMemoryBytes() / (1024.0 * 1024.0));
+	}
+	// GPU time of each pass, to tell GPU bound frames from CPU bound ones
+	GpuProfiler gpuProfiler;
+	gpuProfiler.init();
+	sceneRenderer.gpuProfiler = &gpuProfiler;
+	// Features the tuning panel switches at runtime
+	PerfSettings perfSettings;
+	perfSettings.frameCap = (int)targetFrameRate;
+	PerfOverlay overlay;
+	sceneRenderer.overlay = NULL;
+	sceneRenderer.glStats = glStats;
+	if ((window && !benchCulling) || showOverlay){
+		if (overlay.init(1080, 720, &perfSettings, &gpuProfiler)){
+			size_t meshBytes = 0, geometryBytes = 0;
+			for (int i=0; i<meshCount; i++){
+				meshBytes += meshes[i].vertexCount * sizeof(glm::vec3) + meshes[i].indexCount * (meshes[i].indexType == GL_UNSIGNED_SHORT ? 2 : 4);
+				geometryBytes += (vertices[i].capacity() + normals[i].capacity() + occluderTriangles[i].capacity()) * sizeof(glm::vec3) + uvs[i].capacity() * sizeof(glm::vec2);
+			}
+			overlay.addMemoryCategory("GPU meshes", meshBytes);
+			overlay.addMemoryCategory("CPU geometry", geometryBytes);
+			overlay.addMemoryCategory("uniform ring", uniformStream.getSize());
+			overlay.addMemoryCategory("occlusion buffer", occlusionBuffer.getMemoryBytes());
+			overlay.addMemoryCategory("triggers", game.getTriggers().getMemoryBytes());
+			if (sceneRenderer.ghosts)
+				overlay.addMemoryCategory("ghosts", ghostPlayback.getMemoryBytes());
+			if (window)
+				overlay.attachInput(window);
+			overlay.setVisible(showOverlay || !benchmarking);
+			sceneRenderer.overlay = &overlay;
+		}
+	}
+	FrameCapture capture;
+	if (capturePath){
+		size_t length = strlen(capturePath);
+		bool y4m = length > 4 && strcmp(capturePath + length - 4, ".y4m") == 0;
+		if (capture.init(capturePath, y4m ? CAPTURE_Y4M : CAPTURE_BMP, targetFrameRate > 0.0 ? (int)targetFrameRate : 60))
+			sceneRenderer.capture = &capture;
+	}
+	RenderThread renderThread;
+	renderThread.start(renderContext, renderScene, &sceneRenderer, 2, !noRenderThread);
+
+	// Fixed simulation rate, whatever the frame rate
+	GameLoop gameLoop(replayPath ? replay.getTickRate() : 60, targetFrameRate);
+	if (benchmarking)
+		gameLoop.setFixedFrameTime(gameLoop.getTickDuration()); // One tick per frame, however fast the machine
+	// Records the input of every tick, to play the session again : --record session.rec
+	InputRecorder recorder;
+	if (getOption(argc, argv, "--record"))
+		recorder.open(getOption(argc, argv, "--record"), replayPath ? replay.getRules() : GameRules(), replayPath ? replay.getTickRate() : 60);
+	game.start(gameLoop.getTickDuration());
+	// The last 30 s, to rewind them while R is held. Not with a recording : replays can't rewind.
+	bool canRewind = window && !benchmarking && replayPath == NULL && !recorder.isOpen();
+	SnapshotRing history(game.getStateWords(), canRewind ? (int)(30.0 / gameLoop.getTickDuration() + 0.5) : 1);
+	std::vector<uint32_t> snapshot(game.getStateWords());
+	benchmark.endPhase("setup");
+
+	int appliedFrameCap = perfSettings.frameCap;
+	std::chrono::steady_clock::time_point previousFrameStart = std::chrono::steady_clock::now();
 
-		glDisableVertexAttribArray(0);
+	do{
+		PROFILE_SCOPE("frame");
+		benchmark.beginFrame();
+		gameLoop.beginFrame();
+
+		// Measures for the overlay
+		FrameStats stats = {};
+		std::chrono::steady_clock::time_point sectionStart = std::chrono::steady_clock::now();
+		stats.frameMs = std::chrono::duration<float, std::milli>(sectionStart - previousFrameStart).count();
+		previousFrameStart = sectionStart;
+
+		// Changes from the tuning panel
+		if (perfSettings.frameCap != appliedFrameCap){
+			appliedFrameCap = perfSettings.frameCap;
+			gameLoop.setTargetFrameRate(appliedFrameCap);
+		}
+		occlusionBuffer.setJobSystem(perfSettings.parallelOcclusion ? &jobs : NULL);
+		bool occlusionCulling = perfSettings.occlusionCulling;
+
+		{
+			PROFILE_SCOPE("simulation");
+			while (gameLoop.tick()){
+				previousTick = simulation;
+
+				// One tick back per tick, down to the oldest one kept
+				bool rewinding = canRewind && glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS;
+				if (rewinding && !history.isEmpty() && game.getTickCount() > history.getOldestTick() &&
+					history.restore(game.getTickCount() - 1, &snapshot[0])){
+					history.discardAfter(game.getTickCount() - 1);
+					game.restoreState(&snapshot[0]);
+				}
+
+				// Input of the tick : the recording, or WASD pushing the ball
+				GameInput input = { 0.0f, 0.0f };
+				if (replayPath){
+					input = replay.next();
+				}else if (window && !benchmarking){
+					input.pushX = (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS ? 1.0f : 0.0f) - (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS ? 1.0f : 0.0f);
+					input.pushZ = (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS ? 1.0f : 0.0f) - (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS ? 1.0f : 0.0f);
+				}
+				if (recorder.isOpen())
+					input = recorder.record(input);
+				GameStatus status = game.getStatus();
+				if (!rewinding){
+					game.tick(input);
+					if (canRewind){
+						game.saveState(&snapshot[0]);
+						history.capture(game.getTickCount(), &snapshot[0]);
+					}
+				}
+				if (recorder.isOpen())
+					recorder.endTick(game.hashState());
+				if (replayPath && replay.getDesyncTick() == 0 && !replay.check(game.hashState()))
+					printf("The replay differs from the recording at its checkpoint of tick %u\n", replay.getDesyncTick());
+				if (ballNode >= 0){
+					glm::vec3 position;
+					glm::quat rotation;
+					game.getBallTransform(position, rotation);
+					simulation.setPosition(ballNode, position);
+					simulation.setRotation(ballNode, rotation);
+				}
+
+				// What the ball touched during the tick
+				const std::vector<GameEvent> & events = game.getEvents();
+				for (size_t e=0; e<events.size(); e++){
+					if (events[e].type == COIN_TRIGGER)
+						printf("%s collected, %d/%d\n", sceneMeshes[events[e].object].file, game.getCoinsCollected(), game.getCoinCount());
+					else
+						printf("%s hit, %d hit(s), %.1f s left\n", sceneMeshes[events[e].object].file, game.getSpikeHits(), game.getTimeLeft());
+				}
+				if (status == GAME_RUNNING && game.getStatus() == GAME_WON)
+					printf("Every coin collected, with %.2f s left\n", game.getTimeLeft());
+				else if (status == GAME_RUNNING && game.getStatus() == GAME_TIME_UP)
+					printf("Time's up : %d/%d coins\n", game.getCoinsCollected(), game.getCoinCount());
+				else if (status == GAME_RUNNING && game.getStatus() == GAME_FELL)
+					printf("The ball fell off the track\n");
+			}
+		}
+		stats.simulationMs = millisecondsSince(sectionStart);
+		stats.physicsMs = game.getPhysics().getLastStepMs();
+		stats.contacts = game.getPhysics().getLastContacts();
+
+		// Draw in between the last two ticks, so that motion stays smooth when frames and ticks don't line up
+		transforms.interpolate(previousTick, simulation, gameLoop.getAlpha());
+
+		// Waits only if the render thread is still busy with the frame before the previous one
+		CommandList & commands = renderThread.beginRecording();
+
+		FrameConstants & frame = commands.frame;
+		getCameraMatrices(frame.projection, frame.view);
+		if (benchmarking){
+			// Scripted camera, driven by the simulated time only
+			float time = (float)((gameLoop.getTickCount() - 1 + gameLoop.getAlpha()) * gameLoop.getTickDuration());
+			glm::vec3 position, target;
+			sampleCameraPath(benchmarkCameraPath, benchmarkCameraKeyCount, time, position, target);
+			frame.view = glm::lookAt(position, target, glm::vec3(0, 1, 0));
+		}
+		frame.viewProjection = frame.projection * frame.view; // Remember, matrix multiplication is the other way around
+
+		// Only what moved, or everything if the camera moved
+		sectionStart = std::chrono::steady_clock::now();
+		{
+			PROFILE_SCOPE("transforms");
+			transforms.update();
+			transforms.computeMVP(frame.viewProjection);
+		}
+		stats.transformsMs = millisecondsSince(sectionStart);
+
+		// Ghosts at the time of the frame, so they rewind with the game
+		sectionStart = std::chrono::steady_clock::now();
+		if (sceneRenderer.ghosts){
+			PROFILE_SCOPE("ghosts");
+			ghostPlayback.update(game.getTickCount() - 1 + gameLoop.getAlpha());
+			glm::vec3 camera = glm::vec3(glm::inverse(frame.view)[3]);
+			ghostPlayback.buildInstances(frame.viewProjection, camera, game.getBallRadius(), commands.ghosts);
+			stats.ghosts = commands.ghosts.getCount();
+		}
+		stats.ghostsMs = millisecondsSince(sectionStart);
+
+		// Rasterize the occluders, so that hidden objects can be skipped below
+		sectionStart = std::chrono::steady_clock::now();
+		if (occlusionCulling){
+			PROFILE_SCOPE("occlusion");
+			occlusionBuffer.clear();
+			for (int i=0; i<meshCount; i++){
+				if (sceneMeshes[i].occluder != NOT_AN_OCCLUDER)
+					occlusionBuffer.addOccluder(occluderTriangles[i], transforms.getMVP(sceneNodes[i]));
+			}
+			occlusionBuffer.rasterize();
+		}
+		stats.occlusionMs = millisecondsSince(sectionStart);
+
+		// Record every visible object
+		sectionStart = std::chrono::steady_clock::now();
+		{
+			PROFILE_SCOPE("record");
+			for (int i=0; i<meshCount; i++){
+				if (game.isCollected(i))
+					continue;
+				if (occlusionCulling && !occlusionBuffer.isVisible(aabbMin[i], aabbMax[i], transforms.getMVP(sceneNodes[i]))){
+					stats.culledObjects++;
+					continue;
+				}
+				DrawCommand draw = { i, { transforms.getWorld(sceneNodes[i]), meshTint } };
+				commands.draws.push_back(draw);
+				stats.triangles += meshes[i].indexCount / 3;
+			}
+		}
+		stats.recordMs = millisecondsSince(sectionStart);
+		stats.drawCalls = (int)commands.draws.size();
+		commands.stats = stats;
+		benchmark.setDrawCalls((int)commands.draws.size());
 
 		/* 1st attribute buffer : vertices
 		glEnableVertexAttribArray(0);
@@ -832,42 +890,92 @@ int main( void )
 		glDisableVertexAttribArray(0);
 
 		glDisableVertexAttribArray(1);*/
-		
-		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
-		// Swap buffers
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+		// Drawn, and swapped, while the next frame is recorded
+		renderThread.submit();
+
+		gameLoop.endFrame();
+		if (gameLoop.hasNewStats()){
+			const GameLoopStats & stats = gameLoop.getStats();
+			printf("%.2f ms/frame (%.2f ms busy, %.2f ms limiter), %.3f ms/tick, %.1f fps, %.1f ticks/s, %d ticks dropped\n",
+				stats.frameMs, stats.workMs, stats.sleepMs, stats.tickMs, stats.framesPerSecond, stats.ticksPerSecond, stats.droppedTicks);
+		}
+		if (game.getPhysics().hasNewStats())
+			game.getPhysics().printStats();
+
+		if (window)
+			glfwPollEvents();
+
+	} // Check if the ESC key was pressed or the window was closed, or if enough frames were drawn, or the replay is over
+	while( (frameLimit == 0 || gameLoop.getFrameCount() < (unsigned int)frameLimit) &&
+		   (replayPath == NULL || frameLimit > 0 || (!replay.isOver() && replay.getDesyncTick() == 0)) &&
+		   (window == NULL || (glfwGetKey(window, GLFW_KEY_ESCAPE ) != GLFW_PRESS &&
+		   glfwWindowShouldClose(window) == 0)) );
+
+	// Draws what is left, and gives the context back
+	game.stop();
+	if (recorder.isOpen()){
+		recorder.close();
+		printf("Recorded %u ticks in %u bytes\n", recorder.getTickCount(), (unsigned int)recorder.getByteCount());
+	}
+	renderThread.stop();
+	overlay.cleanup();
+	ghostRenderer.cleanup();
+	gpuProfiler.cleanup();
+	uniformStream.cleanup();
+	if (sceneRenderer.capture)
+		capture.finish();
+	glFinish();
+
+	int exitCode = 0;
+	if (replayPath){
+		unsigned int played = gameLoop.getTickCount() < replay.getTickCount() ? gameLoop.getTickCount() : replay.getTickCount();
+		printf("Replay : %u of %u ticks played, %d of %d checkpoints passed\n", played,
+			replay.getTickCount(), replay.getCheckpointsPassed(), replay.getCheckpointCount());
+		if (replay.getDesyncTick() > 0)
+			exitCode = 1;
+	}
+	if (headless)
+		printf("Headless : %u frames, %u ticks\n", gameLoop.getFrameCount(), gameLoop.getTickCount());
+	if (benchmarking){
+		// Offscreen, the last frame can be read back to check the rendering didn't change
+		unsigned int checksum = 0;
+		if (headless){
+			std::vector<unsigned char> pixels;
+			headlessContext.readPixels(pixels);
+			checksum = hashBytes(&pixels[0], pixels.size());
+		}
+		benchmark.finish(checksum);
+		benchmark.printSummary();
+		if (getOption(argc, argv, "--json"))
+			benchmark.writeJSON(getOption(argc, argv, "--json"));
+		if (getOption(argc, argv, "--baseline")){
+			float threshold = getOption(argc, argv, "--threshold") ? (float)atof(getOption(argc, argv, "--threshold")) : 0.1f;
+			if (!benchmark.compareWithBaseline(getOption(argc, argv, "--baseline"), threshold))
+				exitCode = 1;
+		}
+	}
 
-	} // Check if the ESC key was pressed or the window was closed
-	while( glfwGetKey(window, GLFW_KEY_ESCAPE ) != GLFW_PRESS &&
-		   glfwWindowShouldClose(window) == 0 );
+#ifdef ENABLE_GL_STATS
+	if (glStats)
+		glStatsPrintSummary();
+#endif
+
+#ifdef ENABLE_PROFILER
+	if (tracePath){
+		profilerStop();
+		profilerWriteChromeTrace(tracePath);
+	}
+#endif
 
 	// Close OpenGL window and terminate GLFW
 	glfwTerminate();
 
-	return 0;
+	return exitCode;
 
 	// Cleanup VBO and shader
-	glDeleteBuffers(1, &vertexbuffer);
-	glDeleteBuffers(1, &vertexbuffer1);
-	glDeleteBuffers(1, &vertexbuffer2);
-	glDeleteBuffers(1, &vertexbuffer3);
-	glDeleteBuffers(1, &vertexbuffer4);
-	glDeleteBuffers(1, &vertexbuffer5);
-	glDeleteBuffers(1, &vertexbuffer6);
-	glDeleteBuffers(1, &vertexbuffer7);
-	glDeleteBuffers(1, &vertexbuffer8);
-	glDeleteBuffers(1, &vertexbuffer9);
-	glDeleteBuffers(1, &vertexbuffer10);
-	glDeleteBuffers(1, &vertexbuffer11);
-	glDeleteBuffers(1, &vertexbuffer12);
-	glDeleteBuffers(1, &vertexbuffer13);
-	glDeleteBuffers(1, &vertexbuffer14);
-	glDeleteBuffers(1, &vertexbuffer15);
-	glDeleteBuffers(1, &vertexbuffer16);
-	glDeleteBuffers(1, &vertexbuffer17);
-	glDeleteBuffers(1, &vertexbuffer18);
+	for (int i=0; i<meshCount; i++)
+		deleteIndexedMesh(meshes[i]);
 	glDeleteProgram(programID);
 	glDeleteVertexArrays(1, &VertexArrayID);
 